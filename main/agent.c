@@ -1,11 +1,21 @@
 #include "agent.h"
+#include "channel.h"
 #include "config.h"
 #include "llm.h"
 #include "tools.h"
 #include "user_tools.h"
+#include "tool_script.h"
 #include "json_util.h"
+#include "history.h"
+#include "session.h"
+#include "input_sched.h"
+#include "command_router.h"
+#include "buffers.h"
+#include "token_estimate.h"
 #include "messages.h"
+#include "msg_pool.h"
 #include "ratelimit.h"
+#include "text_buffer.h"
 #include "cJSON.h"
 #include "esp_timer.h"
 #include "esp_log.h"
@@ -28,23 +38,109 @@ static QueueHandle_t s_input_queue;
 static QueueHandle_t s_channel_output_queue;
 static QueueHandle_t s_telegram_output_queue;
 
-// Conversation history (rolling message buffer)
-static conversation_msg_t s_history[MAX_HISTORY_TURNS * 2];
-static int s_history_len = 0;
+// History of the session being processed (byte-budgeted ring, oldest
+// messages evicted first); one per message origin, see session.h
+static history_t *s_history;
+static bool s_compact_enabled = HISTORY_COMPACT_ENABLED;
+static size_t s_token_budget = LLM_INPUT_TOKEN_BUDGET;
+static uint32_t s_coalesce_window_ms = AGENT_COALESCE_WINDOW_MS;
+static int64_t s_last_turn_end_us;              // When dispatch_next last finished a message
+static bool s_router_enabled = COMMAND_ROUTER_ENABLED;
+static bool s_plan_mode = AGENT_PLAN_MODE_ENABLED;
+static uint32_t s_router_messages;
+static uint32_t s_router_hits;
 
-// Buffers (static to avoid stack overflow)
-static char s_response_buf[LLM_RESPONSE_BUF_SIZE];
+// Buffers (static or allocated once at startup, to avoid stack overflow)
+static char *s_request_buf;                     // LLM_REQUEST_BUF_SIZE, bulk (PSRAM if present)
+static json_request_cache_t s_request_cache;    // Serialized prefix of s_history in s_request_buf
+static char *s_response_buf;                    // response_buf_size(), bulk
 static char s_tool_result_buf[TOOL_RESULT_BUF_SIZE];
+static char s_step_result_buf[TOOL_RESULT_BUF_SIZE];    // Results of replayed steps
+static char s_turn_text[MAX_MESSAGE_LEN];       // User text of the dispatched turn
+
+// Text delivered while an LLM response is still streaming
+typedef struct {
+    size_t round_chars;                         // Chars forwarded during the current LLM call
+    char telegram_pending[TELEGRAM_MAX_MSG_LEN];
+    size_t telegram_pending_len;
+} stream_output_t;
+
+static stream_output_t s_stream_out;
+
+// Progressive Telegram reply: while a Telegram request runs, the send task
+// keeps one message open and replaces its text with each snapshot. The reply
+// text so far lives in s_stream_out.telegram_pending.
+typedef struct {
+    bool active;
+    int64_t last_progress_us;       // When the last snapshot was queued
+} telegram_reply_t;
+
+static bool s_progressive_replies = TELEGRAM_PROGRESSIVE_REPLIES;
+static telegram_reply_t s_reply;
+
+// Plan mode: the model sends every step of a task in one run_plan call
+#define AGENT_PLAN_TOOL "run_plan"
+
+static const tool_def_t s_run_plan_tool = {
+    .name = AGENT_PLAN_TOOL,
+    .description = "Run several tool calls in order on the device and get all results back in one reply. Stops at the first failed step.",
+    .input_schema_json = "{\"type\":\"object\",\"properties\":{\"steps\":{\"type\":\"array\",\"description\":\"Tool calls in order, max 16\",\"items\":{\"type\":\"object\",\"properties\":{\"tool\":{\"type\":\"string\"},\"input\":{\"type\":\"object\"}},\"required\":[\"tool\"]}}},\"required\":[\"steps\"]}",
+    .execute = NULL,    // Run by the agent, see run_plan()
+};
+
+static tool_def_t *s_plan_tools;                // Built-in tools plus run_plan
+static int s_plan_tool_count;
+
+// Built-in calls the model makes after being handed a user tool's action,
+// stored as the tool's recording if the turn succeeds (see user_tools.h)
+typedef struct {
+    char tool_name[TOOL_NAME_MAX_LEN];  // "" when not recording
+    int start_round;                    // Only calls of later rounds carry out the action
+    int last_round;                     // Newest round with a side effect; the action ends
+                                        // at the first later round without one
+    bool failed;                        // Not replayable: error, too many steps, nested tool
+    int step_count;
+    tool_step_t steps[TOOL_SCRIPT_MAX_STEPS];
+    bool read_only[TOOL_SCRIPT_MAX_STEPS];
+} tool_recorder_t;
+
+static tool_recorder_t s_recorder;
+
+// Where a turn came from and how long it waited for the agent
+typedef struct {
+    msg_source_t source;
+    int64_t source_id;
+    msg_class_t msg_class;
+    uint32_t queue_ms;              // Wait of the oldest message in the turn
+    int messages;                   // Queued messages merged into the turn
+} turn_origin_t;
 
 typedef struct {
     int64_t started_us;
+    const char *msg_class;          // Scheduling class name; NULL for internal requests
+    uint32_t queue_ms;              // Time the message waited before the turn began
+    int messages;                   // Queued messages merged into the turn
+    bool plan_mode;
+    int plan_steps;                 // Tool calls run from plans
     uint64_t llm_us_total;
     uint64_t tool_us_total;
     int llm_calls;
     int tool_calls;
     int rounds;
+    uint32_t conn_new;
+    uint32_t conn_reused;
+    uint32_t conn_ticket_offers;
+    uint32_t connect_ms;
+    uint32_t input_tokens;          // Uncached input tokens, summed over LLM calls
+    uint32_t output_tokens;
+    uint32_t cache_read_tokens;
+    uint32_t cache_write_tokens;
 } request_metrics_t;
 
+// Token usage since boot. Only the agent task updates or reads it (get_health
+// runs as a tool call, and cron scripts may not call it), so no locking is needed.
+static agent_usage_totals_t s_usage_totals;
+
 static uint64_t elapsed_us_since(int64_t started_us)
 {
     int64_t now_us = esp_timer_get_time();
@@ -63,34 +159,95 @@ static uint32_t us_to_ms_u32(uint64_t duration_us)
     return (uint32_t)duration_ms;
 }
 
+// Share of input tokens served from the provider's prompt cache.
+static uint32_t metrics_cache_hit_pct(const request_metrics_t *metrics)
+{
+    uint64_t total = (uint64_t)metrics->input_tokens + metrics->cache_read_tokens +
+                     metrics->cache_write_tokens;
+    if (total == 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)metrics->cache_read_tokens * 100ULL) / total);
+}
+
+// All input tokens the provider processed, cached or not.
+static uint32_t metrics_total_input_tokens(const request_metrics_t *metrics)
+{
+    return metrics->input_tokens + metrics->cache_read_tokens + metrics->cache_write_tokens;
+}
+
+// Every request ends in metrics_log_request(), so totals are folded in there.
+static void usage_totals_add(const request_metrics_t *metrics)
+{
+    s_usage_totals.requests++;
+    s_usage_totals.input_tokens += metrics_total_input_tokens(metrics);
+    s_usage_totals.output_tokens += metrics->output_tokens;
+    s_usage_totals.cache_read_tokens += metrics->cache_read_tokens;
+    s_usage_totals.last_input_tokens = metrics_total_input_tokens(metrics);
+    s_usage_totals.last_output_tokens = metrics->output_tokens;
+}
+
 static void metrics_log_request(const request_metrics_t *metrics, const char *outcome)
 {
     if (!metrics) {
         return;
     }
 
+    usage_totals_add(metrics);
+
     ESP_LOGI(TAG,
-             "METRIC request outcome=%s total_ms=%" PRIu32 " llm_ms=%" PRIu32
-             " tool_ms=%" PRIu32 " rounds=%d llm_calls=%d tool_calls=%d",
+             "METRIC request outcome=%s class=%s queue_ms=%" PRIu32 " msgs=%d"
+             " agent=%s total_ms=%" PRIu32 " llm_ms=%" PRIu32
+             " tool_ms=%" PRIu32 " rounds=%d llm_calls=%d tool_calls=%d plan_steps=%d"
+             " conn_new=%" PRIu32 " conn_reused=%" PRIu32
+             " tls_ticket_offered=%" PRIu32 " connect_ms=%" PRIu32
+             " in_tokens=%" PRIu32 " out_tokens=%" PRIu32
+             " cache_read=%" PRIu32 " cache_write=%" PRIu32 " cache_hit_pct=%" PRIu32,
              outcome ? outcome : "unknown",
+             metrics->msg_class ? metrics->msg_class : "none",
+             metrics->queue_ms,
+             metrics->messages,
+             metrics->plan_mode ? "plan" : "step",
              us_to_ms_u32(elapsed_us_since(metrics->started_us)),
              us_to_ms_u32(metrics->llm_us_total),
              us_to_ms_u32(metrics->tool_us_total),
              metrics->rounds,
              metrics->llm_calls,
-             metrics->tool_calls);
+             metrics->tool_calls,
+             metrics->plan_steps,
+             metrics->conn_new,
+             metrics->conn_reused,
+             metrics->conn_ticket_offers,
+             metrics->connect_ms,
+             metrics_total_input_tokens(metrics),
+             metrics->output_tokens,
+             metrics->cache_read_tokens,
+             metrics->cache_write_tokens,
+             metrics_cache_hit_pct(metrics));
 }
 
-static void history_rollback_to(int marker, const char *reason)
+static void history_rollback_to(uint32_t mark, const char *reason)
 {
-    if (marker < 0 || marker > s_history_len || marker == s_history_len) {
+    int before = history_count(s_history);
+    int dropped = history_rollback(s_history, mark);
+    if (dropped == 0) {
         return;
     }
 
     ESP_LOGW(TAG, "Rolling back conversation history (%d -> %d): %s",
-             s_history_len, marker, reason ? reason : "unknown");
-    memset(&s_history[marker], 0, (s_history_len - marker) * sizeof(conversation_msg_t));
-    s_history_len = marker;
+             before, before - dropped, reason ? reason : "unknown");
+    json_request_cache_invalidate(&s_request_cache);
+}
+
+static void history_push_msg(const conversation_msg_t *msg)
+{
+    // Oldest messages are dropped one at a time until the new one fits.
+    // Tool interactions can span more than 2 messages, so pair-based trimming is unsafe.
+    int evicted = history_push(s_history, msg);
+    if (evicted > 0) {
+        ESP_LOGD(TAG, "History full: evicted %d oldest messages", evicted);
+        json_request_cache_invalidate(&s_request_cache);
+    }
 }
 
 // Add a message to history
@@ -98,111 +255,840 @@ static void history_add(const char *role, const char *content,
                         bool is_tool_use, bool is_tool_result,
                         const char *tool_id, const char *tool_name)
 {
-    // Drop one oldest message when full.
-    // Tool interactions can span more than 2 messages, so pair-based trimming is unsafe.
-    if (s_history_len >= MAX_HISTORY_TURNS * 2) {
-        memmove(&s_history[0], &s_history[1], (MAX_HISTORY_TURNS * 2 - 1) * sizeof(conversation_msg_t));
-        s_history_len -= 1;
-    }
-
-    conversation_msg_t *msg = &s_history[s_history_len++];
-    strncpy(msg->role, role, sizeof(msg->role) - 1);
-    msg->role[sizeof(msg->role) - 1] = '\0';
-    strncpy(msg->content, content, sizeof(msg->content) - 1);
-    msg->content[sizeof(msg->content) - 1] = '\0';
-    msg->is_tool_use = is_tool_use;
-    msg->is_tool_result = is_tool_result;
-
-    if (tool_id) {
-        strncpy(msg->tool_id, tool_id, sizeof(msg->tool_id) - 1);
-        msg->tool_id[sizeof(msg->tool_id) - 1] = '\0';
-    } else {
-        msg->tool_id[0] = '\0';
-    }
+    conversation_msg_t msg = {
+        .role = role,
+        .content = content,
+        .tool_id = tool_id ? tool_id : "",
+        .tool_name = tool_name ? tool_name : "",
+        .is_tool_use = is_tool_use,
+        .is_tool_result = is_tool_result,
+        .is_error = false,
+        .joins_previous = false,
+    };
+    history_push_msg(&msg);
+}
 
-    if (tool_name) {
-        strncpy(msg->tool_name, tool_name, sizeof(msg->tool_name) - 1);
-        msg->tool_name[sizeof(msg->tool_name) - 1] = '\0';
-    } else {
-        msg->tool_name[0] = '\0';
-    }
+// Answer a tool call that was not run, flagged so the model does not take
+// the call as done.
+static void history_add_tool_error(const char *tool_id, const char *error)
+{
+    conversation_msg_t msg = {
+        .role = "user",
+        .content = error,
+        .tool_id = tool_id,
+        .tool_name = "",
+        .is_tool_use = false,
+        .is_tool_result = true,
+        .is_error = true,
+        .joins_previous = false,
+    };
+    history_push_msg(&msg);
 }
 
-static void queue_channel_response(const char *text)
+// Queue one reference to buf for the channel output task.
+static void queue_channel_response(msg_buf_t *buf)
 {
     if (!s_channel_output_queue) {
         return;
     }
 
-    channel_msg_t msg;
-    strncpy(msg.text, text, CHANNEL_RX_BUF_SIZE - 1);
-    msg.text[CHANNEL_RX_BUF_SIZE - 1] = '\0';
-
+    channel_msg_t msg = {.text = msg_pool_retain(buf)};
     if (xQueueSend(s_channel_output_queue, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        msg_pool_release(buf);
         ESP_LOGE(TAG, "Failed to send response to channel queue");
     }
 }
 
-static void queue_telegram_response(const char *text)
+// Queue one reference to buf for the Telegram send task.
+static bool queue_telegram_msg(telegram_msg_kind_t kind, msg_buf_t *buf, TickType_t wait_ticks)
+{
+    telegram_msg_t msg = {.kind = kind, .text = msg_pool_retain(buf)};
+    if (xQueueSend(s_telegram_output_queue, &msg, wait_ticks) != pdTRUE) {
+        msg_pool_release(buf);
+        return false;
+    }
+    return true;
+}
+
+static void queue_telegram_response(msg_buf_t *buf)
 {
     if (!s_telegram_output_queue) {
         return;
     }
 
-    telegram_msg_t msg;
-    strncpy(msg.text, text, TELEGRAM_MAX_MSG_LEN - 1);
-    msg.text[TELEGRAM_MAX_MSG_LEN - 1] = '\0';
-
-    if (xQueueSend(s_telegram_output_queue, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    if (!queue_telegram_msg(TELEGRAM_MSG_TEXT, buf, pdMS_TO_TICKS(1000))) {
         ESP_LOGE(TAG, "Failed to send response to Telegram queue");
     }
 }
 
+// Queue text, then status after a blank line, as one Telegram message.
+static void reply_queue(telegram_msg_kind_t kind, const char *text, size_t text_len,
+                        const char *status, TickType_t wait_ticks)
+{
+    size_t status_len = status ? strlen(status) : 0;
+    msg_buf_t *buf = msg_pool_alloc(text_len + 2 + status_len);
+    if (!buf) {
+        return;
+    }
+
+    msg_pool_append(buf, text, text_len);
+    if (status) {
+        if (buf->len > 0) {
+            msg_pool_append(buf, "\n\n", 2);
+        }
+        msg_pool_append(buf, status, status_len);
+    }
+
+    if (!queue_telegram_msg(kind, buf, wait_ticks) && kind != TELEGRAM_MSG_REPLY_PROGRESS) {
+        ESP_LOGE(TAG, "Failed to send reply to Telegram queue");
+    }
+    msg_pool_release(buf);
+}
+
+static void reply_clear_text(void)
+{
+    s_stream_out.telegram_pending_len = 0;
+    s_stream_out.telegram_pending[0] = '\0';
+}
+
+// Open a progressive reply for a request from Telegram.
+static void reply_begin(const turn_origin_t *origin)
+{
+    s_reply.active = s_progressive_replies && s_telegram_output_queue &&
+                     origin->source == MSG_SOURCE_TELEGRAM;
+    if (!s_reply.active) {
+        return;
+    }
+    reply_clear_text();
+    s_reply.last_progress_us = esp_timer_get_time();
+    reply_queue(TELEGRAM_MSG_REPLY_START, TELEGRAM_REPLY_PLACEHOLDER,
+                strlen(TELEGRAM_REPLY_PLACEHOLDER), NULL, pdMS_TO_TICKS(1000));
+}
+
+// Show the reply so far plus an optional status line. Progress snapshots never
+// block the agent: when the queue is full, a later one supersedes this one.
+static void reply_progress(const char *status)
+{
+    if (!s_reply.active) {
+        return;
+    }
+    s_reply.last_progress_us = esp_timer_get_time();
+    reply_queue(TELEGRAM_MSG_REPLY_PROGRESS, s_stream_out.telegram_pending,
+                s_stream_out.telegram_pending_len, status, 0);
+}
+
+// Give the open reply its final text: what streamed so far, then text (may be
+// NULL). When nothing streamed, text's buffer is queued as it is. When both
+// would not fit one Telegram message, the reply keeps the streamed text and
+// text follows as a message of its own.
+static void reply_finish(msg_buf_t *text)
+{
+    size_t len = s_stream_out.telegram_pending_len;
+    while (len > 0 && (s_stream_out.telegram_pending[len - 1] == '\n' ||
+                       s_stream_out.telegram_pending[len - 1] == ' ')) {
+        len--;
+    }
+
+    if (len > 0 && text && len + 2 + text->len > TELEGRAM_MAX_MSG_LEN - 1) {
+        reply_queue(TELEGRAM_MSG_TEXT, s_stream_out.telegram_pending, len, NULL,
+                    pdMS_TO_TICKS(1000));
+        len = 0;
+    }
+
+    if (len == 0 && text) {
+        if (!queue_telegram_msg(TELEGRAM_MSG_TEXT, text, pdMS_TO_TICKS(1000))) {
+            ESP_LOGE(TAG, "Failed to send reply to Telegram queue");
+        }
+    } else {
+        reply_queue(TELEGRAM_MSG_TEXT, s_stream_out.telegram_pending, len,
+                    text ? text->text : (len == 0 ? "(No response)" : NULL),
+                    pdMS_TO_TICKS(1000));
+    }
+    reply_clear_text();
+    s_reply.active = false;
+}
+
+// Close a reply that streamed its answer and so was never given a final text.
+static void reply_end(void)
+{
+    if (s_reply.active) {
+        reply_finish(NULL);
+    }
+}
+
+// One pooled copy of text, shared by the serial and Telegram queues.
 static void send_response(const char *text)
 {
-    queue_channel_response(text);
-    queue_telegram_response(text);
+    msg_buf_t *buf = msg_pool_copy(text, strlen(text));
+
+    if (buf) {
+        queue_channel_response(buf);
+    }
+    if (s_reply.active) {
+        reply_finish(buf);
+    } else if (buf) {
+        queue_telegram_response(buf);
+    }
+    msg_pool_release(buf);
+}
+
+static void stream_flush_telegram(void)
+{
+    if (s_stream_out.telegram_pending_len == 0) {
+        return;
+    }
+    msg_buf_t *buf = msg_pool_copy(s_stream_out.telegram_pending,
+                                   s_stream_out.telegram_pending_len);
+    if (buf) {
+        queue_telegram_response(buf);
+        msg_pool_release(buf);
+    }
+    s_stream_out.telegram_pending_len = 0;
+    s_stream_out.telegram_pending[0] = '\0';
 }
 
-// Process a single user message
-static void process_message(const char *user_message)
+// Serial gets every fragment immediately; Telegram gets batches so a long
+// answer arrives as a few messages instead of one per token.
+static void stream_on_text(const char *text, void *user_ctx)
+{
+    (void)user_ctx;
+    size_t len = strlen(text);
+    if (len == 0) {
+        return;
+    }
+    s_stream_out.round_chars += len;
+
+    if (s_channel_output_queue) {
+        channel_write(text);
+    }
+    if (!s_telegram_output_queue) {
+        return;
+    }
+
+    if (s_reply.active) {
+        if (s_stream_out.telegram_pending_len + len < sizeof(s_stream_out.telegram_pending)) {
+            memcpy(s_stream_out.telegram_pending + s_stream_out.telegram_pending_len, text, len);
+            s_stream_out.telegram_pending_len += len;
+            s_stream_out.telegram_pending[s_stream_out.telegram_pending_len] = '\0';
+            if (esp_timer_get_time() - s_reply.last_progress_us >=
+                (int64_t)TELEGRAM_EDIT_INTERVAL_MS * 1000) {
+                reply_progress(NULL);
+            }
+            return;
+        }
+        // The reply message is full: it keeps what it has and the rest of
+        // the answer follows in batches.
+        reply_finish(NULL);
+    }
+
+    while (len > 0) {
+        size_t space = sizeof(s_stream_out.telegram_pending) - 1 - s_stream_out.telegram_pending_len;
+        if (space == 0) {
+            stream_flush_telegram();
+            continue;
+        }
+        size_t n = len < space ? len : space;
+        memcpy(s_stream_out.telegram_pending + s_stream_out.telegram_pending_len, text, n);
+        s_stream_out.telegram_pending_len += n;
+        s_stream_out.telegram_pending[s_stream_out.telegram_pending_len] = '\0';
+        text += n;
+        len -= n;
+    }
+
+    // Flush on a sentence or line break once a batch has accumulated.
+    if (s_stream_out.telegram_pending_len >= LLM_STREAM_TELEGRAM_BATCH) {
+        char last = s_stream_out.telegram_pending[s_stream_out.telegram_pending_len - 1];
+        if (last == '\n' || last == '.' || last == '!' || last == '?' || last == ':') {
+            stream_flush_telegram();
+        }
+    }
+}
+
+// Terminate streamed output for this LLM call. Returns true if any text was
+// already delivered, in which case it must not be sent again.
+static bool stream_end_round(void)
+{
+    if (s_stream_out.round_chars == 0) {
+        return false;
+    }
+    if (s_channel_output_queue) {
+        channel_write("\n\n");
+    }
+    if (s_reply.active) {
+        text_buffer_append(s_stream_out.telegram_pending, &s_stream_out.telegram_pending_len,
+                           sizeof(s_stream_out.telegram_pending), "\n\n", 2);
+    } else {
+        stream_flush_telegram();
+    }
+    s_stream_out.round_chars = 0;
+    return true;
+}
+
+static bool history_is_turn_start(const conversation_msg_t *msg)
+{
+    return strcmp(msg->role, "user") == 0 && !msg->is_tool_result;
+}
+
+// Elide the content of the oldest tool results from history[start] on until
+// about excess tokens are saved. Results answering the newest round are kept;
+// the tool_use/tool_result messages themselves stay, so pairs remain intact.
+// Returns how many results were elided.
+static int elide_oldest_tool_results(int start, size_t excess)
+{
+    const conversation_msg_t *history = history_messages(s_history);
+    int history_len = history_count(s_history);
+    int newest_round = history_len;
+    size_t saved = 0;
+    int elided = 0;
+
+    while (newest_round > 0 && history[newest_round - 1].is_tool_result) {
+        newest_round--;
+    }
+
+    for (int i = start; i < newest_round && saved < excess; i++) {
+        if (!history[i].is_tool_result) {
+            continue;
+        }
+        size_t tokens = token_estimate(history[i].content, strlen(history[i].content));
+        if (history_elide(s_history, i, HISTORY_ELIDED_RESULT)) {
+            saved += tokens;
+            elided++;
+        }
+    }
+    return elided;
+}
+
+// Build the request into s_request_buf, appending to the cached prefix when
+// only new messages were added. If it exceeds the input token budget (or the
+// buffer), elide the oldest tool results first, then leave out the oldest
+// turns (always starting on a user message) until it fits. The newest turn is
+// always sent. Stores the request's estimated tokens in *tokens_out.
+static size_t build_request(const tool_def_t *tools, int tool_count, size_t *tokens_out)
+{
+    const conversation_msg_t *history = history_messages(s_history);
+    int history_len = history_count(s_history);
+    int start = 0;
+
+    while (start < history_len) {
+        size_t len = json_build_request_cached(&s_request_cache,
+                                               s_request_buf, LLM_REQUEST_BUF_SIZE,
+                                               s_plan_mode ? SYSTEM_PROMPT_PLAN : SYSTEM_PROMPT,
+                                               &history[start], history_len - start,
+                                               tools, tool_count);
+        size_t tokens = len > 0 ? token_estimate(s_request_buf, len) : 0;
+        *tokens_out = tokens;
+        if (len > 0 && tokens <= s_token_budget) {
+            if (start > 0) {
+                ESP_LOGW(TAG, "Request trimmed to fit: omitted %d oldest messages", start);
+            }
+            return len;
+        }
+
+        // A request that overflows the buffer has no estimate: elide one at a time.
+        size_t excess = len > 0 ? tokens - s_token_budget : 1;
+        int elided = elide_oldest_tool_results(start, excess);
+        if (elided > 0) {
+            ESP_LOGW(TAG, "Request over budget (~%d tokens, budget %d): elided %d oldest tool results",
+                     (int)tokens, (int)s_token_budget, elided);
+            json_request_cache_invalidate(&s_request_cache);
+            continue;
+        }
+
+        int next = start + 1;
+        while (next < history_len && !history_is_turn_start(&history[next])) {
+            next++;
+        }
+        if (next >= history_len && len > 0) {
+            ESP_LOGW(TAG, "Request over budget (~%d tokens, budget %d) with only the newest turn",
+                     (int)tokens, (int)s_token_budget);
+            return len;
+        }
+        start = next;
+    }
+    return 0;
+}
+
+// Index of the first message to keep verbatim: everything before the last
+// HISTORY_COMPACT_KEEP_TURNS user turns is summarized. 0 when too little
+// would be summarized to be worth a request.
+static int history_compact_split(const conversation_msg_t *history, int history_len)
+{
+    int kept_turns = 0;
+
+    for (int i = history_len - 1; i > 0; i--) {
+        if (history_is_turn_start(&history[i]) && ++kept_turns == HISTORY_COMPACT_KEEP_TURNS) {
+            return i >= HISTORY_COMPACT_MIN_MESSAGES ? i : 0;
+        }
+    }
+    return 0;
+}
+
+// A streamed response is decoded as it arrives; the response buffer then only
+// holds error bodies.
+static size_t response_buf_size(void)
+{
+    return llm_stream_enabled() ? LLM_STREAM_ERROR_BUF_SIZE : LLM_RESPONSE_BUF_SIZE;
+}
+
+// Once the history (or the last prompt) passes its threshold, have the model
+// summarize the older turns and keep the summary in their place. On failure
+// the history is left as is; byte-budget eviction still bounds it.
+static void history_maybe_compact(uint32_t last_prompt_tokens)
+{
+    if (!s_compact_enabled) {
+        return;
+    }
+    if (history_bytes_used(s_history) < HISTORY_COMPACT_BYTES &&
+        last_prompt_tokens < HISTORY_COMPACT_TOKENS) {
+        return;
+    }
+
+    const conversation_msg_t *history = history_messages(s_history);
+    int split = history_compact_split(history, history_count(s_history));
+    if (split == 0) {
+        return;
+    }
+
+    char rate_reason[128];
+    if (!ratelimit_check(rate_reason, sizeof(rate_reason))) {
+        ESP_LOGW(TAG, "History compaction skipped: %s", rate_reason);
+        return;
+    }
+
+    // The summary request borrows the request buffer.
+    json_request_cache_invalidate(&s_request_cache);
+    size_t request_len = json_build_summary_request_into(s_request_buf, LLM_REQUEST_BUF_SIZE,
+                                                          HISTORY_SUMMARY_PROMPT, history, split);
+    if (request_len == 0) {
+        ESP_LOGW(TAG, "History compaction skipped: summary request does not fit");
+        return;
+    }
+
+    request_metrics_t metrics = {
+        .started_us = esp_timer_get_time(),
+        .plan_mode = s_plan_mode,
+        .llm_calls = 1,
+    };
+    char summary[MAX_MESSAGE_LEN];
+    size_t prefix_len = strlen(HISTORY_SUMMARY_PREFIX);
+    llm_usage_t usage;
+
+    memcpy(summary, HISTORY_SUMMARY_PREFIX, prefix_len);
+    esp_err_t err = llm_request(s_request_buf, s_response_buf, response_buf_size(),
+                                summary + prefix_len, sizeof(summary) - prefix_len);
+    metrics.llm_us_total = elapsed_us_since(metrics.started_us);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_RESPONSE) {
+        ESP_LOGW(TAG, "History compaction failed: summary request error");
+        metrics_log_request(&metrics, "summary_error");
+        return;
+    }
+    ratelimit_record_request();
+
+    bool parsed = err == ESP_OK;
+    if (parsed && json_get_last_usage(&usage)) {
+        metrics.input_tokens = usage.input_tokens;
+        metrics.output_tokens = usage.output_tokens;
+        metrics.cache_read_tokens = usage.cache_read_tokens;
+        metrics.cache_write_tokens = usage.cache_write_tokens;
+    }
+    json_free_parsed_response();
+    if (!parsed || summary[prefix_len] == '\0') {
+        ESP_LOGW(TAG, "History compaction failed: no summary in response");
+        metrics_log_request(&metrics, "summary_error");
+        return;
+    }
+
+    conversation_msg_t msg = {
+        .role = "user",
+        .content = summary,
+        .tool_id = "",
+        .tool_name = "",
+    };
+    int evicted = history_compact(s_history, split, &msg);
+    ESP_LOGI(TAG, "History compacted: %d messages -> %d byte summary (%d more evicted), %d bytes used",
+             split, (int)strlen(summary), evicted, (int)history_bytes_used(s_history));
+    metrics_log_request(&metrics, "summary");
+}
+
+// Tools that change the user tools themselves are never replayed.
+static bool is_user_tool_admin(const char *name)
+{
+    return strcmp(name, "create_tool") == 0 || strcmp(name, "delete_user_tool") == 0 ||
+           strcmp(name, "reset_user_tool") == 0;
+}
+
+// Lookups with no side effect. Replayed blindly they only matter when they
+// are the whole action (a query), so a recording with side effects drops them.
+static const char *const s_read_only_tools[] = {
+    "gpio_read", "i2c_scan", "memory_get", "memory_list", "cron_list",
+    "get_time", "get_timezone", "get_version", "get_health", "list_user_tools",
+};
+
+static bool is_read_only_tool(const char *name)
+{
+    for (size_t i = 0; i < sizeof(s_read_only_tools) / sizeof(s_read_only_tools[0]); i++) {
+        if (strcmp(s_read_only_tools[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void recorder_begin(const user_tool_t *user_tool, int round)
+{
+    if (s_recorder.tool_name[0] != '\0') {
+        // A second user tool in the turn: its calls can't be told apart.
+        s_recorder.failed = true;
+        return;
+    }
+    memset(&s_recorder, 0, sizeof(s_recorder));
+    snprintf(s_recorder.tool_name, sizeof(s_recorder.tool_name), "%s", user_tool->name);
+    s_recorder.start_round = round;
+    s_recorder.last_round = round;
+}
+
+static void recorder_add(const json_tool_call_t *call, bool ok, int round)
+{
+    // Calls after the action's last side-effect round are the model's own.
+    if (s_recorder.tool_name[0] == '\0' || s_recorder.failed || round <= s_recorder.start_round ||
+        round > s_recorder.last_round + 1) {
+        return;
+    }
+    if (!ok || is_user_tool_admin(call->name) || s_recorder.step_count >= TOOL_SCRIPT_MAX_STEPS) {
+        s_recorder.failed = true;
+        return;
+    }
+
+    tool_step_t *step = &s_recorder.steps[s_recorder.step_count];
+    char *input_str = cJSON_PrintUnformatted(call->input);
+    const char *input = input_str ? input_str : "{}";
+    if (strlen(call->name) >= sizeof(step->tool) || strlen(input) >= sizeof(step->input)) {
+        s_recorder.failed = true;
+    } else {
+        memcpy(step->tool, call->name, strlen(call->name) + 1);
+        memcpy(step->input, input, strlen(input) + 1);
+        s_recorder.read_only[s_recorder.step_count] = is_read_only_tool(call->name);
+        if (!s_recorder.read_only[s_recorder.step_count]) {
+            s_recorder.last_round = round;
+        }
+        s_recorder.step_count++;
+    }
+    free(input_str);
+}
+
+// Store what was recorded during a successful turn, without its lookups
+// unless they are all there is.
+static void recorder_finish(bool success)
+{
+    int count = 0;
+    bool has_side_effects = false;
+
+    for (int i = 0; i < s_recorder.step_count; i++) {
+        has_side_effects |= !s_recorder.read_only[i];
+    }
+    for (int i = 0; i < s_recorder.step_count; i++) {
+        if (!has_side_effects || !s_recorder.read_only[i]) {
+            s_recorder.steps[count++] = s_recorder.steps[i];
+        }
+    }
+    if (success && s_recorder.tool_name[0] != '\0' && !s_recorder.failed && count > 0) {
+        user_tools_record(s_recorder.tool_name, s_recorder.steps, count);
+    }
+    memset(&s_recorder, 0, sizeof(s_recorder));
+}
+
+// Run a user tool's recorded steps into result. On failure the recording
+// is dropped and false returned; result says how far it got.
+static bool replay_user_tool(const user_tool_t *user_tool, const user_tool_recording_t *recording,
+                             char *result, size_t result_len)
+{
+    int step_count = recording->step_count;
+    s_step_result_buf[0] = '\0';
+    int completed = tool_script_run(recording->steps, step_count, s_step_result_buf,
+                                    sizeof(s_step_result_buf));
+    if (completed < step_count) {
+        user_tools_forget(user_tool->name);
+        ESP_LOGW(TAG, "Replay of '%s' failed at step %d", user_tool->name, completed + 1);
+        snprintf(result, result_len,
+                 "Replay of recorded steps failed at step %d of %d; steps before it ran and "
+                 "the recording was cleared.%s\nFinish this action: %s",
+                 completed + 1, step_count, s_step_result_buf, user_tool->action);
+        return false;
+    }
+
+    snprintf(result, result_len, "Done, replayed %d recorded steps:%s", step_count,
+             s_step_result_buf);
+    ESP_LOGI(TAG, "Replayed %d recorded steps of user tool '%s'", step_count, user_tool->name);
+    return true;
+}
+
+// A user tool replays its recording if it has one. Otherwise the model gets
+// the action to carry out, and the calls it makes are recorded.
+static void run_user_tool(const user_tool_t *user_tool, request_metrics_t *metrics)
+{
+    const user_tool_recording_t *recording = user_tools_get_recording(user_tool->name);
+    bool replayable = recording && !recording->replay_disabled;
+
+    if (replayable && recording->step_count > 0) {
+        int64_t tool_started_us = esp_timer_get_time();
+        replay_user_tool(user_tool, recording, s_tool_result_buf, sizeof(s_tool_result_buf));
+        metrics->tool_us_total += elapsed_us_since(tool_started_us);
+        return;
+    }
+
+    if (replayable) {
+        recorder_begin(user_tool, metrics->rounds);
+    }
+    snprintf(s_tool_result_buf, sizeof(s_tool_result_buf),
+             "Execute this action now: %s", user_tool->action);
+    ESP_LOGI(TAG, "User tool '%s' action: %s", user_tool->name, user_tool->action);
+}
+
+// Tools offered to the model: in plan mode, the built-ins plus run_plan.
+static const tool_def_t *agent_tools(int *count)
+{
+    int builtin_count = 0;
+    const tool_def_t *builtins = tools_get_all(&builtin_count);
+    if (!s_plan_mode) {
+        *count = builtin_count;
+        return builtins;
+    }
+
+    // Built once; a stable array keeps the cached tools catalog valid.
+    if (!s_plan_tools || s_plan_tool_count != builtin_count + 1) {
+        tool_def_t *tools = realloc(s_plan_tools, (size_t)(builtin_count + 1) * sizeof(tool_def_t));
+        if (!tools) {
+            *count = builtin_count;
+            return builtins;
+        }
+        if (builtin_count > 0) {
+            memcpy(tools, builtins, (size_t)builtin_count * sizeof(tool_def_t));
+        }
+        tools[builtin_count] = s_run_plan_tool;
+        s_plan_tools = tools;
+        s_plan_tool_count = builtin_count + 1;
+    }
+    *count = s_plan_tool_count;
+    return s_plan_tools;
+}
+
+// Run every step of a plan, stopping at the first failure. The model gets
+// all results at once: it summarizes them, or plans again after a failure.
+// Steps run straight from the call's input, so a plan is not held to the
+// input size of stored scripts.
+static void run_plan(const json_tool_call_t *call, request_metrics_t *metrics)
+{
+    char error[96];
+    const cJSON *steps = cJSON_GetObjectItem(call->input, "steps");
+    int step_count = tool_script_check(steps, TOOL_SCRIPT_AGENT, AGENT_PLAN_MAX_STEPS,
+                                       error, sizeof(error));
+    if (step_count < 0) {
+        snprintf(s_tool_result_buf, sizeof(s_tool_result_buf), "%s", error);
+        return;
+    }
+
+    int64_t tool_started_us = esp_timer_get_time();
+    s_step_result_buf[0] = '\0';
+    int completed = tool_script_run_json(steps, s_step_result_buf, sizeof(s_step_result_buf));
+    metrics->tool_us_total += elapsed_us_since(tool_started_us);
+    metrics->plan_steps += completed < step_count ? completed + 1 : completed;
+
+    if (completed < step_count) {
+        snprintf(s_tool_result_buf, sizeof(s_tool_result_buf),
+                 "Plan stopped: step %d of %d failed, later steps did not run.",
+                 completed + 1, step_count);
+    } else {
+        snprintf(s_tool_result_buf, sizeof(s_tool_result_buf), "Plan done, %d steps:", step_count);
+    }
+    size_t len = strlen(s_tool_result_buf);
+    snprintf(s_tool_result_buf + len, sizeof(s_tool_result_buf) - len, "%s", s_step_result_buf);
+    ESP_LOGI(TAG, "Plan ran %d of %d steps", completed, step_count);
+}
+
+// Run one tool call, leaving its result in s_tool_result_buf.
+static void run_tool_call(const json_tool_call_t *call, request_metrics_t *metrics)
+{
+    metrics->tool_calls++;
+    if (s_plan_mode && strcmp(call->name, AGENT_PLAN_TOOL) == 0) {
+        run_plan(call, metrics);
+        // A plan inside a user tool run is not recorded for replay.
+        recorder_add(call, false, metrics->rounds);
+        return;
+    }
+
+    // Check if it's a user-defined tool
+    const user_tool_t *user_tool = user_tools_find(call->name);
+    if (user_tool) {
+        run_user_tool(user_tool, metrics);
+    } else {
+        // Built-in tool: execute directly
+        int64_t tool_started_us = esp_timer_get_time();
+        bool ok = tools_execute(call->name, call->input, s_tool_result_buf,
+                                sizeof(s_tool_result_buf));
+        metrics->tool_us_total += elapsed_us_since(tool_started_us);
+        ESP_LOGI(TAG, "Tool result: %s", s_tool_result_buf);
+        recorder_add(call, ok, metrics->rounds);
+    }
+}
+
+// The JSON buffers are the largest in the firmware; bulk, so PSRAM takes them
+// when the board has it.
+static bool alloc_buffers(void)
+{
+    if (!s_request_buf) {
+        s_request_buf = buffer_alloc("llm_request", LLM_REQUEST_BUF_SIZE, BUFFER_BULK);
+    }
+    if (!s_response_buf) {
+        s_response_buf = buffer_alloc("llm_response", response_buf_size(), BUFFER_BULK);
+    }
+    return s_request_buf && s_response_buf;
+}
+
+// Switch to the session of the message's origin. The cached request prefix
+// belongs to the previous session.
+static bool select_session(msg_source_t source, int64_t source_id)
+{
+    bool created = false;
+    history_t *history = session_get(source, source_id, &created);
+    if (!history) {
+        return false;
+    }
+    if (history != s_history || created) {
+        json_request_cache_invalidate(&s_request_cache);
+        s_history = history;
+    }
+    return true;
+}
+
+// Answer a routed command locally: at most one tool call, no LLM request
+// and no history.
+static void run_command(const command_route_t *route)
+{
+    if (route->kind == COMMAND_HELP) {
+        send_response(command_router_help());
+        return;
+    }
+
+    cJSON *input = cJSON_Parse(route->input_json);
+    if (!input) {
+        send_response("Error: Invalid command input");
+        return;
+    }
+    int64_t started_us = esp_timer_get_time();
+    tools_execute(route->tool, input, s_tool_result_buf, sizeof(s_tool_result_buf));
+    cJSON_Delete(input);
+    ESP_LOGI(TAG, "Command %s answered in %" PRIu32 " ms", route->tool,
+             us_to_ms_u32(elapsed_us_since(started_us)));
+    send_response(s_tool_result_buf);
+}
+
+// User tool that can run from its recording without the model, if any.
+static const user_tool_t *replayable_user_tool(const char *name)
+{
+    const user_tool_t *user_tool = user_tools_find(name);
+    const user_tool_recording_t *recording = user_tools_get_recording(name);
+    if (!user_tool || !recording || recording->replay_disabled || recording->step_count == 0) {
+        return NULL;
+    }
+    return user_tool;
+}
+
+// Run user_message as a command if it is one. Returns true if it was
+// answered; otherwise *llm_text is what to send to the LLM.
+static bool route_command(const char *user_message, const char **llm_text)
+{
+    command_route_t route;
+    command_kind_t kind = command_route(user_message, &route);
+    bool hit = kind == COMMAND_TOOL || kind == COMMAND_HELP;
+    const char *command = "none";
+
+    s_router_messages++;
+    char user_tool_name[TOOL_NAME_MAX_LEN];
+    const user_tool_t *user_tool = NULL;
+    if (kind == COMMAND_NONE &&
+        command_user_tool_name(user_message, user_tool_name, sizeof(user_tool_name))) {
+        user_tool = replayable_user_tool(user_tool_name);
+    }
+
+    if (user_tool) {
+        hit = true;
+        s_router_hits++;
+        command = user_tool->name;
+    } else if (hit) {
+        s_router_hits++;
+        command = kind == COMMAND_HELP ? "help" : route.tool;
+    } else if (kind == COMMAND_ASK) {
+        command = "ask";
+    }
+    ESP_LOGI(TAG, "METRIC router hit=%d command=%s hits=%" PRIu32 " messages=%" PRIu32
+             " hit_pct=%" PRIu32,
+             hit ? 1 : 0, command, s_router_hits, s_router_messages,
+             (s_router_hits * 100U) / s_router_messages);
+
+    if (user_tool) {
+        const user_tool_recording_t *recording = user_tools_get_recording(user_tool->name);
+        replay_user_tool(user_tool, recording, s_tool_result_buf, sizeof(s_tool_result_buf));
+        send_response(s_tool_result_buf);
+        return true;
+    }
+    if (hit) {
+        run_command(&route);
+        return true;
+    }
+    if (kind == COMMAND_ASK) {
+        *llm_text = route.llm_text;
+    }
+    return false;
+}
+
+// Run one LLM turn (with its tool rounds) in the selected session
+static void run_turn(const turn_origin_t *origin, const char *user_message)
 {
     ESP_LOGI(TAG, "Processing: %s", user_message);
-    int history_turn_start = s_history_len;
+    recorder_finish(false);
+    uint32_t history_turn_start = history_mark(s_history);
     request_metrics_t metrics = {
         .started_us = esp_timer_get_time(),
+        .msg_class = input_sched_class_name(origin->msg_class),
+        .queue_ms = origin->queue_ms,
+        .messages = origin->messages,
+        .plan_mode = s_plan_mode,
+        .plan_steps = 0,
         .llm_us_total = 0,
         .tool_us_total = 0,
         .llm_calls = 0,
         .tool_calls = 0,
         .rounds = 0,
+        .conn_new = 0,
+        .conn_reused = 0,
+        .conn_ticket_offers = 0,
+        .connect_ms = 0,
+        .input_tokens = 0,
+        .output_tokens = 0,
+        .cache_read_tokens = 0,
+        .cache_write_tokens = 0,
     };
 
     // Get tools
     int tool_count;
-    const tool_def_t *tools = tools_get_all(&tool_count);
+    const tool_def_t *tools = agent_tools(&tool_count);
 
     // Add user message to history
     history_add("user", user_message, false, false, NULL, NULL);
 
     int rounds = 0;
     bool done = false;
+    uint32_t last_prompt_tokens = 0;
 
     while (!done && rounds < MAX_TOOL_ROUNDS) {
         rounds++;
         metrics.rounds = rounds;
 
         // Build request JSON (user message already in history)
-        char *request = json_build_request(
-            SYSTEM_PROMPT,
-            s_history,
-            s_history_len,
-            NULL,  // User message already in history
-            tools,
-            tool_count
-        );
-
-        if (!request) {
+        size_t request_tokens = 0;
+        size_t request_len = build_request(tools, tool_count, &request_tokens);
+
+        if (request_len == 0) {
             ESP_LOGE(TAG, "Failed to build request JSON");
             history_rollback_to(history_turn_start, "request build failed");
             send_response("Error: Failed to build request");
@@ -210,28 +1096,39 @@ static void process_message(const char *user_message)
             return;
         }
 
-        ESP_LOGI(TAG, "Request: %d bytes", (int)strlen(request));
+        ESP_LOGI(TAG, "Request: %d bytes, ~%d tokens (budget %d)",
+                 (int)request_len, (int)request_tokens, (int)s_token_budget);
 
         // Check rate limit before making request
         char rate_reason[128];
         if (!ratelimit_check(rate_reason, sizeof(rate_reason))) {
-            free(request);
             history_rollback_to(history_turn_start, "rate limited");
             send_response(rate_reason);
             metrics_log_request(&metrics, "rate_limited");
             return;
         }
 
-        // Send to LLM with retry
+        // Send to LLM with retry; the reply is parsed as it arrives
+        char text_out[MAX_MESSAGE_LEN] = {0};
         esp_err_t err = ESP_FAIL;
         int retry_delay_ms = LLM_RETRY_BASE_MS;
+        s_stream_out.round_chars = 0;
 
         for (int retry = 0; retry < LLM_MAX_RETRIES; retry++) {
+            llm_conn_stats_t conn_before;
+            llm_conn_stats_t conn_after;
+            llm_get_conn_stats(&conn_before);
             int64_t llm_started_us = esp_timer_get_time();
-            err = llm_request(request, s_response_buf, sizeof(s_response_buf));
+            err = llm_request_stream(s_request_buf, s_response_buf, response_buf_size(),
+                                     text_out, sizeof(text_out), stream_on_text, NULL);
             metrics.llm_us_total += elapsed_us_since(llm_started_us);
             metrics.llm_calls++;
-            if (err == ESP_OK) {
+            llm_get_conn_stats(&conn_after);
+            metrics.conn_new += conn_after.new_connections - conn_before.new_connections;
+            metrics.conn_reused += conn_after.reused_connections - conn_before.reused_connections;
+            metrics.conn_ticket_offers += conn_after.ticket_offers - conn_before.ticket_offers;
+            metrics.connect_ms += conn_after.connect_ms_total - conn_before.connect_ms_total;
+            if (err == ESP_OK || err == ESP_ERR_INVALID_RESPONSE) {
                 break;
             }
 
@@ -239,6 +1136,12 @@ static void process_message(const char *user_message)
                 break;
             }
 
+            // A retry would repeat text the user has already seen.
+            if (s_stream_out.round_chars > 0) {
+                ESP_LOGW(TAG, "LLM stream failed after partial output, not retrying");
+                break;
+            }
+
             ESP_LOGW(TAG, "LLM request failed (attempt %d/%d), retrying in %dms",
                      retry + 1, LLM_MAX_RETRIES, retry_delay_ms);
             vTaskDelay(pdMS_TO_TICKS(retry_delay_ms));
@@ -250,12 +1153,22 @@ static void process_message(const char *user_message)
             }
         }
 
-        free(request);
+        bool streamed = stream_end_round();
 
+        if (err == ESP_ERR_INVALID_RESPONSE) {
+            ratelimit_record_request();
+            ESP_LOGE(TAG, "Failed to parse response");
+            history_rollback_to(history_turn_start, "llm response parse failed");
+            send_response("Error: Failed to parse LLM response");
+            json_free_parsed_response();
+            metrics_log_request(&metrics, "parse_error");
+            return;
+        }
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "LLM request failed after %d retries", LLM_MAX_RETRIES);
             history_rollback_to(history_turn_start, "llm request failed");
             send_response("Error: Failed to contact LLM API after retries");
+            json_free_parsed_response();
             metrics_log_request(&metrics, "llm_error");
             return;
         }
@@ -263,54 +1176,61 @@ static void process_message(const char *user_message)
         // Record successful request for rate limiting
         ratelimit_record_request();
 
-        // Parse response
-        char text_out[MAX_MESSAGE_LEN] = {0};
-        char tool_name[32] = {0};
-        char tool_id[64] = {0};
-        cJSON *tool_input = NULL;
-
-        if (!json_parse_response(s_response_buf, text_out, sizeof(text_out),
-                                  tool_name, sizeof(tool_name),
-                                  tool_id, sizeof(tool_id),
-                                  &tool_input)) {
-            ESP_LOGE(TAG, "Failed to parse response");
-            history_rollback_to(history_turn_start, "llm response parse failed");
-            send_response("Error: Failed to parse LLM response");
-            json_free_parsed_response();
-            metrics_log_request(&metrics, "parse_error");
-            return;
+        llm_usage_t usage;
+        if (json_get_last_usage(&usage)) {
+            metrics.input_tokens += usage.input_tokens;
+            metrics.output_tokens += usage.output_tokens;
+            metrics.cache_read_tokens += usage.cache_read_tokens;
+            metrics.cache_write_tokens += usage.cache_write_tokens;
+            last_prompt_tokens = usage.input_tokens + usage.cache_read_tokens +
+                                 usage.cache_write_tokens;
+            if (usage.cache_read_tokens > 0 || usage.cache_write_tokens > 0) {
+                ESP_LOGI(TAG, "Prompt cache: read=%" PRIu32 " write=%" PRIu32 " uncached=%" PRIu32,
+                         usage.cache_read_tokens, usage.cache_write_tokens, usage.input_tokens);
+            }
         }
 
-        // Check if it's a tool use
-        if (tool_name[0] != '\0' && tool_input) {
-            ESP_LOGI(TAG, "Tool call: %s (round %d)", tool_name, rounds);
-
-            // Store the tool_input as JSON string for history
-            char *input_str = cJSON_PrintUnformatted(tool_input);
-
-            // Add tool_use to history
-            history_add("assistant", input_str ? input_str : "{}",
-                        true, false, tool_id, tool_name);
-            free(input_str);
-
-            // Check if it's a user-defined tool
-            const user_tool_t *user_tool = user_tools_find(tool_name);
-            metrics.tool_calls++;
-            if (user_tool) {
-                // User tool: return the action as "instruction" for Claude to execute
-                snprintf(s_tool_result_buf, sizeof(s_tool_result_buf),
-                         "Execute this action now: %s", user_tool->action);
-                ESP_LOGI(TAG, "User tool '%s' action: %s", tool_name, user_tool->action);
-            } else {
-                // Built-in tool: execute directly
-                int64_t tool_started_us = esp_timer_get_time();
-                tools_execute(tool_name, tool_input, s_tool_result_buf, sizeof(s_tool_result_buf));
-                metrics.tool_us_total += elapsed_us_since(tool_started_us);
-                ESP_LOGI(TAG, "Tool result: %s", s_tool_result_buf);
+        // Check if it's a tool use; a response may call several tools at once
+        const json_tool_call_t *calls = NULL;
+        int call_count = json_get_tool_calls(&calls);
+        if (call_count > 0) {
+            ESP_LOGI(TAG, "Tool calls: %d, first %s (round %d)", call_count, calls[0].name, rounds);
+
+            // Add the tool_use blocks to history first: one assistant message
+            for (int i = 0; i < call_count; i++) {
+                // Store the tool input as JSON string for history
+                char *input_str = cJSON_PrintUnformatted(calls[i].input);
+                history_add("assistant", input_str ? input_str : "{}",
+                            true, false, calls[i].id, calls[i].name);
+                free(input_str);
+                if (i > 0) {
+                    history_join_previous(s_history);
+                }
             }
 
-            // Add tool_result to history
-            history_add("user", s_tool_result_buf, false, true, tool_id, NULL);
+            // Run the calls a round takes and answer them all in one user
+            // message; the rest get an error result so the model can retry them.
+            for (int i = 0; i < call_count; i++) {
+                if (i >= MAX_TOOL_CALLS_PER_ROUND) {
+                    ESP_LOGW(TAG, "Not running %s: over %d calls per response",
+                             calls[i].name, MAX_TOOL_CALLS_PER_ROUND);
+                    snprintf(s_tool_result_buf, sizeof(s_tool_result_buf),
+                             "Error: not executed: more than %d tool calls per response",
+                             MAX_TOOL_CALLS_PER_ROUND);
+                    history_add_tool_error(calls[i].id, s_tool_result_buf);
+                } else {
+                    if (s_reply.active) {
+                        char status[64];
+                        snprintf(status, sizeof(status), "Running %s...", calls[i].name);
+                        reply_progress(status);
+                    }
+                    run_tool_call(&calls[i], &metrics);
+                    history_add("user", s_tool_result_buf, false, true, calls[i].id, NULL);
+                }
+                if (i > 0) {
+                    history_join_previous(s_history);
+                }
+            }
 
             json_free_parsed_response();
             // Continue loop to let Claude see the result
@@ -318,7 +1238,9 @@ static void process_message(const char *user_message)
             // Text response - we're done
             if (text_out[0] != '\0') {
                 history_add("assistant", text_out, false, false, NULL, NULL);
-                send_response(text_out);
+                if (!streamed) {
+                    send_response(text_out);
+                }
             } else {
                 history_add("assistant", "(No response from Claude)", false, false, NULL, NULL);
                 send_response("(No response from Claude)");
@@ -333,23 +1255,186 @@ static void process_message(const char *user_message)
         history_add("assistant", "(Reached max tool iterations)", false, false, NULL, NULL);
         send_response("(Reached max tool iterations)");
         metrics_log_request(&metrics, "max_rounds");
+        history_maybe_compact(last_prompt_tokens);
         return;
     }
 
+    recorder_finish(true);
     metrics_log_request(&metrics, "success");
+    history_maybe_compact(last_prompt_tokens);
+}
+
+// Process a single user message
+static void process_message(const turn_origin_t *origin, const char *user_message)
+{
+    if (s_router_enabled && route_command(user_message, &user_message)) {
+        return;
+    }
+
+    if (!select_session(origin->source, origin->source_id)) {
+        send_response("Error: Out of memory for conversation history");
+        return;
+    }
+
+    reply_begin(origin);
+    run_turn(origin, user_message);
+    reply_end();
+}
+
+// Move everything producers queued into the scheduler, blocking up to
+// wait_ticks for the first message. Returns whether anything arrived.
+static bool drain_input_queue(TickType_t wait_ticks)
+{
+    static agent_msg_t incoming;
+    bool received = false;
+
+    while (xQueueReceive(s_input_queue, &incoming, wait_ticks) == pdTRUE) {
+        input_sched_push(&incoming);
+        received = true;
+        wait_ticks = 0;
+    }
+    return received;
+}
+
+// True if the router answers text by itself. Such messages are neither
+// merged into a turn nor merged with, so each one still skips the LLM.
+static bool is_routed_command(const char *text)
+{
+    command_route_t route;
+    char name[TOOL_NAME_MAX_LEN];
+
+    return s_router_enabled &&
+           (command_route(text, &route) != COMMAND_NONE ||
+            command_user_tool_name(text, name, sizeof(name)));
+}
+
+// Append the queued messages of first's chat to s_turn_text (which holds
+// first's text), one per line, stopping at a routed command or when the turn
+// is full. If first had to wait for a running turn, the user is likely still
+// typing: keep collecting until the chat has been quiet for the coalescing
+// window. A message that found the agent idle only takes what is already
+// queued. Returns how many were appended.
+static int coalesce_related(const agent_msg_t *first)
+{
+    static agent_msg_t next;
+    size_t len = strlen(s_turn_text);
+    int64_t newest_us = first->enqueued_us;
+    bool waited = first->enqueued_us < s_last_turn_end_us;
+    int merged = 0;
+
+    if (is_routed_command(s_turn_text)) {
+        return 0;
+    }
+
+    while (1) {
+        const agent_msg_t *peeked;
+        while (len + 2 <= sizeof(s_turn_text) &&
+               (peeked = input_sched_peek_related(first)) &&
+               !is_routed_command(peeked->text->text) &&
+               input_sched_take_related(first, sizeof(s_turn_text) - len - 2,
+                                        esp_timer_get_time(), &next)) {
+            size_t next_len = next.text->len;
+            s_turn_text[len++] = '\n';
+            memcpy(s_turn_text + len, next.text->text, next_len + 1);
+            len += next_len;
+            msg_pool_release(next.text);
+            if (next.enqueued_us > newest_us) {
+                newest_us = next.enqueued_us;
+            }
+            merged++;
+        }
+
+        uint64_t quiet_us = elapsed_us_since(newest_us);
+        uint64_t window_us = waited ? (uint64_t)s_coalesce_window_ms * 1000ULL : 0;
+        if (quiet_us >= window_us || len + 2 > sizeof(s_turn_text)) {
+            break;
+        }
+        // Nothing new for the rest of the window: the chat went quiet.
+        if (!drain_input_queue(pdMS_TO_TICKS((window_us - quiet_us + 999) / 1000))) {
+            break;
+        }
+    }
+    return merged;
+}
+
+// Run the most urgent pending message, merged with the rest of its chat's
+// queued messages. Blocks up to wait_ticks, and only while nothing is
+// pending. Returns false if there was nothing to run.
+static bool dispatch_next(TickType_t wait_ticks)
+{
+    static agent_msg_t msg;
+    uint32_t queue_ms = 0;
+
+    drain_input_queue(input_sched_pending() > 0 ? 0 : wait_ticks);
+    if (!input_sched_pop(esp_timer_get_time(), &msg, &queue_ms)) {
+        return false;
+    }
+
+    snprintf(s_turn_text, sizeof(s_turn_text), "%s", msg.text->text);
+    msg_pool_release(msg.text);
+    int messages = 1;
+    if (msg.msg_class == MSG_CLASS_INTERACTIVE) {
+        messages += coalesce_related(&msg);
+        if (messages > 1) {
+            ESP_LOGI(TAG, "Coalesced %d queued messages into one turn", messages);
+        }
+    }
+
+    turn_origin_t origin = {
+        .source = msg.source,
+        .source_id = msg.source_id,
+        .msg_class = msg.msg_class,
+        .queue_ms = queue_ms,
+        .messages = messages,
+    };
+    process_message(&origin, s_turn_text);
+    s_last_turn_end_us = esp_timer_get_time();
+    return true;
 }
 
 #ifdef TEST_BUILD
 void agent_test_reset(void)
 {
-    memset(s_history, 0, sizeof(s_history));
-    s_history_len = 0;
-    memset(s_response_buf, 0, sizeof(s_response_buf));
+    session_test_reset();
+    input_sched_test_reset();
+    msg_pool_test_reset();
+    s_input_queue = NULL;
+    s_coalesce_window_ms = AGENT_COALESCE_WINDOW_MS;
+    s_last_turn_end_us = 0;
+    s_router_enabled = COMMAND_ROUTER_ENABLED;
+    s_plan_mode = AGENT_PLAN_MODE_ENABLED;
+    free(s_plan_tools);
+    s_plan_tools = NULL;
+    s_plan_tool_count = 0;
+    s_router_messages = 0;
+    s_router_hits = 0;
+    s_history = NULL;
+    s_compact_enabled = HISTORY_COMPACT_ENABLED;
+    s_token_budget = LLM_INPUT_TOKEN_BUDGET;
+    alloc_buffers();
+    memset(s_request_buf, 0, LLM_REQUEST_BUF_SIZE);
+    memset(&s_request_cache, 0, sizeof(s_request_cache));
+    memset(s_response_buf, 0, response_buf_size());
     memset(s_tool_result_buf, 0, sizeof(s_tool_result_buf));
+    memset(&s_stream_out, 0, sizeof(s_stream_out));
+    memset(&s_reply, 0, sizeof(s_reply));
+    s_progressive_replies = TELEGRAM_PROGRESSIVE_REPLIES;
+    memset(&s_recorder, 0, sizeof(s_recorder));
+    memset(&s_usage_totals, 0, sizeof(s_usage_totals));
     s_channel_output_queue = NULL;
     s_telegram_output_queue = NULL;
 }
 
+void agent_test_set_history_compaction(bool enabled)
+{
+    s_compact_enabled = enabled;
+}
+
+void agent_test_set_token_budget(size_t tokens)
+{
+    s_token_budget = tokens;
+}
+
 void agent_test_set_queues(QueueHandle_t channel_output_queue,
                            QueueHandle_t telegram_output_queue)
 {
@@ -359,22 +1444,72 @@ void agent_test_set_queues(QueueHandle_t channel_output_queue,
 
 void agent_test_process_message(const char *user_message)
 {
-    process_message(user_message);
+    agent_test_process_source_message(MSG_SOURCE_SERIAL, 0, user_message);
+}
+
+void agent_test_process_source_message(msg_source_t source, int64_t source_id,
+                                       const char *user_message)
+{
+    turn_origin_t origin = {
+        .source = source,
+        .source_id = source_id,
+        .msg_class = source == MSG_SOURCE_CRON ? MSG_CLASS_AUTOMATION : MSG_CLASS_INTERACTIVE,
+        .messages = 1,
+    };
+    process_message(&origin, user_message);
+}
+
+void agent_test_set_input_queue(QueueHandle_t input_queue)
+{
+    s_input_queue = input_queue;
+}
+
+void agent_test_set_command_router(bool enabled)
+{
+    s_router_enabled = enabled;
+}
+
+void agent_test_set_plan_mode(bool enabled)
+{
+    s_plan_mode = enabled;
+}
+
+void agent_test_set_progressive_replies(bool enabled)
+{
+    s_progressive_replies = enabled;
+}
+
+void agent_test_set_coalesce_window(uint32_t window_ms)
+{
+    s_coalesce_window_ms = window_ms;
+}
+
+bool agent_test_dispatch_next(void)
+{
+    return dispatch_next(0);
+}
+
+void agent_test_request_cache_stats(uint32_t *full_builds, uint32_t *appends)
+{
+    *full_builds = s_request_cache.full_builds;
+    *appends = s_request_cache.appends;
 }
 #endif
 
+void agent_get_usage_totals(agent_usage_totals_t *totals)
+{
+    *totals = s_usage_totals;
+}
+
 // Agent task
 static void agent_task(void *arg)
 {
     (void)arg;
-    channel_msg_t msg;
 
     ESP_LOGI(TAG, "Agent task started");
 
     while (1) {
-        if (xQueueReceive(s_input_queue, &msg, portMAX_DELAY) == pdTRUE) {
-            process_message(msg.text);
-        }
+        dispatch_next(portMAX_DELAY);
     }
 }
 
@@ -390,6 +1525,11 @@ esp_err_t agent_start(QueueHandle_t input_queue,
     s_input_queue = input_queue;
     s_channel_output_queue = channel_output_queue;
     s_telegram_output_queue = telegram_output_queue;
+    session_init();
+    if (!alloc_buffers() || !input_sched_init()) {
+        ESP_LOGE(TAG, "Failed to allocate agent buffers");
+        return ESP_ERR_NO_MEM;
+    }
 
     if (xTaskCreate(agent_task, "agent", AGENT_TASK_STACK_SIZE, NULL,
                     AGENT_TASK_PRIORITY, NULL) != pdPASS) {
@@ -2,20 +2,50 @@
 #define AGENT_H
 
 #include "esp_err.h"
+#include "messages.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Token usage summed over all requests since boot
+typedef struct {
+    uint32_t requests;
+    uint64_t input_tokens;          // All input tokens, cached or not
+    uint64_t output_tokens;
+    uint64_t cache_read_tokens;     // Part of input_tokens served from the prompt cache
+    uint32_t last_input_tokens;     // Most recent request
+    uint32_t last_output_tokens;
+} agent_usage_totals_t;
 
 // Start the agent task
 esp_err_t agent_start(QueueHandle_t input_queue,
                       QueueHandle_t channel_output_queue,
                       QueueHandle_t telegram_output_queue);
 
+// Copy of the token usage totals (agent task context only)
+void agent_get_usage_totals(agent_usage_totals_t *totals);
+
 #ifdef TEST_BUILD
 // Test-only helpers to drive agent logic without spawning FreeRTOS tasks.
 void agent_test_reset(void);
+void agent_test_set_history_compaction(bool enabled);
+void agent_test_set_token_budget(size_t tokens);
+void agent_test_set_command_router(bool enabled);
+void agent_test_set_plan_mode(bool enabled);
+void agent_test_set_progressive_replies(bool enabled);
 void agent_test_set_queues(QueueHandle_t channel_output_queue,
                            QueueHandle_t telegram_output_queue);
+// Processes user_message as serial input
 void agent_test_process_message(const char *user_message);
+void agent_test_process_source_message(msg_source_t source, int64_t source_id,
+                                       const char *user_message);
+// Queue drained by agent_test_dispatch_next(), which runs one scheduled
+// message and returns false when none is pending
+void agent_test_set_input_queue(QueueHandle_t input_queue);
+bool agent_test_dispatch_next(void);
+void agent_test_set_coalesce_window(uint32_t window_ms);
+void agent_test_request_cache_stats(uint32_t *full_builds, uint32_t *appends);
 #endif
 
 #endif // AGENT_H
@@ -0,0 +1,107 @@
+#include "buffers.h"
+#include "config.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "buffers";
+
+#define BUFFER_MAX_NAMED    16
+
+typedef struct {
+    const char *name;
+    size_t size;
+    bool psram;
+} buffer_record_t;
+
+static buffer_record_t s_records[BUFFER_MAX_NAMED];
+static int s_record_count = 0;
+
+static void record(const char *name, size_t size, bool psram)
+{
+    for (int i = 0; i < s_record_count; i++) {
+        if (strcmp(s_records[i].name, name) == 0) {
+            s_records[i].size = size;
+            s_records[i].psram = psram;
+            return;
+        }
+    }
+    if (s_record_count < BUFFER_MAX_NAMED) {
+        s_records[s_record_count++] = (buffer_record_t){.name = name, .size = size, .psram = psram};
+    }
+}
+
+void *buffer_alloc(const char *name, size_t size, buffer_kind_t kind)
+{
+    void *ptr = NULL;
+    bool psram = false;
+
+    if (kind == BUFFER_BULK) {
+        ptr = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        psram = ptr != NULL;
+    }
+    if (!ptr) {
+        ptr = heap_caps_calloc(1, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!ptr) {
+        ESP_LOGE(TAG, "No memory for %s (%u bytes)", name ? name : "buffer", (unsigned)size);
+        return NULL;
+    }
+    if (name) {
+        record(name, size, psram);
+    }
+    return ptr;
+}
+
+QueueHandle_t buffer_queue_create(const char *name, UBaseType_t length, UBaseType_t item_size)
+{
+    StaticQueue_t *queue = buffer_alloc(NULL, sizeof(StaticQueue_t), BUFFER_INTERNAL);
+    uint8_t *storage = buffer_alloc(name, (size_t)length * item_size, BUFFER_BULK);
+    if (!queue || !storage) {
+        free(queue);
+        free(storage);
+        return NULL;
+    }
+    return xQueueCreateStatic(length, item_size, storage, queue);
+}
+
+bool buffer_in_psram(const char *name)
+{
+    for (int i = 0; i < s_record_count; i++) {
+        if (strcmp(s_records[i].name, name) == 0) {
+            return s_records[i].psram;
+        }
+    }
+    return false;
+}
+
+void buffer_report(void)
+{
+    size_t psram_bytes = 0;
+    size_t internal_bytes = 0;
+
+    for (int i = 0; i < s_record_count; i++) {
+        ESP_LOGI(TAG, "  %-16s %6u bytes  %s", s_records[i].name, (unsigned)s_records[i].size,
+                 s_records[i].psram ? "PSRAM" : "internal");
+        if (s_records[i].psram) {
+            psram_bytes += s_records[i].size;
+        } else {
+            internal_bytes += s_records[i].size;
+        }
+    }
+    ESP_LOGI(TAG, "Memory profile %s: %u bytes in PSRAM, %u internal; free PSRAM %u, internal %u",
+             MEMORY_PROFILE_NAME, (unsigned)psram_bytes, (unsigned)internal_bytes,
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    if (MEMORY_SCALE > 1 && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+        ESP_LOGW(TAG, "Memory profile %s expects PSRAM, but none was found", MEMORY_PROFILE_NAME);
+    }
+}
+
+#ifdef TEST_BUILD
+void buffer_test_reset(void)
+{
+    s_record_count = 0;
+}
+#endif
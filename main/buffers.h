@@ -0,0 +1,38 @@
+#ifndef BUFFERS_H
+#define BUFFERS_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Placement of large buffers. Bulk buffers (request/response JSON, session
+// histories, queue storage) go to PSRAM when the board has it and fall back
+// to internal RAM otherwise. Latency-critical buffers stay internal. Never
+// use either for DMA.
+typedef enum {
+    BUFFER_BULK = 0,        // PSRAM preferred, internal RAM fallback
+    BUFFER_INTERNAL,        // Internal RAM only
+} buffer_kind_t;
+
+// Zeroed allocation, released with free(). A named buffer is listed in the
+// boot report (name must outlive it); pass NULL for transient buffers.
+// Returns NULL if neither region has room.
+void *buffer_alloc(const char *name, size_t size, buffer_kind_t kind);
+
+// Queue whose item storage is a bulk buffer (the queue control block stays
+// internal). Never deleted.
+QueueHandle_t buffer_queue_create(const char *name, UBaseType_t length, UBaseType_t item_size);
+
+// Whether the last named allocation of name landed in PSRAM
+bool buffer_in_psram(const char *name);
+
+// Log each named buffer's size and region, plus free memory per region.
+void buffer_report(void);
+
+#ifdef TEST_BUILD
+// Forget the named buffers (tests only; the memory is not freed).
+void buffer_test_reset(void);
+#endif
+
+#endif // BUFFERS_H
@@ -1,6 +1,8 @@
 #include "channel.h"
 #include "config.h"
 #include "messages.h"
+#include "msg_pool.h"
+#include "buffers.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -10,6 +12,7 @@
 #include "driver/usb_serial_jtag.h"
 #endif
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -28,7 +31,7 @@ typedef struct {
 } llm_bridge_response_t;
 
 static QueueHandle_t s_llm_bridge_queue = NULL;
-static char s_llm_bridge_payload[LLM_RESPONSE_BUF_SIZE];
+static char *s_llm_bridge_payload;     // LLM_RESPONSE_BUF_SIZE, bulk
 #endif
 
 #if CONFIG_ZCLAW_CHANNEL_UART
@@ -137,7 +140,7 @@ void channel_init(void)
 // Read task: accumulate characters into lines, push to input queue
 static void channel_read_task(void *arg)
 {
-    char line_buf[CHANNEL_RX_BUF_SIZE];
+    static char line_buf[INPUT_MAX_LEN + 1];
     int line_pos = 0;
     uint8_t byte;
 #if CONFIG_ZCLAW_EMULATOR_LIVE_LLM
@@ -176,7 +179,7 @@ static void channel_read_task(void *arg)
 
                 if (held_echo_len > 0) {
                     for (int i = 0; i < held_echo_len; i++) {
-                        if (line_pos < CHANNEL_RX_BUF_SIZE - 1) {
+                        if (line_pos < INPUT_MAX_LEN) {
                             line_buf[line_pos++] = held_echo[i];
                         }
                         channel_io_write_bytes((const uint8_t *)&held_echo[i], 1, portMAX_DELAY);
@@ -191,11 +194,18 @@ static void channel_read_task(void *arg)
                     channel_io_write_bytes((const uint8_t *)"\r\n", 2, portMAX_DELAY);
 
                     // Push to input queue
-                    channel_msg_t msg;
-                    strncpy(msg.text, line_buf, CHANNEL_RX_BUF_SIZE - 1);
-                    msg.text[CHANNEL_RX_BUF_SIZE - 1] = '\0';
-
-                    if (xQueueSend(s_input_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+                    agent_msg_t msg = {
+                        .source = MSG_SOURCE_SERIAL,
+                        .msg_class = MSG_CLASS_INTERACTIVE,
+                        .source_id = 0,
+                        .enqueued_us = esp_timer_get_time(),
+                        .text = msg_pool_copy(line_buf, line_pos),
+                    };
+
+                    if (!msg.text) {
+                        ESP_LOGW(TAG, "No buffer for input, dropping message");
+                    } else if (xQueueSend(s_input_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+                        msg_pool_release(msg.text);
                         ESP_LOGW(TAG, "Input queue full, dropping message");
                     }
                 }
@@ -229,7 +239,7 @@ static void channel_read_task(void *arg)
 #if CONFIG_ZCLAW_EMULATOR_LIVE_LLM
             } else {
                 if (bridge_line) {
-                    if (bridge_payload_pos < sizeof(s_llm_bridge_payload) - 1) {
+                    if (bridge_payload_pos < LLM_RESPONSE_BUF_SIZE - 1) {
                         s_llm_bridge_payload[bridge_payload_pos++] = (char)byte;
                     } else {
                         bridge_payload_truncated = true;
@@ -255,7 +265,7 @@ static void channel_read_task(void *arg)
                     prefix_check_active = false;
                     if (held_echo_len > 0) {
                         for (int i = 0; i < held_echo_len; i++) {
-                            if (line_pos < CHANNEL_RX_BUF_SIZE - 1) {
+                            if (line_pos < INPUT_MAX_LEN) {
                                 line_buf[line_pos++] = held_echo[i];
                             }
                             channel_io_write_bytes((const uint8_t *)&held_echo[i], 1, portMAX_DELAY);
@@ -264,13 +274,13 @@ static void channel_read_task(void *arg)
                     }
                 }
 
-                if (line_pos < CHANNEL_RX_BUF_SIZE - 1) {
+                if (line_pos < INPUT_MAX_LEN) {
                     line_buf[line_pos++] = (char)byte;
                 }
                 channel_io_write_bytes(&byte, 1, portMAX_DELAY);
 #else
             } else {
-                if (line_pos < CHANNEL_RX_BUF_SIZE - 1) {
+                if (line_pos < INPUT_MAX_LEN) {
                     line_buf[line_pos++] = (char)byte;
                 }
                 channel_io_write_bytes(&byte, 1, portMAX_DELAY);
@@ -288,9 +298,10 @@ static void channel_write_task(void *arg)
     while (1) {
         if (xQueueReceive(s_output_queue, &msg, portMAX_DELAY) == pdTRUE) {
             // Print response with newlines
-            const char *text = msg.text;
+            const char *text = msg.text->text;
             channel_write_normalized_text(text, portMAX_DELAY);
             channel_io_write_bytes((const uint8_t *)"\r\n\r\n", 4, portMAX_DELAY);
+            msg_pool_release(msg.text);
         }
     }
 }
@@ -309,9 +320,12 @@ esp_err_t channel_start(QueueHandle_t input_queue, QueueHandle_t output_queue)
     s_output_queue = output_queue;
 
 #if CONFIG_ZCLAW_EMULATOR_LIVE_LLM
+    if (!s_llm_bridge_payload) {
+        s_llm_bridge_payload = buffer_alloc("llm_bridge", LLM_RESPONSE_BUF_SIZE, BUFFER_BULK);
+    }
     s_llm_bridge_queue = xQueueCreate(1, sizeof(llm_bridge_response_t));
-    if (!s_llm_bridge_queue) {
-        ESP_LOGE(TAG, "Failed to create LLM bridge queue");
+    if (!s_llm_bridge_payload || !s_llm_bridge_queue) {
+        ESP_LOGE(TAG, "Failed to create LLM bridge queue and buffer");
         return ESP_ERR_NO_MEM;
     }
 #endif
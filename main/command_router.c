@@ -0,0 +1,304 @@
+#include "command_router.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#define COMMAND_MAX_WORDS       6
+#define COMMAND_WORD_MAX        24
+
+typedef struct {
+    char words[COMMAND_MAX_WORDS][COMMAND_WORD_MAX];
+    int count;
+} command_words_t;
+
+static const char *s_help_text =
+    "Commands (answered without the LLM):\n"
+    "/health, /time, /version\n"
+    "/gpio <pin> [on|off]\n"
+    "/cron [list], /cron delete <id>\n"
+    "/memory [list], /memory get <key>\n"
+    "/tools, /<user tool> - replays a recorded user tool\n"
+    "/ask <text> - send text to the model as is\n"
+    "Also: \"gpio 5 on\", \"turn off pin 5\", \"read pin 5\", \"what time is it\"";
+
+// Lowercased words of text, without trailing ".!?". False if there are too
+// many words or one is too long: not a command.
+static bool split_words(const char *text, command_words_t *out)
+{
+    size_t len = strlen(text);
+    while (len > 0 && (isspace((unsigned char)text[len - 1]) || text[len - 1] == '.' ||
+                       text[len - 1] == '!' || text[len - 1] == '?')) {
+        len--;
+    }
+
+    out->count = 0;
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && isspace((unsigned char)text[i])) {
+            i++;
+        }
+        if (i >= len) {
+            break;
+        }
+        if (out->count >= COMMAND_MAX_WORDS) {
+            return false;
+        }
+        size_t n = 0;
+        char *word = out->words[out->count++];
+        while (i < len && !isspace((unsigned char)text[i])) {
+            if (n + 1 >= COMMAND_WORD_MAX) {
+                return false;
+            }
+            word[n++] = (char)tolower((unsigned char)text[i++]);
+        }
+        word[n] = '\0';
+    }
+    return out->count > 0;
+}
+
+static bool parse_number(const char *word, int max, int *value)
+{
+    int parsed = 0;
+    if (*word == '\0') {
+        return false;
+    }
+    for (const char *c = word; *c; c++) {
+        if (!isdigit((unsigned char)*c)) {
+            return false;
+        }
+        parsed = parsed * 10 + (*c - '0');
+        if (parsed > max) {
+            return false;
+        }
+    }
+    *value = parsed;
+    return true;
+}
+
+static bool parse_state(const char *word, int *state)
+{
+    if (strcmp(word, "on") == 0 || strcmp(word, "high") == 0 || strcmp(word, "1") == 0) {
+        *state = 1;
+        return true;
+    }
+    if (strcmp(word, "off") == 0 || strcmp(word, "low") == 0 || strcmp(word, "0") == 0) {
+        *state = 0;
+        return true;
+    }
+    return false;
+}
+
+static bool is_pin_word(const char *word)
+{
+    return strcmp(word, "gpio") == 0 || strcmp(word, "pin") == 0;
+}
+
+// Memory keys are passed on as JSON strings; only plain identifiers route.
+static bool is_key_word(const char *word)
+{
+    for (const char *c = word; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_') {
+            return false;
+        }
+    }
+    return *word != '\0';
+}
+
+static command_kind_t route_tool(command_route_t *out, const char *tool)
+{
+    out->kind = COMMAND_TOOL;
+    out->tool = tool;
+    snprintf(out->input_json, sizeof(out->input_json), "{}");
+    return COMMAND_TOOL;
+}
+
+static command_kind_t route_gpio(command_route_t *out, int pin, const int *state)
+{
+    out->kind = COMMAND_TOOL;
+    if (state) {
+        out->tool = "gpio_write";
+        snprintf(out->input_json, sizeof(out->input_json), "{\"pin\":%d,\"state\":%d}", pin, *state);
+    } else {
+        out->tool = "gpio_read";
+        snprintf(out->input_json, sizeof(out->input_json), "{\"pin\":%d}", pin);
+    }
+    return COMMAND_TOOL;
+}
+
+static command_kind_t route_slash(const command_words_t *w, command_route_t *out)
+{
+    char name[COMMAND_WORD_MAX];
+    int pin;
+    int state;
+    int id;
+
+    // "/health@zclaw_bot" is how Telegram addresses a command in groups.
+    snprintf(name, sizeof(name), "%s", w->words[0] + 1);
+    char *at = strchr(name, '@');
+    if (at) {
+        *at = '\0';
+    }
+
+    if (w->count == 1) {
+        if (strcmp(name, "help") == 0) {
+            out->kind = COMMAND_HELP;
+            return COMMAND_HELP;
+        }
+        if (strcmp(name, "health") == 0 || strcmp(name, "status") == 0) {
+            return route_tool(out, "get_health");
+        }
+        if (strcmp(name, "time") == 0) {
+            return route_tool(out, "get_time");
+        }
+        if (strcmp(name, "version") == 0) {
+            return route_tool(out, "get_version");
+        }
+        if (strcmp(name, "tools") == 0) {
+            return route_tool(out, "list_user_tools");
+        }
+    }
+
+    if (strcmp(name, "cron") == 0) {
+        if (w->count == 1 || (w->count == 2 && strcmp(w->words[1], "list") == 0)) {
+            return route_tool(out, "cron_list");
+        }
+        if (w->count == 3 && (strcmp(w->words[1], "delete") == 0 || strcmp(w->words[1], "rm") == 0) &&
+            parse_number(w->words[2], 255, &id)) {
+            route_tool(out, "cron_delete");
+            snprintf(out->input_json, sizeof(out->input_json), "{\"id\":%d}", id);
+            return COMMAND_TOOL;
+        }
+    }
+
+    if (strcmp(name, "memory") == 0) {
+        if (w->count == 1 || (w->count == 2 && strcmp(w->words[1], "list") == 0)) {
+            return route_tool(out, "memory_list");
+        }
+        if (w->count == 3 && strcmp(w->words[1], "get") == 0 && is_key_word(w->words[2])) {
+            route_tool(out, "memory_get");
+            snprintf(out->input_json, sizeof(out->input_json), "{\"key\":\"%s\"}", w->words[2]);
+            return COMMAND_TOOL;
+        }
+    }
+
+    if (strcmp(name, "gpio") == 0 && w->count >= 2 && w->count <= 3 &&
+        parse_number(w->words[1], 99, &pin)) {
+        if (w->count == 2) {
+            return route_gpio(out, pin, NULL);
+        }
+        if (parse_state(w->words[2], &state)) {
+            return route_gpio(out, pin, &state);
+        }
+    }
+
+    return COMMAND_NONE;
+}
+
+static command_kind_t route_phrase(const command_words_t *w, command_route_t *out)
+{
+    int pin;
+    int state;
+
+    // "gpio 5 on", "pin 5 off"
+    if (w->count == 3 && is_pin_word(w->words[0]) && parse_number(w->words[1], 99, &pin) &&
+        parse_state(w->words[2], &state)) {
+        return route_gpio(out, pin, &state);
+    }
+    // "turn on pin 5"
+    if (w->count == 4 && strcmp(w->words[0], "turn") == 0 && parse_state(w->words[1], &state) &&
+        is_pin_word(w->words[2]) && parse_number(w->words[3], 99, &pin)) {
+        return route_gpio(out, pin, &state);
+    }
+    // "turn pin 5 off"
+    if (w->count == 4 && strcmp(w->words[0], "turn") == 0 && is_pin_word(w->words[1]) &&
+        parse_number(w->words[2], 99, &pin) && parse_state(w->words[3], &state)) {
+        return route_gpio(out, pin, &state);
+    }
+    // "read pin 5"
+    if (w->count == 3 && strcmp(w->words[0], "read") == 0 && is_pin_word(w->words[1]) &&
+        parse_number(w->words[2], 99, &pin)) {
+        return route_gpio(out, pin, NULL);
+    }
+    // "what time is it"
+    if (w->count == 4 && strcmp(w->words[0], "what") == 0 && strcmp(w->words[1], "time") == 0 &&
+        strcmp(w->words[2], "is") == 0 && strcmp(w->words[3], "it") == 0) {
+        return route_tool(out, "get_time");
+    }
+    return COMMAND_NONE;
+}
+
+command_kind_t command_route(const char *text, command_route_t *out)
+{
+    command_words_t words;
+
+    memset(out, 0, sizeof(*out));
+    if (!text) {
+        return COMMAND_NONE;
+    }
+
+    // "/ask" is checked on the raw text: what follows goes to the LLM as is.
+    const char *start = text;
+    while (isspace((unsigned char)*start)) {
+        start++;
+    }
+    if (strncmp(start, "/ask", 4) == 0 && (start[4] == '\0' || isspace((unsigned char)start[4]))) {
+        const char *rest = start + 4;
+        while (isspace((unsigned char)*rest)) {
+            rest++;
+        }
+        if (*rest == '\0') {
+            return COMMAND_NONE;
+        }
+        out->kind = COMMAND_ASK;
+        out->llm_text = rest;
+        return COMMAND_ASK;
+    }
+
+    if (!split_words(text, &words)) {
+        return COMMAND_NONE;
+    }
+    command_kind_t kind = words.words[0][0] == '/' ? route_slash(&words, out)
+                                                   : route_phrase(&words, out);
+    if (kind == COMMAND_NONE) {
+        memset(out, 0, sizeof(*out));
+    }
+    return kind;
+}
+
+bool command_user_tool_name(const char *text, char *name, size_t name_len)
+{
+    if (!text || !name || name_len == 0) {
+        return false;
+    }
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    if (*text++ != '/') {
+        return false;
+    }
+
+    size_t n = 0;
+    while (isalnum((unsigned char)*text) || *text == '_') {
+        if (n + 1 >= name_len) {
+            return false;
+        }
+        name[n++] = *text++;
+    }
+    name[n] = '\0';
+
+    if (*text == '@') {
+        text++;
+        while (isalnum((unsigned char)*text) || *text == '_') {
+            text++;
+        }
+    }
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    return n > 0 && *text == '\0';
+}
+
+const char *command_router_help(void)
+{
+    return s_help_text;
+}
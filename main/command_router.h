@@ -0,0 +1,40 @@
+#ifndef COMMAND_ROUTER_H
+#define COMMAND_ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Deterministic grammar for simple commands that map straight to one tool
+// call, so they skip the LLM: slash commands ("/health", "/gpio 5 on",
+// "/cron list") and a few strict phrases ("gpio 5 on", "turn off pin 4",
+// "read pin 3", "what time is it"). Anything else goes to the LLM
+// unchanged; "/ask <text>" forces that.
+
+#define COMMAND_INPUT_JSON_MAX  64
+
+typedef enum {
+    COMMAND_NONE = 0,       // Not a command: send the message to the LLM
+    COMMAND_TOOL,           // Run tool with input_json
+    COMMAND_HELP,           // Reply with command_router_help()
+    COMMAND_ASK,            // Send llm_text to the LLM, bypassing the router
+} command_kind_t;
+
+typedef struct {
+    command_kind_t kind;
+    const char *tool;
+    char input_json[COMMAND_INPUT_JSON_MAX];
+    const char *llm_text;   // Points into the routed text
+} command_route_t;
+
+// Match text against the grammar. Case-insensitive; surrounding whitespace
+// and trailing ".!?" are ignored, and a Telegram "@botname" suffix on a
+// slash command is dropped.
+command_kind_t command_route(const char *text, command_route_t *out);
+
+// Name of a user tool invoked as a lone slash command ("/water_plants",
+// "/water_plants@zclaw_bot"), case kept. False if text is not one.
+bool command_user_tool_name(const char *text, char *name, size_t name_len);
+
+const char *command_router_help(void);
+
+#endif // COMMAND_ROUTER_H
@@ -1,31 +1,88 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// -----------------------------------------------------------------------------
+// Memory Profile (bulk buffers are placed in PSRAM when present, see buffers.h)
+// -----------------------------------------------------------------------------
+#ifdef CONFIG_ZCLAW_MEMORY_PROFILE_PSRAM
+#define MEMORY_PROFILE_NAME     "psram"
+#define MEMORY_SCALE            4       // Multiplier for buffers and history (not the session count)
+#else
+#define MEMORY_PROFILE_NAME     "standard"
+#define MEMORY_SCALE            1
+#endif
+
 // -----------------------------------------------------------------------------
 // Buffer Sizes
 // -----------------------------------------------------------------------------
-#define LLM_REQUEST_BUF_SIZE    12288   // 12KB for outgoing JSON
-#define LLM_RESPONSE_BUF_SIZE   16384   // 16KB for incoming JSON
-#define CHANNEL_RX_BUF_SIZE     512     // Input line buffer
+#define LLM_REQUEST_BUF_SIZE    (16384 * MEMORY_SCALE)  // 16KB per scale step for outgoing JSON
+#define LLM_RESPONSE_BUF_SIZE   (16384 * MEMORY_SCALE)  // 16KB per scale step for incoming JSON
+#define CHANNEL_RX_BUF_SIZE     512     // Serial driver RX/TX buffers
+#define INPUT_MAX_LEN           (MAX_MESSAGE_LEN - 1)   // Longest user message accepted (serial line, Telegram text)
+#define MSG_POOL_BYTES          (15360 * MEMORY_SCALE)  // Heap budget for queued message text (see msg_pool.h)
 #define TOOL_RESULT_BUF_SIZE    512     // Tool execution result
 
 // -----------------------------------------------------------------------------
 // Conversation History
 // -----------------------------------------------------------------------------
-#define MAX_HISTORY_TURNS       12      // User/assistant pairs to keep
+#define HISTORY_ARENA_BYTES     (8192 * MEMORY_SCALE)   // Byte budget for conversation history text
+#define HISTORY_MAX_MESSAGES    (40 * MEMORY_SCALE)     // Most messages kept, whatever their size
 #define MAX_MESSAGE_LEN         1024    // Max length per message in history
 
+#ifdef CONFIG_ZCLAW_HISTORY_COMPACTION
+#define HISTORY_COMPACT_ENABLED CONFIG_ZCLAW_HISTORY_COMPACTION
+#else
+#define HISTORY_COMPACT_ENABLED 0
+#endif
+#define HISTORY_ELIDED_RESULT   "(result elided to fit the token budget)"
+#define HISTORY_COMPACT_BYTES   (HISTORY_ARENA_BYTES * 3 / 4)  // History size that triggers a summary
+#define HISTORY_COMPACT_TOKENS  12000   // Prompt tokens that trigger a summary
+#define HISTORY_COMPACT_KEEP_TURNS 2    // Most recent user turns kept verbatim
+#define HISTORY_COMPACT_MIN_MESSAGES 4  // Fewer older messages than this are not worth a summary
+#define HISTORY_SUMMARY_MAX_TOKENS 400  // Response budget for a summary
+
+// -----------------------------------------------------------------------------
+// Sessions (one conversation history per message origin)
+// -----------------------------------------------------------------------------
+// The standard cap holds three histories (serial, Telegram, cron) of ~10 KB,
+// or ~11.5 KB with 64-bit pointers. Sessions and the message pool together
+// stay within the ~51 KB the single 24-slot history and the fixed-size queue
+// copies used to take.
+#define SESSION_MAX_COUNT       4       // Origins (serial, Telegram chats, cron) held at once
+#define SESSION_MEMORY_CAP      (35840 * MEMORY_SCALE)  // Heap for session histories; LRU evicted beyond it
+
 // -----------------------------------------------------------------------------
 // Agent Loop
 // -----------------------------------------------------------------------------
 #define MAX_TOOL_ROUNDS         5       // Max tool call iterations per request
+#define MAX_TOOL_CALLS_PER_ROUND 4      // Parallel tool calls executed from one response
+#define MAX_TOOL_CALLS_PER_RESPONSE 16  // Calls kept from one response; those past the round limit get an error result
+
+#ifdef CONFIG_ZCLAW_COMMAND_ROUTER
+#define COMMAND_ROUTER_ENABLED  CONFIG_ZCLAW_COMMAND_ROUTER
+#else
+#define COMMAND_ROUTER_ENABLED  0
+#endif
+
+#ifdef CONFIG_ZCLAW_AGENT_PLAN_MODE
+#define AGENT_PLAN_MODE_ENABLED CONFIG_ZCLAW_AGENT_PLAN_MODE
+#else
+#define AGENT_PLAN_MODE_ENABLED 0
+#endif
+#define AGENT_PLAN_MAX_STEPS    16      // Tool calls in one run_plan
+
+#ifdef CONFIG_ZCLAW_COALESCE_WINDOW_MS
+#define AGENT_COALESCE_WINDOW_MS CONFIG_ZCLAW_COALESCE_WINDOW_MS
+#else
+#define AGENT_COALESCE_WINDOW_MS 300    // Wait for follow-ups to a message that queued behind a turn
+#endif
 
 // -----------------------------------------------------------------------------
 // FreeRTOS Tasks
 // -----------------------------------------------------------------------------
 #define AGENT_TASK_STACK_SIZE   8192
 #define CHANNEL_TASK_STACK_SIZE 4096
-#define CRON_TASK_STACK_SIZE    4096
+#define CRON_TASK_STACK_SIZE    6144    // Runs scripted tool steps
 #define AGENT_TASK_PRIORITY     5
 #define CHANNEL_TASK_PRIORITY   5
 #define CRON_TASK_PRIORITY      4
@@ -34,6 +91,8 @@
 // Queues
 // -----------------------------------------------------------------------------
 #define INPUT_QUEUE_LENGTH      8
+#define INPUT_SCHED_CLASS_DEPTH INPUT_QUEUE_LENGTH  // Messages held per scheduling class
+#define INPUT_SCHED_AGING_MS    30000   // Waiting this long raises a message one class
 #define OUTPUT_QUEUE_LENGTH     8
 #define TELEGRAM_OUTPUT_QUEUE_LENGTH 4
 
@@ -55,7 +114,34 @@ typedef enum {
 #define LLM_DEFAULT_MODEL_OPENROUTER  "minimax/minimax-m2.5"
 
 #define LLM_MAX_TOKENS          1024
+#define LLM_INPUT_TOKEN_BUDGET  (4096 * MEMORY_SCALE)   // Estimated input tokens per request (system, tools, history)
 #define HTTP_TIMEOUT_MS         30000   // 30 seconds for API calls
+#define HTTP_STALE_CONN_MS      2000    // A reused socket failing this fast was closed by the server while idle
+#define LLM_KEEPALIVE_IDLE_S    30      // TCP keep-alive probe after idle (seconds)
+#define LLM_KEEPALIVE_INTERVAL_S 10     // Interval between keep-alive probes
+#define LLM_KEEPALIVE_COUNT     3       // Failed probes before the socket is dropped
+
+// -----------------------------------------------------------------------------
+// Response Streaming (server-sent events)
+// -----------------------------------------------------------------------------
+#ifdef CONFIG_ZCLAW_LLM_STREAMING
+#define LLM_STREAMING_ENABLED   CONFIG_ZCLAW_LLM_STREAMING
+#else
+#define LLM_STREAMING_ENABLED   0
+#endif
+#define LLM_STREAM_LINE_BUF_SIZE 2048   // Longest single SSE line kept
+#define LLM_STREAM_TOOL_INPUT_SIZE (2 * MAX_MESSAGE_LEN)  // Raw input JSON of the tool calls still streaming
+#define LLM_STREAM_ERROR_BUF_SIZE 1024  // Response buffer when streaming: only error bodies land in it
+#define LLM_STREAM_TELEGRAM_BATCH 320   // Chars buffered before a Telegram flush
+
+// -----------------------------------------------------------------------------
+// Prompt Caching (Anthropic cache_control breakpoints)
+// -----------------------------------------------------------------------------
+#ifdef CONFIG_ZCLAW_PROMPT_CACHING
+#define LLM_PROMPT_CACHE_ENABLED CONFIG_ZCLAW_PROMPT_CACHING
+#else
+#define LLM_PROMPT_CACHE_ENABLED 0
+#endif
 
 // -----------------------------------------------------------------------------
 // System Prompt
@@ -67,7 +153,25 @@ typedef enum {
     "Be concise - you're on a tiny chip. " \
     "Use your tools to control hardware, remember things, and automate tasks. " \
     "Users can create custom tools with create_tool. When you call a custom tool, " \
-    "you'll receive an action to execute - carry it out using your built-in tools."
+    "you'll receive an action to execute - carry it out using your built-in tools - " \
+    "or, once it has been recorded, the results of replaying it."
+
+// Added in plan mode (AGENT_PLAN_MODE_ENABLED)
+#define SYSTEM_PROMPT_PLAN SYSTEM_PROMPT \
+    " For a task that needs several tool calls, call run_plan once with every step in " \
+    "order (use delay for waits); the device runs them and returns all results. Then " \
+    "reply with a short summary, or call run_plan again with the remaining steps if one " \
+    "failed. Call tools directly only when a step depends on an earlier result."
+
+// Instructions for compacting old history into a summary
+#define HISTORY_SUMMARY_PROMPT \
+    "Summarize the conversation transcript below for an assistant that will continue it " \
+    "without seeing it. Keep facts the user shared, their requests and preferences, " \
+    "devices and GPIO pins involved, tool results that still matter, and open tasks. " \
+    "Write plain prose, at most 150 words, with no preamble."
+
+// Prefix of the history message holding the summary
+#define HISTORY_SUMMARY_PREFIX  "[Summary of the earlier conversation] "
 
 // -----------------------------------------------------------------------------
 // GPIO tool safety range (configurable via Kconfig)
@@ -117,6 +221,21 @@ typedef enum {
 #define TELEGRAM_POLL_TIMEOUT   30      // Long polling timeout (seconds)
 #define TELEGRAM_POLL_INTERVAL  100     // ms between poll attempts on error
 #define TELEGRAM_MAX_MSG_LEN    4096    // Max message length
+#define TELEGRAM_POLL_LIMIT     INPUT_QUEUE_LENGTH  // Updates fetched per getUpdates round trip
+#define TELEGRAM_QUEUE_WAIT_MS  1000    // Wait for input queue space before deferring an update
+#define TELEGRAM_SEND_RETRIES   3       // Backed-off retries of a reply after transport errors
+#define TELEGRAM_KEEPALIVE_IDLE_S LLM_KEEPALIVE_IDLE_S
+#define TELEGRAM_KEEPALIVE_INTERVAL_S LLM_KEEPALIVE_INTERVAL_S
+#define TELEGRAM_KEEPALIVE_COUNT LLM_KEEPALIVE_COUNT
+
+#ifdef CONFIG_ZCLAW_TELEGRAM_PROGRESSIVE_REPLIES
+#define TELEGRAM_PROGRESSIVE_REPLIES CONFIG_ZCLAW_TELEGRAM_PROGRESSIVE_REPLIES
+#else
+#define TELEGRAM_PROGRESSIVE_REPLIES 0
+#endif
+#define TELEGRAM_REPLY_PLACEHOLDER "Thinking..."
+#define TELEGRAM_EDIT_INTERVAL_MS 1000  // Min gap between writes to a private chat
+#define TELEGRAM_GROUP_EDIT_INTERVAL_MS 3000    // Groups allow about 20 per minute
 
 // -----------------------------------------------------------------------------
 // Cron / Scheduler
@@ -124,6 +243,7 @@ typedef enum {
 #define CRON_CHECK_INTERVAL_MS  60000   // Check schedules every minute
 #define CRON_MAX_ENTRIES        16      // Max scheduled tasks
 #define CRON_MAX_ACTION_LEN     256     // Max action string length
+#define CRON_MAX_SCRIPT_LEN     192     // Max stored script (JSON steps) length
 
 // -----------------------------------------------------------------------------
 // Factory Reset
@@ -146,6 +266,13 @@ typedef enum {
 #define TOOL_NAME_MAX_LEN       24
 #define TOOL_DESC_MAX_LEN       128
 
+// -----------------------------------------------------------------------------
+// Tool Scripts (built-in calls run without the LLM: user tool recordings,
+// scripted cron entries)
+// -----------------------------------------------------------------------------
+#define TOOL_SCRIPT_MAX_STEPS   4       // Built-in calls per script
+#define TOOL_STEP_INPUT_LEN     96      // Longest step input (JSON)
+
 // -----------------------------------------------------------------------------
 // Boot Loop Protection
 // -----------------------------------------------------------------------------
@@ -1,10 +1,14 @@
 #include "cron.h"
 #include "config.h"
 #include "cron_utils.h"
+#include "tool_script.h"
+#include "buffers.h"
 #include "memory.h"
 #include "messages.h"
+#include "msg_pool.h"
 #include "nvs_keys.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_netif_sntp.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -28,11 +32,17 @@ static SemaphoreHandle_t s_entries_mutex = NULL;
 static char s_timezone[TIMEZONE_MAX_LEN] = DEFAULT_TIMEZONE_POSIX;
 typedef struct {
     uint8_t id;
+    cron_type_t type;
     char action[CRON_MAX_ACTION_LEN];
+    char script[CRON_MAX_SCRIPT_LEN];
+    bool report;
 } pending_cron_fire_t;
-// Keep pending actions in static storage; allocating this on cron task stack
-// can exceed CRON_TASK_STACK_SIZE on smaller targets (e.g. ESP32-C6).
-static pending_cron_fire_t s_pending_fires[CRON_MAX_ENTRIES];
+// Keep pending actions off the cron task stack; it can exceed
+// CRON_TASK_STACK_SIZE on smaller targets (e.g. ESP32-C6). Bulk: PSRAM if present.
+static pending_cron_fire_t *s_pending_fires;
+// Scripted runs: parsed steps and their results
+static tool_step_t s_script_steps[TOOL_SCRIPT_MAX_STEPS];
+static char s_script_result[TOOL_RESULT_BUF_SIZE];
 
 static bool entries_lock(TickType_t timeout_ticks)
 {
@@ -193,6 +203,15 @@ esp_err_t cron_init(void)
 {
     memset(s_entries, 0, sizeof(s_entries));
 
+    if (!s_pending_fires) {
+        s_pending_fires = buffer_alloc("cron_pending", CRON_MAX_ENTRIES * sizeof(pending_cron_fire_t),
+                                       BUFFER_BULK);
+        if (!s_pending_fires) {
+            ESP_LOGE(TAG, "Failed to allocate cron fire buffer");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     if (!s_entries_mutex) {
         s_entries_mutex = xSemaphoreCreateMutex();
         if (!s_entries_mutex) {
@@ -269,9 +288,20 @@ void cron_get_time_str(char *buf, size_t buf_len)
 }
 
 uint8_t cron_set(cron_type_t type, uint16_t interval_or_hour, uint8_t minute, const char *action)
+{
+    return cron_set_script(type, interval_or_hour, minute, action, NULL, false);
+}
+
+uint8_t cron_set_script(cron_type_t type, uint16_t interval_or_hour, uint8_t minute,
+                        const char *action, const char *script, bool report)
 {
     uint8_t created_id = 0;
 
+    if (script && strlen(script) >= CRON_MAX_SCRIPT_LEN) {
+        ESP_LOGE(TAG, "Cannot create cron entry: script too long");
+        return 0;
+    }
+
     if (!action || action[0] == '\0') {
         ESP_LOGE(TAG, "Cannot create cron entry: empty action");
         return 0;
@@ -346,6 +376,8 @@ uint8_t cron_set(cron_type_t type, uint16_t interval_or_hour, uint8_t minute, co
 
     strncpy(entry->action, action, CRON_MAX_ACTION_LEN - 1);
     entry->action[CRON_MAX_ACTION_LEN - 1] = '\0';
+    snprintf(entry->script, sizeof(entry->script), "%s", script ? script : "");
+    entry->report = script && report;
 
     if (save_entry(slot) != ESP_OK) {
         memset(entry, 0, sizeof(*entry));
@@ -353,7 +385,8 @@ uint8_t cron_set(cron_type_t type, uint16_t interval_or_hour, uint8_t minute, co
     }
 
     created_id = entry->id;
-    ESP_LOGI(TAG, "Created cron entry %d: type=%d action=%s", entry->id, type, action);
+    ESP_LOGI(TAG, "Created cron entry %d: type=%d action=%s%s", entry->id, type, action,
+             entry->script[0] ? " (scripted)" : "");
 
 out:
     entries_unlock();
@@ -418,6 +451,11 @@ void cron_list(char *buf, size_t buf_len)
         }
 
         ok &= cJSON_AddStringToObject(obj, "action", s_entries[i].action) != NULL;
+        if (s_entries[i].script[0] != '\0') {
+            cJSON *steps = cJSON_Parse(s_entries[i].script);
+            ok &= steps != NULL && cJSON_AddItemToObject(obj, "steps", steps);
+            ok &= cJSON_AddBoolToObject(obj, "report", s_entries[i].report) != NULL;
+        }
         ok &= cJSON_AddBoolToObject(obj, "enabled", s_entries[i].enabled) != NULL;
         ok &= cJSON_AddStringToObject(obj, "timezone", timezone_posix) != NULL;
         ok &= cJSON_AddStringToObject(obj, "timezone_abbrev", timezone_abbrev) != NULL;
@@ -473,6 +511,30 @@ esp_err_t cron_delete(uint8_t id)
     return ESP_ERR_NOT_FOUND;
 }
 
+// Run a scripted entry's steps on the cron task, results in s_script_result.
+static bool run_script(const pending_cron_fire_t *fire)
+{
+    char error[128];
+    int64_t started_us = esp_timer_get_time();
+
+    snprintf(s_script_result, sizeof(s_script_result), "Results:");
+    cJSON *script = cJSON_Parse(fire->script);
+    int step_count = tool_script_parse(script, TOOL_SCRIPT_CRON, s_script_steps,
+                                       TOOL_SCRIPT_MAX_STEPS, error, sizeof(error));
+    cJSON_Delete(script);
+    if (step_count < 0) {
+        ESP_LOGW(TAG, "Cron %d script no longer valid: %s", fire->id, error);
+        snprintf(s_script_result, sizeof(s_script_result), "%s", error);
+        return false;
+    }
+
+    int completed = tool_script_run(s_script_steps, step_count, s_script_result,
+                                    sizeof(s_script_result));
+    ESP_LOGI(TAG, "Cron %d ran %d/%d steps in %d ms without the LLM", fire->id, completed,
+             step_count, (int)((esp_timer_get_time() - started_us) / 1000));
+    return completed == step_count;
+}
+
 // Check and fire due entries
 static void check_entries(void)
 {
@@ -519,8 +581,11 @@ static void check_entries(void)
         if (should_fire) {
             if (pending_count < CRON_MAX_ENTRIES) {
                 s_pending_fires[pending_count].id = entry->id;
+                s_pending_fires[pending_count].type = entry->type;
                 strncpy(s_pending_fires[pending_count].action, entry->action, sizeof(s_pending_fires[pending_count].action) - 1);
                 s_pending_fires[pending_count].action[sizeof(s_pending_fires[pending_count].action) - 1] = '\0';
+                memcpy(s_pending_fires[pending_count].script, entry->script, sizeof(entry->script));
+                s_pending_fires[pending_count].report = entry->report;
                 pending_count++;
             }
 
@@ -543,13 +608,45 @@ static void check_entries(void)
     entries_unlock();
 
     for (int i = 0; i < pending_count; i++) {
-        ESP_LOGI(TAG, "Firing cron %d: %s", s_pending_fires[i].id, s_pending_fires[i].action);
+        const pending_cron_fire_t *fire = &s_pending_fires[i];
+        ESP_LOGI(TAG, "Firing cron %d: %s", fire->id, fire->action);
 
         // Push action to agent queue
-        channel_msg_t msg;
-        snprintf(msg.text, sizeof(msg.text), "[CRON %d] %s", s_pending_fires[i].id, s_pending_fires[i].action);
+        // Recurring jobs yield to ones due at a set time
+        agent_msg_t msg = {
+            .source = MSG_SOURCE_CRON,
+            .msg_class = fire->type == CRON_TYPE_PERIODIC ? MSG_CLASS_BACKGROUND
+                                                          : MSG_CLASS_AUTOMATION,
+            .source_id = fire->id,
+            .enqueued_us = esp_timer_get_time(),
+        };
+        bool script_ok = true;
+
+        if (fire->script[0] != '\0') {
+            script_ok = run_script(fire);
+            if (script_ok && !fire->report) {
+                continue;
+            }
+        }
+
+        msg.text = msg_pool_alloc(INPUT_MAX_LEN);
+        if (!msg.text) {
+            ESP_LOGW(TAG, "No buffer for cron %d, action dropped", fire->id);
+            continue;
+        }
+        char *text = msg.text->text;
+        if (fire->script[0] != '\0') {
+            snprintf(text, msg.text->size, "[CRON %d] %s\n", fire->id,
+                     script_ok ? fire->action : "Scheduled steps failed, tell the user.");
+            size_t len = strlen(text);
+            snprintf(text + len, msg.text->size - len, "%s", s_script_result);
+        } else {
+            snprintf(text, msg.text->size, "[CRON %d] %s", fire->id, fire->action);
+        }
+        msg.text->len = (uint16_t)strlen(text);
 
         if (xQueueSend(s_agent_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
+            msg_pool_release(msg.text);
             ESP_LOGW(TAG, "Agent queue full, cron action dropped");
         }
     }
@@ -26,6 +26,8 @@ typedef struct {
     char action[CRON_MAX_ACTION_LEN];   // Action to execute (sent to agent)
     uint32_t last_run;                  // Unix timestamp of last run
     bool enabled;
+    char script[CRON_MAX_SCRIPT_LEN];   // JSON tool steps run by the cron task; "" sends action to agent
+    bool report;                        // Scripted: also send action and results to the agent
 } cron_entry_t;
 
 // Initialize cron system and sync NTP
@@ -37,6 +39,12 @@ esp_err_t cron_start(QueueHandle_t agent_input_queue);
 // Add/update a cron entry (returns entry ID, or 0 on error)
 uint8_t cron_set(cron_type_t type, uint16_t interval_or_hour, uint8_t minute, const char *action);
 
+// Like cron_set, with a validated JSON script (see tool_script.h) that the
+// cron task runs itself. The agent only hears of a run if it fails or
+// report is set; action labels the entry and words the report request.
+uint8_t cron_set_script(cron_type_t type, uint16_t interval_or_hour, uint8_t minute,
+                        const char *action, const char *script, bool report);
+
 // List all cron entries (fills buffer with JSON array string)
 void cron_list(char *buf, size_t buf_len);
 
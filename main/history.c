@@ -0,0 +1,268 @@
+#include "history.h"
+#include <string.h>
+
+// Longest strings kept per message (same limits as the tool call parser)
+#define HISTORY_TOOL_ID_MAX     63
+#define HISTORY_TOOL_NAME_MAX   31
+
+_Static_assert(HISTORY_ARENA_BYTES >= MAX_MESSAGE_LEN + HISTORY_TOOL_ID_MAX + HISTORY_TOOL_NAME_MAX + 2,
+               "history arena must hold at least one maximum-size message");
+
+static size_t bounded_len(const char *s, size_t max)
+{
+    if (!s) {
+        return 0;
+    }
+    size_t len = 0;
+    while (len < max && s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+// Copy len bytes of src to *dst as a terminated string and advance *dst.
+// Empty strings use a shared literal and take no arena space.
+static const char *arena_put(char **dst, const char *src, size_t len, bool always)
+{
+    if (len == 0 && !always) {
+        return "";
+    }
+    char *out = *dst;
+    memcpy(out, src, len);
+    out[len] = '\0';
+    *dst += len + 1;
+    return out;
+}
+
+// Contiguous room for size bytes, or NULL if the oldest message must go first.
+// Free space is [tail, end) plus [0, head) while unwrapped, [tail, head) once
+// wrapped; tail == head with messages present means full.
+static char *arena_reserve(history_t *history, size_t size)
+{
+    size_t start;
+    if (history->count == 0) {
+        history->arena_head = 0;
+        start = 0;
+    } else if (history->arena_tail > history->arena_head) {
+        if (HISTORY_ARENA_BYTES - history->arena_tail >= size) {
+            start = history->arena_tail;
+        } else if (history->arena_head >= size) {
+            start = 0;      // The rest of the end is skipped until head passes it
+        } else {
+            return NULL;
+        }
+    } else if (history->arena_head - history->arena_tail >= size) {
+        start = history->arena_tail;
+    } else {
+        return NULL;
+    }
+
+    history->arena_tail = start + size;
+    return history->arena + start;
+}
+
+// Contiguous room for size bytes that ends where the oldest message's strings
+// begin, or NULL. Mirrors arena_reserve() for a message placed before head.
+static char *arena_reserve_front(history_t *history, size_t size)
+{
+    size_t start;
+    if (history->arena_tail > history->arena_head) {
+        if (history->arena_head >= size) {
+            start = history->arena_head - size;
+        } else if (HISTORY_ARENA_BYTES - history->arena_tail >= size) {
+            start = HISTORY_ARENA_BYTES - size;     // Wraps: head now sits past tail
+        } else {
+            return NULL;
+        }
+    } else if (history->arena_head - history->arena_tail >= size) {
+        start = history->arena_head - size;
+    } else {
+        return NULL;
+    }
+
+    history->arena_head = start;
+    return history->arena + start;
+}
+
+// Strings of a message start at its content.
+static size_t arena_offset(const history_t *history, const conversation_msg_t *msg)
+{
+    return (size_t)(msg->content - history->arena);
+}
+
+static size_t record_size(const conversation_msg_t *msg, size_t *content_len,
+                          size_t *id_len, size_t *name_len)
+{
+    *content_len = bounded_len(msg->content, MAX_MESSAGE_LEN - 1);
+    *id_len = bounded_len(msg->tool_id, HISTORY_TOOL_ID_MAX);
+    *name_len = bounded_len(msg->tool_name, HISTORY_TOOL_NAME_MAX);
+    return *content_len + 1 + (*id_len ? *id_len + 1 : 0) + (*name_len ? *name_len + 1 : 0);
+}
+
+// Copy msg's strings to dst and its descriptor (and mirror) to slot.
+static void store(history_t *history, int slot, char *dst, const conversation_msg_t *msg,
+                  size_t content_len, size_t id_len, size_t name_len, size_t size)
+{
+    conversation_msg_t *out = &history->msgs[slot];
+    out->role = (msg->role && strcmp(msg->role, "assistant") == 0) ? "assistant" : "user";
+    out->content = arena_put(&dst, msg->content, content_len, true);
+    out->tool_id = arena_put(&dst, msg->tool_id, id_len, false);
+    out->tool_name = arena_put(&dst, msg->tool_name, name_len, false);
+    out->is_tool_use = msg->is_tool_use;
+    out->is_tool_result = msg->is_tool_result;
+    out->is_error = msg->is_error;
+    out->joins_previous = msg->joins_previous;
+    history->msgs[slot + HISTORY_MAX_MESSAGES] = *out;
+
+    history->sizes[slot] = (uint16_t)size;
+    history->arena_used += size;
+    history->count++;
+}
+
+static void evict_oldest(history_t *history)
+{
+    history->arena_used -= history->sizes[history->head];
+    history->head = (history->head + 1) % HISTORY_MAX_MESSAGES;
+    history->count--;
+    if (history->count > 0) {
+        history->arena_head = arena_offset(history, &history->msgs[history->head]);
+    }
+}
+
+void history_init(history_t *history)
+{
+    memset(history, 0, sizeof(*history));
+}
+
+int history_push(history_t *history, const conversation_msg_t *msg)
+{
+    size_t content_len, id_len, name_len;
+    size_t size = record_size(msg, &content_len, &id_len, &name_len);
+    int evicted = 0;
+    char *dst = NULL;
+
+    while (history->count >= HISTORY_MAX_MESSAGES || !(dst = arena_reserve(history, size))) {
+        evict_oldest(history);
+        evicted++;
+    }
+
+    int slot = (history->head + history->count) % HISTORY_MAX_MESSAGES;
+    store(history, slot, dst, msg, content_len, id_len, name_len, size);
+    history->pushed++;
+    return evicted;
+}
+
+int history_compact(history_t *history, int count, const conversation_msg_t *summary)
+{
+    size_t content_len, id_len, name_len;
+    size_t size = record_size(summary, &content_len, &id_len, &name_len);
+    int evicted = 0;
+    char *dst = NULL;
+
+    if (count > history->count) {
+        count = history->count;
+    }
+    for (int i = 0; i < count; i++) {
+        evict_oldest(history);
+    }
+    if (history->count >= HISTORY_MAX_MESSAGES) {
+        evict_oldest(history);
+        evicted++;
+    }
+    if (history->count == 0) {
+        // Nothing kept: the summary is simply the only message.
+        history_push(history, summary);
+        history->pushed--;
+        return evicted;
+    }
+
+    // The space freed at the front may be split by the arena end; keep
+    // giving up the oldest kept messages until the summary fits.
+    while (!(dst = arena_reserve_front(history, size))) {
+        evict_oldest(history);
+        evicted++;
+        if (history->count == 0) {
+            history_push(history, summary);
+            history->pushed--;
+            return evicted;
+        }
+    }
+
+    history->head = (history->head + HISTORY_MAX_MESSAGES - 1) % HISTORY_MAX_MESSAGES;
+    store(history, history->head, dst, summary, content_len, id_len, name_len, size);
+    // A summary never continues a tool group, and its successor cannot join it.
+    history->msgs[history->head].joins_previous = false;
+    history->msgs[history->head + HISTORY_MAX_MESSAGES].joins_previous = false;
+    return evicted;
+}
+
+bool history_elide(history_t *history, int index, const char *placeholder)
+{
+    if (index < 0 || index >= history->count) {
+        return false;
+    }
+    conversation_msg_t *msg = &history->msgs[history->head + index];
+    size_t placeholder_len = strlen(placeholder);
+    if (strlen(msg->content) <= placeholder_len) {
+        return false;
+    }
+
+    // Shorter text fits in place; the record keeps its size until evicted.
+    char *content = history->arena + arena_offset(history, msg);
+    memcpy(content, placeholder, placeholder_len + 1);
+    return true;
+}
+
+void history_join_previous(history_t *history)
+{
+    if (history->count < 2) {
+        return;
+    }
+    int slot = (history->head + history->count - 1) % HISTORY_MAX_MESSAGES;
+    history->msgs[slot].joins_previous = true;
+    history->msgs[slot + HISTORY_MAX_MESSAGES].joins_previous = true;
+}
+
+const conversation_msg_t *history_messages(const history_t *history)
+{
+    return &history->msgs[history->head];
+}
+
+int history_count(const history_t *history)
+{
+    return history->count;
+}
+
+size_t history_bytes_used(const history_t *history)
+{
+    return history->arena_used;
+}
+
+uint32_t history_mark(const history_t *history)
+{
+    return history->pushed;
+}
+
+int history_rollback(history_t *history, uint32_t mark)
+{
+    int dropped = 0;
+
+    while (history->count > 0 && history->pushed > mark) {
+        int slot = (history->head + history->count - 1) % HISTORY_MAX_MESSAGES;
+        history->arena_used -= history->sizes[slot];
+        history->count--;
+        history->pushed--;
+        dropped++;
+        if (history->count > 0) {
+            // The newest survivor's strings end where the next message goes.
+            int newest = (slot + HISTORY_MAX_MESSAGES - 1) % HISTORY_MAX_MESSAGES;
+            history->arena_tail = arena_offset(history, &history->msgs[newest]) +
+                                  history->sizes[newest];
+        }
+    }
+    // Messages evicted since the mark are gone; only the count moves back.
+    if (history->pushed > mark) {
+        history->pushed = mark;
+    }
+    return dropped;
+}
@@ -0,0 +1,62 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "config.h"
+#include "json_util.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Conversation history as a ring of variable-length records. Message strings
+// are packed back to back in one byte arena, so a message costs only what it
+// holds; descriptors point into the arena. Appending and evicting the oldest
+// message are O(1), with no memmove of the history.
+//
+// Descriptors are mirrored (slot i and i + HISTORY_MAX_MESSAGES hold the same
+// message), so the live messages are always one contiguous array, oldest
+// first, as the request builder expects.
+typedef struct {
+    conversation_msg_t msgs[HISTORY_MAX_MESSAGES * 2];
+    uint16_t sizes[HISTORY_MAX_MESSAGES];   // Arena bytes held by each slot
+    int head;                               // Slot of the oldest message
+    int count;
+    uint32_t pushed;                        // Messages ever appended
+    size_t arena_head;                      // Offset of the oldest message's strings
+    size_t arena_tail;                      // Offset for the next message's strings
+    size_t arena_used;                      // Bytes held by live messages
+    char arena[HISTORY_ARENA_BYTES];
+} history_t;
+
+void history_init(history_t *history);
+
+// Copy msg in as the newest message (content is cut at MAX_MESSAGE_LEN - 1
+// bytes), evicting the oldest messages until it fits. Returns how many were
+// evicted; any eviction moves history_messages().
+int history_push(history_t *history, const conversation_msg_t *msg);
+
+// Replace the oldest count messages with summary, placed as the oldest
+// message. Rollback marks taken before are unaffected (only the newest
+// messages roll back). Returns how many further messages had to be evicted
+// to make room; any change moves history_messages().
+int history_compact(history_t *history, int count, const conversation_msg_t *summary);
+
+// Replace the content of message index (0 = oldest) with the shorter
+// placeholder. Returns false if the content is not longer than placeholder.
+bool history_elide(history_t *history, int index, const char *placeholder);
+
+// Mark the newest message as another block of the one before it.
+void history_join_previous(history_t *history);
+
+// The live messages, oldest first. Valid until the next push or rollback.
+const conversation_msg_t *history_messages(const history_t *history);
+int history_count(const history_t *history);
+size_t history_bytes_used(const history_t *history);
+
+// Position to roll back to: messages pushed after this mark can be dropped
+// with history_rollback(), even if older ones were evicted meanwhile.
+uint32_t history_mark(const history_t *history);
+
+// Drop the messages pushed since mark. Returns how many were dropped.
+int history_rollback(history_t *history, uint32_t mark);
+
+#endif // HISTORY_H
@@ -0,0 +1,192 @@
+#include "input_sched.h"
+#include "buffers.h"
+#include "config.h"
+#include "msg_pool.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "sched";
+
+typedef struct {
+    agent_msg_t msgs[INPUT_SCHED_CLASS_DEPTH];
+    int head;
+    int count;
+} class_queue_t;
+
+// Bulk: CLASS_COUNT * depth messages (text held in the message pool)
+static class_queue_t *s_queues;
+static input_class_stats_t s_stats[MSG_CLASS_COUNT];
+
+static msg_class_t class_of(const agent_msg_t *msg)
+{
+    return (unsigned)msg->msg_class < MSG_CLASS_COUNT ? msg->msg_class : MSG_CLASS_BACKGROUND;
+}
+
+static uint32_t waited_ms(const agent_msg_t *msg, int64_t now_us)
+{
+    if (now_us <= msg->enqueued_us) {
+        return 0;
+    }
+    uint64_t ms = (uint64_t)(now_us - msg->enqueued_us) / 1000ULL;
+    return ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+}
+
+// Class after aging; 0 is the most urgent.
+static int effective_class(msg_class_t msg_class, uint32_t wait_ms)
+{
+    int promoted = (int)msg_class - (int)(wait_ms / INPUT_SCHED_AGING_MS);
+    return promoted < 0 ? 0 : promoted;
+}
+
+bool input_sched_init(void)
+{
+    if (!s_queues) {
+        s_queues = buffer_alloc("input_sched", sizeof(class_queue_t) * MSG_CLASS_COUNT, BUFFER_BULK);
+        if (!s_queues) {
+            return false;
+        }
+    }
+    memset(s_queues, 0, sizeof(class_queue_t) * MSG_CLASS_COUNT);
+    memset(s_stats, 0, sizeof(s_stats));
+    return true;
+}
+
+bool input_sched_push(const agent_msg_t *msg)
+{
+    msg_class_t msg_class = class_of(msg);
+    class_queue_t *queue = &s_queues[msg_class];
+
+    if (queue->count >= INPUT_SCHED_CLASS_DEPTH) {
+        s_stats[msg_class].dropped++;
+        msg_pool_release(msg->text);
+        ESP_LOGW(TAG, "%s input full, message dropped", input_sched_class_name(msg_class));
+        return false;
+    }
+    queue->msgs[(queue->head + queue->count) % INPUT_SCHED_CLASS_DEPTH] = *msg;
+    queue->count++;
+    return true;
+}
+
+static void record_dispatch(msg_class_t msg_class, uint32_t wait_ms)
+{
+    input_class_stats_t *stats = &s_stats[msg_class];
+    stats->dispatched++;
+    stats->wait_ms_total += wait_ms;
+    if (wait_ms > stats->wait_ms_max) {
+        stats->wait_ms_max = wait_ms;
+    }
+}
+
+bool input_sched_pop(int64_t now_us, agent_msg_t *out, uint32_t *wait_ms)
+{
+    int best = -1;
+    int best_rank = 0;
+    uint32_t best_wait = 0;
+
+    // Only the oldest message of each class competes (FIFO within a class).
+    // Ties go to the longer wait, so an aged message overtakes fresh ones.
+    for (int c = 0; c < MSG_CLASS_COUNT; c++) {
+        class_queue_t *queue = &s_queues[c];
+        if (queue->count == 0) {
+            continue;
+        }
+        uint32_t wait = waited_ms(&queue->msgs[queue->head], now_us);
+        int rank = effective_class((msg_class_t)c, wait);
+        if (best < 0 || rank < best_rank || (rank == best_rank && wait > best_wait)) {
+            best = c;
+            best_rank = rank;
+            best_wait = wait;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+
+    class_queue_t *queue = &s_queues[best];
+    *out = queue->msgs[queue->head];
+    queue->head = (queue->head + 1) % INPUT_SCHED_CLASS_DEPTH;
+    queue->count--;
+
+    record_dispatch((msg_class_t)best, best_wait);
+    *wait_ms = best_wait;
+    return true;
+}
+
+const agent_msg_t *input_sched_peek_related(const agent_msg_t *first)
+{
+    const class_queue_t *queue = &s_queues[class_of(first)];
+
+    for (int i = 0; i < queue->count; i++) {
+        const agent_msg_t *msg = &queue->msgs[(queue->head + i) % INPUT_SCHED_CLASS_DEPTH];
+        if (msg->source == first->source && msg->source_id == first->source_id) {
+            return msg;
+        }
+    }
+    return NULL;
+}
+
+bool input_sched_take_related(const agent_msg_t *first, size_t max_text_len, int64_t now_us,
+                              agent_msg_t *out)
+{
+    msg_class_t msg_class = class_of(first);
+    class_queue_t *queue = &s_queues[msg_class];
+
+    for (int i = 0; i < queue->count; i++) {
+        agent_msg_t *msg = &queue->msgs[(queue->head + i) % INPUT_SCHED_CLASS_DEPTH];
+        if (msg->source != first->source || msg->source_id != first->source_id) {
+            continue;
+        }
+        if (msg->text->len > max_text_len) {
+            return false;
+        }
+        *out = *msg;
+        // Close the gap; the class stays in arrival order.
+        for (int j = i; j + 1 < queue->count; j++) {
+            queue->msgs[(queue->head + j) % INPUT_SCHED_CLASS_DEPTH] =
+                queue->msgs[(queue->head + j + 1) % INPUT_SCHED_CLASS_DEPTH];
+        }
+        queue->count--;
+        record_dispatch(msg_class, waited_ms(out, now_us));
+        return true;
+    }
+    return false;
+}
+
+int input_sched_pending(void)
+{
+    int pending = 0;
+    for (int c = 0; c < MSG_CLASS_COUNT; c++) {
+        pending += s_queues[c].count;
+    }
+    return pending;
+}
+
+void input_sched_get_stats(msg_class_t msg_class, input_class_stats_t *stats)
+{
+    if ((unsigned)msg_class >= MSG_CLASS_COUNT) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    *stats = s_stats[msg_class];
+}
+
+const char *input_sched_class_name(msg_class_t msg_class)
+{
+    switch (msg_class) {
+        case MSG_CLASS_INTERACTIVE:
+            return "interactive";
+        case MSG_CLASS_AUTOMATION:
+            return "automation";
+        case MSG_CLASS_BACKGROUND:
+            return "background";
+        default:
+            return "unknown";
+    }
+}
+
+#ifdef TEST_BUILD
+void input_sched_test_reset(void)
+{
+    input_sched_init();
+}
+#endif
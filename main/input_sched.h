@@ -0,0 +1,54 @@
+#ifndef INPUT_SCHED_H
+#define INPUT_SCHED_H
+
+#include "messages.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Pending agent input, one FIFO per scheduling class. The agent drains its
+// input queue into here and always runs the most urgent message next:
+// strict priority by class, except that every INPUT_SCHED_AGING_MS spent
+// waiting raises a message one class, so background work never starves.
+
+// Queue wait per class since boot
+typedef struct {
+    uint32_t dispatched;
+    uint32_t dropped;               // Arrived while the class was full
+    uint64_t wait_ms_total;
+    uint32_t wait_ms_max;
+} input_class_stats_t;
+
+bool input_sched_init(void);
+
+// Hold msg until it is dispatched; takes over its text reference, which the
+// caller of pop/take_related releases. Returns false (and drops msg, releasing
+// the text) if its class already holds INPUT_SCHED_CLASS_DEPTH messages.
+bool input_sched_push(const agent_msg_t *msg);
+
+// Take the message to run next, as of now_us. Sets *wait_ms to the time it
+// spent queued. Returns false if nothing is pending.
+bool input_sched_pop(int64_t now_us, agent_msg_t *out, uint32_t *wait_ms);
+
+// The oldest pending message from the same origin as first, left in place
+// (valid until the next push or take), or NULL.
+const agent_msg_t *input_sched_peek_related(const agent_msg_t *first);
+
+// Take the oldest pending message from the same origin as first, for
+// merging into first's turn, if its text is at most max_text_len bytes.
+// Counts as dispatched at now_us.
+bool input_sched_take_related(const agent_msg_t *first, size_t max_text_len, int64_t now_us,
+                              agent_msg_t *out);
+
+int input_sched_pending(void);
+
+void input_sched_get_stats(msg_class_t msg_class, input_class_stats_t *stats);
+const char *input_sched_class_name(msg_class_t msg_class);
+
+#ifdef TEST_BUILD
+// Drop pending messages and statistics (tests only). Their text is not
+// released: pair with msg_pool_test_reset().
+void input_sched_test_reset(void);
+#endif
+
+#endif // INPUT_SCHED_H
@@ -0,0 +1,439 @@
+#include "json_pull.h"
+#include <string.h>
+
+static void skip_ws(json_pull_t *pull)
+{
+    while (pull->p < pull->end &&
+           (*pull->p == ' ' || *pull->p == '\t' || *pull->p == '\n' || *pull->p == '\r')) {
+        pull->p++;
+    }
+}
+
+static bool fail(json_pull_t *pull)
+{
+    pull->error = true;
+    return false;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool read_hex4(const char *p, const char *end, unsigned *out)
+{
+    unsigned value = 0;
+
+    if (end - p < 4) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        int h = hex_value(p[i]);
+        if (h < 0) {
+            return false;
+        }
+        value = (value << 4) | (unsigned)h;
+    }
+    *out = value;
+    return true;
+}
+
+// Returns the position just past the closing quote, or NULL if malformed.
+static const char *scan_string(const char *p, const char *end)
+{
+    if (p >= end || *p != '"') {
+        return NULL;
+    }
+    for (p++; p < end; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"') {
+            return p + 1;
+        }
+        if (c < 0x20) {
+            return NULL;
+        }
+        if (c == '\\') {
+            unsigned ignored;
+            p++;
+            if (p >= end) {
+                return NULL;
+            }
+            if (*p == 'u') {
+                if (!read_hex4(p + 1, end, &ignored)) {
+                    return NULL;
+                }
+                p += 4;
+            } else if (!strchr("\"\\/bfnrt", *p) || *p == '\0') {
+                return NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+static const char *scan_digits(const char *p, const char *end)
+{
+    const char *start = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        p++;
+    }
+    return p == start ? NULL : p;
+}
+
+static const char *scan_number(const char *p, const char *end)
+{
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p < end && *p == '0') {
+        p++;
+    } else if (!(p = scan_digits(p, end))) {
+        return NULL;
+    }
+    if (p < end && *p == '.') {
+        if (!(p = scan_digits(p + 1, end))) {
+            return NULL;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (!(p = scan_digits(p, end))) {
+            return NULL;
+        }
+    }
+    return p;
+}
+
+static const char *scan_literal(const char *p, const char *end, const char *word)
+{
+    size_t len = strlen(word);
+    if ((size_t)(end - p) < len || memcmp(p, word, len) != 0) {
+        return NULL;
+    }
+    return p + len;
+}
+
+static const char *scan_value(const char *p, const char *end, int depth);
+
+static const char *scan_ws(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static const char *scan_container(const char *p, const char *end, int depth, bool object)
+{
+    char close = object ? '}' : ']';
+
+    p = scan_ws(p + 1, end);
+    if (p < end && *p == close) {
+        return p + 1;
+    }
+    while (p < end) {
+        if (object) {
+            if (!(p = scan_string(p, end))) {
+                return NULL;
+            }
+            p = scan_ws(p, end);
+            if (p >= end || *p != ':') {
+                return NULL;
+            }
+            p = scan_ws(p + 1, end);
+        }
+        if (!(p = scan_value(p, end, depth + 1))) {
+            return NULL;
+        }
+        p = scan_ws(p, end);
+        if (p < end && *p == ',') {
+            p = scan_ws(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == close) {
+            return p + 1;
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+static const char *scan_value(const char *p, const char *end, int depth)
+{
+    if (p >= end || depth > JSON_PULL_MAX_DEPTH) {
+        return NULL;
+    }
+    switch (*p) {
+        case '{': return scan_container(p, end, depth, true);
+        case '[': return scan_container(p, end, depth, false);
+        case '"': return scan_string(p, end);
+        case 't': return scan_literal(p, end, "true");
+        case 'f': return scan_literal(p, end, "false");
+        case 'n': return scan_literal(p, end, "null");
+        default:  return scan_number(p, end);
+    }
+}
+
+// Encode a code point as UTF-8 into out, bounded by *pos < limit.
+static void put_utf8(char *out, size_t *pos, size_t limit, unsigned cp)
+{
+    char bytes[4];
+    size_t n;
+
+    if (cp < 0x80) {
+        bytes[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        bytes[0] = (char)(0xC0 | (cp >> 6));
+        bytes[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        bytes[0] = (char)(0xE0 | (cp >> 12));
+        bytes[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        bytes[0] = (char)(0xF0 | (cp >> 18));
+        bytes[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        bytes[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        bytes[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    for (size_t i = 0; i < n && *pos < limit; i++) {
+        out[(*pos)++] = bytes[i];
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Public API
+// -----------------------------------------------------------------------------
+
+void json_pull_init(json_pull_t *pull, const char *json, size_t len)
+{
+    pull->p = json;
+    pull->end = json ? json + len : json;
+    pull->fresh = false;
+    pull->error = (json == NULL);
+}
+
+char json_pull_peek(json_pull_t *pull)
+{
+    if (pull->error) {
+        return '\0';
+    }
+    skip_ws(pull);
+    return pull->p < pull->end ? *pull->p : '\0';
+}
+
+static bool container_begin(json_pull_t *pull, char open)
+{
+    if (json_pull_peek(pull) != open) {
+        return fail(pull);
+    }
+    pull->p++;
+    pull->fresh = true;
+    return true;
+}
+
+// Step over the separator before the next member; false at the container end.
+static bool container_next(json_pull_t *pull, char close)
+{
+    bool first = pull->fresh;
+
+    if (pull->error) {
+        return false;
+    }
+    pull->fresh = false;
+    skip_ws(pull);
+    if (pull->p >= pull->end) {
+        return fail(pull);
+    }
+    if (*pull->p == close) {
+        pull->p++;
+        return false;
+    }
+    if (!first) {
+        if (*pull->p != ',') {
+            return fail(pull);
+        }
+        pull->p++;
+        skip_ws(pull);
+    }
+    return true;
+}
+
+bool json_pull_object_begin(json_pull_t *pull)
+{
+    return container_begin(pull, '{');
+}
+
+bool json_pull_next_key(json_pull_t *pull, json_span_t *key)
+{
+    if (!container_next(pull, '}')) {
+        return false;
+    }
+
+    const char *after = scan_string(pull->p, pull->end);
+    if (!after) {
+        return fail(pull);
+    }
+    key->ptr = pull->p + 1;
+    key->len = (size_t)(after - pull->p) - 2;
+    pull->p = after;
+
+    skip_ws(pull);
+    if (pull->p >= pull->end || *pull->p != ':') {
+        return fail(pull);
+    }
+    pull->p++;
+    return true;
+}
+
+bool json_pull_array_begin(json_pull_t *pull)
+{
+    return container_begin(pull, '[');
+}
+
+bool json_pull_next_item(json_pull_t *pull)
+{
+    return container_next(pull, ']');
+}
+
+bool json_pull_skip(json_pull_t *pull, json_span_t *span)
+{
+    if (json_pull_peek(pull) == '\0') {
+        return fail(pull);
+    }
+
+    const char *after = scan_value(pull->p, pull->end, 0);
+    if (!after) {
+        return fail(pull);
+    }
+    if (span) {
+        span->ptr = pull->p;
+        span->len = (size_t)(after - pull->p);
+    }
+    pull->p = after;
+    pull->fresh = false;
+    return true;
+}
+
+bool json_pull_string(json_pull_t *pull, char *out, size_t out_len)
+{
+    json_span_t span;
+
+    if (json_pull_peek(pull) != '"') {
+        // Leave non-string values for the caller to skip.
+        return false;
+    }
+    if (!json_pull_skip(pull, &span)) {
+        return false;
+    }
+    json_span_decode_string(&span, out, out_len);
+    return true;
+}
+
+bool json_pull_uint32(json_pull_t *pull, uint32_t *out)
+{
+    json_span_t span;
+    char c = json_pull_peek(pull);
+    uint64_t value = 0;
+
+    if (c != '-' && (c < '0' || c > '9')) {
+        return false;
+    }
+    if (!json_pull_skip(pull, &span)) {
+        return false;
+    }
+    if (span.ptr[0] != '-') {
+        for (size_t i = 0; i < span.len && span.ptr[i] >= '0' && span.ptr[i] <= '9'; i++) {
+            value = value * 10 + (uint64_t)(span.ptr[i] - '0');
+            if (value > UINT32_MAX) {
+                value = UINT32_MAX;
+                break;
+            }
+        }
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+bool json_pull_at_end(json_pull_t *pull)
+{
+    if (pull->error) {
+        return false;
+    }
+    skip_ws(pull);
+    return pull->p == pull->end || *pull->p == '\0';
+}
+
+bool json_span_eq(const json_span_t *span, const char *name)
+{
+    size_t len = strlen(name);
+    return span->len == len && memcmp(span->ptr, name, len) == 0;
+}
+
+size_t json_span_decode_string(const json_span_t *span, char *out, size_t out_len)
+{
+    size_t pos = 0;
+
+    if (out_len == 0) {
+        return 0;
+    }
+    if (span->len < 2) {
+        out[0] = '\0';
+        return 0;
+    }
+
+    size_t limit = out_len - 1;
+    const char *p = span->ptr + 1;
+    const char *end = span->ptr + span->len - 1;
+
+    while (p < end && pos < limit) {
+        if (*p != '\\') {
+            out[pos++] = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case 'b': out[pos++] = '\b'; p++; break;
+            case 'f': out[pos++] = '\f'; p++; break;
+            case 'n': out[pos++] = '\n'; p++; break;
+            case 'r': out[pos++] = '\r'; p++; break;
+            case 't': out[pos++] = '\t'; p++; break;
+            case 'u': {
+                unsigned cp = 0;
+                unsigned low = 0;
+                if (!read_hex4(p + 1, end, &cp)) {
+                    p = end;
+                    break;
+                }
+                p += 5;
+                if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 6 &&
+                    p[0] == '\\' && p[1] == 'u' && read_hex4(p + 2, end, &low) &&
+                    low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                if (cp == 0) {
+                    // An embedded NUL ends the C string.
+                    p = end;
+                    break;
+                }
+                put_utf8(out, &pos, limit, cp);
+                break;
+            }
+            default:
+                out[pos++] = *p++;
+                break;
+        }
+    }
+    out[pos] = '\0';
+    return pos;
+}
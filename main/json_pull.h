@@ -0,0 +1,65 @@
+#ifndef JSON_PULL_H
+#define JSON_PULL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_PULL_MAX_DEPTH     32
+
+// A slice of the source document (not NUL-terminated).
+typedef struct {
+    const char *ptr;
+    size_t len;
+} json_span_t;
+
+// Forward-only cursor over a JSON document held in memory. Nothing is
+// allocated: containers are walked member by member, values the caller does
+// not care about are skipped (and validated) in place, and strings are
+// decoded straight into caller buffers. Any malformed input latches error.
+typedef struct {
+    const char *p;
+    const char *end;
+    bool fresh;                 // Just entered a container, no member consumed yet
+    bool error;
+} json_pull_t;
+
+void json_pull_init(json_pull_t *pull, const char *json, size_t len);
+
+// First significant character of the next value ('{', '[', '"', 't', ...),
+// or '\0' at the end of input.
+char json_pull_peek(json_pull_t *pull);
+
+// Object walk: begin, then next_key() until it returns false. Every key
+// returned must be followed by exactly one value call (skip, string, begin).
+bool json_pull_object_begin(json_pull_t *pull);
+bool json_pull_next_key(json_pull_t *pull, json_span_t *key);
+
+// Array walk: begin, then next_item() until it returns false.
+bool json_pull_array_begin(json_pull_t *pull);
+bool json_pull_next_item(json_pull_t *pull);
+
+// Consume one value of any type. If span is non-NULL it receives the raw
+// JSON text of the value.
+bool json_pull_skip(json_pull_t *pull, json_span_t *span);
+
+// Consume a string value, decoding escapes into out (truncated to fit,
+// always NUL-terminated). Returns false, consuming nothing and leaving out
+// untouched, if the value is not a string.
+bool json_pull_string(json_pull_t *pull, char *out, size_t out_len);
+
+// Consume a number value, storing its integer part clamped to [0, UINT32_MAX].
+// Returns false, consuming nothing, if the value is not a number.
+bool json_pull_uint32(json_pull_t *pull, uint32_t *out);
+
+// True once the whole input was consumed (trailing whitespace allowed).
+bool json_pull_at_end(json_pull_t *pull);
+
+// Compare a raw key span with a plain ASCII name.
+bool json_span_eq(const json_span_t *span, const char *name);
+
+// Decode a raw string span (including its quotes) into out. Returns the
+// decoded length, truncated to out_len - 1.
+size_t json_span_decode_string(const json_span_t *span, char *out, size_t out_len);
+
+#endif // JSON_PULL_H
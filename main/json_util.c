@@ -1,4 +1,6 @@
 #include "json_util.h"
+#include "json_writer.h"
+#include "json_pull.h"
 #include "config.h"
 #include "tools.h"
 #include "user_tools.h"
@@ -11,17 +13,90 @@
 
 static const char *TAG = "json";
 
-// Keep parsed response tree alive for tool_input access
-static cJSON *s_parsed_response = NULL;
+// Tool calls of the last parsed response, in order. Their inputs are the
+// only trees built while parsing; kept alive until json_free_parsed_response().
+static json_tool_call_t s_tool_calls[MAX_TOOL_CALLS_PER_RESPONSE];
+static int s_tool_call_count = 0;
 
-static bool add_token_limit_field(cJSON *root)
+// Token usage of the last parsed response
+static llm_usage_t s_last_usage;
+static bool s_has_usage = false;
+
+// True if span holds exactly the given raw JSON string (quotes included).
+static bool span_is_string(const json_span_t *span, const char *quoted)
+{
+    return span->ptr && json_span_eq(span, quoted);
+}
+
+// Decode a string value into out; anything else leaves out untouched.
+static void copy_string_span(const json_span_t *span, char *out, size_t out_len)
+{
+    if (span->ptr && span->ptr[0] == '"') {
+        json_span_decode_string(span, out, out_len);
+    }
+}
+
+// Next free tool call slot, or NULL (with a warning) beyond the per-response limit.
+static json_tool_call_t *next_tool_call(void)
+{
+    if (s_tool_call_count >= MAX_TOOL_CALLS_PER_RESPONSE) {
+        ESP_LOGW(TAG, "Dropping tool call beyond %d per response", MAX_TOOL_CALLS_PER_RESPONSE);
+        return NULL;
+    }
+
+    json_tool_call_t *call = &s_tool_calls[s_tool_call_count++];
+    call->name[0] = '\0';
+    call->id[0] = '\0';
+    call->input = NULL;
+    return call;
+}
+
+// Record a tool call; takes ownership of input. Calls without an input are
+// not actionable and are dropped, as are calls beyond the per-response limit.
+static void add_tool_call(const json_span_t *name, const json_span_t *id, cJSON *input)
+{
+    if (!input) {
+        return;
+    }
+
+    json_tool_call_t *call = next_tool_call();
+    if (!call) {
+        cJSON_Delete(input);
+        return;
+    }
+    copy_string_span(name, call->name, sizeof(call->name));
+    copy_string_span(id, call->id, sizeof(call->id));
+    call->input = input;
+}
+
+static void write_token_limit_field(json_writer_t *w, int max_tokens)
 {
     const char *field = "max_tokens";
     if (llm_get_backend() == LLM_BACKEND_OPENAI) {
         // GPT-5 chat-completions models reject max_tokens and require max_completion_tokens.
         field = "max_completion_tokens";
     }
-    return cJSON_AddNumberToObject(root, field, LLM_MAX_TOKENS) != NULL;
+    json_writer_kv_int(w, field, max_tokens);
+}
+
+// Stored JSON (tool schemas, tool_use inputs) is copied verbatim after
+// validation; anything malformed degrades to an empty object.
+static void write_json_or_empty_object(json_writer_t *w, const char *json)
+{
+    if (!json_writer_raw(w, json)) {
+        json_writer_object_begin(w);
+        json_writer_object_end(w);
+    }
+}
+
+static void write_empty_object_schema(json_writer_t *w)
+{
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "type", "object");
+    json_writer_key(w, "properties");
+    json_writer_object_begin(w);
+    json_writer_object_end(w);
+    json_writer_object_end(w);
 }
 
 static bool history_has_prior_tool_use(
@@ -41,476 +116,633 @@ static bool history_has_prior_tool_use(
 }
 
 // -----------------------------------------------------------------------------
-// Anthropic Format (Claude API)
+// Tools catalog
 // -----------------------------------------------------------------------------
 
-static char *build_anthropic_request(
-    const char *system_prompt,
-    const conversation_msg_t *history,
-    int history_len,
-    const char *user_message,
-    const tool_def_t *tools,
-    int tool_count)
+// Serialized "tools" array for the active request format. It only changes
+// when user tools are created or deleted, so it is built once and spliced
+// into every request until the user tool generation moves.
+typedef struct {
+    char *json;
+    size_t len;
+    bool openai_format;
+    const tool_def_t *tools;
+    int tool_count;
+    uint32_t user_generation;
+} tools_catalog_t;
+
+static tools_catalog_t s_tools_catalog = {0};
+static int s_tools_catalog_builds = 0;
+
+static void write_anthropic_tools(json_writer_t *w, const tool_def_t *tools, int tool_count);
+static void write_openai_tools(json_writer_t *w, const tool_def_t *tools, int tool_count);
+
+static bool tools_catalog_matches(const tool_def_t *tools, int tool_count)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        return NULL;
-    }
+    return s_tools_catalog.json &&
+           s_tools_catalog.openai_format == llm_is_openai_format() &&
+           s_tools_catalog.tools == tools &&
+           s_tools_catalog.tool_count == tool_count &&
+           s_tools_catalog.user_generation == user_tools_generation();
+}
 
-    if (!cJSON_AddStringToObject(root, "model", llm_get_model()) ||
-        !cJSON_AddNumberToObject(root, "max_tokens", LLM_MAX_TOKENS) ||
-        !cJSON_AddStringToObject(root, "system", system_prompt)) {
-        goto fail;
+static void write_tools_catalog(json_writer_t *w, const tool_def_t *tools, int tool_count)
+{
+    if (tools_catalog_matches(tools, tool_count)) {
+        json_writer_fragment(w, s_tools_catalog.json, s_tools_catalog.len);
+        return;
     }
 
-    cJSON *messages = cJSON_AddArrayToObject(root, "messages");
-    if (!messages) {
-        goto fail;
+    // Serialize in place, then keep a copy of exactly what was written.
+    bool openai_format = llm_is_openai_format();
+    uint32_t user_generation = user_tools_generation();
+    size_t start = w->len;
+    if (openai_format) {
+        write_openai_tools(w, tools, tool_count);
+    } else {
+        write_anthropic_tools(w, tools, tool_count);
+    }
+    if (w->overflow || w->error) {
+        return;
     }
 
-    // Add history
-    for (int i = 0; i < history_len; i++) {
-        cJSON *msg = cJSON_CreateObject();
-        if (!msg || !cJSON_AddStringToObject(msg, "role", history[i].role)) {
-            cJSON_Delete(msg);
-            goto fail;
-        }
-
-        if (history[i].is_tool_use) {
-            cJSON *content = cJSON_AddArrayToObject(msg, "content");
-            cJSON *tool_use = cJSON_CreateObject();
-            if (!content || !tool_use ||
-                !cJSON_AddStringToObject(tool_use, "type", "tool_use") ||
-                !cJSON_AddStringToObject(tool_use, "id", history[i].tool_id) ||
-                !cJSON_AddStringToObject(tool_use, "name", history[i].tool_name)) {
-                cJSON_Delete(tool_use);
-                cJSON_Delete(msg);
-                goto fail;
-            }
-
-            cJSON *input = cJSON_Parse(history[i].content);
-            if (!input) {
-                input = cJSON_CreateObject();
-            }
-            if (!input) {
-                cJSON_Delete(tool_use);
-                cJSON_Delete(msg);
-                goto fail;
-            }
+    size_t len = w->len - start;
+    char *json = malloc(len);
+    if (!json) {
+        ESP_LOGW(TAG, "No memory to cache tools catalog (%d bytes)", (int)len);
+        return;
+    }
+    memcpy(json, w->buf + start, len);
+
+    free(s_tools_catalog.json);
+    s_tools_catalog = (tools_catalog_t){
+        .json = json,
+        .len = len,
+        .openai_format = openai_format,
+        .tools = tools,
+        .tool_count = tool_count,
+        .user_generation = user_generation,
+    };
+    s_tools_catalog_builds++;
+    ESP_LOGI(TAG, "Cached tools catalog: %d bytes (%s format)", (int)len,
+             openai_format ? "openai" : "anthropic");
+}
 
-            cJSON_AddItemToObject(tool_use, "input", input);
-            cJSON_AddItemToArray(content, tool_use);
-        } else if (history[i].is_tool_result) {
-            if (!history_has_prior_tool_use(history, i, history[i].tool_id)) {
-                ESP_LOGW(TAG, "Skipping orphan tool_result in history[%d] (id=%s)",
-                         i, history[i].tool_id);
-                cJSON_Delete(msg);
-                continue;
-            }
-            cJSON *content = cJSON_AddArrayToObject(msg, "content");
-            cJSON *tool_result = cJSON_CreateObject();
-            if (!content || !tool_result ||
-                !cJSON_AddStringToObject(tool_result, "type", "tool_result") ||
-                !cJSON_AddStringToObject(tool_result, "tool_use_id", history[i].tool_id) ||
-                !cJSON_AddStringToObject(tool_result, "content", history[i].content)) {
-                cJSON_Delete(tool_result);
-                cJSON_Delete(msg);
-                goto fail;
-            }
+// -----------------------------------------------------------------------------
+// Anthropic Format (Claude API)
+// -----------------------------------------------------------------------------
 
-            cJSON_AddItemToArray(content, tool_result);
-        } else if (!cJSON_AddStringToObject(msg, "content", history[i].content)) {
-            cJSON_Delete(msg);
-            goto fail;
-        }
+// Prompt cache breakpoint: the prompt up to and including this block is cacheable.
+static void write_cache_control(json_writer_t *w)
+{
+    json_writer_key(w, "cache_control");
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "type", "ephemeral");
+    json_writer_object_end(w);
+}
 
-        cJSON_AddItemToArray(messages, msg);
+// Everything up to and including the opening of the messages array.
+static void write_anthropic_head(json_writer_t *w, const char *system_prompt)
+{
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "model", llm_get_model());
+    json_writer_kv_int(w, "max_tokens", LLM_MAX_TOKENS);
+    if (llm_prompt_cache_enabled()) {
+        // Tools precede the system prompt in the cached prefix, so this one
+        // breakpoint covers both.
+        json_writer_key(w, "system");
+        json_writer_array_begin(w);
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "type", "text");
+        json_writer_kv_string(w, "text", system_prompt);
+        write_cache_control(w);
+        json_writer_object_end(w);
+        json_writer_array_end(w);
+    } else {
+        json_writer_kv_string(w, "system", system_prompt);
     }
-
-    // Add new user message
-    if (user_message && user_message[0] != '\0') {
-        cJSON *user_msg = cJSON_CreateObject();
-        if (!user_msg ||
-            !cJSON_AddStringToObject(user_msg, "role", "user") ||
-            !cJSON_AddStringToObject(user_msg, "content", user_message)) {
-            cJSON_Delete(user_msg);
-            goto fail;
-        }
-
-        cJSON_AddItemToArray(messages, user_msg);
+    if (llm_stream_enabled()) {
+        json_writer_key(w, "stream");
+        json_writer_bool(w, true);
     }
 
-    // Tools array (built-in + user-defined)
-    int user_tool_count = user_tools_count();
-    if (tool_count > 0 || user_tool_count > 0) {
-        cJSON *tools_arr = cJSON_AddArrayToObject(root, "tools");
-        if (!tools_arr) {
-            goto fail;
-        }
-
-        // Built-in tools
-        for (int i = 0; i < tool_count; i++) {
-            cJSON *tool = cJSON_CreateObject();
-            if (!tool ||
-                !cJSON_AddStringToObject(tool, "name", tools[i].name) ||
-                !cJSON_AddStringToObject(tool, "description", tools[i].description)) {
-                cJSON_Delete(tool);
-                goto fail;
-            }
+    json_writer_key(w, "messages");
+    json_writer_array_begin(w);
+}
 
-            cJSON *schema = cJSON_Parse(tools[i].input_schema_json);
-            if (!schema) {
-                schema = cJSON_CreateObject();
-            }
-            if (!schema) {
-                cJSON_Delete(tool);
-                goto fail;
-            }
-            cJSON_AddItemToObject(tool, "input_schema", schema);
+// Opens a tool_use/tool_result message; its content array stays open so
+// the blocks of parallel tool calls can follow.
+static void write_anthropic_group_begin(json_writer_t *w, const conversation_msg_t *msg)
+{
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "role", msg->role);
+    json_writer_key(w, "content");
+    json_writer_array_begin(w);
+}
 
-            cJSON_AddItemToArray(tools_arr, tool);
+static void write_anthropic_tool_block(json_writer_t *w, const conversation_msg_t *msg,
+                                       bool cache_breakpoint)
+{
+    json_writer_object_begin(w);
+    if (msg->is_tool_use) {
+        json_writer_kv_string(w, "type", "tool_use");
+        json_writer_kv_string(w, "id", msg->tool_id);
+        json_writer_kv_string(w, "name", msg->tool_name);
+        json_writer_key(w, "input");
+        write_json_or_empty_object(w, msg->content);
+    } else {
+        json_writer_kv_string(w, "type", "tool_result");
+        json_writer_kv_string(w, "tool_use_id", msg->tool_id);
+        json_writer_kv_string(w, "content", msg->content);
+        if (msg->is_error) {
+            json_writer_key(w, "is_error");
+            json_writer_bool(w, true);
         }
+    }
+    if (cache_breakpoint) {
+        write_cache_control(w);
+    }
+    json_writer_object_end(w);
+}
 
-        // User-defined tools
-        user_tool_t user_tools_arr[MAX_DYNAMIC_TOOLS];
-        int loaded = user_tools_get_all(user_tools_arr, MAX_DYNAMIC_TOOLS);
-        for (int i = 0; i < loaded; i++) {
-            cJSON *tool = cJSON_CreateObject();
-            cJSON *schema = cJSON_CreateObject();
-            cJSON *properties = cJSON_CreateObject();
-            if (!tool || !schema || !properties ||
-                !cJSON_AddStringToObject(tool, "name", user_tools_arr[i].name) ||
-                !cJSON_AddStringToObject(tool, "description", user_tools_arr[i].description) ||
-                !cJSON_AddStringToObject(schema, "type", "object")) {
-                cJSON_Delete(properties);
-                cJSON_Delete(schema);
-                cJSON_Delete(tool);
-                goto fail;
-            }
-
-            cJSON_AddItemToObject(schema, "properties", properties);
-            cJSON_AddItemToObject(tool, "input_schema", schema);
-            cJSON_AddItemToArray(tools_arr, tool);
-        }
+// Plain text message
+static void write_anthropic_message(json_writer_t *w, const conversation_msg_t *msg,
+                                    bool cache_breakpoint)
+{
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "role", msg->role);
+
+    if (cache_breakpoint) {
+        // Breakpoints attach to content blocks, so use the block form.
+        json_writer_key(w, "content");
+        json_writer_array_begin(w);
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "type", "text");
+        json_writer_kv_string(w, "text", msg->content);
+        write_cache_control(w);
+        json_writer_object_end(w);
+        json_writer_array_end(w);
+    } else {
+        json_writer_kv_string(w, "content", msg->content);
     }
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (!json_str) {
-        goto fail;
+    json_writer_object_end(w);
+}
+
+static void write_anthropic_tools(json_writer_t *w, const tool_def_t *tools, int tool_count)
+{
+    json_writer_array_begin(w);
+
+    // Built-in tools
+    for (int i = 0; i < tool_count; i++) {
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "name", tools[i].name);
+        json_writer_kv_string(w, "description", tools[i].description);
+        json_writer_key(w, "input_schema");
+        write_json_or_empty_object(w, tools[i].input_schema_json);
+        json_writer_object_end(w);
     }
 
-    cJSON_Delete(root);
-    return json_str;
+    // User-defined tools
+    user_tool_t user_tools_arr[MAX_DYNAMIC_TOOLS];
+    int loaded = user_tools_get_all(user_tools_arr, MAX_DYNAMIC_TOOLS);
+    for (int i = 0; i < loaded; i++) {
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "name", user_tools_arr[i].name);
+        json_writer_kv_string(w, "description", user_tools_arr[i].description);
+        json_writer_key(w, "input_schema");
+        write_empty_object_schema(w);
+        json_writer_object_end(w);
+    }
 
-fail:
-    cJSON_Delete(root);
-    return NULL;
+    json_writer_array_end(w);
 }
 
-static bool parse_anthropic_response(
-    cJSON *root,
-    char *text_out,
-    size_t text_out_len,
-    char *tool_name_out,
-    size_t tool_name_len,
-    char *tool_id_out,
-    size_t tool_id_len,
-    cJSON **tool_input_out)
+static bool parse_anthropic_content(json_pull_t *pull, char *text_out, size_t text_out_len)
 {
-    cJSON *content = cJSON_GetObjectItem(root, "content");
-    if (!content || !cJSON_IsArray(content)) {
+    if (json_pull_peek(pull) != '[') {
         ESP_LOGE(TAG, "No content array in response");
         return false;
     }
 
-    cJSON *block;
-    cJSON_ArrayForEach(block, content) {
-        cJSON *type = cJSON_GetObjectItem(block, "type");
-        if (!type || !cJSON_IsString(type)) continue;
+    json_pull_array_begin(pull);
+    while (json_pull_next_item(pull)) {
+        if (json_pull_peek(pull) != '{') {
+            json_pull_skip(pull, NULL);
+            continue;
+        }
 
-        if (strcmp(type->valuestring, "text") == 0) {
-            cJSON *text = cJSON_GetObjectItem(block, "text");
-            if (text && cJSON_IsString(text)) {
-                strncpy(text_out, text->valuestring, text_out_len - 1);
-                text_out[text_out_len - 1] = '\0';
-            }
-        } else if (strcmp(type->valuestring, "tool_use") == 0) {
-            cJSON *name = cJSON_GetObjectItem(block, "name");
-            cJSON *id = cJSON_GetObjectItem(block, "id");
-            cJSON *input = cJSON_GetObjectItem(block, "input");
-
-            if (name && cJSON_IsString(name)) {
-                strncpy(tool_name_out, name->valuestring, tool_name_len - 1);
-                tool_name_out[tool_name_len - 1] = '\0';
-            }
-            if (id && cJSON_IsString(id)) {
-                strncpy(tool_id_out, id->valuestring, tool_id_len - 1);
-                tool_id_out[tool_id_len - 1] = '\0';
-            }
-            if (input) {
-                *tool_input_out = input;
-            }
+        // Members may come in any order; note where they are, act on "type" after.
+        json_span_t key;
+        json_span_t type = {0};
+        json_span_t text = {0};
+        json_span_t name = {0};
+        json_span_t id = {0};
+        json_span_t input = {0};
+        json_pull_object_begin(pull);
+        while (json_pull_next_key(pull, &key)) {
+            json_span_t *slot = NULL;
+            if (json_span_eq(&key, "type")) slot = &type;
+            else if (json_span_eq(&key, "text")) slot = &text;
+            else if (json_span_eq(&key, "name")) slot = &name;
+            else if (json_span_eq(&key, "id")) slot = &id;
+            else if (json_span_eq(&key, "input")) slot = &input;
+            json_pull_skip(pull, slot);
+        }
+
+        if (span_is_string(&type, "\"text\"")) {
+            copy_string_span(&text, text_out, text_out_len);
+        } else if (span_is_string(&type, "\"tool_use\"") && input.ptr) {
+            add_tool_call(&name, &id, cJSON_ParseWithLength(input.ptr, input.len));
         }
     }
 
-    return true;
+    return !pull->error;
 }
 
 // -----------------------------------------------------------------------------
 // OpenAI Format (OpenAI, OpenRouter)
 // -----------------------------------------------------------------------------
 
-static char *build_openai_request(
-    const char *system_prompt,
-    const conversation_msg_t *history,
-    int history_len,
-    const char *user_message,
-    const tool_def_t *tools,
-    int tool_count)
+// Everything up to and including the system message.
+static void write_openai_head(json_writer_t *w, const char *system_prompt)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        return NULL;
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "model", llm_get_model());
+    write_token_limit_field(w, LLM_MAX_TOKENS);
+    if (llm_stream_enabled()) {
+        json_writer_key(w, "stream");
+        json_writer_bool(w, true);
+        // Ask for a final chunk carrying the token usage.
+        json_writer_key(w, "stream_options");
+        json_writer_object_begin(w);
+        json_writer_key(w, "include_usage");
+        json_writer_bool(w, true);
+        json_writer_object_end(w);
     }
 
-    if (!cJSON_AddStringToObject(root, "model", llm_get_model()) ||
-        !add_token_limit_field(root)) {
-        goto fail;
+    json_writer_key(w, "messages");
+    json_writer_array_begin(w);
+
+    // System message first
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "role", "system");
+    json_writer_kv_string(w, "content", system_prompt);
+    json_writer_object_end(w);
+}
+
+// Opens an assistant message whose tool_calls array stays open so the
+// calls of one parallel round can follow.
+static void write_openai_group_begin(json_writer_t *w)
+{
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "role", "assistant");
+    json_writer_key(w, "content");
+    json_writer_null(w);
+    json_writer_key(w, "tool_calls");
+    json_writer_array_begin(w);
+}
+
+static void write_openai_tool_call(json_writer_t *w, const conversation_msg_t *msg)
+{
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "id", msg->tool_id);
+    json_writer_kv_string(w, "type", "function");
+    json_writer_key(w, "function");
+    json_writer_object_begin(w);
+    json_writer_kv_string(w, "name", msg->tool_name);
+    json_writer_kv_string(w, "arguments", msg->content);
+    json_writer_object_end(w);
+    json_writer_object_end(w);
+}
+
+// Tool result or plain text message
+static void write_openai_message(json_writer_t *w, const conversation_msg_t *msg)
+{
+    json_writer_object_begin(w);
+    if (msg->is_tool_result) {
+        // Tool response message (one per call, even for parallel calls)
+        json_writer_kv_string(w, "role", "tool");
+        json_writer_kv_string(w, "tool_call_id", msg->tool_id);
+        json_writer_kv_string(w, "content", msg->content);
+    } else {
+        // Regular message
+        json_writer_kv_string(w, "role", msg->role);
+        json_writer_kv_string(w, "content", msg->content);
     }
+    json_writer_object_end(w);
+}
 
-    cJSON *messages = cJSON_AddArrayToObject(root, "messages");
-    if (!messages) {
-        goto fail;
+static void write_openai_tools(json_writer_t *w, const tool_def_t *tools, int tool_count)
+{
+    json_writer_array_begin(w);
+
+    // Built-in tools
+    for (int i = 0; i < tool_count; i++) {
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "type", "function");
+        json_writer_key(w, "function");
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "name", tools[i].name);
+        json_writer_kv_string(w, "description", tools[i].description);
+        json_writer_key(w, "parameters");
+        write_json_or_empty_object(w, tools[i].input_schema_json);
+        json_writer_object_end(w);
+        json_writer_object_end(w);
     }
 
-    // System message first
-    cJSON *sys_msg = cJSON_CreateObject();
-    if (!sys_msg ||
-        !cJSON_AddStringToObject(sys_msg, "role", "system") ||
-        !cJSON_AddStringToObject(sys_msg, "content", system_prompt)) {
-        cJSON_Delete(sys_msg);
-        goto fail;
+    // User-defined tools
+    user_tool_t user_tools_arr[MAX_DYNAMIC_TOOLS];
+    int loaded = user_tools_get_all(user_tools_arr, MAX_DYNAMIC_TOOLS);
+    for (int i = 0; i < loaded; i++) {
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "type", "function");
+        json_writer_key(w, "function");
+        json_writer_object_begin(w);
+        json_writer_kv_string(w, "name", user_tools_arr[i].name);
+        json_writer_kv_string(w, "description", user_tools_arr[i].description);
+        json_writer_key(w, "parameters");
+        write_empty_object_schema(w);
+        json_writer_object_end(w);
+        json_writer_object_end(w);
     }
-    cJSON_AddItemToArray(messages, sys_msg);
 
-    // Add history
-    for (int i = 0; i < history_len; i++) {
-        cJSON *msg = cJSON_CreateObject();
-        if (!msg) {
-            goto fail;
-        }
+    json_writer_array_end(w);
+}
 
-        if (history[i].is_tool_use) {
-            // Assistant message with tool_calls
-            cJSON *tool_calls = NULL;
-            cJSON *tc = NULL;
-            cJSON *func = NULL;
+// function.arguments is a JSON document encoded as a string; only this
+// small subobject is turned into a cJSON tree for the tool handlers.
+static cJSON *parse_openai_arguments(const json_span_t *args)
+{
+    cJSON *parsed_args = NULL;
+    char *decoded = cJSON_malloc(args->len);
 
-            if (!cJSON_AddStringToObject(msg, "role", "assistant") ||
-                !cJSON_AddNullToObject(msg, "content")) {
-                cJSON_Delete(msg);
-                goto fail;
-            }
+    if (decoded) {
+        json_span_decode_string(args, decoded, args->len);
+        parsed_args = cJSON_Parse(decoded);
+        cJSON_free(decoded);
+    }
+    if (!parsed_args) {
+        parsed_args = cJSON_CreateObject();
+    }
+    return parsed_args;
+}
 
-            tool_calls = cJSON_AddArrayToObject(msg, "tool_calls");
-            tc = cJSON_CreateObject();
-            func = cJSON_CreateObject();
-            if (!tool_calls || !tc || !func ||
-                !cJSON_AddStringToObject(tc, "id", history[i].tool_id) ||
-                !cJSON_AddStringToObject(tc, "type", "function") ||
-                !cJSON_AddStringToObject(func, "name", history[i].tool_name) ||
-                !cJSON_AddStringToObject(func, "arguments", history[i].content)) {
-                cJSON_Delete(func);
-                cJSON_Delete(tc);
-                cJSON_Delete(msg);
-                goto fail;
-            }
+static void parse_openai_tool_call(json_pull_t *pull)
+{
+    json_span_t key;
+    json_span_t id = {0};
+    json_span_t func = {0};
+
+    json_pull_object_begin(pull);
+    while (json_pull_next_key(pull, &key)) {
+        json_pull_skip(pull, json_span_eq(&key, "id") ? &id :
+                             json_span_eq(&key, "function") ? &func : NULL);
+    }
 
-            cJSON_AddItemToObject(tc, "function", func);
-            cJSON_AddItemToArray(tool_calls, tc);
-        } else if (history[i].is_tool_result) {
-            if (!history_has_prior_tool_use(history, i, history[i].tool_id)) {
-                ESP_LOGW(TAG, "Skipping orphan tool_result in history[%d] (id=%s)",
-                         i, history[i].tool_id);
-                cJSON_Delete(msg);
-                continue;
-            }
-            // Tool response message
-            if (!cJSON_AddStringToObject(msg, "role", "tool") ||
-                !cJSON_AddStringToObject(msg, "tool_call_id", history[i].tool_id) ||
-                !cJSON_AddStringToObject(msg, "content", history[i].content)) {
-                cJSON_Delete(msg);
-                goto fail;
-            }
-        } else {
-            // Regular message
-            if (!cJSON_AddStringToObject(msg, "role", history[i].role) ||
-                !cJSON_AddStringToObject(msg, "content", history[i].content)) {
-                cJSON_Delete(msg);
-                goto fail;
-            }
-        }
+    if (!func.ptr || func.ptr[0] != '{') {
+        return;
+    }
 
-        cJSON_AddItemToArray(messages, msg);
+    json_pull_t fn;
+    json_span_t name = {0};
+    json_span_t args = {0};
+    json_pull_init(&fn, func.ptr, func.len);
+    json_pull_object_begin(&fn);
+    while (json_pull_next_key(&fn, &key)) {
+        json_pull_skip(&fn, json_span_eq(&key, "name") ? &name :
+                            json_span_eq(&key, "arguments") ? &args : NULL);
     }
 
-    // Add new user message
-    if (user_message && user_message[0] != '\0') {
-        cJSON *user_msg = cJSON_CreateObject();
-        if (!user_msg ||
-            !cJSON_AddStringToObject(user_msg, "role", "user") ||
-            !cJSON_AddStringToObject(user_msg, "content", user_message)) {
-            cJSON_Delete(user_msg);
-            goto fail;
+    // Parse arguments string into JSON
+    if (args.ptr && args.ptr[0] == '"') {
+        add_tool_call(&name, &id, parse_openai_arguments(&args));
+    }
+}
+
+static bool parse_openai_choices(json_pull_t *pull, char *text_out, size_t text_out_len)
+{
+    // OpenAI: choices[0].message
+    if (json_pull_peek(pull) != '[' || !json_pull_array_begin(pull) ||
+        !json_pull_next_item(pull)) {
+        ESP_LOGE(TAG, "No choices in response");
+        return false;
+    }
+
+    json_span_t key;
+    json_span_t message = {0};
+    if (json_pull_peek(pull) == '{') {
+        json_pull_object_begin(pull);
+        while (json_pull_next_key(pull, &key)) {
+            json_pull_skip(pull, json_span_eq(&key, "message") ? &message : NULL);
         }
-        cJSON_AddItemToArray(messages, user_msg);
+    }
+    if (!message.ptr || message.ptr[0] != '{') {
+        ESP_LOGE(TAG, "No message in choice");
+        return false;
     }
 
-    // Tools array (OpenAI format: built-in + user-defined)
-    int user_tool_count = user_tools_count();
-    if (tool_count > 0 || user_tool_count > 0) {
-        cJSON *tools_arr = cJSON_AddArrayToObject(root, "tools");
-        if (!tools_arr) {
-            goto fail;
+    json_pull_t msg;
+    json_span_t tool_calls = {0};
+    json_pull_init(&msg, message.ptr, message.len);
+    json_pull_object_begin(&msg);
+    while (json_pull_next_key(&msg, &key)) {
+        // Text content (null when the reply is only tool calls)
+        if (json_span_eq(&key, "content") && json_pull_string(&msg, text_out, text_out_len)) {
+            continue;
         }
+        json_pull_skip(&msg, json_span_eq(&key, "tool_calls") ? &tool_calls : NULL);
+    }
 
-        // Built-in tools
-        for (int i = 0; i < tool_count; i++) {
-            cJSON *tool = cJSON_CreateObject();
-            cJSON *func = cJSON_CreateObject();
-            cJSON *params = cJSON_Parse(tools[i].input_schema_json);
-            if (!params) {
-                params = cJSON_CreateObject();
+    // Check for tool_calls (several when the model calls tools in parallel)
+    if (tool_calls.ptr && tool_calls.ptr[0] == '[') {
+        json_pull_t calls;
+        json_pull_init(&calls, tool_calls.ptr, tool_calls.len);
+        json_pull_array_begin(&calls);
+        while (json_pull_next_item(&calls)) {
+            if (json_pull_peek(&calls) == '{') {
+                parse_openai_tool_call(&calls);
+            } else {
+                json_pull_skip(&calls, NULL);
             }
+        }
+    }
 
-            if (!tool || !func || !params ||
-                !cJSON_AddStringToObject(tool, "type", "function") ||
-                !cJSON_AddStringToObject(func, "name", tools[i].name) ||
-                !cJSON_AddStringToObject(func, "description", tools[i].description)) {
-                cJSON_Delete(params);
-                cJSON_Delete(func);
-                cJSON_Delete(tool);
-                goto fail;
-            }
+    return true;
+}
 
-            cJSON_AddItemToObject(func, "parameters", params);
-            cJSON_AddItemToObject(tool, "function", func);
-            cJSON_AddItemToArray(tools_arr, tool);
-        }
+static void parse_anthropic_usage(const json_span_t *span)
+{
+    json_pull_t pull;
+    json_span_t key;
 
-        // User-defined tools
-        user_tool_t user_tools_arr[MAX_DYNAMIC_TOOLS];
-        int loaded = user_tools_get_all(user_tools_arr, MAX_DYNAMIC_TOOLS);
-        for (int i = 0; i < loaded; i++) {
-            cJSON *tool = cJSON_CreateObject();
-            cJSON *func = cJSON_CreateObject();
-            cJSON *params = cJSON_CreateObject();
-            cJSON *properties = cJSON_CreateObject();
-            if (!tool || !func || !params || !properties ||
-                !cJSON_AddStringToObject(tool, "type", "function") ||
-                !cJSON_AddStringToObject(func, "name", user_tools_arr[i].name) ||
-                !cJSON_AddStringToObject(func, "description", user_tools_arr[i].description) ||
-                !cJSON_AddStringToObject(params, "type", "object")) {
-                cJSON_Delete(properties);
-                cJSON_Delete(params);
-                cJSON_Delete(func);
-                cJSON_Delete(tool);
-                goto fail;
-            }
+    json_pull_init(&pull, span->ptr, span->len);
+    if (json_pull_peek(&pull) != '{') {
+        return;
+    }
+    json_pull_object_begin(&pull);
+    while (json_pull_next_key(&pull, &key)) {
+        uint32_t *field = NULL;
+        if (json_span_eq(&key, "input_tokens")) field = &s_last_usage.input_tokens;
+        else if (json_span_eq(&key, "output_tokens")) field = &s_last_usage.output_tokens;
+        else if (json_span_eq(&key, "cache_read_input_tokens")) field = &s_last_usage.cache_read_tokens;
+        else if (json_span_eq(&key, "cache_creation_input_tokens")) field = &s_last_usage.cache_write_tokens;
+        if (!field || !json_pull_uint32(&pull, field)) {
+            json_pull_skip(&pull, NULL);
+        }
+    }
+    s_has_usage = !pull.error;
+}
 
-            cJSON_AddItemToObject(params, "properties", properties);
-            cJSON_AddItemToObject(func, "parameters", params);
-            cJSON_AddItemToObject(tool, "function", func);
-            cJSON_AddItemToArray(tools_arr, tool);
+// OpenAI counts cached tokens inside prompt_tokens; llm_usage_t keeps them apart.
+static void parse_openai_usage(const json_span_t *span)
+{
+    json_pull_t pull;
+    json_span_t key;
+    json_span_t details = {0};
+    uint32_t prompt_tokens = 0;
+
+    json_pull_init(&pull, span->ptr, span->len);
+    if (json_pull_peek(&pull) != '{') {
+        return;
+    }
+    json_pull_object_begin(&pull);
+    while (json_pull_next_key(&pull, &key)) {
+        uint32_t *field = NULL;
+        if (json_span_eq(&key, "prompt_tokens")) field = &prompt_tokens;
+        else if (json_span_eq(&key, "completion_tokens")) field = &s_last_usage.output_tokens;
+        if (!field || !json_pull_uint32(&pull, field)) {
+            json_pull_skip(&pull, json_span_eq(&key, "prompt_tokens_details") ? &details : NULL);
         }
     }
+    if (pull.error) {
+        return;
+    }
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (!json_str) {
-        goto fail;
+    if (details.ptr && details.ptr[0] == '{') {
+        json_pull_t det;
+        json_pull_init(&det, details.ptr, details.len);
+        json_pull_object_begin(&det);
+        while (json_pull_next_key(&det, &key)) {
+            if (!json_span_eq(&key, "cached_tokens") ||
+                !json_pull_uint32(&det, &s_last_usage.cache_read_tokens)) {
+                json_pull_skip(&det, NULL);
+            }
+        }
+    }
+    if (s_last_usage.cache_read_tokens > prompt_tokens) {
+        s_last_usage.cache_read_tokens = prompt_tokens;
     }
+    s_last_usage.input_tokens = prompt_tokens - s_last_usage.cache_read_tokens;
+    s_has_usage = true;
+}
 
-    cJSON_Delete(root);
-    return json_str;
+// -----------------------------------------------------------------------------
+// Request assembly (shared by both formats)
+// -----------------------------------------------------------------------------
 
-fail:
-    cJSON_Delete(root);
-    return NULL;
+static void write_request_head(json_writer_t *w, const char *system_prompt)
+{
+    if (llm_is_openai_format()) {
+        write_openai_head(w, system_prompt);
+    } else {
+        write_anthropic_head(w, system_prompt);
+    }
 }
 
-static bool parse_openai_response(
-    cJSON *root,
-    char *text_out,
-    size_t text_out_len,
-    char *tool_name_out,
-    size_t tool_name_len,
-    char *tool_id_out,
-    size_t tool_id_len,
-    cJSON **tool_input_out)
+// Append history[from..to). Earlier messages are only consulted to drop
+// orphaned tool results. With prompt caching on, the message at
+// breakpoint_index carries a cache_control marker (-1 for none).
+//
+// Entries flagged joins_previous are further blocks of the message opened
+// before them (parallel tool calls), so a range must start and end on a
+// group boundary. A joiner whose head was dropped opens the group itself.
+static void write_history_range(json_writer_t *w, const conversation_msg_t *history,
+                                int from, int to, int breakpoint_index)
 {
-    // OpenAI: choices[0].message
-    cJSON *choices = cJSON_GetObjectItem(root, "choices");
-    if (!choices || !cJSON_IsArray(choices) || cJSON_GetArraySize(choices) == 0) {
-        ESP_LOGE(TAG, "No choices in response");
-        return false;
-    }
+    bool openai_format = llm_is_openai_format();
+    bool prompt_cache = llm_prompt_cache_enabled();
+    const conversation_msg_t *group = NULL;     // Message whose block array is open
+
+    for (int i = from; i < to; i++) {
+        const conversation_msg_t *msg = &history[i];
+        if (msg->is_tool_result &&
+            !history_has_prior_tool_use(history, i, msg->tool_id)) {
+            ESP_LOGW(TAG, "Skipping orphan tool_result in history[%d] (id=%s)",
+                     i, msg->tool_id);
+            continue;
+        }
 
-    cJSON *choice = cJSON_GetArrayItem(choices, 0);
-    cJSON *message = cJSON_GetObjectItem(choice, "message");
-    if (!message) {
-        ESP_LOGE(TAG, "No message in choice");
-        return false;
+        bool joins = group && msg->joins_previous && group->is_tool_use == msg->is_tool_use;
+        if (group && !joins) {
+            json_writer_array_end(w);
+            json_writer_object_end(w);
+            group = NULL;
+        }
+
+        if (openai_format) {
+            if (msg->is_tool_use) {
+                if (!group) {
+                    write_openai_group_begin(w);
+                    group = msg;
+                }
+                write_openai_tool_call(w, msg);
+            } else {
+                write_openai_message(w, msg);
+            }
+        } else if (msg->is_tool_use || msg->is_tool_result) {
+            if (!group) {
+                write_anthropic_group_begin(w, msg);
+                group = msg;
+            }
+            write_anthropic_tool_block(w, msg, prompt_cache && i == breakpoint_index);
+        } else {
+            write_anthropic_message(w, msg, prompt_cache && i == breakpoint_index);
+        }
     }
 
-    // Check for text content
-    cJSON *content = cJSON_GetObjectItem(message, "content");
-    if (content && cJSON_IsString(content)) {
-        strncpy(text_out, content->valuestring, text_out_len - 1);
-        text_out[text_out_len - 1] = '\0';
+    if (group) {
+        json_writer_array_end(w);
+        json_writer_object_end(w);
     }
+}
 
-    // Check for tool_calls
-    cJSON *tool_calls = cJSON_GetObjectItem(message, "tool_calls");
-    if (tool_calls && cJSON_IsArray(tool_calls) && cJSON_GetArraySize(tool_calls) > 0) {
-        cJSON *tc = cJSON_GetArrayItem(tool_calls, 0);
+// Close the messages array, then add tools and close the request object.
+static void write_request_tail(json_writer_t *w, const tool_def_t *tools, int tool_count)
+{
+    json_writer_array_end(w);
 
-        cJSON *id = cJSON_GetObjectItem(tc, "id");
-        if (id && cJSON_IsString(id)) {
-            strncpy(tool_id_out, id->valuestring, tool_id_len - 1);
-            tool_id_out[tool_id_len - 1] = '\0';
-        }
+    // Tools array (built-in + user-defined)
+    if (tool_count > 0 || user_tools_count() > 0) {
+        json_writer_key(w, "tools");
+        write_tools_catalog(w, tools, tool_count);
+    }
 
-        cJSON *func = cJSON_GetObjectItem(tc, "function");
-        if (func) {
-            cJSON *name = cJSON_GetObjectItem(func, "name");
-            if (name && cJSON_IsString(name)) {
-                strncpy(tool_name_out, name->valuestring, tool_name_len - 1);
-                tool_name_out[tool_name_len - 1] = '\0';
-            }
+    json_writer_object_end(w);
+}
 
-            // Parse arguments string into JSON
-            cJSON *args = cJSON_GetObjectItem(func, "arguments");
-            if (args && cJSON_IsString(args)) {
-                cJSON *parsed_args = cJSON_Parse(args->valuestring);
-                if (!parsed_args) {
-                    parsed_args = cJSON_CreateObject();
-                }
-                if (parsed_args) {
-                    cJSON_AddItemToObject(tc, "_parsed_arguments", parsed_args);
-                    *tool_input_out = parsed_args;
-                }
-            }
+static size_t finish_request(json_writer_t *w, size_t buf_size)
+{
+    if (!json_writer_finish(w)) {
+        if (w->overflow) {
+            ESP_LOGW(TAG, "Request does not fit in %d bytes", (int)buf_size);
+        } else {
+            ESP_LOGE(TAG, "Request JSON writer error");
         }
+        return 0;
     }
 
-    return true;
+    ESP_LOGD(TAG, "Built request: %d bytes", (int)w->len);
+    return w->len;
 }
 
 // -----------------------------------------------------------------------------
 // Public API
 // -----------------------------------------------------------------------------
 
-char *json_build_request(
+size_t json_build_request_into(
+    char *buf,
+    size_t buf_size,
     const char *system_prompt,
     const conversation_msg_t *history,
     int history_len,
@@ -518,23 +750,207 @@ char *json_build_request(
     const tool_def_t *tools,
     int tool_count)
 {
-    char *json_str;
+    json_writer_t w;
+    json_writer_init(&w, buf, buf_size);
+
+    write_request_head(&w, system_prompt);
+    write_history_range(&w, history, 0, history_len, history_len - 1);
+
+    // Add new user message
+    if (user_message && user_message[0] != '\0') {
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "role", "user");
+        json_writer_kv_string(&w, "content", user_message);
+        json_writer_object_end(&w);
+    }
+
+    write_request_tail(&w, tools, tool_count);
+    return finish_request(&w, buf_size);
+}
+
+// One line per message, e.g. "assistant called gpio_write {...}".
+static void write_transcript(json_writer_t *w, const conversation_msg_t *history, int history_len)
+{
+    json_writer_string_begin(w);
+    for (int i = 0; i < history_len; i++) {
+        const conversation_msg_t *msg = &history[i];
+        if (msg->is_tool_use) {
+            json_writer_string_append(w, "assistant called ");
+            json_writer_string_append(w, msg->tool_name);
+            json_writer_string_append(w, " ");
+        } else if (msg->is_tool_result) {
+            json_writer_string_append(w, "tool result: ");
+        } else {
+            json_writer_string_append(w, msg->role);
+            json_writer_string_append(w, ": ");
+        }
+        json_writer_string_append(w, msg->content);
+        json_writer_string_append(w, "\n");
+    }
+    json_writer_string_end(w);
+}
+
+size_t json_build_summary_request_into(
+    char *buf,
+    size_t buf_size,
+    const char *instructions,
+    const conversation_msg_t *history,
+    int history_len)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, buf_size);
 
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "model", llm_get_summary_model());
     if (llm_is_openai_format()) {
-        json_str = build_openai_request(system_prompt, history, history_len,
-                                         user_message, tools, tool_count);
+        write_token_limit_field(&w, HISTORY_SUMMARY_MAX_TOKENS);
+        json_writer_key(&w, "messages");
+        json_writer_array_begin(&w);
+        json_writer_object_begin(&w);
+        json_writer_kv_string(&w, "role", "system");
+        json_writer_kv_string(&w, "content", instructions);
+        json_writer_object_end(&w);
+    } else {
+        json_writer_kv_int(&w, "max_tokens", HISTORY_SUMMARY_MAX_TOKENS);
+        json_writer_kv_string(&w, "system", instructions);
+        json_writer_key(&w, "messages");
+        json_writer_array_begin(&w);
+    }
+
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "role", "user");
+    json_writer_key(&w, "content");
+    write_transcript(&w, history, history_len);
+    json_writer_object_end(&w);
+
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    return finish_request(&w, buf_size);
+}
+
+static bool request_cache_usable(const json_request_cache_t *cache, char *buf, size_t buf_size,
+                                 const char *system_prompt,
+                                 const conversation_msg_t *history, int stable_len)
+{
+    return cache->valid &&
+           cache->prefix.buf == buf &&
+           cache->prefix.cap == buf_size &&
+           cache->system_prompt == system_prompt &&
+           cache->history == history &&
+           cache->emitted <= stable_len &&
+           cache->backend == llm_get_backend() &&
+           cache->streaming == llm_stream_enabled() &&
+           cache->prompt_cache == llm_prompt_cache_enabled();
+}
+
+size_t json_build_request_cached(
+    json_request_cache_t *cache,
+    char *buf,
+    size_t buf_size,
+    const char *system_prompt,
+    const conversation_msg_t *history,
+    int history_len,
+    const tool_def_t *tools,
+    int tool_count)
+{
+    json_writer_t w;
+    int from = 0;
+    bool prompt_cache = llm_prompt_cache_enabled();
+    // The newest message carries the cache breakpoint, which moves every
+    // round, so with prompt caching it is never part of the kept prefix.
+    // Parallel tool blocks share that message, so back up to its first block.
+    int stable = history_len;
+    if (prompt_cache && history_len > 0) {
+        stable = history_len - 1;
+        while (stable > 0 && history[stable].joins_previous) {
+            stable--;
+        }
+    }
+
+    if (request_cache_usable(cache, buf, buf_size, system_prompt, history, stable)) {
+        // Rewind to the end of the last emitted message; the tail is rewritten.
+        w = cache->prefix;
+        from = cache->emitted;
+        cache->appends++;
     } else {
-        json_str = build_anthropic_request(system_prompt, history, history_len,
-                                            user_message, tools, tool_count);
+        json_writer_init(&w, buf, buf_size);
+        write_request_head(&w, system_prompt);
+        cache->full_builds++;
     }
 
-    if (json_str) {
-        ESP_LOGD(TAG, "Built request: %d bytes", (int)strlen(json_str));
+    write_history_range(&w, history, from, stable, -1);
+    if (w.overflow || w.error) {
+        cache->valid = false;
+        return finish_request(&w, buf_size);
     }
 
+    cache->prefix = w;
+    cache->system_prompt = system_prompt;
+    cache->history = history;
+    cache->emitted = stable;
+    cache->backend = llm_get_backend();
+    cache->streaming = llm_stream_enabled();
+    cache->prompt_cache = prompt_cache;
+    cache->valid = true;
+
+    write_history_range(&w, history, stable, history_len, history_len - 1);
+    write_request_tail(&w, tools, tool_count);
+    size_t len = finish_request(&w, buf_size);
+    if (len == 0) {
+        cache->valid = false;
+    }
+    return len;
+}
+
+void json_request_cache_invalidate(json_request_cache_t *cache)
+{
+    cache->valid = false;
+}
+
+char *json_build_request(
+    const char *system_prompt,
+    const conversation_msg_t *history,
+    int history_len,
+    const char *user_message,
+    const tool_def_t *tools,
+    int tool_count)
+{
+    char *json_str = malloc(LLM_REQUEST_BUF_SIZE);
+    if (!json_str) {
+        return NULL;
+    }
+
+    if (json_build_request_into(json_str, LLM_REQUEST_BUF_SIZE, system_prompt, history,
+                                history_len, user_message, tools, tool_count) == 0) {
+        free(json_str);
+        return NULL;
+    }
     return json_str;
 }
 
+void json_response_begin(void)
+{
+    json_free_parsed_response();
+    memset(&s_last_usage, 0, sizeof(s_last_usage));
+    s_has_usage = false;
+}
+
+json_tool_call_t *json_response_add_tool_call(void)
+{
+    return next_tool_call();
+}
+
+void json_response_add_usage(const char *usage_json, size_t len)
+{
+    json_span_t usage = {.ptr = usage_json, .len = len};
+
+    if (llm_is_openai_format()) {
+        parse_openai_usage(&usage);
+    } else {
+        parse_anthropic_usage(&usage);
+    }
+}
+
 bool json_parse_response(
     const char *response_json,
     char *text_out,
@@ -546,47 +962,114 @@ bool json_parse_response(
     cJSON **tool_input_out)
 {
     // Free any previous parsed response
-    json_free_parsed_response();
+    json_response_begin();
 
     text_out[0] = '\0';
     tool_name_out[0] = '\0';
     tool_id_out[0] = '\0';
     *tool_input_out = NULL;
 
-    s_parsed_response = cJSON_Parse(response_json);
-    if (!s_parsed_response) {
+    // One pass over the top level: validate it and note where the parts we
+    // need are. Nothing is copied or allocated here.
+    bool openai_format = llm_is_openai_format();
+    const char *body_key = openai_format ? "choices" : "content";
+    json_pull_t pull;
+    json_span_t key;
+    json_span_t body = {0};
+    json_span_t error = {0};
+    json_span_t usage = {0};
+
+    json_pull_init(&pull, response_json, response_json ? strlen(response_json) : 0);
+    if (json_pull_peek(&pull) == '{') {
+        json_pull_object_begin(&pull);
+        while (json_pull_next_key(&pull, &key)) {
+            json_pull_skip(&pull, json_span_eq(&key, "error") ? &error :
+                                  json_span_eq(&key, body_key) ? &body :
+                                  json_span_eq(&key, "usage") ? &usage : NULL);
+        }
+    } else {
+        json_pull_skip(&pull, NULL);
+    }
+    if (!json_pull_at_end(&pull)) {
         ESP_LOGE(TAG, "Failed to parse response JSON");
         return false;
     }
 
+    if (usage.ptr && openai_format) {
+        parse_openai_usage(&usage);
+    } else if (usage.ptr) {
+        parse_anthropic_usage(&usage);
+    }
+
     // Check for error (both APIs use similar format)
-    cJSON *error = cJSON_GetObjectItem(s_parsed_response, "error");
-    if (error) {
-        cJSON *msg = cJSON_GetObjectItem(error, "message");
-        if (msg && cJSON_IsString(msg)) {
-            snprintf(text_out, text_out_len, "API Error: %s", msg->valuestring);
+    if (error.ptr) {
+        json_span_t message = {0};
+        if (error.ptr[0] == '{') {
+            json_pull_t err;
+            json_pull_init(&err, error.ptr, error.len);
+            json_pull_object_begin(&err);
+            while (json_pull_next_key(&err, &key)) {
+                json_pull_skip(&err, json_span_eq(&key, "message") ? &message : NULL);
+            }
+        }
+        if (message.ptr && message.ptr[0] == '"') {
+            int prefix = snprintf(text_out, text_out_len, "API Error: ");
+            if (prefix > 0 && (size_t)prefix < text_out_len) {
+                json_span_decode_string(&message, text_out + prefix, text_out_len - prefix);
+            }
         } else {
             snprintf(text_out, text_out_len, "API Error (unknown)");
         }
         return true;
     }
 
+    json_pull_t part;
+    json_pull_init(&part, body.ptr, body.len);
+
     // Parse based on format
-    if (llm_is_openai_format()) {
-        return parse_openai_response(s_parsed_response, text_out, text_out_len,
-                                      tool_name_out, tool_name_len,
-                                      tool_id_out, tool_id_len, tool_input_out);
-    } else {
-        return parse_anthropic_response(s_parsed_response, text_out, text_out_len,
-                                         tool_name_out, tool_name_len,
-                                         tool_id_out, tool_id_len, tool_input_out);
+    bool ok = openai_format ? parse_openai_choices(&part, text_out, text_out_len)
+                            : parse_anthropic_content(&part, text_out, text_out_len);
+
+    // The out parameters carry the first call; see json_get_tool_calls() for all.
+    if (ok && s_tool_call_count > 0) {
+        snprintf(tool_name_out, tool_name_len, "%s", s_tool_calls[0].name);
+        snprintf(tool_id_out, tool_id_len, "%s", s_tool_calls[0].id);
+        *tool_input_out = s_tool_calls[0].input;
     }
+    return ok;
+}
+
+#ifdef TEST_BUILD
+int json_test_tools_catalog_builds(void)
+{
+    return s_tools_catalog_builds;
+}
+
+void json_test_reset_tools_catalog(void)
+{
+    free(s_tools_catalog.json);
+    memset(&s_tools_catalog, 0, sizeof(s_tools_catalog));
+    s_tools_catalog_builds = 0;
+}
+#endif
+
+bool json_get_last_usage(llm_usage_t *usage)
+{
+    *usage = s_last_usage;
+    return s_has_usage;
+}
+
+int json_get_tool_calls(const json_tool_call_t **calls)
+{
+    *calls = s_tool_calls;
+    return s_tool_call_count;
 }
 
 void json_free_parsed_response(void)
 {
-    if (s_parsed_response) {
-        cJSON_Delete(s_parsed_response);
-        s_parsed_response = NULL;
+    for (int i = 0; i < s_tool_call_count; i++) {
+        cJSON_Delete(s_tool_calls[i].input);
+        s_tool_calls[i].input = NULL;
     }
+    s_tool_call_count = 0;
 }
@@ -2,23 +2,93 @@
 #define JSON_UTIL_H
 
 #include "config.h"
+#include "json_writer.h"
+#include "llm.h"
 #include "cJSON.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 // Forward declaration
 struct tool_def;
 
-// Conversation message
+// Conversation message. Strings are never NULL; the agent's copies live in
+// the history arena (history.h).
 typedef struct {
-    char role[16];                  // "user" or "assistant"
-    char content[MAX_MESSAGE_LEN];  // The text or tool result
+    const char *role;               // "user" or "assistant"
+    const char *content;            // The text or tool result
+    const char *tool_id;            // Tool use ID (for tool_use/tool_result), "" otherwise
+    const char *tool_name;          // Tool name (for tool_use), "" otherwise
     bool is_tool_use;               // True if this is a tool_use response
     bool is_tool_result;            // True if this is a tool_result
-    char tool_id[64];               // Tool use ID (for tool_use/tool_result)
-    char tool_name[32];             // Tool name (for tool_use)
+    bool is_error;                  // tool_result of a call that was not carried out
+    bool joins_previous;            // Another tool_use/tool_result block of the previous message
 } conversation_msg_t;
 
-// Build the complete API request JSON
+// One tool call from a parsed response
+typedef struct json_tool_call {
+    char name[32];
+    char id[64];
+    cJSON *input;                   // Valid until json_free_parsed_response()
+} json_tool_call_t;
+
+// Build the complete API request JSON directly into buf (no heap, no cJSON tree)
+// Returns the request length, or 0 if it does not fit in buf_size
+size_t json_build_request_into(
+    char *buf,
+    size_t buf_size,
+    const char *system_prompt,
+    const conversation_msg_t *history,
+    int history_len,
+    const char *user_message,
+    const struct tool_def *tools,
+    int tool_count
+);
+
+// Serialized request prefix (header, system prompt and the messages already
+// emitted) kept in the caller's buffer between builds of the same history.
+// Messages must not change once emitted: invalidate whenever the history is
+// shifted (oldest entry evicted) or truncated (rollback).
+typedef struct {
+    bool valid;
+    json_writer_t prefix;           // Writer state right after the last emitted message
+    const char *system_prompt;
+    const conversation_msg_t *history;
+    int emitted;                    // history[0..emitted) is already in the prefix
+    llm_backend_t backend;
+    bool streaming;
+    bool prompt_cache;
+    uint32_t full_builds;
+    uint32_t appends;
+} json_request_cache_t;
+
+// Like json_build_request_into() without a separate user message, but only
+// serializes messages added since the previous call when the cache is valid.
+size_t json_build_request_cached(
+    json_request_cache_t *cache,
+    char *buf,
+    size_t buf_size,
+    const char *system_prompt,
+    const conversation_msg_t *history,
+    int history_len,
+    const struct tool_def *tools,
+    int tool_count
+);
+
+void json_request_cache_invalidate(json_request_cache_t *cache);
+
+// Build a request (no tools, not streamed) asking the summary model to
+// condense history[0..history_len) per instructions. The messages are sent
+// as one plain-text transcript, so tool calls need no tool definitions.
+// Returns the request length, or 0 if it does not fit in buf_size
+size_t json_build_summary_request_into(
+    char *buf,
+    size_t buf_size,
+    const char *instructions,
+    const conversation_msg_t *history,
+    int history_len
+);
+
+// Build the complete API request JSON into a LLM_REQUEST_BUF_SIZE heap buffer
 // Returns allocated string (caller must free) or NULL on error
 char *json_build_request(
     const char *system_prompt,
@@ -29,9 +99,9 @@ char *json_build_request(
     int tool_count
 );
 
-// Parse the API response, extracting:
+// Parse the API response in place (only tool inputs become cJSON trees), extracting:
 // - text content (if present)
-// - tool_use block (if present)
+// - the first tool_use block (if present); json_get_tool_calls() returns all of them
 // Returns true on success
 bool json_parse_response(
     const char *response_json,
@@ -41,10 +111,37 @@ bool json_parse_response(
     size_t tool_name_len,
     char *tool_id_out,
     size_t tool_id_len,
-    cJSON **tool_input_out  // Caller must NOT free - points into parsed tree
+    cJSON **tool_input_out  // Caller must NOT free - valid until json_free_parsed_response()
 );
 
+// Tool calls of the last parsed response, in response order (at most
+// MAX_TOOL_CALLS_PER_RESPONSE; the agent runs MAX_TOOL_CALLS_PER_ROUND of
+// them). Returns the count.
+int json_get_tool_calls(const json_tool_call_t **calls);
+
+// Build the parsed response piece by piece instead, as the streaming decoder
+// (llm_stream.c) sees it one event at a time. json_response_begin() drops the
+// previous response; the getters above then report what was added.
+void json_response_begin(void);
+
+// Append a tool call with empty name, id and input for the caller to fill in.
+// Returns NULL beyond the per-response limit.
+json_tool_call_t *json_response_add_tool_call(void);
+
+// Merge a usage object in the backend's format into json_get_last_usage().
+void json_response_add_usage(const char *usage_json, size_t len);
+
 // Free the parsed response (call after done with tool_input)
 void json_free_parsed_response(void);
 
+// Token usage from the last json_parse_response() call. Returns false (and
+// zeroes) when the response carried no usage object.
+bool json_get_last_usage(llm_usage_t *usage);
+
+#ifdef TEST_BUILD
+// Test-only helpers for the cached tools catalog.
+int json_test_tools_catalog_builds(void);
+void json_test_reset_tools_catalog(void);
+#endif
+
 #endif // JSON_UTIL_H
@@ -0,0 +1,394 @@
+#include "json_writer.h"
+#include <string.h>
+#include <stdio.h>
+
+static void put(json_writer_t *w, const char *data, size_t len)
+{
+    if (w->overflow) {
+        return;
+    }
+    // Always keep room for the terminating NUL.
+    if (len >= w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+// Emit the separator that precedes a value or key at the current level.
+static void begin_item(json_writer_t *w)
+{
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth > 0) {
+        if (w->has_items[w->depth - 1]) {
+            put_char(w, ',');
+        }
+        w->has_items[w->depth - 1] = true;
+    }
+}
+
+static void put_escaped_body(json_writer_t *w, const char *s)
+{
+    const char *run = s;
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        const char *esc = NULL;
+        char ubuf[8];
+
+        switch (c) {
+            case '"':  esc = "\\\""; break;
+            case '\\': esc = "\\\\"; break;
+            case '\b': esc = "\\b"; break;
+            case '\f': esc = "\\f"; break;
+            case '\n': esc = "\\n"; break;
+            case '\r': esc = "\\r"; break;
+            case '\t': esc = "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    snprintf(ubuf, sizeof(ubuf), "\\u%04x", c);
+                    esc = ubuf;
+                }
+                break;
+        }
+
+        if (esc) {
+            put(w, run, (size_t)(s - run));
+            put(w, esc, strlen(esc));
+            run = s + 1;
+        }
+    }
+    put(w, run, (size_t)(s - run));
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    put_char(w, '"');
+    put_escaped_body(w, s);
+    put_char(w, '"');
+}
+
+static void open_container(json_writer_t *w, char c)
+{
+    begin_item(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->error = true;
+        return;
+    }
+    put_char(w, c);
+    w->has_items[w->depth++] = false;
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+    if (w->depth <= 0 || w->after_key) {
+        w->error = true;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+// -----------------------------------------------------------------------------
+// Validation (recursive descent, no allocation)
+// -----------------------------------------------------------------------------
+
+static const char *skip_ws(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+static const char *scan_value(const char *p, int depth);
+
+static const char *scan_string(const char *p)
+{
+    if (*p != '"') {
+        return NULL;
+    }
+    p++;
+    while (*p != '"') {
+        unsigned char c = (unsigned char)*p;
+        if (c == '\0' || c < 0x20) {
+            return NULL;
+        }
+        if (c == '\\') {
+            p++;
+            if (*p == 'u') {
+                for (int i = 1; i <= 4; i++) {
+                    char h = p[i];
+                    bool hex = (h >= '0' && h <= '9') || (h >= 'a' && h <= 'f') ||
+                               (h >= 'A' && h <= 'F');
+                    if (!hex) {
+                        return NULL;
+                    }
+                }
+                p += 4;
+            } else if (!*p || !strchr("\"\\/bfnrt", *p)) {
+                return NULL;
+            }
+        }
+        p++;
+    }
+    return p + 1;
+}
+
+static const char *scan_number(const char *p)
+{
+    const char *start;
+
+    if (*p == '-') {
+        p++;
+    }
+    if (*p == '0') {
+        p++;
+    } else if (*p >= '1' && *p <= '9') {
+        while (*p >= '0' && *p <= '9') p++;
+    } else {
+        return NULL;
+    }
+    if (*p == '.') {
+        start = ++p;
+        while (*p >= '0' && *p <= '9') p++;
+        if (p == start) return NULL;
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        if (*p == '+' || *p == '-') p++;
+        start = p;
+        while (*p >= '0' && *p <= '9') p++;
+        if (p == start) return NULL;
+    }
+    return p;
+}
+
+static const char *scan_container(const char *p, int depth, bool object)
+{
+    char close = object ? '}' : ']';
+
+    p = skip_ws(p + 1);
+    if (*p == close) {
+        return p + 1;
+    }
+    while (1) {
+        if (object) {
+            p = scan_string(p);
+            if (!p) return NULL;
+            p = skip_ws(p);
+            if (*p != ':') return NULL;
+            p = skip_ws(p + 1);
+        }
+        p = scan_value(p, depth + 1);
+        if (!p) return NULL;
+        p = skip_ws(p);
+        if (*p == ',') {
+            p = skip_ws(p + 1);
+            continue;
+        }
+        if (*p == close) {
+            return p + 1;
+        }
+        return NULL;
+    }
+}
+
+static const char *scan_value(const char *p, int depth)
+{
+    if (depth > JSON_WRITER_MAX_DEPTH) {
+        return NULL;
+    }
+    switch (*p) {
+        case '{': return scan_container(p, depth, true);
+        case '[': return scan_container(p, depth, false);
+        case '"': return scan_string(p);
+        case 't': return strncmp(p, "true", 4) == 0 ? p + 4 : NULL;
+        case 'f': return strncmp(p, "false", 5) == 0 ? p + 5 : NULL;
+        case 'n': return strncmp(p, "null", 4) == 0 ? p + 4 : NULL;
+        default:  return scan_number(p);
+    }
+}
+
+bool json_writer_is_valid(const char *json)
+{
+    if (!json) {
+        return false;
+    }
+    const char *end = scan_value(skip_ws(json), 0);
+    return end && *skip_ws(end) == '\0';
+}
+
+// -----------------------------------------------------------------------------
+// Public API
+// -----------------------------------------------------------------------------
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    if (!buf || cap == 0) {
+        w->overflow = true;
+        return;
+    }
+    buf[0] = '\0';
+}
+
+void json_writer_object_begin(json_writer_t *w)
+{
+    open_container(w, '{');
+}
+
+void json_writer_object_end(json_writer_t *w)
+{
+    close_container(w, '}');
+}
+
+void json_writer_array_begin(json_writer_t *w)
+{
+    open_container(w, '[');
+}
+
+void json_writer_array_end(json_writer_t *w)
+{
+    close_container(w, ']');
+}
+
+void json_writer_key(json_writer_t *w, const char *key)
+{
+    if (w->depth <= 0 || w->after_key) {
+        w->error = true;
+        return;
+    }
+    begin_item(w);
+    put_escaped(w, key ? key : "");
+    put_char(w, ':');
+    w->after_key = true;
+}
+
+void json_writer_string(json_writer_t *w, const char *value)
+{
+    begin_item(w);
+    put_escaped(w, value ? value : "");
+}
+
+void json_writer_int(json_writer_t *w, int value)
+{
+    char num[16];
+    int n = snprintf(num, sizeof(num), "%d", value);
+
+    begin_item(w);
+    put(w, num, (size_t)n);
+}
+
+void json_writer_bool(json_writer_t *w, bool value)
+{
+    begin_item(w);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w)
+{
+    begin_item(w);
+    put(w, "null", 4);
+}
+
+void json_writer_string_begin(json_writer_t *w)
+{
+    if (w->in_string) {
+        w->error = true;
+        return;
+    }
+    begin_item(w);
+    put_char(w, '"');
+    w->in_string = true;
+}
+
+void json_writer_string_append(json_writer_t *w, const char *s)
+{
+    if (!w->in_string) {
+        w->error = true;
+        return;
+    }
+    put_escaped_body(w, s ? s : "");
+}
+
+void json_writer_string_end(json_writer_t *w)
+{
+    if (!w->in_string) {
+        w->error = true;
+        return;
+    }
+    put_char(w, '"');
+    w->in_string = false;
+}
+
+bool json_writer_raw(json_writer_t *w, const char *json)
+{
+    if (!json_writer_is_valid(json)) {
+        return false;
+    }
+
+    begin_item(w);
+
+    bool in_string = false;
+    for (const char *p = json; *p != '\0'; p++) {
+        char c = *p;
+        if (in_string) {
+            if (c == '\\') {
+                put(w, p, 2);
+                p++;
+                continue;
+            }
+            if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            continue;
+        } else if (c == '"') {
+            in_string = true;
+        }
+        put_char(w, c);
+    }
+    return true;
+}
+
+void json_writer_fragment(json_writer_t *w, const char *json, size_t len)
+{
+    begin_item(w);
+    put(w, json, len);
+}
+
+void json_writer_kv_string(json_writer_t *w, const char *key, const char *value)
+{
+    json_writer_key(w, key);
+    json_writer_string(w, value);
+}
+
+void json_writer_kv_int(json_writer_t *w, const char *key, int value)
+{
+    json_writer_key(w, key);
+    json_writer_int(w, value);
+}
+
+bool json_writer_finish(json_writer_t *w)
+{
+    if (w->buf && w->cap > 0) {
+        w->buf[w->len] = '\0';
+    }
+    return !w->overflow && !w->error && w->depth == 0 && !w->after_key && !w->in_string;
+}
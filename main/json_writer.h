@@ -0,0 +1,63 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JSON_WRITER_MAX_DEPTH   16
+
+// Append-only JSON emitter that writes straight into a caller-provided buffer.
+// No heap allocation and no intermediate tree. Once the buffer fills up the
+// writer latches into an overflow state and every further call is a no-op.
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    bool error;                             // Misuse (bad nesting, invalid raw JSON)
+    int depth;
+    bool has_items[JSON_WRITER_MAX_DEPTH];  // Per level: a comma is needed before the next item
+    bool after_key;                         // Next value completes a "key": pair
+    bool in_string;                         // Between string_begin and string_end
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+
+void json_writer_object_begin(json_writer_t *w);
+void json_writer_object_end(json_writer_t *w);
+void json_writer_array_begin(json_writer_t *w);
+void json_writer_array_end(json_writer_t *w);
+
+void json_writer_key(json_writer_t *w, const char *key);
+void json_writer_string(json_writer_t *w, const char *value);
+void json_writer_int(json_writer_t *w, int value);
+void json_writer_bool(json_writer_t *w, bool value);
+void json_writer_null(json_writer_t *w);
+
+// Write one string value in pieces (e.g. a transcript assembled from many
+// messages) without a temporary buffer. Nothing else may be written between
+// begin and end.
+void json_writer_string_begin(json_writer_t *w);
+void json_writer_string_append(json_writer_t *w, const char *s);
+void json_writer_string_end(json_writer_t *w);
+
+// Copy an already-serialized JSON value, validating it and dropping
+// insignificant whitespace. Returns false (without writing) if it is not
+// a single valid JSON value.
+bool json_writer_raw(json_writer_t *w, const char *json);
+
+// Splice a trusted, already-serialized value (e.g. a cached fragment this
+// writer produced earlier) without validating it.
+void json_writer_fragment(json_writer_t *w, const char *json, size_t len);
+
+// Convenience: "key": value pairs
+void json_writer_kv_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_kv_int(json_writer_t *w, const char *key, int value);
+
+// NUL-terminate and report whether the output is complete and well-formed.
+bool json_writer_finish(json_writer_t *w);
+
+// Validate a JSON value without allocating.
+bool json_writer_is_valid(const char *json);
+
+#endif // JSON_WRITER_H
@@ -1,13 +1,16 @@
 #include "llm.h"
 #include "channel.h"
 #include "config.h"
+#include "json_util.h"
 #include "memory.h"
 #include "nvs_keys.h"
 #include "text_buffer.h"
+#include "tls_session.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_tls.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -22,6 +25,8 @@ static const char *TAG = "llm";
 static llm_backend_t s_backend = LLM_BACKEND_OPENAI;
 static char s_api_key[256] = {0};
 static char s_model[64] = {0};
+static char s_summary_model[64] = {0};
+static llm_conn_stats_t s_conn_stats = {0};
 
 #if !CONFIG_ZCLAW_STUB_LLM && !CONFIG_ZCLAW_EMULATOR_LIVE_LLM
 // Context for HTTP response accumulation (thread-safe via user_data)
@@ -30,16 +35,39 @@ typedef struct {
     size_t len;
     size_t max;
     bool truncated;
+    bool connected;     // Fresh TCP/TLS connection opened during this exchange
+    int64_t started_us;
+    uint32_t connect_ms;
+    llm_stream_t *stream;   // Non-NULL when the body is an SSE stream
+    size_t stream_bytes;
 } http_response_ctx_t;
 
+// Long-lived client: kept open across tool rounds and requests so the
+// TLS handshake is only paid when the server drops the connection.
+static esp_http_client_handle_t s_client = NULL;
+static tls_session_t s_tls;                     // Ticket state of s_client
+
+// Stream decoder state (static to keep it off the agent task stack)
+static llm_stream_t s_stream;
+
 // HTTP event handler
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
     http_response_ctx_t *ctx = (http_response_ctx_t *)evt->user_data;
 
     switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            if (ctx) {
+                ctx->connected = true;
+                ctx->connect_ms = (uint32_t)((esp_timer_get_time() - ctx->started_us) / 1000);
+            }
+            break;
         case HTTP_EVENT_ON_DATA:
-            if (ctx && ctx->buf) {
+            // Error bodies are plain JSON even when streaming was requested.
+            if (ctx && ctx->stream && esp_http_client_get_status_code(evt->client) == 200) {
+                llm_stream_feed(ctx->stream, (const char *)evt->data, evt->data_len);
+                ctx->stream_bytes += evt->data_len;
+            } else if (ctx && ctx->buf) {
                 bool ok = text_buffer_append(ctx->buf, &ctx->len, ctx->max,
                                              (const char *)evt->data, evt->data_len);
                 if (!ok && !ctx->truncated) {
@@ -53,6 +81,75 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     }
     return ESP_OK;
 }
+
+// Whether a failed exchange can be sent again without the provider seeing the
+// request twice: the connection was a reused one, nothing came back, and it
+// either failed before the request was written or failed at once because the
+// provider had closed the idle socket. A timeout is never resent, since the
+// request may be running (and streaming text may already have been shown).
+static bool llm_can_resend(const http_response_ctx_t *ctx, esp_err_t err)
+{
+    if (ctx->connected || ctx->len > 0 || ctx->stream_bytes > 0) {
+        return false;
+    }
+    if (err == ESP_ERR_HTTP_CONNECT || err == ESP_ERR_HTTP_WRITE_DATA) {
+        return true;
+    }
+    return esp_timer_get_time() - ctx->started_us < (int64_t)HTTP_STALE_CONN_MS * 1000;
+}
+
+static void llm_client_reset(void)
+{
+    if (s_client) {
+        esp_http_client_cleanup(s_client);
+        s_client = NULL;
+        // The session ticket lived inside the handle.
+        tls_session_forget(&s_tls);
+    }
+}
+
+static esp_err_t llm_client_create(void)
+{
+    esp_http_client_config_t config = {
+        .url = llm_get_api_url(),
+        .event_handler = http_event_handler,
+        .timeout_ms = HTTP_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
+        .keep_alive_idle = LLM_KEEPALIVE_IDLE_S,
+        .keep_alive_interval = LLM_KEEPALIVE_INTERVAL_S,
+        .keep_alive_count = LLM_KEEPALIVE_COUNT,
+    };
+    tls_session_prepare(&config);
+
+    s_client = esp_http_client_init(&config);
+    if (!s_client) {
+        ESP_LOGE(TAG, "Failed to init HTTP client");
+        return ESP_FAIL;
+    }
+
+    // Method and headers persist on the handle across requests.
+    esp_http_client_set_method(s_client, HTTP_METHOD_POST);
+    esp_http_client_set_header(s_client, "Content-Type", "application/json");
+
+    if (s_backend == LLM_BACKEND_ANTHROPIC) {
+        esp_http_client_set_header(s_client, "x-api-key", s_api_key);
+        esp_http_client_set_header(s_client, "anthropic-version", "2023-06-01");
+    } else {
+        // OpenAI and OpenRouter use Bearer token
+        char auth_header[270];
+        snprintf(auth_header, sizeof(auth_header), "Bearer %s", s_api_key);
+        esp_http_client_set_header(s_client, "Authorization", auth_header);
+
+        // OpenRouter needs additional headers
+        if (s_backend == LLM_BACKEND_OPENROUTER) {
+            esp_http_client_set_header(s_client, "HTTP-Referer", "https://github.com/tnm/zclaw");
+            esp_http_client_set_header(s_client, "X-Title", "zclaw");
+        }
+    }
+
+    return ESP_OK;
+}
 #endif
 
 esp_err_t llm_init(void)
@@ -93,8 +190,16 @@ esp_err_t llm_init(void)
         s_model[sizeof(s_model) - 1] = '\0';
     }
 
+    // Summary model (optional, e.g. a cheaper model of the same backend)
+    if (!memory_get(NVS_KEY_LLM_SUM_MODEL, s_summary_model, sizeof(s_summary_model))) {
+        s_summary_model[0] = '\0';
+    }
+
     const char *backend_names[] = {"Anthropic", "OpenAI", "OpenRouter"};
     ESP_LOGI(TAG, "Backend: %s, Model: %s", backend_names[s_backend], s_model);
+    if (s_summary_model[0] != '\0') {
+        ESP_LOGI(TAG, "Summary model: %s", s_summary_model);
+    }
 
 #ifdef CONFIG_ZCLAW_STUB_LLM
     ESP_LOGW(TAG, "LLM stub mode enabled (QEMU testing)");
@@ -149,11 +254,37 @@ const char *llm_get_model(void)
     return s_model;
 }
 
+const char *llm_get_summary_model(void)
+{
+    return s_summary_model[0] != '\0' ? s_summary_model : s_model;
+}
+
 bool llm_is_openai_format(void)
 {
     return s_backend == LLM_BACKEND_OPENAI || s_backend == LLM_BACKEND_OPENROUTER;
 }
 
+bool llm_prompt_cache_enabled(void)
+{
+    return LLM_PROMPT_CACHE_ENABLED && s_backend == LLM_BACKEND_ANTHROPIC;
+}
+
+bool llm_stream_enabled(void)
+{
+#if CONFIG_ZCLAW_STUB_LLM || CONFIG_ZCLAW_EMULATOR_LIVE_LLM
+    return false;
+#else
+    return LLM_STREAMING_ENABLED;
+#endif
+}
+
+void llm_get_conn_stats(llm_conn_stats_t *out)
+{
+    if (out) {
+        *out = s_conn_stats;
+    }
+}
+
 #ifdef CONFIG_ZCLAW_STUB_LLM
 // Stub response for QEMU testing
 static const char *get_stub_response(const char *request_json)
@@ -195,9 +326,35 @@ static const char *get_stub_response(const char *request_json)
 }
 #endif
 
-esp_err_t llm_request(const char *request_json, char *response_buf, size_t response_buf_size)
+// Parse a complete (non-streamed) response body into the parsed response.
+static esp_err_t parse_body(const char *body, char *text_out, size_t text_out_len)
+{
+    char tool_name[32];
+    char tool_id[64];
+    cJSON *tool_input = NULL;
+
+    if (!json_parse_response(body, text_out, text_out_len, tool_name, sizeof(tool_name),
+                             tool_id, sizeof(tool_id), &tool_input)) {
+        ESP_LOGE(TAG, "Failed to parse response");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t llm_request(const char *request_json, char *response_buf, size_t response_buf_size,
+                      char *text_out, size_t text_out_len)
+{
+    return llm_request_stream(request_json, response_buf, response_buf_size,
+                              text_out, text_out_len, NULL, NULL);
+}
+
+esp_err_t llm_request_stream(const char *request_json, char *response_buf, size_t response_buf_size,
+                             char *text_out, size_t text_out_len,
+                             llm_stream_text_cb_t on_text, void *user_ctx)
 {
 #if CONFIG_ZCLAW_EMULATOR_LIVE_LLM
+    (void)on_text;
+    (void)user_ctx;
     // In emulator bridge mode, delegate HTTPS API calls to a host-side proxy.
     esp_err_t bridge_err = channel_llm_bridge_exchange(request_json, response_buf, response_buf_size,
                                                        HTTP_TIMEOUT_MS + 30000);
@@ -206,88 +363,116 @@ esp_err_t llm_request(const char *request_json, char *response_buf, size_t respo
         return bridge_err;
     }
     ESP_LOGI(TAG, "Host bridge response: %d bytes", (int)strlen(response_buf));
-    return ESP_OK;
+    return parse_body(response_buf, text_out, text_out_len);
 #elif defined(CONFIG_ZCLAW_STUB_LLM)
+    (void)on_text;
+    (void)user_ctx;
     const char *stub = get_stub_response(request_json);
     strncpy(response_buf, stub, response_buf_size - 1);
     response_buf[response_buf_size - 1] = '\0';
     ESP_LOGI(TAG, "Stub response: %d bytes", (int)strlen(response_buf));
-    return ESP_OK;
+    return parse_body(response_buf, text_out, text_out_len);
 #else
     if (s_api_key[0] == '\0') {
         ESP_LOGE(TAG, "No API key configured");
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Thread-safe response context
-    http_response_ctx_t ctx = {
-        .buf = response_buf,
-        .len = 0,
-        .max = response_buf_size,
-        .truncated = false
-    };
-    response_buf[0] = '\0';
-
-    esp_http_client_config_t config = {
-        .url = llm_get_api_url(),
-        .event_handler = http_event_handler,
-        .user_data = &ctx,
-        .timeout_ms = HTTP_TIMEOUT_MS,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
+    const char *backend_names[] = {"Anthropic", "OpenAI", "OpenRouter"};
+    http_response_ctx_t ctx;
+    esp_err_t err = ESP_FAIL;
+
+    // A kept-alive socket may have been closed by the provider while idle; the
+    // exchange then fails at once. Retry once on a fresh connection before
+    // giving up (see llm_can_resend).
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!s_client && llm_client_create() != ESP_OK) {
+            return ESP_FAIL;
+        }
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to init HTTP client");
-        return ESP_FAIL;
-    }
+        ctx = (http_response_ctx_t){
+            .buf = response_buf,
+            .len = 0,
+            .max = response_buf_size,
+            .truncated = false,
+            .connected = false,
+            .started_us = esp_timer_get_time(),
+            .connect_ms = 0,
+            .stream = NULL,
+            .stream_bytes = 0,
+        };
+        response_buf[0] = '\0';
+        if (llm_stream_enabled()) {
+            llm_stream_init(&s_stream, llm_is_openai_format(), text_out, text_out_len,
+                            on_text, user_ctx);
+            ctx.stream = &s_stream;
+        }
 
-    // Set common headers
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
+        esp_http_client_set_user_data(s_client, &ctx);
+        esp_http_client_set_post_field(s_client, request_json, strlen(request_json));
+
+        ESP_LOGI(TAG, "Sending request to %s...", backend_names[s_backend]);
+        err = esp_http_client_perform(s_client);
+        s_conn_stats.requests++;
+        if (ctx.connected) {
+            s_conn_stats.new_connections++;
+            s_conn_stats.connect_ms_total += ctx.connect_ms;
+            if (tls_session_record_connect(&s_tls, llm_get_api_url(), ctx.connect_ms)) {
+                s_conn_stats.ticket_offers++;
+            }
+        } else {
+            s_conn_stats.reused_connections++;
+        }
 
-    // Set backend-specific headers
-    if (s_backend == LLM_BACKEND_ANTHROPIC) {
-        esp_http_client_set_header(client, "x-api-key", s_api_key);
-        esp_http_client_set_header(client, "anthropic-version", "2023-06-01");
-    } else {
-        // OpenAI and OpenRouter use Bearer token
-        char auth_header[270];
-        snprintf(auth_header, sizeof(auth_header), "Bearer %s", s_api_key);
-        esp_http_client_set_header(client, "Authorization", auth_header);
+        if (err == ESP_OK) {
+            break;
+        }
 
-        // OpenRouter needs additional headers
-        if (s_backend == LLM_BACKEND_OPENROUTER) {
-            esp_http_client_set_header(client, "HTTP-Referer", "https://github.com/tnm/zclaw");
-            esp_http_client_set_header(client, "X-Title", "zclaw");
+        if (attempt == 0 && llm_can_resend(&ctx, err)) {
+            // Close only the socket: the handle keeps its session ticket, so
+            // the reconnect can use an abbreviated handshake.
+            s_conn_stats.reconnects++;
+            ESP_LOGW(TAG, "Kept-alive connection failed (%s), reconnecting",
+                     esp_err_to_name(err));
+            esp_http_client_close(s_client);
+            continue;
         }
+        llm_client_reset();
+        break;
     }
 
-    // Set body
-    esp_http_client_set_post_field(client, request_json, strlen(request_json));
-
-    const char *backend_names[] = {"Anthropic", "OpenAI", "OpenRouter"};
-    ESP_LOGI(TAG, "Sending request to %s...", backend_names[s_backend]);
-
-    esp_err_t err = esp_http_client_perform(client);
-
     if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Response: %d, %d bytes", status, (int)ctx.len);
+        int status = esp_http_client_get_status_code(s_client);
+        ESP_LOGI(TAG, "Response: %d, %d bytes (%s connection%s)", status,
+                 (int)(ctx.stream ? ctx.stream_bytes : ctx.len),
+                 ctx.connected ? "new" : "reused", ctx.stream ? ", streamed" : "");
 
         if (status != 200) {
             ESP_LOGE(TAG, "API error: %s", response_buf);
             err = ESP_FAIL;
+        } else if (ctx.stream) {
+            // The events were decoded as they arrived; only the tail is left.
+            if (!llm_stream_finish(ctx.stream)) {
+                ESP_LOGE(TAG, "Streamed response incomplete");
+                err = ESP_FAIL;
+            } else if (ctx.stream->truncated) {
+                ESP_LOGE(TAG, "LLM response truncated");
+                err = ESP_ERR_NO_MEM;
+            }
         } else if (ctx.truncated) {
             ESP_LOGE(TAG, "LLM response truncated");
             err = ESP_ERR_NO_MEM;
+        } else {
+            err = parse_body(response_buf, text_out, text_out_len);
         }
+
+        // Keep the connection open, but drop references to caller-owned buffers.
+        esp_http_client_set_post_field(s_client, NULL, 0);
+        esp_http_client_set_user_data(s_client, NULL);
     } else {
         ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
-
     return err;
 #endif
 }
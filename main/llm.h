@@ -2,18 +2,48 @@
 #define LLM_H
 
 #include "config.h"
+#include "llm_stream.h"
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+// Connection reuse counters for the long-lived LLM HTTPS client
+typedef struct {
+    uint32_t requests;              // HTTP exchanges attempted
+    uint32_t new_connections;       // Exchanges that opened a fresh TCP/TLS connection
+    uint32_t reused_connections;    // Exchanges served over a kept-alive connection
+    uint32_t reconnects;            // Stale kept-alive connections replaced mid-request
+    uint32_t ticket_offers;         // New connections that offered a cached TLS session ticket
+                                    // (the server may still have made a full handshake)
+    uint32_t connect_ms_total;      // Time spent in DNS + TCP + TLS setup for new connections
+} llm_conn_stats_t;
 
 // Initialize the LLM HTTP client
 esp_err_t llm_init(void);
 
-// Send a request to LLM API
+// Send a request to LLM API and parse the reply
 // request_json: the complete API request body (format depends on backend)
-// response_buf: buffer to store the response
-// response_buf_size: size of response buffer
-// Returns ESP_OK on success
-esp_err_t llm_request(const char *request_json, char *response_buf, size_t response_buf_size);
+// response_buf: buffer for the raw response body
+// text_out: receives the response text (or "API Error: ..." from the provider)
+// Tool calls and token usage are then available from json_get_tool_calls() and
+// json_get_last_usage() until json_free_parsed_response().
+// Returns ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the body did not parse
+esp_err_t llm_request(const char *request_json, char *response_buf, size_t response_buf_size,
+                      char *text_out, size_t text_out_len);
+
+// Same as llm_request(), but when streaming is enabled on_text receives text
+// fragments while the response is still arriving. The events are decoded
+// straight into text_out and the parsed response, so response_buf then only
+// receives error bodies (LLM_STREAM_ERROR_BUF_SIZE is enough).
+esp_err_t llm_request_stream(const char *request_json, char *response_buf, size_t response_buf_size,
+                             char *text_out, size_t text_out_len,
+                             llm_stream_text_cb_t on_text, void *user_ctx);
+
+// True when requests ask the API for a server-sent event stream
+bool llm_stream_enabled(void);
+
+// True when requests carry Anthropic cache_control breakpoints
+bool llm_prompt_cache_enabled(void);
 
 // Check if we're in stub mode (QEMU testing)
 bool llm_is_stub_mode(void);
@@ -30,7 +60,13 @@ const char *llm_get_default_model(void);
 // Get current model (user-configured or default)
 const char *llm_get_model(void);
 
+// Model for history summaries (user-configured cheaper model, or the current model)
+const char *llm_get_summary_model(void);
+
 // Check if backend uses OpenAI-compatible format (OpenAI, OpenRouter)
 bool llm_is_openai_format(void);
 
+// Snapshot cumulative connection reuse counters (zero in stub/bridge modes)
+void llm_get_conn_stats(llm_conn_stats_t *out);
+
 #endif // LLM_H
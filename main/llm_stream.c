@@ -0,0 +1,492 @@
+#include "llm_stream.h"
+#include "json_util.h"
+#include "json_pull.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "llm_stream";
+
+// Walk the object in json, noting where the named members are (spans of
+// absent members stay empty). Returns false if json is not a valid object.
+static bool find_members(const char *json, size_t len, const char *const names[],
+                         json_span_t spans[], int count)
+{
+    json_pull_t pull;
+    json_span_t key;
+
+    memset(spans, 0, count * sizeof(spans[0]));
+    json_pull_init(&pull, json, json ? len : 0);
+    if (json_pull_peek(&pull) != '{') {
+        return false;
+    }
+    json_pull_object_begin(&pull);
+    while (json_pull_next_key(&pull, &key)) {
+        json_span_t *slot = NULL;
+        for (int i = 0; i < count && !slot; i++) {
+            if (json_span_eq(&key, names[i])) {
+                slot = &spans[i];
+            }
+        }
+        json_pull_skip(&pull, slot);
+    }
+    return json_pull_at_end(&pull);
+}
+
+static bool span_is_string(const json_span_t *span)
+{
+    return span->ptr && span->len >= 2 && span->ptr[0] == '"';
+}
+
+// True if span is the string value (without quotes).
+static bool span_is(const json_span_t *span, const char *value)
+{
+    size_t len = strlen(value);
+    return span_is_string(span) && span->len == len + 2 && memcmp(span->ptr + 1, value, len) == 0;
+}
+
+// Integer value of span; 0 when absent or not a number.
+static int span_index(const json_span_t *span)
+{
+    json_pull_t pull;
+    uint32_t value = 0;
+
+    json_pull_init(&pull, span->ptr, span->ptr ? span->len : 0);
+    json_pull_uint32(&pull, &value);
+    return value > INT32_MAX ? INT32_MAX : (int)value;
+}
+
+static void mark_truncated(llm_stream_t *stream, const char *what)
+{
+    if (!stream->truncated) {
+        stream->truncated = true;
+        ESP_LOGW(TAG, "Streamed %s truncated", what);
+    }
+}
+
+// Decode a string span onto the end of buf (len < size, NUL-terminated).
+// Returns the number of bytes added; *cut is set if the rest did not fit.
+static size_t append_string(const json_span_t *span, char *buf, size_t *len, size_t size,
+                            bool *cut)
+{
+    size_t space = size - *len;
+    size_t added = json_span_decode_string(span, buf + *len, space);
+
+    // Decoding never makes a string longer, so a full buffer only loses text
+    // when the raw string was longer than what fit.
+    *cut = added + 1 == space && span->len - 2 > added;
+    *len += added;
+    return added;
+}
+
+// Text beyond the caller's buffer is dropped, as json_parse_response() cuts
+// it: the reply is shorter, but the response is still complete.
+static void emit_text(llm_stream_t *stream, const json_span_t *span)
+{
+    bool cut;
+
+    if (!span_is_string(span)) {
+        return;
+    }
+    char *fragment = stream->text + stream->text_len;
+    size_t added = append_string(span, stream->text, &stream->text_len, stream->text_size, &cut);
+    if (cut && !stream->text_truncated) {
+        stream->text_truncated = true;
+        ESP_LOGW(TAG, "Streamed text truncated at %d bytes", (int)stream->text_len);
+    }
+    if (added > 0 && stream->on_text) {
+        stream->on_text(fragment, stream->user_ctx);
+    }
+}
+
+static void record_error(llm_stream_t *stream, const json_span_t *error)
+{
+    static const char *const names[] = {"message"};
+    json_span_t message;
+
+    if (find_members(error->ptr, error->len, names, &message, 1) && span_is_string(&message)) {
+        json_span_decode_string(&message, stream->error, sizeof(stream->error));
+    } else {
+        snprintf(stream->error, sizeof(stream->error), "unknown");
+    }
+    stream->done = true;
+}
+
+// -----------------------------------------------------------------------------
+// Tool calls
+// -----------------------------------------------------------------------------
+
+static llm_stream_tool_t *find_tool(llm_stream_t *stream, int index)
+{
+    for (int i = 0; i < stream->tool_count; i++) {
+        if (stream->tools[i].index == index) {
+            return &stream->tools[i];
+        }
+    }
+    return NULL;
+}
+
+static llm_stream_tool_t *open_tool(llm_stream_t *stream, int index)
+{
+    json_tool_call_t *call;
+
+    if (stream->tool_count >= MAX_TOOL_CALLS_PER_RESPONSE ||
+        !(call = json_response_add_tool_call())) {
+        return NULL;
+    }
+    llm_stream_tool_t *tool = &stream->tools[stream->tool_count++];
+    tool->call = call;
+    tool->index = index;
+    tool->input_start = stream->tool_input_len;
+    tool->input_len = 0;
+    return tool;
+}
+
+// Fill in a name or id the first time the stream carries it.
+static void set_once(char *field, size_t size, const json_span_t *span)
+{
+    if (field[0] == '\0' && span_is_string(span)) {
+        json_span_decode_string(span, field, size);
+    }
+}
+
+static void reverse(char *p, size_t len)
+{
+    for (size_t i = 0; i < len / 2; i++) {
+        char c = p[i];
+        p[i] = p[len - 1 - i];
+        p[len - 1 - i] = c;
+    }
+}
+
+// Add a fragment of raw input JSON. The inputs lie in tool_input in the order
+// of tools[]. Fragments of parallel OpenAI calls may interleave; the fragment
+// is then moved down in front of the later calls' input.
+static void append_tool_input(llm_stream_t *stream, llm_stream_tool_t *tool,
+                              const json_span_t *span)
+{
+    if (!tool || !span_is_string(span)) {
+        return;
+    }
+
+    size_t end = tool->input_start + tool->input_len;
+    size_t tail = stream->tool_input_len - end;
+    bool cut;
+    size_t added = append_string(span, stream->tool_input, &stream->tool_input_len,
+                                 sizeof(stream->tool_input), &cut);
+    if (cut) {
+        mark_truncated(stream, "tool input");
+    }
+    if (tail > 0 && added > 0) {
+        reverse(stream->tool_input + end, tail);
+        reverse(stream->tool_input + end + tail, added);
+        reverse(stream->tool_input + end, tail + added);
+        for (llm_stream_tool_t *later = tool + 1; later < stream->tools + stream->tool_count;
+             later++) {
+            later->input_start += added;
+        }
+    }
+    tool->input_len += added;
+}
+
+// Parse the complete input into the call and give its buffer space back.
+static void close_tool(llm_stream_t *stream, llm_stream_tool_t *tool)
+{
+    // An empty input stream means the tool takes no input. Input that does
+    // not parse was cut off: the call must not run with a default.
+    cJSON *input = NULL;
+    if (tool->input_len > 0) {
+        input = cJSON_ParseWithLength(stream->tool_input + tool->input_start, tool->input_len);
+        if (!input) {
+            ESP_LOGW(TAG, "Streamed tool input is not valid JSON");
+            stream->bad_tool_input = true;
+        }
+    }
+    tool->call->input = input ? input : cJSON_CreateObject();
+
+    size_t start = tool->input_start;
+    size_t len = tool->input_len;
+    memmove(stream->tool_input + start, stream->tool_input + start + len,
+            stream->tool_input_len - start - len);
+    stream->tool_input_len -= len;
+
+    int slot = (int)(tool - stream->tools);
+    memmove(&stream->tools[slot], &stream->tools[slot + 1],
+            (stream->tool_count - slot - 1) * sizeof(stream->tools[0]));
+    stream->tool_count--;
+    for (int i = slot; i < stream->tool_count; i++) {
+        stream->tools[i].input_start -= len;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Anthropic events (message_start, content_block_*, message_delta, ...)
+// -----------------------------------------------------------------------------
+
+enum { AN_TYPE, AN_INDEX, AN_MESSAGE, AN_BLOCK, AN_DELTA, AN_USAGE, AN_ERROR, AN_COUNT };
+static const char *const s_anthropic_members[AN_COUNT] = {
+    "type", "index", "message", "content_block", "delta", "usage", "error",
+};
+
+static void handle_anthropic_event(llm_stream_t *stream, const json_span_t ev[])
+{
+    const json_span_t *type = &ev[AN_TYPE];
+    int index = span_index(&ev[AN_INDEX]);
+
+    if (span_is(type, "content_block_delta")) {
+        // delta: {type, text | partial_json}
+        static const char *const names[] = {"type", "text", "partial_json"};
+        json_span_t delta[3];
+        find_members(ev[AN_DELTA].ptr, ev[AN_DELTA].len, names, delta, 3);
+        if (span_is(&delta[0], "text_delta")) {
+            emit_text(stream, &delta[1]);
+        } else if (span_is(&delta[0], "input_json_delta")) {
+            append_tool_input(stream, find_tool(stream, index), &delta[2]);
+        }
+    } else if (span_is(type, "content_block_start")) {
+        static const char *const names[] = {"type", "id", "name"};
+        json_span_t block[3];
+        find_members(ev[AN_BLOCK].ptr, ev[AN_BLOCK].len, names, block, 3);
+        if (span_is(&block[0], "tool_use")) {
+            llm_stream_tool_t *tool = open_tool(stream, index);
+            if (tool) {
+                set_once(tool->call->id, sizeof(tool->call->id), &block[1]);
+                set_once(tool->call->name, sizeof(tool->call->name), &block[2]);
+            }
+        }
+    } else if (span_is(type, "content_block_stop")) {
+        llm_stream_tool_t *tool = find_tool(stream, index);
+        if (tool) {
+            close_tool(stream, tool);
+        }
+    } else if (span_is(type, "message_start")) {
+        // message_start carries the input side of the usage, message_delta
+        // the (cumulative) output.
+        static const char *const names[] = {"usage"};
+        json_span_t usage;
+        find_members(ev[AN_MESSAGE].ptr, ev[AN_MESSAGE].len, names, &usage, 1);
+        if (usage.ptr) {
+            json_response_add_usage(usage.ptr, usage.len);
+        }
+    } else if (span_is(type, "message_delta")) {
+        static const char *const names[] = {"stop_reason"};
+        json_span_t stop_reason;
+        find_members(ev[AN_DELTA].ptr, ev[AN_DELTA].len, names, &stop_reason, 1);
+        if (span_is_string(&stop_reason)) {
+            json_span_decode_string(&stop_reason, stream->stop_reason, sizeof(stream->stop_reason));
+        }
+        if (ev[AN_USAGE].ptr) {
+            json_response_add_usage(ev[AN_USAGE].ptr, ev[AN_USAGE].len);
+        }
+    } else if (span_is(type, "message_stop")) {
+        stream->done = true;
+    } else if (span_is(type, "error")) {
+        record_error(stream, &ev[AN_ERROR]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// OpenAI chunks (choices[0].delta)
+// -----------------------------------------------------------------------------
+
+enum { OA_ERROR, OA_USAGE, OA_CHOICES, OA_COUNT };
+static const char *const s_openai_members[OA_COUNT] = {"error", "usage", "choices"};
+
+// One entry of delta.tool_calls. Parallel calls are told apart by index;
+// fragments of one call share it.
+static void handle_openai_tool_call(llm_stream_t *stream, const json_span_t *item)
+{
+    static const char *const names[] = {"index", "id", "function"};
+    static const char *const func_names[] = {"name", "arguments"};
+    json_span_t tc[3];
+    json_span_t func[2];
+
+    if (!find_members(item->ptr, item->len, names, tc, 3)) {
+        return;
+    }
+    find_members(tc[2].ptr, tc[2].len, func_names, func, 2);
+
+    int index = span_index(&tc[0]);
+    llm_stream_tool_t *tool = find_tool(stream, index);
+    if (!tool && !(tool = open_tool(stream, index))) {
+        return;
+    }
+    set_once(tool->call->id, sizeof(tool->call->id), &tc[1]);
+    set_once(tool->call->name, sizeof(tool->call->name), &func[0]);
+    append_tool_input(stream, tool, &func[1]);
+}
+
+static void handle_openai_event(llm_stream_t *stream, const json_span_t ev[])
+{
+    if (ev[OA_ERROR].ptr) {
+        record_error(stream, &ev[OA_ERROR]);
+        return;
+    }
+
+    // Sent in a final chunk with empty choices when stream_options.include_usage
+    // is set.
+    if (ev[OA_USAGE].ptr && ev[OA_USAGE].ptr[0] == '{') {
+        json_response_add_usage(ev[OA_USAGE].ptr, ev[OA_USAGE].len);
+    }
+
+    json_pull_t choices;
+    json_span_t choice = {0};
+    json_pull_init(&choices, ev[OA_CHOICES].ptr, ev[OA_CHOICES].ptr ? ev[OA_CHOICES].len : 0);
+    if (json_pull_peek(&choices) != '[' || !json_pull_array_begin(&choices) ||
+        !json_pull_next_item(&choices) || !json_pull_skip(&choices, &choice)) {
+        return;
+    }
+
+    static const char *const choice_names[] = {"delta", "finish_reason"};
+    static const char *const delta_names[] = {"content", "tool_calls"};
+    json_span_t ch[2];
+    json_span_t delta[2];
+    find_members(choice.ptr, choice.len, choice_names, ch, 2);
+    if (span_is_string(&ch[1])) {
+        json_span_decode_string(&ch[1], stream->stop_reason, sizeof(stream->stop_reason));
+    }
+    if (!find_members(ch[0].ptr, ch[0].len, delta_names, delta, 2)) {
+        return;
+    }
+
+    // Text content (null while the model calls tools)
+    emit_text(stream, &delta[0]);
+
+    json_pull_t calls;
+    json_pull_init(&calls, delta[1].ptr, delta[1].ptr ? delta[1].len : 0);
+    if (json_pull_peek(&calls) == '[') {
+        json_pull_array_begin(&calls);
+        while (json_pull_next_item(&calls)) {
+            json_span_t item;
+            if (json_pull_skip(&calls, &item)) {
+                handle_openai_tool_call(stream, &item);
+            }
+        }
+    }
+}
+
+static void handle_line(llm_stream_t *stream, char *line, size_t len)
+{
+    // Strip CR from CRLF line endings
+    if (len > 0 && line[len - 1] == '\r') {
+        line[--len] = '\0';
+    }
+
+    // Only data lines carry payload; "event:" names are repeated in the JSON
+    // and ":" lines are keep-alive comments.
+    if (strncmp(line, "data:", 5) != 0) {
+        return;
+    }
+    const char *payload = line + 5;
+    if (*payload == ' ') {
+        payload++;
+    }
+
+    if (strcmp(payload, "[DONE]") == 0) {
+        stream->done = true;
+        return;
+    }
+
+    // Members are located in place first and only acted on if the whole
+    // event is well-formed.
+    json_span_t ev[AN_COUNT];       // Anthropic events have the most members
+    size_t payload_len = len - (size_t)(payload - line);
+    bool ok = stream->openai_format
+        ? find_members(payload, payload_len, s_openai_members, ev, OA_COUNT)
+        : find_members(payload, payload_len, s_anthropic_members, ev, AN_COUNT);
+    if (!ok) {
+        ESP_LOGW(TAG, "Skipping malformed stream event (%d bytes)", (int)len);
+        return;
+    }
+    stream->events++;
+
+    if (stream->openai_format) {
+        handle_openai_event(stream, ev);
+    } else {
+        handle_anthropic_event(stream, ev);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Public API
+// -----------------------------------------------------------------------------
+
+void llm_stream_init(llm_stream_t *stream, bool openai_format, char *text_out, size_t text_out_len,
+                     llm_stream_text_cb_t on_text, void *user_ctx)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->openai_format = openai_format;
+    stream->on_text = on_text;
+    stream->user_ctx = user_ctx;
+    stream->text = text_out;
+    stream->text_size = text_out_len;
+    text_out[0] = '\0';
+    json_response_begin();
+}
+
+void llm_stream_feed(llm_stream_t *stream, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+
+        if (c == '\n') {
+            if (stream->line_overflow) {
+                ESP_LOGW(TAG, "Dropped stream line longer than %d bytes",
+                         (int)(sizeof(stream->line) - 1));
+                stream->truncated = true;
+            } else {
+                stream->line[stream->line_len] = '\0';
+                handle_line(stream, stream->line, stream->line_len);
+            }
+            stream->line_len = 0;
+            stream->line_overflow = false;
+            continue;
+        }
+
+        if (stream->line_len + 1 >= sizeof(stream->line)) {
+            stream->line_overflow = true;
+            continue;
+        }
+        stream->line[stream->line_len++] = c;
+    }
+}
+
+bool llm_stream_finish(llm_stream_t *stream)
+{
+    // A final event without a trailing newline is still complete.
+    if (stream->line_len > 0 && !stream->line_overflow) {
+        stream->line[stream->line_len] = '\0';
+        handle_line(stream, stream->line, stream->line_len);
+        stream->line_len = 0;
+    }
+
+    // Without a terminal event an open call may have lost the end of its
+    // input, so the response is not acted on.
+    bool cut_off = !stream->done && stream->tool_count > 0;
+
+    // OpenAI calls are complete only now.
+    while (stream->tool_count > 0) {
+        close_tool(stream, &stream->tools[0]);
+    }
+
+    if (stream->events == 0) {
+        ESP_LOGE(TAG, "No events in streamed response");
+        return false;
+    }
+    if (cut_off || stream->bad_tool_input) {
+        ESP_LOGE(TAG, "Stream ended inside a tool call");
+        json_free_parsed_response();
+        return false;
+    }
+    if (!stream->done) {
+        ESP_LOGW(TAG, "Stream ended without a terminal event");
+    }
+
+    // Same as an error body: no calls, the message as the text.
+    if (stream->error[0] != '\0') {
+        json_free_parsed_response();
+        snprintf(stream->text, stream->text_size, "API Error: %s", stream->error);
+    }
+    return true;
+}
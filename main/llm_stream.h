@@ -0,0 +1,78 @@
+#ifndef LLM_STREAM_H
+#define LLM_STREAM_H
+
+#include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Token usage reported by the provider for one response
+typedef struct {
+    uint32_t input_tokens;          // Input tokens processed without the prompt cache
+    uint32_t output_tokens;
+    uint32_t cache_read_tokens;     // Input tokens served from the prompt cache
+    uint32_t cache_write_tokens;    // Input tokens written to the prompt cache
+} llm_usage_t;
+
+struct json_tool_call;
+
+// A tool call still streaming. The call itself is filled in place in the
+// parsed response (json_util.h); only its raw input JSON is buffered here,
+// until the call is complete and the input can be parsed.
+typedef struct {
+    struct json_tool_call *call;
+    int index;                      // Content block (Anthropic) / tool call index (OpenAI)
+    size_t input_start;             // Raw input in llm_stream_t.tool_input
+    size_t input_len;
+} llm_stream_tool_t;
+
+// Called with each text fragment as soon as it is decoded from the stream.
+typedef void (*llm_stream_text_cb_t)(const char *text, void *user_ctx);
+
+// Incremental server-sent events decoder for Anthropic and OpenAI-format
+// streaming responses. Events are read in place from the current line; text
+// goes straight to the caller's buffer and tool calls and usage to the parsed
+// response (json_get_tool_calls(), json_get_last_usage()), so the raw event
+// stream is never kept and no response body is assembled.
+typedef struct {
+    bool openai_format;
+    llm_stream_text_cb_t on_text;
+    void *user_ctx;
+
+    char line[LLM_STREAM_LINE_BUF_SIZE];
+    size_t line_len;
+    bool line_overflow;             // Current line exceeded the line buffer
+
+    char *text;                     // Caller's buffer
+    size_t text_size;
+    size_t text_len;
+    char tool_input[LLM_STREAM_TOOL_INPUT_SIZE];
+    size_t tool_input_len;
+    llm_stream_tool_t tools[MAX_TOOL_CALLS_PER_RESPONSE];
+    int tool_count;                 // Calls whose input is still buffered
+    char stop_reason[32];
+    char error[256];
+
+    bool done;                      // Terminal event seen (message_stop / [DONE])
+    bool truncated;                 // Tool input or an event was dropped: the response is unusable
+    bool text_truncated;            // Text beyond text_size was dropped (not an error)
+    bool bad_tool_input;            // A call's input did not parse (cut off)
+    size_t events;
+} llm_stream_t;
+
+// Reset the decoder and the parsed response for a new response. The text is
+// written to text_out (NUL-terminated at all times).
+void llm_stream_init(llm_stream_t *stream, bool openai_format, char *text_out, size_t text_out_len,
+                     llm_stream_text_cb_t on_text, void *user_ctx);
+
+// Feed raw body bytes as they arrive (any split is fine).
+void llm_stream_feed(llm_stream_t *stream, const char *data, size_t len);
+
+// Complete the parsed response: decode a final unterminated line, parse the
+// inputs of the tool calls still open, and turn an error event into the
+// "API Error: ..." text json_parse_response() gives. Returns false, with no
+// tool calls left, if no event was received or a call was cut off: the stream
+// ended inside it without a terminal event, or its input does not parse.
+bool llm_stream_finish(llm_stream_t *stream);
+
+#endif // LLM_STREAM_H
@@ -2,6 +2,9 @@
 #include "memory.h"
 #include "channel.h"
 #include "agent.h"
+#include "messages.h"
+#include "msg_pool.h"
+#include "buffers.h"
 #include "llm.h"
 #include "tools.h"
 #include "telegram.h"
@@ -423,9 +426,11 @@ void app_main(void)
     tools_init();
     channel_init();
 
-    QueueHandle_t input_queue = xQueueCreate(INPUT_QUEUE_LENGTH, CHANNEL_RX_BUF_SIZE);
-    QueueHandle_t channel_output_queue = xQueueCreate(OUTPUT_QUEUE_LENGTH, CHANNEL_RX_BUF_SIZE);
-    if (!input_queue || !channel_output_queue) {
+    QueueHandle_t input_queue = buffer_queue_create("input_queue", INPUT_QUEUE_LENGTH,
+                                                    sizeof(agent_msg_t));
+    QueueHandle_t channel_output_queue = buffer_queue_create("channel_queue", OUTPUT_QUEUE_LENGTH,
+                                                             sizeof(channel_msg_t));
+    if (!msg_pool_init() || !input_queue || !channel_output_queue) {
         ESP_LOGE(TAG, "Failed to create emulator queues");
         esp_restart();
     }
@@ -439,6 +444,7 @@ void app_main(void)
     if (startup_err != ESP_OK) {
         fail_fast_startup("agent_start", startup_err);
     }
+    buffer_report();
 
     channel_write("\r\nzclaw emulator ready. Type a message and press Enter.\r\n\r\n");
 
@@ -506,8 +512,10 @@ void app_main(void)
     channel_init();
 
     // 13. Create queues
-    QueueHandle_t input_queue = xQueueCreate(INPUT_QUEUE_LENGTH, CHANNEL_RX_BUF_SIZE);
-    QueueHandle_t channel_output_queue = xQueueCreate(OUTPUT_QUEUE_LENGTH, CHANNEL_RX_BUF_SIZE);
+    QueueHandle_t input_queue = buffer_queue_create("input_queue", INPUT_QUEUE_LENGTH,
+                                                    sizeof(agent_msg_t));
+    QueueHandle_t channel_output_queue = buffer_queue_create("channel_queue", OUTPUT_QUEUE_LENGTH,
+                                                             sizeof(channel_msg_t));
     QueueHandle_t telegram_output_queue = NULL;
 #if CONFIG_ZCLAW_STUB_TELEGRAM
     bool telegram_enabled = false;
@@ -515,10 +523,12 @@ void app_main(void)
     bool telegram_enabled = telegram_is_configured();
 #endif
     if (telegram_enabled) {
-        telegram_output_queue = xQueueCreate(TELEGRAM_OUTPUT_QUEUE_LENGTH, TELEGRAM_MAX_MSG_LEN);
+        telegram_output_queue = buffer_queue_create("telegram_queue", TELEGRAM_OUTPUT_QUEUE_LENGTH,
+                                                    sizeof(telegram_msg_t));
     }
 
-    if (!input_queue || !channel_output_queue || (telegram_enabled && !telegram_output_queue)) {
+    if (!msg_pool_init() || !input_queue || !channel_output_queue ||
+        (telegram_enabled && !telegram_output_queue)) {
         ESP_LOGE(TAG, "Failed to create queues");
         esp_restart();
     }
@@ -550,6 +560,7 @@ void app_main(void)
     }
 
     // 18. Print ready message
+    buffer_report();
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "  Ready! Free heap: %lu bytes", esp_get_free_heap_size());
@@ -20,6 +20,7 @@ bool memory_keys_is_sensitive(const char *key)
         NVS_KEY_WIFI_PASS,
         NVS_KEY_LLM_BACKEND,
         NVS_KEY_LLM_MODEL,
+        NVS_KEY_LLM_SUM_MODEL,
         NVS_KEY_WIFI_SSID,
         NULL
     };
@@ -2,15 +2,53 @@
 #define MESSAGES_H
 
 #include "config.h"
+#include "msg_pool.h"
+#include <stdint.h>
 
-// Shared queue payload for local channel and inbound agent messages.
+// Queue payloads carry their text as a msg_pool buffer. Each queued message
+// owns one reference: the receiver releases it, and so does a sender whose
+// xQueueSend fails.
+
+// Shared queue payload for local channel output.
 typedef struct {
-    char text[CHANNEL_RX_BUF_SIZE];
+    msg_buf_t *text;
 } channel_msg_t;
 
+// Where an inbound agent message came from; each origin has its own session.
+typedef enum {
+    MSG_SOURCE_SERIAL = 0,
+    MSG_SOURCE_TELEGRAM,
+    MSG_SOURCE_CRON,
+} msg_source_t;
+
+// Scheduling class of an inbound agent message; lower classes run first.
+typedef enum {
+    MSG_CLASS_INTERACTIVE = 0,      // A person is waiting (serial, Telegram)
+    MSG_CLASS_AUTOMATION,           // Scheduled for a point in time (daily, one-shot cron)
+    MSG_CLASS_BACKGROUND,           // Recurring work (periodic cron)
+    MSG_CLASS_COUNT,
+} msg_class_t;
+
+// Queue payload for inbound agent messages.
+typedef struct {
+    msg_source_t source;
+    msg_class_t msg_class;
+    int64_t source_id;              // Telegram chat ID, cron entry ID, 0 for serial
+    int64_t enqueued_us;            // esp_timer time the producer queued it
+    msg_buf_t *text;                // At most INPUT_MAX_LEN bytes
+} agent_msg_t;
+
+// What the Telegram send task does with an outbound message.
+typedef enum {
+    TELEGRAM_MSG_TEXT = 0,          // New message, or the final text of the open reply
+    TELEGRAM_MSG_REPLY_START,       // Post a placeholder and keep it open for edits
+    TELEGRAM_MSG_REPLY_PROGRESS,    // Replace the open reply's text (rate limited, may be skipped)
+} telegram_msg_kind_t;
+
 // Shared queue payload for outbound Telegram messages.
 typedef struct {
-    char text[TELEGRAM_MAX_MSG_LEN];
+    telegram_msg_kind_t kind;
+    msg_buf_t *text;
 } telegram_msg_t;
 
 #endif // MESSAGES_H
@@ -0,0 +1,183 @@
+#include "msg_pool.h"
+#include "config.h"
+#include "buffers.h"
+#include "text_buffer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "msg_pool";
+
+// Text bytes per class, NUL included. The largest fits a Telegram message.
+static const uint16_t s_class_sizes[] = {128, 512, MAX_MESSAGE_LEN, TELEGRAM_MAX_MSG_LEN};
+#define MSG_POOL_CLASS_COUNT ((int)(sizeof(s_class_sizes) / sizeof(s_class_sizes[0])))
+
+static SemaphoreHandle_t s_lock;
+static msg_buf_t *s_free[MSG_POOL_CLASS_COUNT];
+static msg_buf_t *s_blocks;                     // Every block taken from the heap
+static msg_pool_stats_t s_stats;
+
+static size_t block_bytes(int size_class)
+{
+    return sizeof(msg_buf_t) + s_class_sizes[size_class];
+}
+
+static void lock(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+// Hand cached free blocks back to the heap so another class can use the
+// budget. Called with the lock held.
+static void trim_free_blocks(void)
+{
+    msg_buf_t **link = &s_blocks;
+    while (*link) {
+        msg_buf_t *block = *link;
+        if (block->refs == 0) {
+            *link = block->next_block;
+            s_stats.bytes_reserved -= block_bytes(block->size_class);
+            free(block);
+        } else {
+            link = &block->next_block;
+        }
+    }
+    memset(s_free, 0, sizeof(s_free));
+}
+
+// Called with the lock held.
+static msg_buf_t *take_block(int size_class)
+{
+    msg_buf_t *block = s_free[size_class];
+    if (block) {
+        s_free[size_class] = block->next_free;
+        return block;
+    }
+
+    size_t bytes = block_bytes(size_class);
+    if (s_stats.bytes_reserved + bytes > MSG_POOL_BYTES) {
+        trim_free_blocks();
+        if (s_stats.bytes_reserved + bytes > MSG_POOL_BYTES) {
+            return NULL;
+        }
+    }
+
+    block = buffer_alloc(NULL, bytes, BUFFER_BULK);
+    if (!block) {
+        return NULL;
+    }
+    block->size_class = (uint8_t)size_class;
+    block->size = s_class_sizes[size_class];
+    block->next_block = s_blocks;
+    s_blocks = block;
+    s_stats.bytes_reserved += bytes;
+    return block;
+}
+
+bool msg_pool_init(void)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+    }
+    return s_lock != NULL;
+}
+
+msg_buf_t *msg_pool_alloc(size_t capacity)
+{
+    int size_class = 0;
+    while (size_class < MSG_POOL_CLASS_COUNT - 1 && capacity + 1 > s_class_sizes[size_class]) {
+        size_class++;
+    }
+
+    lock();
+    msg_buf_t *buf = take_block(size_class);
+    if (buf) {
+        buf->refs = 1;
+        buf->len = 0;
+        buf->text[0] = '\0';
+        buf->next_free = NULL;
+        s_stats.allocs++;
+        s_stats.bytes_in_use += block_bytes(size_class);
+        if (s_stats.bytes_in_use > s_stats.bytes_in_use_peak) {
+            s_stats.bytes_in_use_peak = s_stats.bytes_in_use;
+        }
+    } else {
+        s_stats.failures++;
+    }
+    unlock();
+
+    if (!buf) {
+        ESP_LOGW(TAG, "No room for a %u byte message", (unsigned)capacity);
+    }
+    return buf;
+}
+
+msg_buf_t *msg_pool_copy(const char *text, size_t len)
+{
+    msg_buf_t *buf = msg_pool_alloc(len);
+    if (buf) {
+        msg_pool_append(buf, text, len);
+    }
+    return buf;
+}
+
+bool msg_pool_append(msg_buf_t *buf, const char *text, size_t len)
+{
+    size_t buf_len = buf->len;
+    bool ok = text_buffer_append(buf->text, &buf_len, buf->size, text, len);
+    buf->len = (uint16_t)buf_len;
+    return ok;
+}
+
+msg_buf_t *msg_pool_retain(msg_buf_t *buf)
+{
+    if (buf) {
+        lock();
+        buf->refs++;
+        unlock();
+    }
+    return buf;
+}
+
+void msg_pool_release(msg_buf_t *buf)
+{
+    if (!buf) {
+        return;
+    }
+
+    lock();
+    if (buf->refs > 0 && --buf->refs == 0) {
+        buf->next_free = s_free[buf->size_class];
+        s_free[buf->size_class] = buf;
+        s_stats.bytes_in_use -= block_bytes(buf->size_class);
+    }
+    unlock();
+}
+
+void msg_pool_get_stats(msg_pool_stats_t *stats)
+{
+    lock();
+    *stats = s_stats;
+    unlock();
+}
+
+#ifdef TEST_BUILD
+void msg_pool_test_reset(void)
+{
+    msg_pool_init();
+    while (s_blocks) {
+        msg_buf_t *next = s_blocks->next_block;
+        free(s_blocks);
+        s_blocks = next;
+    }
+    memset(s_free, 0, sizeof(s_free));
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+#endif
@@ -0,0 +1,57 @@
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Shared pool of refcounted, variable-length text buffers for messages passed
+// between tasks. Queues carry a msg_buf_t pointer instead of a fixed-size copy
+// of the text: a reply fans out to the serial and Telegram queues by taking
+// one reference per queue, and each consumer releases its reference when done.
+// Buffers come in a few size classes and are allocated on first use, within
+// MSG_POOL_BYTES. Released buffers go back to their class's free list rather
+// than the heap, so steady message traffic does not fragment it.
+typedef struct msg_buf {
+    struct msg_buf *next_free;      // Pool internal
+    struct msg_buf *next_block;     // Pool internal
+    uint16_t refs;
+    uint16_t size;                  // Bytes available in text, NUL included
+    uint16_t len;                   // Text length
+    uint8_t size_class;
+    char text[];
+} msg_buf_t;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t failures;              // Refused: the pool budget was spent
+    size_t bytes_reserved;          // Taken from the heap (text and headers)
+    size_t bytes_in_use;            // Held by live buffers
+    size_t bytes_in_use_peak;
+} msg_pool_stats_t;
+
+bool msg_pool_init(void);
+
+// Empty buffer with room for at least capacity text bytes plus the NUL, one
+// reference held by the caller. Capacities beyond the largest class
+// (TELEGRAM_MAX_MSG_LEN) are clamped. Returns NULL when the pool budget is spent.
+msg_buf_t *msg_pool_alloc(size_t capacity);
+
+// Buffer holding the first len bytes of text (as much as the largest class fits).
+msg_buf_t *msg_pool_copy(const char *text, size_t len);
+
+// Append to buf's text as far as it fits. Returns false if it was truncated.
+bool msg_pool_append(msg_buf_t *buf, const char *text, size_t len);
+
+// Take another reference (returns buf) / drop one. NULL is ignored.
+msg_buf_t *msg_pool_retain(msg_buf_t *buf);
+void msg_pool_release(msg_buf_t *buf);
+
+void msg_pool_get_stats(msg_pool_stats_t *stats);
+
+#ifdef TEST_BUILD
+// Free every block, referenced or not, and clear the statistics (tests only).
+void msg_pool_test_reset(void);
+#endif
+
+#endif // MSG_POOL_H
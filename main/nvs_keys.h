@@ -8,6 +8,7 @@
 #define NVS_KEY_LLM_BACKEND  "llm_backend"
 #define NVS_KEY_API_KEY      "api_key"
 #define NVS_KEY_LLM_MODEL    "llm_model"
+#define NVS_KEY_LLM_SUM_MODEL "llm_sum_model"
 #define NVS_KEY_TG_TOKEN     "tg_token"
 #define NVS_KEY_TG_CHAT_ID   "tg_chat_id"
 #define NVS_KEY_TIMEZONE     "timezone"
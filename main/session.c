@@ -0,0 +1,153 @@
+#include "session.h"
+#include "buffers.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "session";
+
+typedef struct {
+    history_t *history;             // NULL when the slot is free
+    msg_source_t source;
+    int64_t source_id;
+    uint32_t last_used;             // LRU clock value of the last session_get()
+} session_t;
+
+static session_t s_sessions[SESSION_MAX_COUNT];
+static uint32_t s_clock = 0;
+
+static const char *source_name(msg_source_t source)
+{
+    switch (source) {
+        case MSG_SOURCE_TELEGRAM:
+            return "telegram";
+        case MSG_SOURCE_CRON:
+            return "cron";
+        default:
+            return "serial";
+    }
+}
+
+static void session_free(session_t *session)
+{
+    free(session->history);
+    memset(session, 0, sizeof(*session));
+}
+
+// Cron firings need little context, and a session per cron entry would
+// crowd out the interactive ones, so they all share one.
+static int64_t session_key(msg_source_t source, int64_t source_id)
+{
+    return source == MSG_SOURCE_CRON ? 0 : source_id;
+}
+
+// Least recently used held session other than keep that a session for
+// source may evict, or NULL. Cron only ever displaces cron.
+static session_t *lru_session(const session_t *keep, msg_source_t source)
+{
+    session_t *lru = NULL;
+    for (int i = 0; i < SESSION_MAX_COUNT; i++) {
+        session_t *session = &s_sessions[i];
+        if (session->history && session != keep &&
+            (source != MSG_SOURCE_CRON || session->source == MSG_SOURCE_CRON) &&
+            (!lru || session->last_used < lru->last_used)) {
+            lru = session;
+        }
+    }
+    return lru;
+}
+
+static void evict(session_t *session, const char *reason)
+{
+    ESP_LOGI(TAG, "Evicting %s session %lld (%s, %d messages)",
+             source_name(session->source), (long long)session->source_id, reason,
+             history_count(session->history));
+    session_free(session);
+}
+
+void session_init(void)
+{
+    memset(s_sessions, 0, sizeof(s_sessions));
+    s_clock = 0;
+}
+
+int session_capacity(void)
+{
+    int capacity = (int)(SESSION_MEMORY_CAP / sizeof(history_t));
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    return capacity < SESSION_MAX_COUNT ? capacity : SESSION_MAX_COUNT;
+}
+
+int session_count(void)
+{
+    int count = 0;
+    for (int i = 0; i < SESSION_MAX_COUNT; i++) {
+        if (s_sessions[i].history) {
+            count++;
+        }
+    }
+    return count;
+}
+
+history_t *session_get(msg_source_t source, int64_t source_id, bool *created)
+{
+    session_t *free_slot = NULL;
+
+    *created = false;
+    source_id = session_key(source, source_id);
+    for (int i = 0; i < SESSION_MAX_COUNT; i++) {
+        session_t *session = &s_sessions[i];
+        if (session->history && session->source == source && session->source_id == source_id) {
+            session->last_used = ++s_clock;
+            return session->history;
+        }
+        if (!session->history && !free_slot && i < session_capacity()) {
+            free_slot = session;
+        }
+    }
+
+    if (!free_slot) {
+        free_slot = lru_session(NULL, source);
+        if (!free_slot) {
+            ESP_LOGW(TAG, "No room for a %s session: interactive sessions are kept",
+                     source_name(source));
+            return NULL;
+        }
+        evict(free_slot, "memory cap");
+    }
+
+    history_t *history = buffer_alloc(NULL, sizeof(history_t), BUFFER_BULK);
+    while (!history) {
+        session_t *victim = lru_session(free_slot, source);
+        if (!victim) {
+            ESP_LOGE(TAG, "No memory for a %s session", source_name(source));
+            return NULL;
+        }
+        evict(victim, "out of memory");
+        history = buffer_alloc(NULL, sizeof(history_t), BUFFER_BULK);
+    }
+
+    history_init(history);
+    free_slot->history = history;
+    free_slot->source = source;
+    free_slot->source_id = source_id;
+    free_slot->last_used = ++s_clock;
+    *created = true;
+    ESP_LOGI(TAG, "New %s session %lld (%d/%d held)", source_name(source),
+             (long long)source_id, session_count(), session_capacity());
+    return history;
+}
+
+#ifdef TEST_BUILD
+void session_test_reset(void)
+{
+    for (int i = 0; i < SESSION_MAX_COUNT; i++) {
+        if (s_sessions[i].history) {
+            session_free(&s_sessions[i]);
+        }
+    }
+    s_clock = 0;
+}
+#endif
@@ -0,0 +1,33 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "history.h"
+#include "messages.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Conversation sessions keyed by message origin (serial, a Telegram chat,
+// cron), so each request carries only the context of its own origin. All cron
+// entries share one session. Histories are allocated on first use; once
+// SESSION_MEMORY_CAP is reached the least recently used idle session is
+// dropped to make room, but never an interactive one for cron.
+
+void session_init(void);
+
+// History for the origin, created (with LRU eviction) if needed. Sets
+// *created when a fresh, empty history was returned. Returns NULL if no
+// memory could be found even after evicting every session it may evict.
+history_t *session_get(msg_source_t source, int64_t source_id, bool *created);
+
+// Sessions currently held
+int session_count(void);
+
+// Most sessions held at once under SESSION_MEMORY_CAP
+int session_capacity(void);
+
+#ifdef TEST_BUILD
+// Free every session (tests only).
+void session_test_reset(void);
+#endif
+
+#endif // SESSION_H
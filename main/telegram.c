@@ -1,17 +1,22 @@
 #include "telegram.h"
 #include "config.h"
 #include "messages.h"
+#include "msg_pool.h"
 #include "memory.h"
 #include "nvs_keys.h"
 #include "telegram_update.h"
 #include "text_buffer.h"
+#include "tls_session.h"
+#include "buffers.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -47,18 +52,47 @@ static const char *i64_to_str(int64_t val, char *buf, size_t buf_size)
     return p;
 }
 
-// Exponential backoff state
+// Exponential backoff state (poll task)
 static int s_consecutive_failures = 0;
 #define BACKOFF_BASE_MS     5000    // 5 seconds
 #define BACKOFF_MAX_MS      300000  // 5 minutes
 #define BACKOFF_MULTIPLIER  2
 
+// Connection bookkeeping for one exchange on a kept-alive client
 typedef struct {
+    tls_session_t *tls;             // Ticket state of the client running the exchange
+    int64_t started_us;
+    bool connected;                 // Fresh TCP/TLS connection opened during this exchange
+    size_t received;                // Body bytes seen
+} telegram_conn_t;
+
+typedef struct {
+    telegram_conn_t conn;
     char buf[4096];
     size_t len;
     bool truncated;
 } telegram_http_ctx_t;
 
+typedef struct {
+    telegram_conn_t conn;
+    telegram_update_stream_t stream;
+    int64_t last_update_id;         // Flush: newest update seen
+} telegram_poll_ctx_t;
+
+// Long-lived clients: the poll task owns s_poll_client, replies go through
+// s_send_client under s_send_lock. A handle is only rebuilt after a transport
+// error, so long polls and replies reuse one open connection each.
+static esp_http_client_handle_t s_poll_client = NULL;
+static esp_http_client_handle_t s_send_client = NULL;
+static tls_session_t s_poll_tls;
+static tls_session_t s_send_tls;
+static SemaphoreHandle_t s_send_lock = NULL;
+static int64_t s_last_write_us = 0;         // Last sendMessage/editMessageText to the chat
+
+// Progressive reply being edited in place (send task only)
+static int64_t s_reply_message_id = 0;
+static uint32_t s_reply_text_hash = 0;      // Text the reply shows now
+
 static bool parse_chat_id_string(const char *input, int64_t *chat_id_out)
 {
     const unsigned char *cursor = (const unsigned char *)input;
@@ -93,13 +127,26 @@ static bool parse_chat_id_string(const char *input, int64_t *chat_id_out)
     return true;
 }
 
+static void conn_on_connected(telegram_conn_t *conn)
+{
+    conn->connected = true;
+    tls_session_record_connect(conn->tls, TELEGRAM_API_URL,
+                               (uint32_t)((esp_timer_get_time() - conn->started_us) / 1000));
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
     telegram_http_ctx_t *ctx = (telegram_http_ctx_t *)evt->user_data;
 
     switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            if (ctx) {
+                conn_on_connected(&ctx->conn);
+            }
+            break;
         case HTTP_EVENT_ON_DATA:
             if (ctx) {
+                ctx->conn.received += evt->data_len;
                 bool ok = text_buffer_append(ctx->buf, &ctx->len, sizeof(ctx->buf),
                                              (const char *)evt->data, evt->data_len);
                 if (!ok && !ctx->truncated) {
@@ -114,6 +161,138 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+static esp_err_t http_poll_event_handler(esp_http_client_event_t *evt)
+{
+    telegram_poll_ctx_t *ctx = (telegram_poll_ctx_t *)evt->user_data;
+
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            if (ctx) {
+                conn_on_connected(&ctx->conn);
+            }
+            break;
+        case HTTP_EVENT_ON_DATA:
+            // Error bodies carry no updates; leave them to the status check.
+            if (ctx) {
+                ctx->conn.received += evt->data_len;
+                if (esp_http_client_get_status_code(evt->client) == 200) {
+                    telegram_update_stream_feed(&ctx->stream, (const char *)evt->data,
+                                                (size_t)evt->data_len);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+// Build URL for Telegram API
+static void build_url(char *buf, size_t buf_size, const char *method)
+{
+    snprintf(buf, buf_size, "%s%s/%s", TELEGRAM_API_URL, s_bot_token, method);
+}
+
+static esp_http_client_handle_t telegram_client_create(const char *method,
+                                                       http_event_handle_cb handler,
+                                                       int timeout_ms)
+{
+    char url[256];
+    build_url(url, sizeof(url), method);
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .event_handler = handler,
+        .timeout_ms = timeout_ms,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
+        .keep_alive_idle = TELEGRAM_KEEPALIVE_IDLE_S,
+        .keep_alive_interval = TELEGRAM_KEEPALIVE_INTERVAL_S,
+        .keep_alive_count = TELEGRAM_KEEPALIVE_COUNT,
+    };
+    tls_session_prepare(&config);
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        ESP_LOGE(TAG, "Failed to init HTTP client for %s", method);
+    }
+    return client;
+}
+
+static void telegram_client_reset(esp_http_client_handle_t *client, tls_session_t *tls)
+{
+    if (*client) {
+        esp_http_client_cleanup(*client);
+        *client = NULL;
+        // The session ticket lived inside the handle.
+        tls_session_forget(tls);
+    }
+}
+
+// Transport errors that leave no doubt the request never reached Telegram.
+static bool request_not_sent(esp_err_t err)
+{
+    return err == ESP_ERR_HTTP_CONNECT || err == ESP_ERR_HTTP_WRITE_DATA;
+}
+
+// Run one exchange on a kept-alive client. A socket the server closed while
+// idle fails at once, before anything is received; that is retried once on a
+// fresh connection. A read timeout is not: a sendMessage may already have been
+// delivered. Any other transport error drops the handle, so the next call
+// reconnects from scratch.
+static esp_err_t telegram_client_perform(esp_http_client_handle_t *client, tls_session_t *tls,
+                                         telegram_conn_t *conn)
+{
+    esp_err_t err = ESP_FAIL;
+
+    conn->tls = tls;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        conn->started_us = esp_timer_get_time();
+        conn->connected = false;
+        conn->received = 0;
+
+        err = esp_http_client_perform(*client);
+        if (err == ESP_OK) {
+            return ESP_OK;
+        }
+
+        bool stale = esp_timer_get_time() - conn->started_us < (int64_t)HTTP_STALE_CONN_MS * 1000;
+        if (attempt == 0 && !conn->connected && conn->received == 0 &&
+            (request_not_sent(err) || stale)) {
+            ESP_LOGW(TAG, "Kept-alive connection failed (%s), reconnecting",
+                     esp_err_to_name(err));
+            esp_http_client_close(*client);
+            continue;
+        }
+        break;
+    }
+
+    telegram_client_reset(client, tls);
+    return err;
+}
+
+// Single getUpdates call streamed into ctx on the poll client; returns HTTP
+// status or -1 on error
+static int telegram_get_updates(const char *url, telegram_poll_ctx_t *ctx)
+{
+    if (!s_poll_client) {
+        s_poll_client = telegram_client_create("getUpdates", http_poll_event_handler,
+                                               (TELEGRAM_POLL_TIMEOUT + 10) * 1000);
+        if (!s_poll_client) {
+            return -1;
+        }
+    }
+
+    esp_http_client_set_url(s_poll_client, url);
+    esp_http_client_set_user_data(s_poll_client, ctx);
+    esp_err_t err = telegram_client_perform(&s_poll_client, &s_poll_tls, &ctx->conn);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "getUpdates transport error: %s", esp_err_to_name(err));
+        return -1;
+    }
+    return esp_http_client_get_status_code(s_poll_client);
+}
+
 esp_err_t telegram_init(void)
 {
     // Load bot token from NVS
@@ -136,6 +315,12 @@ esp_err_t telegram_init(void)
         }
     }
 
+    s_send_lock = xSemaphoreCreateMutex();
+    if (!s_send_lock) {
+        ESP_LOGE(TAG, "Failed to create Telegram send lock");
+        return ESP_ERR_NO_MEM;
+    }
+
     ESP_LOGI(TAG, "Telegram initialized");
     return ESP_OK;
 }
@@ -150,289 +335,363 @@ int64_t telegram_get_chat_id(void)
     return s_chat_id;
 }
 
-// Build URL for Telegram API
-static void build_url(char *buf, size_t buf_size, const char *method)
-{
-    snprintf(buf, buf_size, "%s%s/%s", TELEGRAM_API_URL, s_bot_token, method);
-}
-
-esp_err_t telegram_send(const char *text)
+// POST a Bot API method on the send client. root is consumed. When message_id_out
+// is set it receives result.message_id. Returns ESP_ERR_INVALID_RESPONSE when
+// Telegram answered with an error, or the transport error when no answer arrived
+// (ESP_ERR_HTTP_CONNECT / ESP_ERR_HTTP_WRITE_DATA only if the request was not sent).
+static esp_err_t telegram_post(const char *method, cJSON *root, int64_t *message_id_out)
 {
     telegram_http_ctx_t *ctx = NULL;
-    esp_http_client_handle_t client = NULL;
     esp_err_t err;
-
-    if (!telegram_is_configured() || s_chat_id == 0) {
-        ESP_LOGW(TAG, "Cannot send - not configured or no chat ID");
-        return ESP_ERR_INVALID_STATE;
-    }
-
     char url[256];
-    build_url(url, sizeof(url), "sendMessage");
 
-    // Build JSON body
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        return ESP_ERR_NO_MEM;
-    }
-    if (!cJSON_AddNumberToObject(root, "chat_id", (double)s_chat_id) ||
-        !cJSON_AddStringToObject(root, "text", text)) {
-        cJSON_Delete(root);
-        return ESP_ERR_NO_MEM;
-    }
     char *body = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
-
     if (!body) {
         return ESP_ERR_NO_MEM;
     }
 
-    ctx = calloc(1, sizeof(*ctx));
+    ctx = buffer_alloc(NULL, sizeof(*ctx), BUFFER_BULK);
     if (!ctx) {
         free(body);
         return ESP_ERR_NO_MEM;
     }
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .user_data = ctx,
-        .timeout_ms = HTTP_TIMEOUT_MS,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
+    xSemaphoreTake(s_send_lock, portMAX_DELAY);
 
-    client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to init HTTP client");
-        free(body);
-        free(ctx);
-        return ESP_FAIL;
+    if (!s_send_client) {
+        s_send_client = telegram_client_create(method, http_event_handler, HTTP_TIMEOUT_MS);
+        if (!s_send_client) {
+            xSemaphoreGive(s_send_lock);
+            free(body);
+            free(ctx);
+            return ESP_ERR_HTTP_CONNECT;
+        }
+        // Method and headers persist on the handle across requests.
+        esp_http_client_set_method(s_send_client, HTTP_METHOD_POST);
+        esp_http_client_set_header(s_send_client, "Content-Type", "application/json");
     }
 
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, body, strlen(body));
-
-    err = esp_http_client_perform(client);
+    build_url(url, sizeof(url), method);
+    esp_http_client_set_url(s_send_client, url);
+    esp_http_client_set_user_data(s_send_client, ctx);
+    esp_http_client_set_post_field(s_send_client, body, strlen(body));
+    err = telegram_client_perform(&s_send_client, &s_send_tls, &ctx->conn);
+    s_last_write_us = esp_timer_get_time();
 
     if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
+        int status = esp_http_client_get_status_code(s_send_client);
         if (status != 200) {
-            ESP_LOGE(TAG, "sendMessage failed: %d", status);
+            ESP_LOGE(TAG, "%s failed: %d", method, status);
             if (ctx->buf[0] != '\0') {
-                ESP_LOGE(TAG, "sendMessage response: %s", ctx->buf);
+                ESP_LOGE(TAG, "%s response: %s", method, ctx->buf);
             }
-            err = ESP_FAIL;
+            err = ESP_ERR_INVALID_RESPONSE;
         }
+    } else {
+        ESP_LOGE(TAG, "%s transport error: %s", method, esp_err_to_name(err));
+    }
+
+    xSemaphoreGive(s_send_lock);
+
+    if (err == ESP_OK && message_id_out) {
+        cJSON *response = cJSON_Parse(ctx->buf);
+        cJSON *result = response ? cJSON_GetObjectItem(response, "result") : NULL;
+        cJSON *message_id = result ? cJSON_GetObjectItem(result, "message_id") : NULL;
+        *message_id_out = (message_id && cJSON_IsNumber(message_id))
+                              ? (int64_t)message_id->valuedouble : 0;
+        cJSON_Delete(response);
     }
 
-    esp_http_client_cleanup(client);
     free(body);
     free(ctx);
     return err;
 }
 
+// Body with chat_id and text, plus message_id when editing (non-zero).
+static cJSON *telegram_text_body(int64_t message_id, const char *text)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        return NULL;
+    }
+    if (!cJSON_AddNumberToObject(root, "chat_id", (double)s_chat_id) ||
+        (message_id != 0 && !cJSON_AddNumberToObject(root, "message_id", (double)message_id)) ||
+        !cJSON_AddStringToObject(root, "text", text)) {
+        cJSON_Delete(root);
+        return NULL;
+    }
+    return root;
+}
+
+esp_err_t telegram_send(const char *text)
+{
+    if (!telegram_is_configured() || s_chat_id == 0 || !s_send_lock) {
+        ESP_LOGW(TAG, "Cannot send - not configured or no chat ID");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    cJSON *root = telegram_text_body(0, text);
+    if (!root) {
+        return ESP_ERR_NO_MEM;
+    }
+    return telegram_post("sendMessage", root, NULL);
+}
+
 esp_err_t telegram_send_startup(void)
 {
     return telegram_send("I'm back online. What can I help you with?");
 }
 
-// Poll for updates using long polling
+// Hand one received update to the agent. Returning false stops the batch
+// before s_last_update_id moves past the update, so getUpdates offers it again.
+static bool handle_update(const telegram_update_t *update, const char *text, void *user_ctx)
+{
+    (void)user_ctx;
+    agent_msg_t msg = {
+        .source = MSG_SOURCE_TELEGRAM,
+        .msg_class = MSG_CLASS_INTERACTIVE,
+    };
+
+    if (!update->has_id) {
+        ESP_LOGW(TAG, "Skipping update without update_id");
+        return true;
+    }
+    if (update->update_id <= s_last_update_id) {
+        return true;
+    }
+
+    char id_buf[24];
+    if (update->has_chat && update->has_text) {
+        if (s_chat_id == 0) {
+            // If no chat ID configured, reject all (must be set during provisioning)
+            ESP_LOGW(TAG, "No chat ID configured - ignoring message from %s",
+                     i64_to_str(update->chat_id, id_buf, sizeof(id_buf)));
+        } else if (update->chat_id != s_chat_id) {
+            // Authentication: reject messages from unknown chat IDs
+            ESP_LOGW(TAG, "Rejected message from unauthorized chat: %s",
+                     i64_to_str(update->chat_id, id_buf, sizeof(id_buf)));
+        } else if (update->text_truncated) {
+            // Only a cut-off prefix was kept; acting on it could do the wrong thing.
+            ESP_LOGW(TAG, "Update %s text exceeds %d bytes, rejected",
+                     i64_to_str(update->update_id, id_buf, sizeof(id_buf)), INPUT_MAX_LEN);
+            char notice[80];
+            snprintf(notice, sizeof(notice),
+                     "That message is too long for me (max %d bytes). Please shorten it.",
+                     INPUT_MAX_LEN);
+            telegram_send(notice);
+        } else {
+            msg.source_id = update->chat_id;
+            msg.enqueued_us = esp_timer_get_time();
+            msg.text = msg_pool_copy(text, strlen(text));
+            if (!msg.text) {
+                ESP_LOGW(TAG, "No buffer for update %s, left for the next poll",
+                         i64_to_str(update->update_id, id_buf, sizeof(id_buf)));
+                return false;
+            }
+            ESP_LOGI(TAG, "Received: %s", msg.text->text);
+
+            if (xQueueSend(s_input_queue, &msg, pdMS_TO_TICKS(TELEGRAM_QUEUE_WAIT_MS)) != pdTRUE) {
+                msg_pool_release(msg.text);
+                ESP_LOGW(TAG, "Input queue full, update %s left for the next poll",
+                         i64_to_str(update->update_id, id_buf, sizeof(id_buf)));
+                return false;
+            }
+        }
+    }
+
+    s_last_update_id = update->update_id;
+    return true;
+}
+
+// Poll for updates using long polling. Up to TELEGRAM_POLL_LIMIT updates arrive
+// per round trip and each is handed over as soon as it has streamed in.
 static esp_err_t telegram_poll(void)
 {
     char url[384];
-    telegram_http_ctx_t *ctx = NULL;
-    esp_http_client_handle_t client = NULL;
-    esp_err_t err;
+    telegram_poll_ctx_t *ctx = NULL;
     int status;
 
     char off_buf[24];
-    snprintf(url, sizeof(url), "%s%s/getUpdates?timeout=%d&limit=1&offset=%s",
-             TELEGRAM_API_URL, s_bot_token, TELEGRAM_POLL_TIMEOUT,
+    snprintf(url, sizeof(url),
+             "%s%s/getUpdates?timeout=%d&limit=%d&offset=%s&allowed_updates=%%5B%%22message%%22%%5D",
+             TELEGRAM_API_URL, s_bot_token, TELEGRAM_POLL_TIMEOUT, TELEGRAM_POLL_LIMIT,
              i64_to_str(s_last_update_id + 1, off_buf, sizeof(off_buf)));
 
-    ctx = calloc(1, sizeof(*ctx));
+    ctx = buffer_alloc(NULL, sizeof(*ctx), BUFFER_BULK);
     if (!ctx) {
         return ESP_ERR_NO_MEM;
     }
+    telegram_update_stream_init(&ctx->stream, handle_update, ctx);
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .user_data = ctx,
-        .timeout_ms = (TELEGRAM_POLL_TIMEOUT + 10) * 1000,  // Add buffer to timeout
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
-
-    client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to init HTTP client for poll");
+    status = telegram_get_updates(url, ctx);
+    if (status != 200) {
+        ESP_LOGE(TAG, "getUpdates failed: status=%d", status);
         free(ctx);
         return ESP_FAIL;
     }
 
-    err = esp_http_client_perform(client);
-    status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
-    client = NULL;
-
-    if (err != ESP_OK || status != 200) {
-        ESP_LOGE(TAG, "getUpdates failed: err=%d status=%d", err, status);
+    if (!ctx->stream.result_done && !ctx->stream.stopped) {
+        ESP_LOGE(TAG, "getUpdates response incomplete after %d updates",
+                 ctx->stream.updates);
         free(ctx);
         return ESP_FAIL;
     }
 
-    if (ctx->truncated) {
-        int64_t recovered_update_id = 0;
-        if (telegram_extract_max_update_id(ctx->buf, &recovered_update_id)) {
-            s_last_update_id = recovered_update_id;
-            char rec_buf[24];
-            ESP_LOGW(TAG, "Recovered from truncated response, skipping to update_id=%s",
-                     i64_to_str(s_last_update_id, rec_buf, sizeof(rec_buf)));
-            free(ctx);
-            return ESP_OK;
-        }
-
-        ESP_LOGE(TAG, "Truncated response without parseable update_id");
-        free(ctx);
-        return ESP_FAIL;
+    if (ctx->stream.updates > 1) {
+        ESP_LOGI(TAG, "Received %d updates in one poll", ctx->stream.updates);
     }
+    free(ctx);
+    return ESP_OK;
+}
 
-    // Parse response
-    cJSON *root = cJSON_Parse(ctx->buf);
-    if (!root) {
-        ESP_LOGE(TAG, "Failed to parse response");
-        free(ctx);
-        return ESP_FAIL;
+// Calculate exponential backoff delay after the given number of consecutive failures
+static int get_backoff_delay_ms(int failures)
+{
+    if (failures == 0) {
+        return 0;
     }
 
-    cJSON *ok = cJSON_GetObjectItem(root, "ok");
-    if (!ok || !cJSON_IsTrue(ok)) {
-        ESP_LOGE(TAG, "API returned not ok");
-        cJSON_Delete(root);
-        free(ctx);
-        return ESP_FAIL;
+    int delay = BACKOFF_BASE_MS;
+    for (int i = 1; i < failures && delay < BACKOFF_MAX_MS; i++) {
+        delay *= BACKOFF_MULTIPLIER;
     }
 
-    cJSON *result = cJSON_GetObjectItem(root, "result");
-    if (!result || !cJSON_IsArray(result)) {
-        cJSON_Delete(root);
-        free(ctx);
-        return ESP_OK;  // No updates, that's fine
+    if (delay > BACKOFF_MAX_MS) {
+        delay = BACKOFF_MAX_MS;
     }
 
-    cJSON *update;
-    cJSON_ArrayForEach(update, result) {
-        cJSON *update_id = cJSON_GetObjectItem(update, "update_id");
-        if (update_id && cJSON_IsNumber(update_id)) {
-            // Note: cJSON stores numbers as double (53-bit precision).
-            // Telegram update IDs fit safely within this range.
-            s_last_update_id = (int64_t)update_id->valuedouble;
-        }
-
-        cJSON *message = cJSON_GetObjectItem(update, "message");
-        if (!message) continue;
-
-        cJSON *chat = cJSON_GetObjectItem(message, "chat");
-        cJSON *text = cJSON_GetObjectItem(message, "text");
+    return delay;
+}
 
-        if (chat && text && cJSON_IsString(text)) {
-            cJSON *chat_id = cJSON_GetObjectItem(chat, "id");
-            if (chat_id && cJSON_IsNumber(chat_id)) {
-                // Note: cJSON stores numbers as double (53-bit precision)
-                // Telegram chat IDs fit within this range
-                int64_t incoming_chat_id = (int64_t)chat_id->valuedouble;
+static uint32_t text_hash(const char *text)
+{
+    uint32_t hash = 2166136261u;
+    for (; *text; text++) {
+        hash = (hash ^ (uint8_t)*text) * 16777619u;
+    }
+    return hash;
+}
 
-                // Sanity check for precision loss (chat IDs > 2^53)
-                if (chat_id->valuedouble > 9007199254740992.0) {
-                    ESP_LOGW(TAG, "Chat ID may have precision loss");
-                }
+// Wait until another write to the chat stays within Telegram's rate limits:
+// about one per second in a private chat, 20 per minute in a group.
+static void wait_for_write_slot(void)
+{
+    int interval_ms = s_chat_id < 0 ? TELEGRAM_GROUP_EDIT_INTERVAL_MS : TELEGRAM_EDIT_INTERVAL_MS;
+    int64_t elapsed_ms = (esp_timer_get_time() - s_last_write_us) / 1000;
+    if (elapsed_ms < interval_ms) {
+        vTaskDelay(pdMS_TO_TICKS(interval_ms - elapsed_ms));
+    }
+}
 
-                // Authentication: reject messages from unknown chat IDs
-                if (s_chat_id != 0 && incoming_chat_id != s_chat_id) {
-                    char rej_buf[24];
-                    ESP_LOGW(TAG, "Rejected message from unauthorized chat: %s",
-                             i64_to_str(incoming_chat_id, rej_buf, sizeof(rej_buf)));
-                    continue;
-                }
+static void reply_start(const char *placeholder)
+{
+    cJSON *root = telegram_text_body(0, placeholder);
 
-                // If no chat ID configured, reject all (must be set during provisioning)
-                if (s_chat_id == 0) {
-                    char ign_buf[24];
-                    ESP_LOGW(TAG, "No chat ID configured - ignoring message from %s",
-                             i64_to_str(incoming_chat_id, ign_buf, sizeof(ign_buf)));
-                    continue;
-                }
+    s_reply_message_id = 0;
+    if (root && telegram_post("sendMessage", root, &s_reply_message_id) == ESP_OK) {
+        s_reply_text_hash = text_hash(placeholder);
+    }
+}
 
-                // Push message to input queue
-                channel_msg_t msg;
-                strncpy(msg.text, text->valuestring, CHANNEL_RX_BUF_SIZE - 1);
-                msg.text[CHANNEL_RX_BUF_SIZE - 1] = '\0';
+static esp_err_t reply_edit(const char *text)
+{
+    uint32_t hash = text_hash(text);
+    if (hash == s_reply_text_hash) {
+        return ESP_OK;  // Telegram rejects edits that change nothing
+    }
 
-                ESP_LOGI(TAG, "Received: %s", msg.text);
+    cJSON *root = telegram_text_body(s_reply_message_id, text);
+    if (!root) {
+        return ESP_ERR_NO_MEM;
+    }
+    wait_for_write_slot();
+    esp_err_t err = telegram_post("editMessageText", root, NULL);
+    if (err == ESP_OK) {
+        s_reply_text_hash = hash;
+    }
+    return err;
+}
 
-                if (xQueueSend(s_input_queue, &msg, pdMS_TO_TICKS(100)) != pdTRUE) {
-                    ESP_LOGW(TAG, "Input queue full");
-                }
-            }
+// A reply that never reached Telegram is retried with backoff. One Telegram
+// rejected, or one that may have been delivered before the answer was lost
+// (e.g. a read timeout), is not: resending it could post the reply twice.
+static void send_with_retry(const char *text)
+{
+    int failures = 0;
+    while (telegram_is_configured() && s_chat_id != 0) {
+        esp_err_t err = telegram_send(text);
+        if (!request_not_sent(err) || failures >= TELEGRAM_SEND_RETRIES) {
+            break;
         }
+        failures++;
+        int backoff_ms = get_backoff_delay_ms(failures);
+        ESP_LOGW(TAG, "Send failed (%d consecutive), retry in %dms", failures, backoff_ms);
+        vTaskDelay(pdMS_TO_TICKS(backoff_ms));
     }
-
-    cJSON_Delete(root);
-    free(ctx);
-    return ESP_OK;
 }
 
-// Telegram response task - watches output queue, sends to Telegram
+// Telegram response task - watches output queue, sends to Telegram. Replies
+// opened with TELEGRAM_MSG_REPLY_START are edited in place until their final
+// text arrives; if the placeholder failed, or the final edit never went out or
+// was rejected, the final text is sent as a new message instead.
 static void telegram_send_task(void *arg)
 {
     (void)arg;
     while (1) {
-        if (xQueueReceive(s_output_queue, &s_send_msg, portMAX_DELAY) == pdTRUE) {
-            if (telegram_is_configured() && s_chat_id != 0) {
-                telegram_send(s_send_msg.text);
-            }
+        if (xQueueReceive(s_output_queue, &s_send_msg, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (!telegram_is_configured() || s_chat_id == 0) {
+            msg_pool_release(s_send_msg.text);
+            continue;
         }
-    }
-}
-
-// Calculate exponential backoff delay
-static int get_backoff_delay_ms(void)
-{
-    if (s_consecutive_failures == 0) {
-        return 0;
-    }
-
-    int delay = BACKOFF_BASE_MS;
-    for (int i = 1; i < s_consecutive_failures && delay < BACKOFF_MAX_MS; i++) {
-        delay *= BACKOFF_MULTIPLIER;
-    }
 
-    if (delay > BACKOFF_MAX_MS) {
-        delay = BACKOFF_MAX_MS;
+        const char *text = s_send_msg.text->text;
+        switch (s_send_msg.kind) {
+            case TELEGRAM_MSG_REPLY_START:
+                reply_start(text);
+                break;
+            case TELEGRAM_MSG_REPLY_PROGRESS:
+                if (s_reply_message_id == 0) {
+                    break;
+                }
+                wait_for_write_slot();
+                // Anything queued meanwhile is newer than this snapshot.
+                if (uxQueueMessagesWaiting(s_output_queue) == 0) {
+                    reply_edit(text);
+                }
+                break;
+            default:
+                if (s_reply_message_id != 0) {
+                    esp_err_t err = reply_edit(text);
+                    s_reply_message_id = 0;
+                    // After a timeout the edit may well have landed; a second
+                    // message would show the answer twice.
+                    if (!request_not_sent(err) && err != ESP_ERR_INVALID_RESPONSE) {
+                        if (err != ESP_OK) {
+                            ESP_LOGW(TAG, "Final reply edit failed (%s), not resent",
+                                     esp_err_to_name(err));
+                        }
+                        break;
+                    }
+                }
+                send_with_retry(text);
+                break;
+        }
+        msg_pool_release(s_send_msg.text);
     }
-
-    return delay;
 }
 
-// Helper: single getUpdates call, returns HTTP status or -1 on error
-static int telegram_get_updates_raw(const char *url, telegram_http_ctx_t *ctx)
+static bool note_update_id(const telegram_update_t *update, const char *text, void *user_ctx)
 {
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .user_data = ctx,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) return -1;
+    telegram_poll_ctx_t *ctx = (telegram_poll_ctx_t *)user_ctx;
 
-    esp_err_t err = esp_http_client_perform(client);
-    int status = (err == ESP_OK) ? esp_http_client_get_status_code(client) : -1;
-    esp_http_client_cleanup(client);
-    return status;
+    (void)text;
+    if (update->has_id && update->update_id > ctx->last_update_id) {
+        ctx->last_update_id = update->update_id;
+    }
+    return true;
 }
 
 // Flush any pending updates so we don't reprocess old messages after reboot.
@@ -446,36 +705,22 @@ static void telegram_flush_pending(void)
     snprintf(url, sizeof(url), "%s%s/getUpdates?offset=-1&limit=1&timeout=0",
              TELEGRAM_API_URL, s_bot_token);
 
-    telegram_http_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    telegram_poll_ctx_t *ctx = buffer_alloc(NULL, sizeof(*ctx), BUFFER_BULK);
     if (!ctx) return;
+    telegram_update_stream_init(&ctx->stream, note_update_id, ctx);
+    ctx->last_update_id = 0;
 
-    int status = telegram_get_updates_raw(url, ctx);
+    int status = telegram_get_updates(url, ctx);
     if (status != 200) {
         ESP_LOGW(TAG, "Flush step 1 failed (status=%d)", status);
         free(ctx);
         return;
     }
 
-    // Parse the last update_id
-    int64_t last_id = 0;
-    cJSON *root = cJSON_Parse(ctx->buf);
-    if (root) {
-        cJSON *result = cJSON_GetObjectItem(root, "result");
-        if (result && cJSON_IsArray(result)) {
-            cJSON *update = cJSON_GetArrayItem(result, 0);
-            if (update) {
-                cJSON *uid = cJSON_GetObjectItem(update, "update_id");
-                if (uid && cJSON_IsNumber(uid)) {
-                    last_id = (int64_t)uid->valuedouble;
-                }
-            }
-        }
-        cJSON_Delete(root);
-    }
-    free(ctx);
-
+    int64_t last_id = ctx->last_update_id;
     if (last_id == 0) {
         ESP_LOGI(TAG, "No pending updates to flush");
+        free(ctx);
         return;
     }
 
@@ -485,10 +730,8 @@ static void telegram_flush_pending(void)
              TELEGRAM_API_URL, s_bot_token,
              i64_to_str(last_id + 1, flush_buf, sizeof(flush_buf)));
 
-    ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) return;
-
-    status = telegram_get_updates_raw(url, ctx);
+    telegram_update_stream_init(&ctx->stream, NULL, NULL);
+    status = telegram_get_updates(url, ctx);
     free(ctx);
 
     s_last_update_id = last_id;
@@ -510,7 +753,7 @@ static void telegram_poll_task(void *arg)
             esp_err_t err = telegram_poll();
             if (err != ESP_OK) {
                 s_consecutive_failures++;
-                int backoff_ms = get_backoff_delay_ms();
+                int backoff_ms = get_backoff_delay_ms(s_consecutive_failures);
                 ESP_LOGW(TAG, "Poll failed (%d consecutive), backoff %dms",
                          s_consecutive_failures, backoff_ms);
                 vTaskDelay(pdMS_TO_TICKS(backoff_ms));
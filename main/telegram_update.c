@@ -44,3 +44,338 @@ bool telegram_extract_max_update_id(const char *buf, int64_t *max_id_out)
 
     return false;
 }
+
+enum {
+    FIELD_NONE = 0,
+    FIELD_UPDATE_ID,
+    FIELD_CHAT_ID,
+    FIELD_TEXT,
+};
+
+void telegram_update_stream_init(telegram_update_stream_t *stream,
+                                 telegram_update_cb_t on_update, void *user_ctx)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->on_update = on_update;
+    stream->user_ctx = user_ctx;
+}
+
+static bool key_is(const telegram_update_stream_t *stream, const char *name)
+{
+    size_t len = strlen(name);
+    return stream->key_len == len && memcmp(stream->key, name, len) == 0;
+}
+
+static bool is_object(const telegram_update_stream_t *stream, int depth)
+{
+    return depth < 32 && (stream->objects & (1u << depth)) != 0;
+}
+
+static void begin_update(telegram_update_stream_t *stream)
+{
+    stream->capturing = true;
+    stream->message_depth = 0;
+    stream->chat_depth = 0;
+    stream->field = FIELD_NONE;
+    stream->unicode_digits = 0;
+    stream->high_surrogate = 0;
+    memset(&stream->update, 0, sizeof(stream->update));
+    stream->text[0] = '\0';
+    stream->text_len = 0;
+}
+
+static void finish_update(telegram_update_stream_t *stream)
+{
+    stream->capturing = false;
+    stream->updates++;
+    if (stream->on_update &&
+        !stream->on_update(&stream->update, stream->text, stream->user_ctx)) {
+        stream->stopped = true;
+    }
+}
+
+static void finish_number(telegram_update_stream_t *stream)
+{
+    char *endptr = NULL;
+    long long parsed;
+
+    stream->number[stream->number_len] = '\0';
+    parsed = strtoll(stream->number, &endptr, 10);
+    if (stream->number_len > 0 && *endptr == '\0') {
+        if (stream->field == FIELD_UPDATE_ID && parsed >= 0) {
+            stream->update.update_id = (int64_t)parsed;
+            stream->update.has_id = true;
+        } else if (stream->field == FIELD_CHAT_ID) {
+            stream->update.chat_id = (int64_t)parsed;
+            stream->update.has_chat = true;
+        }
+    }
+    stream->number_len = 0;
+    stream->field = FIELD_NONE;
+}
+
+// Append one decoded byte of message.text. Past the buffer the text is cut
+// before the last incomplete UTF-8 sequence.
+static void text_byte(telegram_update_stream_t *stream, char c)
+{
+    if (stream->update.text_truncated) {
+        return;
+    }
+    if (stream->text_len + 1 < sizeof(stream->text)) {
+        stream->text[stream->text_len++] = c;
+        stream->text[stream->text_len] = '\0';
+        return;
+    }
+
+    stream->update.text_truncated = true;
+    size_t lead = stream->text_len;
+    while (lead > 0 && ((unsigned char)stream->text[lead - 1] & 0xC0) == 0x80) {
+        lead--;
+    }
+    if (lead > 0 && ((unsigned char)stream->text[lead - 1] & 0x80)) {
+        unsigned char first = (unsigned char)stream->text[lead - 1];
+        size_t need = first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+        if (stream->text_len - (lead - 1) < need) {
+            stream->text_len = lead - 1;
+            stream->text[stream->text_len] = '\0';
+        }
+    }
+}
+
+static void text_codepoint(telegram_update_stream_t *stream, uint32_t cp)
+{
+    char utf8[4];
+    size_t n;
+
+    if (cp < 0x80) {
+        utf8[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        utf8[0] = (char)(0xC0 | (cp >> 6));
+        utf8[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        utf8[0] = (char)(0xE0 | (cp >> 12));
+        utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        utf8[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        utf8[0] = (char)(0xF0 | (cp >> 18));
+        utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        utf8[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    // A whole character or none of it.
+    if (stream->text_len + n >= sizeof(stream->text)) {
+        stream->update.text_truncated = true;
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        text_byte(stream, utf8[i]);
+    }
+}
+
+// One \uXXXX unit; UTF-16 surrogate pairs arrive as two.
+static void text_unicode(telegram_update_stream_t *stream, uint32_t unit)
+{
+    if (unit >= 0xD800 && unit <= 0xDBFF) {
+        if (stream->high_surrogate) {
+            text_codepoint(stream, 0xFFFD);
+        }
+        stream->high_surrogate = unit;
+        return;
+    }
+    if (unit >= 0xDC00 && unit <= 0xDFFF) {
+        if (stream->high_surrogate) {
+            unit = 0x10000 + ((stream->high_surrogate - 0xD800) << 10) + (unit - 0xDC00);
+        } else {
+            unit = 0xFFFD;
+        }
+    } else if (stream->high_surrogate) {
+        text_codepoint(stream, 0xFFFD);
+    }
+    stream->high_surrogate = 0;
+    text_codepoint(stream, unit);
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// A character inside message.text's string, escapes included.
+static void text_char(telegram_update_stream_t *stream, char c)
+{
+    if (stream->unicode_digits > 0) {
+        int value = hex_value(c);
+        stream->unicode = (stream->unicode << 4) | (uint32_t)(value < 0 ? 0 : value);
+        if (--stream->unicode_digits == 0) {
+            text_unicode(stream, stream->unicode);
+        }
+        return;
+    }
+    if (!stream->escape && c == '\\') {
+        return;
+    }
+    if (stream->escape) {
+        static const char from[] = "bfnrt";
+        static const char to[] = "\b\f\n\r\t";
+        const char *mapped = strchr(from, c);
+        if (c == 'u') {
+            stream->unicode = 0;
+            stream->unicode_digits = 4;
+            return;
+        }
+        c = (mapped && c != '\0') ? to[mapped - from] : c;
+    }
+    if (stream->high_surrogate) {
+        text_codepoint(stream, 0xFFFD);
+        stream->high_surrogate = 0;
+    }
+    text_byte(stream, c);
+}
+
+static void end_text(telegram_update_stream_t *stream)
+{
+    if (stream->high_surrogate) {
+        text_codepoint(stream, 0xFFFD);
+        stream->high_surrogate = 0;
+    }
+    stream->update.has_text = true;
+    stream->field = FIELD_NONE;
+}
+
+// A member name just ended with ':' at the current depth.
+static void begin_value(telegram_update_stream_t *stream)
+{
+    stream->field = FIELD_NONE;
+    if (!stream->capturing) {
+        return;
+    }
+    if (stream->depth == 3 && key_is(stream, "update_id")) {
+        stream->field = FIELD_UPDATE_ID;
+    } else if (stream->depth == stream->chat_depth && key_is(stream, "id")) {
+        stream->field = FIELD_CHAT_ID;
+    } else if (stream->depth == stream->message_depth && key_is(stream, "text")) {
+        stream->field = FIELD_TEXT;
+    }
+}
+
+// Tracks nesting, member names and strings; only the wanted values are kept.
+void telegram_update_stream_feed(telegram_update_stream_t *stream, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !stream->stopped; i++) {
+        char c = data[i];
+
+        if (stream->in_string) {
+            bool text = !stream->in_key && stream->field == FIELD_TEXT;
+            if (!stream->escape && stream->unicode_digits == 0 && c == '"') {
+                stream->in_string = false;
+                if (text) {
+                    end_text(stream);
+                }
+                continue;
+            }
+            if (text) {
+                text_char(stream, c);
+            } else if (stream->in_key && !stream->escape && c != '\\') {
+                if (stream->key_len < sizeof(stream->key)) {
+                    stream->key[stream->key_len] = c;
+                }
+                stream->key_len++;
+            }
+            stream->escape = !stream->escape && stream->unicode_digits == 0 && c == '\\';
+            continue;
+        }
+
+        if (stream->field == FIELD_UPDATE_ID || stream->field == FIELD_CHAT_ID) {
+            if ((c >= '0' && c <= '9') || c == '-') {
+                if (stream->number_len + 1 < sizeof(stream->number)) {
+                    stream->number[stream->number_len++] = c;
+                }
+                continue;
+            }
+            if (stream->number_len > 0 || (c != ' ' && c != '\t' && c != '\r' && c != '\n')) {
+                finish_number(stream);
+            }
+        }
+
+        switch (c) {
+            case '"':
+                stream->in_string = true;
+                stream->in_key = stream->expect_key;
+                if (stream->in_key) {
+                    stream->key_len = 0;
+                } else if (stream->field != FIELD_TEXT) {
+                    stream->field = FIELD_NONE;
+                }
+                break;
+            case ':':
+                stream->expect_key = false;
+                begin_value(stream);
+                break;
+            case ',':
+                stream->expect_key = is_object(stream, stream->depth);
+                stream->field = FIELD_NONE;
+                break;
+            case '{':
+            case '[':
+                if (stream->depth == 1 && c == '[' && !stream->result_done && key_is(stream, "result")) {
+                    stream->in_result = true;
+                } else if (stream->in_result && stream->depth == 2 && c == '{' &&
+                           !stream->capturing) {
+                    begin_update(stream);
+                } else if (stream->capturing && c == '{') {
+                    if (stream->depth == 3 && key_is(stream, "message")) {
+                        stream->message_depth = 4;
+                    } else if (stream->depth == stream->message_depth && key_is(stream, "chat")) {
+                        stream->chat_depth = stream->message_depth + 1;
+                    }
+                }
+                stream->field = FIELD_NONE;
+                stream->depth++;
+                if (stream->depth < 32) {
+                    if (c == '{') {
+                        stream->objects |= 1u << stream->depth;
+                    } else {
+                        stream->objects &= ~(1u << stream->depth);
+                    }
+                }
+                stream->expect_key = c == '{';
+                break;
+            case '}':
+            case ']':
+                if (stream->depth == stream->chat_depth) {
+                    stream->chat_depth = 0;
+                }
+                if (stream->depth == stream->message_depth) {
+                    stream->message_depth = 0;
+                    stream->chat_depth = 0;
+                }
+                if (stream->depth > 0) {
+                    stream->depth--;
+                }
+                stream->expect_key = false;
+                stream->field = FIELD_NONE;
+                if (stream->capturing && stream->depth == 2) {
+                    finish_update(stream);
+                } else if (stream->in_result && stream->depth == 1) {
+                    stream->in_result = false;
+                    stream->result_done = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -1,11 +1,73 @@
 #ifndef TELEGRAM_UPDATE_H
 #define TELEGRAM_UPDATE_H
 
+#include "config.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // Best-effort parser for recovering the max update_id from partially received JSON.
 // Returns true and sets max_id_out when at least one non-negative update_id is found.
 bool telegram_extract_max_update_id(const char *buf, int64_t *max_id_out);
 
+// Fields of one getUpdates result element that the bot acts on.
+typedef struct {
+    int64_t update_id;
+    int64_t chat_id;
+    bool has_id;                    // update_id was present (and not negative)
+    bool has_chat;                  // message.chat.id was present
+    bool has_text;                  // message.text was present
+    bool text_truncated;            // message.text was longer than INPUT_MAX_LEN bytes
+} telegram_update_t;
+
+// Called with each element of the response's "result" array as soon as its
+// closing brace arrives. text holds the decoded message.text ("" without
+// one), cut at INPUT_MAX_LEN bytes. Return false to stop: the rest of the
+// response is ignored.
+typedef bool (*telegram_update_cb_t)(const telegram_update_t *update, const char *text,
+                                     void *user_ctx);
+
+// Incremental decoder for getUpdates responses. update_id, message.chat.id
+// and message.text are extracted byte by byte as an update arrives; the
+// update itself is never buffered, so neither its size nor where the text
+// lies in it (after a long reply_to_message, say) loses the message.
+typedef struct {
+    telegram_update_cb_t on_update;
+    void *user_ctx;
+
+    int depth;
+    uint32_t objects;               // Bit d: the container at depth d is an object
+    bool expect_key;                // The next string is a member name
+    bool in_string;
+    bool in_key;
+    bool escape;
+    char key[12];                   // Last member name at the current depth
+    size_t key_len;
+    bool in_result;                 // Inside the top-level "result" array
+
+    bool capturing;                 // Inside a result element
+    int message_depth;              // Depth of message's members, 0 outside
+    int chat_depth;                 // Depth of message.chat's members, 0 outside
+    int field;                      // Value being extracted (telegram_update.c)
+    char number[24];
+    size_t number_len;
+    uint32_t unicode;               // \uXXXX escape being read
+    int unicode_digits;             // Hex digits still expected, 0 outside one
+    uint32_t high_surrogate;        // First half of a UTF-16 pair, 0 if none
+    telegram_update_t update;
+    char text[INPUT_MAX_LEN + 1];
+    size_t text_len;
+
+    bool result_done;               // Closing bracket of "result" seen
+    bool stopped;                   // Callback asked to stop
+    int updates;                    // Elements handed to the callback
+} telegram_update_stream_t;
+
+// Reset the splitter for a new response.
+void telegram_update_stream_init(telegram_update_stream_t *stream,
+                                 telegram_update_cb_t on_update, void *user_ctx);
+
+// Feed raw body bytes as they arrive (any split is fine).
+void telegram_update_stream_feed(telegram_update_stream_t *stream, const char *data, size_t len);
+
 #endif // TELEGRAM_UPDATE_H
@@ -0,0 +1,103 @@
+#include "tls_session.h"
+#include "config.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "tls";
+
+typedef struct {
+    const char *host;
+    tls_session_stats_t stats;
+} tls_host_entry_t;
+
+// Fixed host table: every endpoint the firmware talks to is known at build time,
+// so entries never need allocation or locking.
+static tls_host_entry_t s_hosts[] = {
+    { .host = "api.anthropic.com" },
+    { .host = "api.openai.com" },
+    { .host = "openrouter.ai" },
+    { .host = "api.telegram.org" },
+};
+
+#define TLS_HOST_COUNT (sizeof(s_hosts) / sizeof(s_hosts[0]))
+
+static tls_host_entry_t *find_host(const char *url)
+{
+    if (!url) {
+        return NULL;
+    }
+
+    const char *host = strstr(url, "://");
+    host = host ? host + 3 : url;
+
+    for (size_t i = 0; i < TLS_HOST_COUNT; i++) {
+        size_t len = strlen(s_hosts[i].host);
+        if (strncmp(host, s_hosts[i].host, len) == 0 &&
+            (host[len] == '\0' || host[len] == '/' || host[len] == ':')) {
+            return &s_hosts[i];
+        }
+    }
+    return NULL;
+}
+
+void tls_session_prepare(esp_http_client_config_t *config)
+{
+    if (!config) {
+        return;
+    }
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    config->save_client_session = true;
+#endif
+}
+
+bool tls_session_record_connect(tls_session_t *session, const char *url, uint32_t connect_ms)
+{
+    if (!session) {
+        return false;
+    }
+
+    bool offered = session->ticket_cached;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    session->ticket_cached = true;
+#endif
+
+    tls_host_entry_t *entry = find_host(url);
+    if (!entry) {
+        return offered;
+    }
+
+    if (offered) {
+        entry->stats.ticket_offered_count++;
+        entry->stats.ticket_offered_ms_total += connect_ms;
+    } else {
+        entry->stats.full_count++;
+        entry->stats.full_ms_total += connect_ms;
+    }
+
+    const tls_session_stats_t *s = &entry->stats;
+    ESP_LOGI(TAG, "METRIC tls host=%s ticket=%s connect_ms=%u full=%u/%ums ticket_offered=%u/%ums",
+             entry->host, offered ? "offered" : "none", (unsigned)connect_ms,
+             (unsigned)s->full_count,
+             (unsigned)(s->full_count ? s->full_ms_total / s->full_count : 0),
+             (unsigned)s->ticket_offered_count,
+             (unsigned)(s->ticket_offered_count ?
+                        s->ticket_offered_ms_total / s->ticket_offered_count : 0));
+    return offered;
+}
+
+void tls_session_forget(tls_session_t *session)
+{
+    if (session) {
+        session->ticket_cached = false;
+    }
+}
+
+bool tls_session_get_stats(const char *url, tls_session_stats_t *out)
+{
+    tls_host_entry_t *entry = find_host(url);
+    if (!entry || !out) {
+        return false;
+    }
+    *out = entry->stats;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef TLS_SESSION_H
+#define TLS_SESSION_H
+
+#include "esp_http_client.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Per-host connection setup statistics (DNS + TCP + TLS handshake).
+// esp_http_client does not report whether the server accepted a ticket, so
+// ticket_offered counts attempts at resumption, not resumed handshakes.
+typedef struct {
+    uint32_t full_count;            // Handshakes with no cached session ticket to offer
+    uint32_t full_ms_total;
+    uint32_t ticket_offered_count;  // Handshakes where a cached session ticket was offered
+    uint32_t ticket_offered_ms_total;
+} tls_session_stats_t;
+
+// Ticket state of one client handle. Tickets live inside the handle, so each
+// long-lived client keeps its own, beside the handle it describes.
+typedef struct {
+    bool ticket_cached;
+} tls_session_t;
+
+// Enable client session-ticket caching on an HTTPS client config.
+// Tickets live inside the client handle, so long-lived handles resume
+// handshakes after the server closes an idle connection.
+void tls_session_prepare(esp_http_client_config_t *config);
+
+// Record one completed connection setup by session's client, for the host of url.
+// Returns true when a cached session ticket was offered.
+bool tls_session_record_connect(tls_session_t *session, const char *url, uint32_t connect_ms);
+
+// Forget session's cached ticket (call when its client handle is destroyed).
+void tls_session_forget(tls_session_t *session);
+
+// Copy stats for the host of url. Returns false for unknown hosts.
+bool tls_session_get_stats(const char *url, tls_session_stats_t *out);
+
+#endif // TLS_SESSION_H
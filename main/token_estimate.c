@@ -0,0 +1,85 @@
+#include "token_estimate.h"
+#include <stdbool.h>
+
+// Typical BPE vocabularies (cl100k, Claude) hold most English words whole,
+// split digit runs into groups of up to 3, merge short punctuation runs such
+// as ":" or "},{", and give JSON escapes a token each; a leading space merges
+// into the following word.
+#define WORD_CHARS_PER_TOKEN    5
+#define DIGITS_PER_TOKEN        3
+#define PUNCT_CHARS_PER_TOKEN   3
+
+static bool is_letter(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_digit(unsigned char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool is_punct(unsigned char c)
+{
+    return c > ' ' && c < 0x80 && c != '\\' && !is_letter(c) && !is_digit(c);
+}
+
+size_t token_estimate(const char *text, size_t len)
+{
+    size_t tokens = 0;
+    size_t i = 0;
+
+    if (!text) {
+        return 0;
+    }
+
+    while (i < len) {
+        unsigned char c = (unsigned char)text[i];
+        size_t run = 0;
+
+        if (is_letter(c)) {
+            while (i < len && is_letter((unsigned char)text[i])) {
+                i++;
+                run++;
+            }
+            tokens += (run + WORD_CHARS_PER_TOKEN - 1) / WORD_CHARS_PER_TOKEN;
+        } else if (is_digit(c)) {
+            while (i < len && is_digit((unsigned char)text[i])) {
+                i++;
+                run++;
+            }
+            tokens += (run + DIGITS_PER_TOKEN - 1) / DIGITS_PER_TOKEN;
+        } else if (c == ' ') {
+            // Merges into the next word; runs of spaces still cost a token.
+            while (i < len && text[i] == ' ') {
+                i++;
+                run++;
+            }
+            if (run > 1) {
+                tokens++;
+            }
+        } else if (c == '\\' && i + 1 < len) {
+            // A JSON escape such as \n or \" reads as one token.
+            i += (text[i + 1] == 'u') ? 6 : 2;
+            tokens++;
+        } else if (c >= 0x80) {
+            // One per UTF-8 code point: skip its continuation bytes.
+            i++;
+            while (i < len && ((unsigned char)text[i] & 0xC0) == 0x80) {
+                i++;
+            }
+            tokens++;
+        } else if (is_punct(c)) {
+            while (i < len && is_punct((unsigned char)text[i])) {
+                i++;
+                run++;
+            }
+            tokens += (run + PUNCT_CHARS_PER_TOKEN - 1) / PUNCT_CHARS_PER_TOKEN;
+        } else {
+            // Tabs, newlines and other control bytes
+            i++;
+            tokens++;
+        }
+    }
+    return tokens;
+}
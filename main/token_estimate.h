@@ -0,0 +1,11 @@
+#ifndef TOKEN_ESTIMATE_H
+#define TOKEN_ESTIMATE_H
+
+#include <stddef.h>
+
+// Approximate the number of BPE tokens an LLM provider counts for text
+// (e.g. a serialized request). Errs on the high side for JSON and IDs so a
+// budget based on it is rarely exceeded. No allocation; one pass.
+size_t token_estimate(const char *text, size_t len);
+
+#endif // TOKEN_ESTIMATE_H
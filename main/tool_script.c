@@ -0,0 +1,213 @@
+#include "tool_script.h"
+#include "tools.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "script";
+
+// Tools a cron script may call. Anything that blocks (delay), edits the
+// schedule or the user tools, or reads agent state stays with the agent task.
+static const char *const s_cron_tools[] = {
+    "gpio_write", "gpio_read", "i2c_scan",
+    "memory_set", "memory_get", "memory_list", "memory_delete",
+    "get_time", "get_timezone",
+};
+
+static bool is_builtin_tool(const char *name)
+{
+    int count = 0;
+    const tool_def_t *tools = tools_get_all(&count);
+    for (int i = 0; tools && i < count; i++) {
+        if (strcmp(tools[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool scope_allows(tool_script_scope_t scope, const char *name)
+{
+    if (scope == TOOL_SCRIPT_AGENT) {
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(s_cron_tools) / sizeof(s_cron_tools[0]); i++) {
+        if (strcmp(s_cron_tools[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check a script's shape: returns the step count, or -1 with a message in error.
+static int check_script(const cJSON *script, int max_steps, char *error, size_t error_len)
+{
+    if (!cJSON_IsArray(script)) {
+        snprintf(error, error_len, "Error: steps must be an array of {tool, input}");
+        return -1;
+    }
+    int count = cJSON_GetArraySize(script);
+    if (count < 1 || count > max_steps) {
+        snprintf(error, error_len, "Error: steps must hold 1-%d tool calls", max_steps);
+        return -1;
+    }
+    return count;
+}
+
+// Check step i (0-based) of a script; false with a message in error.
+static bool check_step(const cJSON *item, int i, tool_script_scope_t scope,
+                       char *error, size_t error_len)
+{
+    const cJSON *tool_json = cJSON_GetObjectItem(item, "tool");
+    const cJSON *input_json = cJSON_GetObjectItem(item, "input");
+
+    if (!cJSON_IsString(tool_json) || !is_builtin_tool(tool_json->valuestring)) {
+        snprintf(error, error_len, "Error: step %d must name a built-in tool", i + 1);
+        return false;
+    }
+    if (!scope_allows(scope, tool_json->valuestring)) {
+        snprintf(error, error_len, "Error: step %d: %s cannot run in a schedule "
+                 "(gpio, i2c, memory and time tools only)", i + 1, tool_json->valuestring);
+        return false;
+    }
+    if (input_json && !cJSON_IsObject(input_json)) {
+        snprintf(error, error_len, "Error: step %d input must be an object", i + 1);
+        return false;
+    }
+    return true;
+}
+
+int tool_script_parse(const cJSON *script, tool_script_scope_t scope, tool_step_t *steps,
+                      int max_steps, char *error, size_t error_len)
+{
+    int count = check_script(script, max_steps, error, error_len);
+    if (count < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const cJSON *item = cJSON_GetArrayItem(script, i);
+        if (!check_step(item, i, scope, error, error_len)) {
+            return -1;
+        }
+
+        const cJSON *tool_json = cJSON_GetObjectItem(item, "tool");
+        const cJSON *input_json = cJSON_GetObjectItem(item, "input");
+        char *input_str = input_json ? cJSON_PrintUnformatted(input_json) : NULL;
+        const char *input = input_str ? input_str : "{}";
+        bool fits = strlen(tool_json->valuestring) < sizeof(steps[i].tool) &&
+                    strlen(input) < sizeof(steps[i].input);
+        if (fits) {
+            memcpy(steps[i].tool, tool_json->valuestring, strlen(tool_json->valuestring) + 1);
+            memcpy(steps[i].input, input, strlen(input) + 1);
+        }
+        free(input_str);
+        if (!fits) {
+            snprintf(error, error_len, "Error: step %d input too long (max %d chars)",
+                     i + 1, TOOL_STEP_INPUT_LEN - 1);
+            return -1;
+        }
+    }
+    return count;
+}
+
+int tool_script_check(const cJSON *script, tool_script_scope_t scope, int max_steps,
+                      char *error, size_t error_len)
+{
+    int count = check_script(script, max_steps, error, error_len);
+    for (int i = 0; i < count; i++) {
+        if (!check_step(cJSON_GetArrayItem(script, i), i, scope, error, error_len)) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+bool tool_script_to_json(const tool_step_t *steps, int step_count, char *buf, size_t buf_len)
+{
+    size_t len = 0;
+    for (int i = 0; i < step_count; i++) {
+        int written = snprintf(buf + len, buf_len - len, "%s{\"tool\":\"%s\",\"input\":%s}",
+                               i == 0 ? "[" : ",", steps[i].tool, steps[i].input);
+        if (written < 0 || (size_t)written >= buf_len - len) {
+            return false;
+        }
+        len += (size_t)written;
+    }
+    if (step_count <= 0 || len + 2 > buf_len) {
+        return false;
+    }
+    memcpy(buf + len, "]", 2);
+    return true;
+}
+
+// Run one step, appending "\n<tool>: <result>" at *len. input NULL means the
+// stored input did not parse.
+static bool run_step(const char *tool, const cJSON *input, char *result, size_t result_len,
+                     size_t *len)
+{
+    char overflow[64];
+    int written = snprintf(result + *len, result_len - *len, "\n%s: ", tool);
+    if (written > 0 && (size_t)written < result_len - *len) {
+        *len += (size_t)written;
+    } else {
+        *len = result_len - 1;
+    }
+
+    // A full result still runs the step, into a scratch buffer.
+    char *out = result + *len;
+    size_t out_len = result_len - *len;
+    if (out_len < 2) {
+        out = overflow;
+        out_len = sizeof(overflow);
+    }
+    bool ok = false;
+    if (input) {
+        ok = tools_execute(tool, input, out, out_len);
+    } else {
+        snprintf(out, out_len, "Error: invalid stored input");
+    }
+    if (out != overflow) {
+        *len += strlen(out);
+    }
+    return ok;
+}
+
+int tool_script_run(const tool_step_t *steps, int step_count, char *result, size_t result_len)
+{
+    size_t len = strlen(result);
+
+    for (int i = 0; i < step_count; i++) {
+        cJSON *input = cJSON_Parse(steps[i].input);
+        bool ok = run_step(steps[i].tool, input, result, result_len, &len);
+        cJSON_Delete(input);
+
+        if (!ok) {
+            ESP_LOGW(TAG, "Step %d of %d (%s) failed", i + 1, step_count, steps[i].tool);
+            return i;
+        }
+    }
+    return step_count;
+}
+
+int tool_script_run_json(const cJSON *script, char *result, size_t result_len)
+{
+    int step_count = cJSON_GetArraySize(script);
+    size_t len = strlen(result);
+
+    for (int i = 0; i < step_count; i++) {
+        const cJSON *item = cJSON_GetArrayItem(script, i);
+        const char *tool = cJSON_GetObjectItem(item, "tool")->valuestring;
+        const cJSON *input = cJSON_GetObjectItem(item, "input");
+        cJSON *empty = input ? NULL : cJSON_CreateObject();
+
+        bool ok = run_step(tool, input ? input : empty, result, result_len, &len);
+        cJSON_Delete(empty);
+        if (!ok) {
+            ESP_LOGW(TAG, "Step %d of %d (%s) failed", i + 1, step_count, tool);
+            return i;
+        }
+    }
+    return step_count;
+}
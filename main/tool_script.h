@@ -0,0 +1,50 @@
+#ifndef TOOL_SCRIPT_H
+#define TOOL_SCRIPT_H
+
+#include "config.h"
+#include "cJSON.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Ordered built-in tool calls run without the LLM: the recordings of user
+// tools (user_tools.h) and scripted cron entries (cron.h). As JSON, a
+// script is [{"tool":"gpio_write","input":{"pin":4,"state":1}}, ...].
+
+// Where a script runs, which decides the tools it may call
+typedef enum {
+    TOOL_SCRIPT_AGENT,              // On the agent task (plans, user tools): any built-in
+    TOOL_SCRIPT_CRON,               // On the cron task, beside the agent: only gpio, i2c,
+                                    // memory and time lookups, which neither block nor
+                                    // touch agent or schedule state
+} tool_script_scope_t;
+
+// One built-in tool call
+typedef struct {
+    char tool[TOOL_NAME_MAX_LEN];
+    char input[TOOL_STEP_INPUT_LEN];    // Unformatted JSON object
+} tool_step_t;
+
+// Parse and validate a JSON script: 1..max_steps steps, each naming a
+// built-in tool the scope allows, with an object input (missing means {}).
+// Returns the step count, or -1 with a message in error.
+int tool_script_parse(const cJSON *script, tool_script_scope_t scope, tool_step_t *steps,
+                      int max_steps, char *error, size_t error_len);
+
+// Validate a JSON script as tool_script_parse does, without copying the
+// steps: for scripts run once, straight from the JSON, whose inputs need not
+// fit TOOL_STEP_INPUT_LEN. Returns the step count, or -1 with a message in error.
+int tool_script_check(const cJSON *script, tool_script_scope_t scope, int max_steps,
+                      char *error, size_t error_len);
+
+// Serialize steps as a JSON script. False if it does not fit in buf.
+bool tool_script_to_json(const tool_step_t *steps, int step_count, char *buf, size_t buf_len);
+
+// Run steps in order via tools_execute, stopping at the first failure.
+// Appends "\n<tool>: <result>" per step to result (truncated if full; the
+// steps still run). Returns how many steps succeeded.
+int tool_script_run(const tool_step_t *steps, int step_count, char *result, size_t result_len);
+
+// tool_script_run for a script that passed tool_script_check.
+int tool_script_run_json(const cJSON *script, char *result, size_t result_len);
+
+#endif // TOOL_SCRIPT_H
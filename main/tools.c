@@ -65,8 +65,8 @@ static const tool_def_t s_tools[] = {
     // Cron/Scheduler
     {
         .name = "cron_set",
-        .description = "Create a scheduled task. Type 'periodic' runs every N minutes. Type 'daily' runs at a specific local time in the device timezone (see set_timezone/get_timezone). Type 'once' runs one time after N minutes.",
-        .input_schema_json = "{\"type\":\"object\",\"properties\":{\"type\":{\"type\":\"string\",\"enum\":[\"periodic\",\"daily\",\"once\"]},\"interval_minutes\":{\"type\":\"integer\",\"description\":\"For periodic: minutes between runs\"},\"delay_minutes\":{\"type\":\"integer\",\"description\":\"For once: minutes from now before one-time run\"},\"hour\":{\"type\":\"integer\",\"description\":\"For daily: hour 0-23\"},\"minute\":{\"type\":\"integer\",\"description\":\"For daily: minute 0-59\"},\"action\":{\"type\":\"string\",\"description\":\"What to do when triggered\"}},\"required\":[\"type\",\"action\"]}",
+        .description = "Create a scheduled task. Type 'periodic' runs every N minutes. Type 'daily' runs at a specific local time in the device timezone (see set_timezone/get_timezone). Type 'once' runs one time after N minutes. For fixed tool calls (e.g. turn a pin on) give steps: they run on the device without you; set report=true only if the user wants a written report.",
+        .input_schema_json = "{\"type\":\"object\",\"properties\":{\"type\":{\"type\":\"string\",\"enum\":[\"periodic\",\"daily\",\"once\"]},\"interval_minutes\":{\"type\":\"integer\",\"description\":\"For periodic: minutes between runs\"},\"delay_minutes\":{\"type\":\"integer\",\"description\":\"For once: minutes from now before one-time run\"},\"hour\":{\"type\":\"integer\",\"description\":\"For daily: hour 0-23\"},\"minute\":{\"type\":\"integer\",\"description\":\"For daily: minute 0-59\"},\"action\":{\"type\":\"string\",\"description\":\"What to do when triggered (with steps: a label, or the report to write)\"},\"steps\":{\"type\":\"array\",\"description\":\"Optional gpio, i2c, memory or time tool calls run in order, max 4\",\"items\":{\"type\":\"object\",\"properties\":{\"tool\":{\"type\":\"string\"},\"input\":{\"type\":\"object\"}},\"required\":[\"tool\"]}},\"report\":{\"type\":\"boolean\",\"description\":\"With steps: have the model report the results (default false)\"}},\"required\":[\"type\",\"action\"]}",
         .execute = tools_cron_set_handler
     },
     {
@@ -116,8 +116,8 @@ static const tool_def_t s_tools[] = {
     // User Tool Management
     {
         .name = "create_tool",
-        .description = "Create a custom tool. Provide a short name (no spaces), brief description, and the action to perform when called.",
-        .input_schema_json = "{\"type\":\"object\",\"properties\":{\"name\":{\"type\":\"string\",\"description\":\"Tool name (alphanumeric, no spaces)\"},\"description\":{\"type\":\"string\",\"description\":\"Short description for tool list\"},\"action\":{\"type\":\"string\",\"description\":\"What to do when tool is called\"}},\"required\":[\"name\",\"description\",\"action\"]}",
+        .description = "Create a custom tool. Provide a short name (no spaces), brief description, and the action to perform when called. Its first successful run is recorded and replayed on later calls; set replay=false if the action depends on context.",
+        .input_schema_json = "{\"type\":\"object\",\"properties\":{\"name\":{\"type\":\"string\",\"description\":\"Tool name (alphanumeric, no spaces)\"},\"description\":{\"type\":\"string\",\"description\":\"Short description for tool list\"},\"action\":{\"type\":\"string\",\"description\":\"What to do when tool is called\"},\"replay\":{\"type\":\"boolean\",\"description\":\"Replay the recorded tool calls of the first run (default true)\"}},\"required\":[\"name\",\"description\",\"action\"]}",
         .execute = tools_create_tool_handler
     },
     {
@@ -132,6 +132,12 @@ static const tool_def_t s_tools[] = {
         .input_schema_json = "{\"type\":\"object\",\"properties\":{\"name\":{\"type\":\"string\",\"description\":\"Tool name to delete\"}},\"required\":[\"name\"]}",
         .execute = tools_delete_user_tool_handler
     },
+    {
+        .name = "reset_user_tool",
+        .description = "Forget the recorded tool calls of a user tool so its next call is carried out and recorded again. Optionally turn replay on or off.",
+        .input_schema_json = "{\"type\":\"object\",\"properties\":{\"name\":{\"type\":\"string\",\"description\":\"User tool name\"},\"replay\":{\"type\":\"boolean\",\"description\":\"Replay recorded calls on later runs\"}},\"required\":[\"name\"]}",
+        .execute = tools_reset_user_tool_handler
+    },
 };
 
 static const int s_tool_count = sizeof(s_tools) / sizeof(s_tools[0]);
@@ -1,6 +1,7 @@
 #include "tools_handlers.h"
 #include "cron.h"
 #include "cron_utils.h"
+#include "tool_script.h"
 #include "config.h"
 #include "tools_common.h"
 #include <stdio.h>
@@ -190,7 +191,30 @@ bool tools_cron_set_handler(const cJSON *input, char *result, size_t result_len)
         return false;
     }
 
-    uint8_t id = cron_set(type, interval_or_hour, minute, action);
+    // Optional script: validated now, run by the cron task without the LLM.
+    cJSON *steps_json = cJSON_GetObjectItem(input, "steps");
+    cJSON *report_json = cJSON_GetObjectItem(input, "report");
+    char script[CRON_MAX_SCRIPT_LEN] = "";
+    if (report_json && !cJSON_IsBool(report_json)) {
+        snprintf(result, result_len, "Error: 'report' must be true or false");
+        return false;
+    }
+    if (steps_json) {
+        tool_step_t steps[TOOL_SCRIPT_MAX_STEPS];
+        int step_count = tool_script_parse(steps_json, TOOL_SCRIPT_CRON, steps,
+                                           TOOL_SCRIPT_MAX_STEPS, result, result_len);
+        if (step_count < 0) {
+            return false;
+        }
+        if (!tool_script_to_json(steps, step_count, script, sizeof(script))) {
+            snprintf(result, result_len, "Error: steps too long (max %d chars as JSON)",
+                     CRON_MAX_SCRIPT_LEN - 1);
+            return false;
+        }
+    }
+
+    uint8_t id = cron_set_script(type, interval_or_hour, minute, action,
+                                 script[0] ? script : NULL, cJSON_IsTrue(report_json));
     if (id > 0) {
         if (type == CRON_TYPE_PERIODIC) {
             snprintf(result, result_len, "Created schedule #%d: every %d min → %s",
@@ -36,5 +36,6 @@ bool tools_get_health_handler(const cJSON *input, char *result, size_t result_le
 bool tools_create_tool_handler(const cJSON *input, char *result, size_t result_len);
 bool tools_list_user_tools_handler(const cJSON *input, char *result, size_t result_len);
 bool tools_delete_user_tool_handler(const cJSON *input, char *result, size_t result_len);
+bool tools_reset_user_tool_handler(const cJSON *input, char *result, size_t result_len);
 
 #endif // TOOLS_HANDLERS_H
@@ -4,6 +4,7 @@
 #include "ratelimit.h"
 #include "cron.h"
 #include "user_tools.h"
+#include "agent.h"
 #include "esp_system.h"
 #include <stdio.h>
 
@@ -33,10 +34,15 @@ bool tools_get_health_handler(const cJSON *input, char *result, size_t result_le
     cron_get_timezone(timezone_posix, sizeof(timezone_posix));
     cron_get_timezone_abbrev(timezone_abbrev, sizeof(timezone_abbrev));
 
+    // Get token usage since boot
+    agent_usage_totals_t usage;
+    agent_get_usage_totals(&usage);
+
     snprintf(result, result_len,
              "Health: OK | "
              "Heap: %lu free, %lu min | "
              "Requests: %d/hr, %d/day | "
+             "Tokens: %llu in (%llu cached), %llu out over %lu requests, last %lu/%lu | "
              "Time: %s | "
              "TZ: %s (%s) | "
              "Version: %s",
@@ -44,6 +50,12 @@ bool tools_get_health_handler(const cJSON *input, char *result, size_t result_le
              (unsigned long)min_heap,
              requests_hour,
              requests_day,
+             (unsigned long long)usage.input_tokens,
+             (unsigned long long)usage.cache_read_tokens,
+             (unsigned long long)usage.output_tokens,
+             (unsigned long)usage.requests,
+             (unsigned long)usage.last_input_tokens,
+             (unsigned long)usage.last_output_tokens,
              time_synced ? "synced" : "not synced",
              timezone_posix,
              timezone_abbrev,
@@ -57,6 +69,7 @@ bool tools_create_tool_handler(const cJSON *input, char *result, size_t result_l
     cJSON *name_json = cJSON_GetObjectItem(input, "name");
     cJSON *desc_json = cJSON_GetObjectItem(input, "description");
     cJSON *action_json = cJSON_GetObjectItem(input, "action");
+    cJSON *replay_json = cJSON_GetObjectItem(input, "replay");
 
     if (!name_json || !cJSON_IsString(name_json)) {
         snprintf(result, result_len, "Error: 'name' required (string, no spaces)");
@@ -86,6 +99,10 @@ bool tools_create_tool_handler(const cJSON *input, char *result, size_t result_l
     }
 
     if (user_tools_create(name, description, action)) {
+        if (cJSON_IsFalse(replay_json) && !user_tools_set_replay(name, false)) {
+            snprintf(result, result_len, "Created tool '%s', but failed to turn off replay", name);
+            return false;
+        }
         snprintf(result, result_len, "Created tool '%s': %s", name, description);
         return true;
     }
@@ -118,3 +135,38 @@ bool tools_delete_user_tool_handler(const cJSON *input, char *result, size_t res
     snprintf(result, result_len, "Tool '%s' not found", name_json->valuestring);
     return true;
 }
+
+bool tools_reset_user_tool_handler(const cJSON *input, char *result, size_t result_len)
+{
+    cJSON *name_json = cJSON_GetObjectItem(input, "name");
+    cJSON *replay_json = cJSON_GetObjectItem(input, "replay");
+
+    if (!name_json || !cJSON_IsString(name_json)) {
+        snprintf(result, result_len, "Error: 'name' required");
+        return false;
+    }
+    if (replay_json && !cJSON_IsBool(replay_json)) {
+        snprintf(result, result_len, "Error: 'replay' must be true or false");
+        return false;
+    }
+
+    const char *name = name_json->valuestring;
+    if (!user_tools_get_recording(name)) {
+        snprintf(result, result_len, "Tool '%s' not found", name);
+        return true;
+    }
+
+    bool ok = replay_json ? user_tools_set_replay(name, cJSON_IsTrue(replay_json))
+                          : user_tools_forget(name);
+    if (!ok) {
+        snprintf(result, result_len, "Error: failed to reset tool '%s'", name);
+        return false;
+    }
+
+    if (user_tools_get_recording(name)->replay_disabled) {
+        snprintf(result, result_len, "Tool '%s' will be carried out step by step on every call", name);
+    } else {
+        snprintf(result, result_len, "Tool '%s' will be recorded again on its next call", name);
+    }
+    return true;
+}
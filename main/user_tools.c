@@ -10,9 +10,12 @@ static const char *TAG = "user_tools";
 
 // In-memory cache of user tools
 static user_tool_t s_tools[MAX_DYNAMIC_TOOLS];
+static user_tool_recording_t s_recordings[MAX_DYNAMIC_TOOLS];
 static int s_tool_count = 0;
+static uint32_t s_generation = 0;
 
 // NVS key format: "ut_<index>" for tool data
+// "ur_<index>" for its recording (absent until recorded or opted out)
 // "ut_count" for total count
 
 static bool name_conflicts_with_builtin_tool(const char *name)
@@ -36,6 +39,43 @@ static bool name_conflicts_with_builtin_tool(const char *name)
     return false;
 }
 
+static bool recording_is_empty(const user_tool_recording_t *recording)
+{
+    return recording->step_count == 0 && !recording->replay_disabled;
+}
+
+static esp_err_t write_recording(nvs_handle_t handle, int index)
+{
+    char key[16];
+    snprintf(key, sizeof(key), "ur_%d", index);
+    if (index >= s_tool_count || recording_is_empty(&s_recordings[index])) {
+        esp_err_t err = nvs_erase_key(handle, key);
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+    }
+    return nvs_set_blob(handle, key, &s_recordings[index], sizeof(user_tool_recording_t));
+}
+
+static esp_err_t save_recording(int index)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE_TOOLS, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS for writing");
+        return err;
+    }
+
+    err = write_recording(handle, index);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to persist recording of '%s': %s",
+                 s_tools[index].name, esp_err_to_name(err));
+    }
+    nvs_close(handle);
+    return err;
+}
+
 static esp_err_t save_to_nvs(void)
 {
     nvs_handle_t handle;
@@ -63,6 +103,12 @@ static esp_err_t save_to_nvs(void)
             nvs_close(handle);
             return err;
         }
+        err = write_recording(handle, i);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to persist recording slot %d: %s", i, esp_err_to_name(err));
+            nvs_close(handle);
+            return err;
+        }
     }
 
     // Clear any remaining old slots
@@ -75,6 +121,12 @@ static esp_err_t save_to_nvs(void)
             nvs_close(handle);
             return err;
         }
+        err = write_recording(handle, i);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed clearing stale recording slot %d: %s", i, esp_err_to_name(err));
+            nvs_close(handle);
+            return err;
+        }
     }
 
     err = nvs_commit(handle);
@@ -110,10 +162,21 @@ static void load_from_nvs(void)
         char key[16];
         snprintf(key, sizeof(key), "ut_%d", i);
         size_t len = sizeof(user_tool_t);
-        if (nvs_get_blob(handle, key, &s_tools[i], &len) == ESP_OK) {
-            s_tool_count++;
-            ESP_LOGI(TAG, "Loaded user tool: %s", s_tools[i].name);
+        if (nvs_get_blob(handle, key, &s_tools[s_tool_count], &len) != ESP_OK) {
+            continue;
+        }
+
+        // A recording from another firmware layout is dropped: re-recorded on next use.
+        user_tool_recording_t *recording = &s_recordings[s_tool_count];
+        snprintf(key, sizeof(key), "ur_%d", i);
+        len = sizeof(user_tool_recording_t);
+        if (nvs_get_blob(handle, key, recording, &len) != ESP_OK ||
+            len != sizeof(user_tool_recording_t) || recording->step_count > TOOL_SCRIPT_MAX_STEPS) {
+            memset(recording, 0, sizeof(*recording));
         }
+        ESP_LOGI(TAG, "Loaded user tool: %s (%d recorded steps)",
+                 s_tools[s_tool_count].name, recording->step_count);
+        s_tool_count++;
     }
 
     nvs_close(handle);
@@ -124,7 +187,9 @@ void user_tools_init(void)
 {
     s_tool_count = 0;
     memset(s_tools, 0, sizeof(s_tools));
+    memset(s_recordings, 0, sizeof(s_recordings));
     load_from_nvs();
+    s_generation++;
 }
 
 bool user_tools_create(const char *name, const char *description, const char *action)
@@ -164,6 +229,8 @@ bool user_tools_create(const char *name, const char *description, const char *ac
     strncpy(tool->action, action, CRON_MAX_ACTION_LEN - 1);
     tool->action[CRON_MAX_ACTION_LEN - 1] = '\0';
 
+    memset(&s_recordings[s_tool_count], 0, sizeof(user_tool_recording_t));
+
     s_tool_count++;
     esp_err_t save_err = save_to_nvs();
     if (save_err != ESP_OK) {
@@ -173,6 +240,7 @@ bool user_tools_create(const char *name, const char *description, const char *ac
         return false;
     }
 
+    s_generation++;
     ESP_LOGI(TAG, "Created user tool: %s", name);
     return true;
 }
@@ -183,26 +251,33 @@ bool user_tools_delete(const char *name)
         return false;
     }
 
-    user_tool_t previous_tools[MAX_DYNAMIC_TOOLS];
-    memcpy(previous_tools, s_tools, sizeof(previous_tools));
-    int previous_count = s_tool_count;
-
     for (int i = 0; i < s_tool_count; i++) {
         if (strcmp(s_tools[i].name, name) == 0) {
+            user_tool_t removed = s_tools[i];
+            user_tool_recording_t removed_recording = s_recordings[i];
+
             // Shift remaining tools down
             for (int j = i; j < s_tool_count - 1; j++) {
                 s_tools[j] = s_tools[j + 1];
+                s_recordings[j] = s_recordings[j + 1];
             }
             s_tool_count--;
             memset(&s_tools[s_tool_count], 0, sizeof(user_tool_t));
+            memset(&s_recordings[s_tool_count], 0, sizeof(user_tool_recording_t));
             esp_err_t save_err = save_to_nvs();
             if (save_err != ESP_OK) {
-                memcpy(s_tools, previous_tools, sizeof(s_tools));
-                s_tool_count = previous_count;
+                for (int j = s_tool_count; j > i; j--) {
+                    s_tools[j] = s_tools[j - 1];
+                    s_recordings[j] = s_recordings[j - 1];
+                }
+                s_tools[i] = removed;
+                s_recordings[i] = removed_recording;
+                s_tool_count++;
                 ESP_LOGE(TAG, "Failed to persist deletion of '%s': %s",
                          name, esp_err_to_name(save_err));
                 return false;
             }
+            s_generation++;
             ESP_LOGI(TAG, "Deleted user tool: %s", name);
             return true;
         }
@@ -235,11 +310,102 @@ const user_tool_t *user_tools_find(const char *name)
     return NULL;
 }
 
+static int find_index(const char *name)
+{
+    if (!name) {
+        return -1;
+    }
+    for (int i = 0; i < s_tool_count; i++) {
+        if (strcmp(s_tools[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const user_tool_recording_t *user_tools_get_recording(const char *name)
+{
+    int index = find_index(name);
+    return index >= 0 ? &s_recordings[index] : NULL;
+}
+
+bool user_tools_record(const char *name, const tool_step_t *steps, int step_count)
+{
+    int index = find_index(name);
+    if (index < 0 || !steps || step_count <= 0 || step_count > TOOL_SCRIPT_MAX_STEPS ||
+        s_recordings[index].replay_disabled) {
+        return false;
+    }
+
+    user_tool_recording_t previous = s_recordings[index];
+    user_tool_recording_t *recording = &s_recordings[index];
+    memset(recording, 0, sizeof(*recording));
+    for (int i = 0; i < step_count; i++) {
+        snprintf(recording->steps[i].tool, sizeof(recording->steps[i].tool), "%s", steps[i].tool);
+        snprintf(recording->steps[i].input, sizeof(recording->steps[i].input), "%s", steps[i].input);
+    }
+    recording->step_count = (uint8_t)step_count;
+
+    if (save_recording(index) != ESP_OK) {
+        s_recordings[index] = previous;
+        return false;
+    }
+    ESP_LOGI(TAG, "Recorded %d steps for user tool: %s", step_count, name);
+    return true;
+}
+
+static bool update_recording(const char *name, bool replay_disabled)
+{
+    int index = find_index(name);
+    if (index < 0) {
+        return false;
+    }
+
+    user_tool_recording_t previous = s_recordings[index];
+    memset(&s_recordings[index], 0, sizeof(user_tool_recording_t));
+    s_recordings[index].replay_disabled = replay_disabled;
+    if (memcmp(&previous, &s_recordings[index], sizeof(previous)) == 0) {
+        return true;
+    }
+    if (save_recording(index) != ESP_OK) {
+        s_recordings[index] = previous;
+        return false;
+    }
+    return true;
+}
+
+bool user_tools_forget(const char *name)
+{
+    int index = find_index(name);
+    if (index < 0) {
+        return false;
+    }
+    if (!update_recording(name, s_recordings[index].replay_disabled)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Forgot recording of user tool: %s", name);
+    return true;
+}
+
+bool user_tools_set_replay(const char *name, bool enabled)
+{
+    if (!update_recording(name, !enabled)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Replay %s for user tool: %s", enabled ? "enabled" : "disabled", name);
+    return true;
+}
+
 int user_tools_count(void)
 {
     return s_tool_count;
 }
 
+uint32_t user_tools_generation(void)
+{
+    return s_generation;
+}
+
 void user_tools_list(char *buf, size_t buf_len)
 {
     if (!buf || buf_len == 0) {
@@ -260,8 +426,14 @@ void user_tools_list(char *buf, size_t buf_len)
     }
 
     for (int i = 0; i < s_tool_count && remaining > 20; i++) {
-        written = snprintf(ptr, remaining, "\n  %s - %s",
-                          s_tools[i].name, s_tools[i].description);
+        char replay[24] = "";
+        if (s_recordings[i].replay_disabled) {
+            snprintf(replay, sizeof(replay), " [no replay]");
+        } else if (s_recordings[i].step_count > 0) {
+            snprintf(replay, sizeof(replay), " [replays %d steps]", s_recordings[i].step_count);
+        }
+        written = snprintf(ptr, remaining, "\n  %s - %s%s",
+                          s_tools[i].name, s_tools[i].description, replay);
         if (written > 0 && (size_t)written < remaining) {
             ptr += written;
             remaining -= written;
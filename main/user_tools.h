@@ -2,8 +2,10 @@
 #define USER_TOOLS_H
 
 #include "config.h"
+#include "tool_script.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // User-defined tool (stored in NVS)
 typedef struct {
@@ -12,6 +14,15 @@ typedef struct {
     char action[CRON_MAX_ACTION_LEN];  // Natural language action to execute
 } user_tool_t;
 
+// Built-in calls the model made the first time a user tool ran
+// successfully. Later calls replay them locally instead of handing the
+// action back to the model. Stored in NVS next to the tool.
+typedef struct {
+    bool replay_disabled;       // Action depends on context: always ask the model
+    uint8_t step_count;         // 0 until recorded
+    tool_step_t steps[TOOL_SCRIPT_MAX_STEPS];
+} user_tool_recording_t;
+
 // Initialize user tools (load from NVS)
 void user_tools_init(void);
 
@@ -30,9 +41,25 @@ int user_tools_get_all(user_tool_t *tools, int max_count);
 // Returns NULL if not found
 const user_tool_t *user_tools_find(const char *name);
 
+// Recording of a user tool, NULL if the tool does not exist
+const user_tool_recording_t *user_tools_get_recording(const char *name);
+
+// Store the steps of a successful run (persists to NVS). Fails if replay
+// is disabled for the tool or step_count is out of range.
+bool user_tools_record(const char *name, const tool_step_t *steps, int step_count);
+
+// Drop a tool's recording so the next call is recorded again
+bool user_tools_forget(const char *name);
+
+// Allow or forbid replay for a tool; either way the recording is dropped
+bool user_tools_set_replay(const char *name, bool enabled);
+
 // Get count of user tools
 int user_tools_count(void);
 
+// Changes whenever the set of user tools changes (load, create, delete)
+uint32_t user_tools_generation(void);
+
 // List user tools into buffer (for display)
 void user_tools_list(char *buf, size_t buf_len);
 
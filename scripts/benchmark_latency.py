@@ -33,7 +33,10 @@ class RequestSample:
     device_llm_ms: int | None
     device_tool_ms: int | None
     device_rounds: int | None
+    device_agent: str | None
     device_outcome: str | None
+    device_in_tokens: int | None
+    device_out_tokens: int | None
 
 
 def parse_args() -> argparse.Namespace:
@@ -162,7 +165,7 @@ def percentile(values: list[float], pct: float) -> float:
     return sorted_values[lower] * (1.0 - weight) + sorted_values[upper] * weight
 
 
-def print_summary(title: str, values: list[float]) -> None:
+def print_summary(title: str, values: list[float], unit: str = "ms") -> None:
     if not values:
         print(f"  {title}: n/a")
         return
@@ -171,9 +174,9 @@ def print_summary(title: str, values: list[float]) -> None:
     stdev = statistics.pstdev(values) if len(values) > 1 else 0.0
     print(
         f"  {title}: n={len(values)} "
-        f"min={min(values):.1f}ms p50={percentile(values, 0.50):.1f}ms "
-        f"p90={percentile(values, 0.90):.1f}ms p95={percentile(values, 0.95):.1f}ms "
-        f"max={max(values):.1f}ms mean={mean:.1f}ms stdev={stdev:.1f}ms"
+        f"min={min(values):.1f}{unit} p50={percentile(values, 0.50):.1f}{unit} "
+        f"p90={percentile(values, 0.90):.1f}{unit} p95={percentile(values, 0.95):.1f}{unit} "
+        f"max={max(values):.1f}{unit} mean={mean:.1f}{unit} stdev={stdev:.1f}{unit}"
     )
 
 
@@ -262,7 +265,10 @@ def run_relay_request(
         device_llm_ms=None,
         device_tool_ms=None,
         device_rounds=None,
+        device_agent=None,
         device_outcome=None,
+        device_in_tokens=None,
+        device_out_tokens=None,
     )
 
 
@@ -338,7 +344,10 @@ def run_serial_request(
         device_llm_ms=try_parse_int((latest_metric or {}).get("llm_ms")),
         device_tool_ms=try_parse_int((latest_metric or {}).get("tool_ms")),
         device_rounds=try_parse_int((latest_metric or {}).get("rounds")),
+        device_agent=(latest_metric or {}).get("agent"),
         device_outcome=(latest_metric or {}).get("outcome"),
+        device_in_tokens=try_parse_int((latest_metric or {}).get("in_tokens")),
+        device_out_tokens=try_parse_int((latest_metric or {}).get("out_tokens")),
     )
     return sample, response_lines
 
@@ -420,10 +429,20 @@ def run_serial_benchmark(args: argparse.Namespace) -> list[RequestSample]:
                     if sample.device_total_ms is not None
                     else ""
                 )
+                tokens_str = (
+                    f" tokens={sample.device_in_tokens}/{sample.device_out_tokens}"
+                    if sample.device_in_tokens is not None and sample.device_out_tokens is not None
+                    else ""
+                )
+                rounds_str = (
+                    f" rounds={sample.device_rounds} agent={sample.device_agent or '?'}"
+                    if sample.device_rounds is not None
+                    else ""
+                )
                 outcome_str = f" outcome={sample.device_outcome}" if sample.device_outcome else ""
                 print(
                     f"  [{len(samples)}/{args.count}] {phase} host={sample.host_total_ms:.1f}ms"
-                    f"{first_str}{device_str}{outcome_str}"
+                    f"{first_str}{device_str}{tokens_str}{rounds_str}{outcome_str}"
                 )
 
                 if args.log_lines:
@@ -471,6 +490,16 @@ def print_benchmark_summary(mode: str, samples: list[RequestSample]) -> None:
     if device_tool_values:
         print_summary("Device tools", device_tool_values)
 
+    # Rounds per request, split by agent mode (agent=step or agent=plan).
+    rounds_by_agent: dict[str, list[float]] = {}
+    for sample in samples:
+        if sample.device_rounds is None:
+            continue
+        agent = sample.device_agent or "unknown"
+        rounds_by_agent.setdefault(agent, []).append(float(sample.device_rounds))
+    for agent, rounds in sorted(rounds_by_agent.items()):
+        print_summary(f"Device rounds ({agent} mode)", rounds, unit="")
+
     # Explicitly attribute on-device latency when full stage metrics are available.
     stage_pairs: list[tuple[float, float, float]] = []
     for sample in samples:
@@ -506,6 +535,22 @@ def print_benchmark_summary(mode: str, samples: list[RequestSample]) -> None:
             f"us={p50_us:.1f}ms ({pct(p50_us, p50_total):.1f}%)"
         )
 
+    # Token-normalized LLM latency: output speed, and cost of prompt size.
+    tokens_per_s: list[float] = []
+    ms_per_1k_input: list[float] = []
+    for sample in samples:
+        if not sample.device_llm_ms or sample.device_llm_ms <= 0:
+            continue
+        if sample.device_out_tokens:
+            tokens_per_s.append(sample.device_out_tokens / (sample.device_llm_ms / 1000.0))
+        if sample.device_in_tokens:
+            ms_per_1k_input.append(sample.device_llm_ms / (sample.device_in_tokens / 1000.0))
+
+    if tokens_per_s:
+        print_summary("Output tokens/s", tokens_per_s, unit="")
+    if ms_per_1k_input:
+        print_summary("LLM latency per 1k input tokens", ms_per_1k_input)
+
     outcomes: dict[str, int] = {}
     for sample in samples:
         if not sample.device_outcome:
@@ -10,6 +10,7 @@ WIFI_SSID=""
 WIFI_PASS=""
 BACKEND=""
 MODEL=""
+SUMMARY_MODEL=""
 API_KEY=""
 TG_TOKEN=""
 TG_CHAT_ID=""
@@ -27,6 +28,7 @@ Options:
   --pass <wifi-pass>        WiFi password (optional)
   --backend <provider>      anthropic | openai | openrouter
   --model <model-id>        Model ID (defaults by backend)
+  --summary-model <id>      Cheaper model for history summaries (optional)
   --api-key <key>           LLM API key (required unless prompted)
   --tg-token <token>        Telegram bot token (optional)
   --tg-chat-id <id>         Telegram chat ID (optional)
@@ -459,6 +461,14 @@ while [ $# -gt 0 ]; do
         --model=*)
             MODEL="${1#*=}"
             ;;
+        --summary-model)
+            shift
+            [ $# -gt 0 ] || { echo "Error: --summary-model requires a value"; exit 1; }
+            SUMMARY_MODEL="$1"
+            ;;
+        --summary-model=*)
+            SUMMARY_MODEL="${1#*=}"
+            ;;
         --api-key)
             shift
             [ $# -gt 0 ] || { echo "Error: --api-key requires a value"; exit 1; }
@@ -692,6 +702,9 @@ trap 'rm -rf "$tmpdir"' EXIT
     printf "llm_backend,data,string,%s\n" "$(csv_escape "$BACKEND")"
     printf "api_key,data,string,%s\n" "$(csv_escape "$API_KEY")"
     printf "llm_model,data,string,%s\n" "$(csv_escape "$MODEL")"
+    if [ -n "$SUMMARY_MODEL" ]; then
+        printf "llm_sum_model,data,string,%s\n" "$(csv_escape "$SUMMARY_MODEL")"
+    fi
 
     if [ -n "$TG_TOKEN" ]; then
         printf "tg_token,data,string,%s\n" "$(csv_escape "$TG_TOKEN")"
@@ -719,6 +732,9 @@ echo "  WiFi SSID: $WIFI_SSID"
 echo "  WiFi password: ${WIFI_PASS:-<empty>}"
 echo "  Backend:   $BACKEND"
 echo "  Model:     $MODEL"
+if [ -n "$SUMMARY_MODEL" ]; then
+    echo "  Summary model: $SUMMARY_MODEL"
+fi
 echo ""
 echo "Next steps:"
 echo "  1) Board reset is automatic after provisioning"
@@ -58,6 +58,17 @@ run_host_tests() {
         test_telegram_update.c \
         test_agent.c \
         test_tools_gpio_policy.c \
+        test_llm_stream.c \
+        test_json_writer.c \
+        test_json_pull.c \
+        test_history.c \
+        test_token_estimate.c \
+        test_session.c \
+        test_buffers.c \
+        test_input_sched.c \
+        test_msg_pool.c \
+        test_command_router.c \
+        test_tool_script.c \
         test_runner.c \
         mock_esp.c \
         mock_llm.c \
@@ -65,7 +76,11 @@ run_host_tests() {
         mock_freertos.c \
         mock_tools.c \
         mock_ratelimit.c \
+        mock_channel.c \
+        json_request_cjson.c \
         ../../main/json_util.c \
+        ../../main/json_writer.c \
+        ../../main/json_pull.c \
         ../../main/cron_utils.c \
         ../../main/security.c \
         ../../main/text_buffer.c \
@@ -73,7 +88,16 @@ run_host_tests() {
         ../../main/memory_keys.c \
         ../../main/telegram_update.c \
         ../../main/agent.c \
+        ../../main/history.c \
+        ../../main/session.c \
+        ../../main/input_sched.c \
+        ../../main/msg_pool.c \
+        ../../main/command_router.c \
+        ../../main/tool_script.c \
+        ../../main/buffers.c \
+        ../../main/token_estimate.c \
         ../../main/tools_gpio.c \
+        ../../main/llm_stream.c \
         $CJSON_LDFLAGS 2>&1 || {
         echo "Note: Failed to compile tests. Install cJSON:"
         echo "  macOS:  brew install cjson"
@@ -91,6 +115,64 @@ run_host_tests() {
     echo ""
 }
 
+run_host_bench() {
+    echo "=== Running host benchmarks ==="
+    cd "$PROJECT_DIR/test/host"
+
+    if [ ! -d "build" ]; then
+        mkdir build
+    fi
+
+    CJSON_CFLAGS=""
+    CJSON_LDFLAGS="-lcjson"
+    if [ -d "/opt/homebrew/include/cjson" ]; then
+        CJSON_CFLAGS="-I/opt/homebrew/include"
+        CJSON_LDFLAGS="-L/opt/homebrew/lib -lcjson"
+    elif [ -d "/usr/local/include/cjson" ]; then
+        CJSON_CFLAGS="-I/usr/local/include"
+        CJSON_LDFLAGS="-L/usr/local/lib -lcjson"
+    fi
+
+    # Optimized and without sanitizers so timings are meaningful.
+    gcc -o build/bench_json_request -O2 \
+        -std=c99 \
+        -Wall -Wextra -Werror -Wshadow \
+        -I../../main \
+        -I. \
+        $CJSON_CFLAGS \
+        -DTEST_BUILD \
+        bench_json_request.c \
+        json_request_cjson.c \
+        mock_llm.c \
+        mock_user_tools.c \
+        ../../main/json_util.c \
+        ../../main/history.c \
+        ../../main/token_estimate.c \
+        ../../main/json_writer.c \
+        ../../main/json_pull.c \
+        $CJSON_LDFLAGS
+
+    gcc -o build/bench_json_response -O2 \
+        -std=c99 \
+        -Wall -Wextra -Werror -Wshadow \
+        -I../../main \
+        -I. \
+        $CJSON_CFLAGS \
+        -DTEST_BUILD \
+        bench_json_response.c \
+        mock_llm.c \
+        mock_user_tools.c \
+        ../../main/json_util.c \
+        ../../main/json_writer.c \
+        ../../main/json_pull.c \
+        $CJSON_LDFLAGS
+
+    ./build/bench_json_request
+    echo ""
+    ./build/bench_json_response
+    echo ""
+}
+
 run_device_tests() {
     echo "=== Running device tests ==="
 
@@ -130,6 +212,9 @@ case "$TEST_TYPE" in
     device)
         run_device_tests
         ;;
+    bench)
+        run_host_bench
+        ;;
     all)
         run_host_tests
         # Device tests require hardware, just build them
@@ -137,8 +222,9 @@ case "$TEST_TYPE" in
         run_device_tests
         ;;
     *)
-        echo "Usage: $0 [host|device|all]"
+        echo "Usage: $0 [host|device|bench|all]"
         echo "  host   - Run host-based unit tests (no hardware needed)"
+        echo "  bench  - Run host benchmarks (request JSON build: writer vs cJSON)"
         echo "  device - Build device tests (requires flashing)"
         echo "  all    - Run host tests and build device tests"
         exit 1
@@ -0,0 +1,230 @@
+/*
+ * Host benchmark: request JSON via json_writer vs the reference cJSON tree.
+ * Reports heap allocations, bytes allocated, peak live heap, and time per build.
+ *
+ * Run with: ./scripts/test.sh bench
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json_util.h"
+#include "history.h"
+#include "token_estimate.h"
+#include "json_request_cjson.h"
+#include "tools.h"
+#include "user_tools.h"
+#include "mock_llm.h"
+
+#define BENCH_ITERATIONS    2000
+#define BENCH_TOOL_COUNT    19
+#define BENCH_HISTORY_LEN   24
+
+typedef struct {
+    size_t allocs;
+    size_t bytes;
+    size_t live;
+    size_t peak;
+} alloc_stats_t;
+
+static alloc_stats_t s_alloc;
+
+// Size-prefixed allocations so frees can be accounted for.
+static void *counting_malloc(size_t size)
+{
+    size_t *p = malloc(sizeof(size_t) + size);
+    if (!p) {
+        return NULL;
+    }
+    *p = size;
+    s_alloc.allocs++;
+    s_alloc.bytes += size;
+    s_alloc.live += size;
+    if (s_alloc.live > s_alloc.peak) {
+        s_alloc.peak = s_alloc.live;
+    }
+    return p + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    size_t *p = (size_t *)ptr - 1;
+    s_alloc.live -= *p;
+    free(p);
+}
+
+static bool bench_tool_execute(const cJSON *input, char *result, size_t result_len)
+{
+    (void)input;
+    snprintf(result, result_len, "ok");
+    return true;
+}
+
+static char s_tool_names[BENCH_TOOL_COUNT][24];
+static tool_def_t s_tools[BENCH_TOOL_COUNT];
+static history_t s_history_ring;
+static const conversation_msg_t *s_history;
+static char s_request_buf[LLM_REQUEST_BUF_SIZE];
+
+// Roughly the shape of the firmware's built-in tool table.
+static void setup_fixtures(void)
+{
+    for (int i = 0; i < BENCH_TOOL_COUNT; i++) {
+        snprintf(s_tool_names[i], sizeof(s_tool_names[i]), "tool_%02d", i);
+        s_tools[i] = (tool_def_t){
+            .name = s_tool_names[i],
+            .description = "Set a GPIO pin HIGH or LOW. Controls LEDs, relays, outputs.",
+            .input_schema_json = "{\"type\":\"object\",\"properties\":{\"pin\":{\"type\":\"integer\","
+                                 "\"description\":\"GPIO pin allowed by GPIO Tool Safety policy\"},"
+                                 "\"state\":{\"type\":\"integer\",\"description\":\"0=LOW, 1=HIGH\"}},"
+                                 "\"required\":[\"pin\",\"state\"]}",
+            .execute = bench_tool_execute,
+        };
+    }
+
+    history_init(&s_history_ring);
+    for (int i = 0; i < BENCH_HISTORY_LEN; i++) {
+        char content[96];
+        char tool_id[16];
+        conversation_msg_t msg = {.role = "user", .content = content, .tool_id = "", .tool_name = ""};
+        switch (i % 4) {
+            case 0:
+                snprintf(content, sizeof(content),
+                         "Please turn on the porch light and tell me the temperature (%d).", i);
+                break;
+            case 1:
+                msg.role = "assistant";
+                snprintf(content, sizeof(content), "{\"pin\":%d,\"state\":1}", i % 8);
+                snprintf(tool_id, sizeof(tool_id), "toolu_%04d", i);
+                msg.tool_id = tool_id;
+                msg.tool_name = "tool_00";
+                msg.is_tool_use = true;
+                break;
+            case 2:
+                snprintf(content, sizeof(content), "Pin %d set HIGH", i % 8);
+                snprintf(tool_id, sizeof(tool_id), "toolu_%04d", i - 1);
+                msg.tool_id = tool_id;
+                msg.is_tool_result = true;
+                break;
+            default:
+                msg.role = "assistant";
+                snprintf(content, sizeof(content),
+                         "Done. The porch light is on and it is 21.5 C outside.");
+                break;
+        }
+        history_push(&s_history_ring, &msg);
+    }
+    s_history = history_messages(&s_history_ring);
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static void bench_backend(llm_backend_t backend, const char *label)
+{
+    alloc_stats_t cjson_stats;
+    alloc_stats_t writer_stats;
+    size_t cjson_len = 0;
+    size_t writer_len = 0;
+    double started;
+    double cjson_us;
+    double writer_us;
+
+    mock_llm_set_backend(backend, "bench-model");
+
+    memset(&s_alloc, 0, sizeof(s_alloc));
+    started = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        char *json = json_build_request_cjson(SYSTEM_PROMPT, s_history, BENCH_HISTORY_LEN,
+                                              NULL, s_tools, BENCH_TOOL_COUNT);
+        if (!json) {
+            printf("  %s: cJSON build failed\n", label);
+            return;
+        }
+        cjson_len = strlen(json);
+        cJSON_free(json);
+    }
+    cjson_us = (now_us() - started) / BENCH_ITERATIONS;
+    cjson_stats = s_alloc;
+
+    memset(&s_alloc, 0, sizeof(s_alloc));
+    started = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        writer_len = json_build_request_into(s_request_buf, sizeof(s_request_buf), SYSTEM_PROMPT,
+                                             s_history, BENCH_HISTORY_LEN, NULL,
+                                             s_tools, BENCH_TOOL_COUNT);
+        if (writer_len == 0) {
+            printf("  %s: writer build failed\n", label);
+            return;
+        }
+    }
+    writer_us = (now_us() - started) / BENCH_ITERATIONS;
+    writer_stats = s_alloc;
+
+    // Tool round: only the newest message is serialized onto the cached prefix.
+    json_request_cache_t primed = {0};
+    json_request_cache_t cache;
+    double append_us;
+    json_build_request_cached(&primed, s_request_buf, sizeof(s_request_buf), SYSTEM_PROMPT,
+                              s_history, BENCH_HISTORY_LEN - 1, s_tools, BENCH_TOOL_COUNT);
+    started = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        cache = primed;
+        if (json_build_request_cached(&cache, s_request_buf, sizeof(s_request_buf), SYSTEM_PROMPT,
+                                      s_history, BENCH_HISTORY_LEN, s_tools,
+                                      BENCH_TOOL_COUNT) != writer_len) {
+            printf("  %s: cached build differs in length\n", label);
+            return;
+        }
+    }
+    append_us = (now_us() - started) / BENCH_ITERATIONS;
+
+    // Budget check the agent runs on every request.
+    size_t tokens = 0;
+    double estimate_us;
+    started = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        tokens = token_estimate(s_request_buf, writer_len);
+    }
+    estimate_us = (now_us() - started) / BENCH_ITERATIONS;
+
+    printf("%-10s bytes=%-6zu cjson: %7.1f us %5zu allocs %7zu B alloc %7zu B peak | "
+           "writer: %7.1f us %5zu allocs %7zu B alloc (out=%zu) | append: %5.1f us | "
+           "estimate: %5.1f us (~%zu tokens)\n",
+           label, cjson_len, cjson_us,
+           cjson_stats.allocs / BENCH_ITERATIONS, cjson_stats.bytes / BENCH_ITERATIONS,
+           cjson_stats.peak,
+           writer_us, writer_stats.allocs / BENCH_ITERATIONS,
+           writer_stats.bytes / BENCH_ITERATIONS, writer_len, append_us,
+           estimate_us, tokens);
+}
+
+int main(void)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = counting_malloc,
+        .free_fn = counting_free,
+    };
+
+    cJSON_InitHooks(&hooks);
+    setup_fixtures();
+    user_tools_init();
+    user_tools_create("water_plants", "Water the plants on the balcony", "gpio_write pin 3 high");
+
+    printf("Request build benchmark (%d iterations, %d history messages, %d tools)\n",
+           BENCH_ITERATIONS, BENCH_HISTORY_LEN, BENCH_TOOL_COUNT);
+    bench_backend(LLM_BACKEND_ANTHROPIC, "anthropic");
+    bench_backend(LLM_BACKEND_OPENAI, "openai");
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Host benchmark: response parsing via the pull parser vs a full cJSON tree,
+ * over provider-shaped fixtures. Reports heap allocations, peak live heap,
+ * and time per parse.
+ *
+ * Run with: ./scripts/test.sh bench
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json_util.h"
+#include "llm_response_fixtures.h"
+#include "mock_llm.h"
+
+#define BENCH_ITERATIONS    5000
+
+typedef struct {
+    size_t allocs;
+    size_t live;
+    size_t peak;
+} alloc_stats_t;
+
+static alloc_stats_t s_alloc;
+
+// Size-prefixed allocations so frees can be accounted for.
+static void *counting_malloc(size_t size)
+{
+    size_t *p = malloc(sizeof(size_t) + size);
+    if (!p) {
+        return NULL;
+    }
+    *p = size;
+    s_alloc.allocs++;
+    s_alloc.live += size;
+    if (s_alloc.live > s_alloc.peak) {
+        s_alloc.peak = s_alloc.live;
+    }
+    return p + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    size_t *p = (size_t *)ptr - 1;
+    s_alloc.live -= *p;
+    free(p);
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static void bench_fixture(llm_backend_t backend, const char *label, const char *fixture)
+{
+    char text[1024];
+    char name[32];
+    char id[64];
+    cJSON *input = NULL;
+    alloc_stats_t tree_stats;
+    alloc_stats_t pull_stats;
+    double started;
+    double tree_us;
+    double pull_us;
+
+    mock_llm_set_backend(backend, "bench-model");
+
+    // Reference: what the old parser held alive while the tool ran.
+    memset(&s_alloc, 0, sizeof(s_alloc));
+    started = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        cJSON *root = cJSON_Parse(fixture);
+        if (!root) {
+            printf("  %s: cJSON parse failed\n", label);
+            return;
+        }
+        cJSON_Delete(root);
+    }
+    tree_us = (now_us() - started) / BENCH_ITERATIONS;
+    tree_stats = s_alloc;
+
+    memset(&s_alloc, 0, sizeof(s_alloc));
+    started = now_us();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        if (!json_parse_response(fixture, text, sizeof(text), name, sizeof(name),
+                                 id, sizeof(id), &input)) {
+            printf("  %s: pull parse failed\n", label);
+            return;
+        }
+        json_free_parsed_response();
+    }
+    pull_us = (now_us() - started) / BENCH_ITERATIONS;
+    pull_stats = s_alloc;
+
+    printf("%-18s bytes=%-5zu cjson tree: %6.2f us %4zu allocs %6zu B peak | "
+           "pull: %6.2f us %4zu allocs %6zu B peak\n",
+           label, strlen(fixture),
+           tree_us, tree_stats.allocs / BENCH_ITERATIONS, tree_stats.peak,
+           pull_us, pull_stats.allocs / BENCH_ITERATIONS, pull_stats.peak);
+}
+
+int main(void)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = counting_malloc,
+        .free_fn = counting_free,
+    };
+
+    cJSON_InitHooks(&hooks);
+
+    printf("Response parse benchmark (%d iterations)\n", BENCH_ITERATIONS);
+    bench_fixture(LLM_BACKEND_ANTHROPIC, "anthropic tool_use", FIXTURE_ANTHROPIC_TOOL_USE);
+    bench_fixture(LLM_BACKEND_ANTHROPIC, "anthropic text", FIXTURE_ANTHROPIC_TEXT);
+    bench_fixture(LLM_BACKEND_OPENAI, "openai tool_call", FIXTURE_OPENAI_TOOL_CALL);
+    bench_fixture(LLM_BACKEND_OPENAI, "openai text", FIXTURE_OPENAI_TEXT);
+    return 0;
+}
@@ -16,6 +16,8 @@ static inline const char *esp_err_to_name(esp_err_t err)
             return "ESP_ERR_INVALID_ARG";
         case ESP_ERR_NOT_FOUND:
             return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_INVALID_RESPONSE:
+            return "ESP_ERR_INVALID_RESPONSE";
         default:
             return "ESP_ERR_UNKNOWN";
     }
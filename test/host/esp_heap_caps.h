@@ -0,0 +1,19 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_SPIRAM       (1 << 10)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+
+// Host heap: internal RAM is malloc(); PSRAM is a byte budget set with
+// mock_esp_set_psram_size() (none by default).
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_total_size(uint32_t caps);
+
+void mock_esp_set_psram_size(size_t bytes);
+
+#endif // ESP_HEAP_CAPS_H
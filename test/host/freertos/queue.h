@@ -5,8 +5,13 @@
 #include <stddef.h>
 
 typedef struct mock_queue *QueueHandle_t;
+typedef struct {
+    void *unused;
+} StaticQueue_t;
 
 QueueHandle_t xQueueCreate(UBaseType_t queue_length, UBaseType_t item_size);
+QueueHandle_t xQueueCreateStatic(UBaseType_t queue_length, UBaseType_t item_size,
+                                 uint8_t *storage, StaticQueue_t *static_queue);
 BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout_ticks);
 BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout_ticks);
 UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
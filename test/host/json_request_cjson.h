@@ -0,0 +1,16 @@
+#ifndef JSON_REQUEST_CJSON_H
+#define JSON_REQUEST_CJSON_H
+
+#include "json_util.h"
+
+// Same contract as json_build_request(), built through a cJSON tree.
+char *json_build_request_cjson(
+    const char *system_prompt,
+    const conversation_msg_t *history,
+    int history_len,
+    const char *user_message,
+    const struct tool_def *tools,
+    int tool_count
+);
+
+#endif // JSON_REQUEST_CJSON_H
@@ -0,0 +1,102 @@
+#ifndef LLM_RESPONSE_FIXTURES_H
+#define LLM_RESPONSE_FIXTURES_H
+
+/*
+ * Non-streaming response bodies in the shape the providers actually send
+ * (ids, usage blocks, pretty-printing), shared by parse tests and benchmarks.
+ */
+
+static const char *const FIXTURE_ANTHROPIC_TOOL_USE =
+    "{\n"
+    "  \"id\": \"msg_01XFDUDYJgAACzvnptvVoYEL\",\n"
+    "  \"type\": \"message\",\n"
+    "  \"role\": \"assistant\",\n"
+    "  \"model\": \"claude-sonnet-4-5\",\n"
+    "  \"content\": [\n"
+    "    {\n"
+    "      \"type\": \"text\",\n"
+    "      \"text\": \"I'll switch the porch light on (pin 5) \\u2014 one moment.\"\n"
+    "    },\n"
+    "    {\n"
+    "      \"type\": \"tool_use\",\n"
+    "      \"id\": \"toolu_01A09q90qw90lq917835lq9\",\n"
+    "      \"name\": \"gpio_write\",\n"
+    "      \"input\": {\"pin\": 5, \"state\": 1, \"note\": \"porch \\\"main\\\" light\"}\n"
+    "    }\n"
+    "  ],\n"
+    "  \"stop_reason\": \"tool_use\",\n"
+    "  \"stop_sequence\": null,\n"
+    "  \"usage\": {\n"
+    "    \"input_tokens\": 2095,\n"
+    "    \"cache_creation_input_tokens\": 0,\n"
+    "    \"cache_read_input_tokens\": 1824,\n"
+    "    \"output_tokens\": 503,\n"
+    "    \"service_tier\": \"standard\"\n"
+    "  }\n"
+    "}\n";
+
+static const char *const FIXTURE_ANTHROPIC_TEXT =
+    "{\"id\":\"msg_013Zva2CMHLNnXjNJJKqJ2EF\",\"type\":\"message\",\"role\":\"assistant\","
+    "\"model\":\"claude-sonnet-4-5\",\"content\":[{\"type\":\"text\",\"text\":"
+    "\"Done. The porch light is on and it is 21.5\\u00b0C outside.\\nAnything else? \\ud83d\\ude00\"}],"
+    "\"stop_reason\":\"end_turn\",\"stop_sequence\":null,"
+    "\"usage\":{\"input_tokens\":2211,\"cache_creation_input_tokens\":0,"
+    "\"cache_read_input_tokens\":1824,\"output_tokens\":24}}";
+
+static const char *const FIXTURE_OPENAI_TOOL_CALL =
+    "{\n"
+    "  \"id\": \"chatcmpl-B9MBs8CjcvOU2jLn4n570S5qMJKcT\",\n"
+    "  \"object\": \"chat.completion\",\n"
+    "  \"created\": 1741569952,\n"
+    "  \"model\": \"gpt-5-mini-2025-08-07\",\n"
+    "  \"choices\": [\n"
+    "    {\n"
+    "      \"index\": 0,\n"
+    "      \"message\": {\n"
+    "        \"role\": \"assistant\",\n"
+    "        \"content\": null,\n"
+    "        \"tool_calls\": [\n"
+    "          {\n"
+    "            \"id\": \"call_12345xyz\",\n"
+    "            \"type\": \"function\",\n"
+    "            \"function\": {\n"
+    "              \"name\": \"gpio_write\",\n"
+    "              \"arguments\": \"{\\\"pin\\\":5,\\\"state\\\":1,\\\"note\\\":\\\"porch \\\\\\\"main\\\\\\\" light\\\"}\"\n"
+    "            }\n"
+    "          }\n"
+    "        ],\n"
+    "        \"refusal\": null,\n"
+    "        \"annotations\": []\n"
+    "      },\n"
+    "      \"logprobs\": null,\n"
+    "      \"finish_reason\": \"tool_calls\"\n"
+    "    }\n"
+    "  ],\n"
+    "  \"usage\": {\n"
+    "    \"prompt_tokens\": 2082,\n"
+    "    \"completion_tokens\": 217,\n"
+    "    \"total_tokens\": 2299,\n"
+    "    \"prompt_tokens_details\": {\"cached_tokens\": 1792, \"audio_tokens\": 0},\n"
+    "    \"completion_tokens_details\": {\n"
+    "      \"reasoning_tokens\": 192,\n"
+    "      \"audio_tokens\": 0,\n"
+    "      \"accepted_prediction_tokens\": 0,\n"
+    "      \"rejected_prediction_tokens\": 0\n"
+    "    }\n"
+    "  },\n"
+    "  \"service_tier\": \"default\",\n"
+    "  \"system_fingerprint\": null\n"
+    "}\n";
+
+static const char *const FIXTURE_OPENAI_TEXT =
+    "{\"id\":\"chatcmpl-B9MHDbslfkBeAs8l4bebGdFOJ6PeG\",\"object\":\"chat.completion\","
+    "\"created\":1741570283,\"model\":\"gpt-5-mini-2025-08-07\",\"choices\":[{\"index\":0,"
+    "\"message\":{\"role\":\"assistant\",\"content\":\"Done. The porch light is on and it is "
+    "21.5\\u00b0C outside.\",\"refusal\":null,\"annotations\":[]},\"logprobs\":null,"
+    "\"finish_reason\":\"stop\"}],\"usage\":{\"prompt_tokens\":2311,\"completion_tokens\":88,"
+    "\"total_tokens\":2399,\"prompt_tokens_details\":{\"cached_tokens\":2048,\"audio_tokens\":0},"
+    "\"completion_tokens_details\":{\"reasoning_tokens\":64,\"audio_tokens\":0,"
+    "\"accepted_prediction_tokens\":0,\"rejected_prediction_tokens\":0}},"
+    "\"service_tier\":\"default\",\"system_fingerprint\":null}";
+
+#endif // LLM_RESPONSE_FIXTURES_H
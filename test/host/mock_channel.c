@@ -0,0 +1,34 @@
+#include "channel.h"
+#include "mock_channel.h"
+#include "config.h"
+#include <string.h>
+
+static char s_written[LLM_RESPONSE_BUF_SIZE];
+static size_t s_written_len = 0;
+
+void mock_channel_reset(void)
+{
+    s_written[0] = '\0';
+    s_written_len = 0;
+}
+
+const char *mock_channel_written(void)
+{
+    return s_written;
+}
+
+void channel_write(const char *text)
+{
+    size_t len;
+
+    if (!text) {
+        return;
+    }
+    len = strlen(text);
+    if (len > sizeof(s_written) - 1 - s_written_len) {
+        len = sizeof(s_written) - 1 - s_written_len;
+    }
+    memcpy(s_written + s_written_len, text, len);
+    s_written_len += len;
+    s_written[s_written_len] = '\0';
+}
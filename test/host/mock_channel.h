@@ -0,0 +1,7 @@
+#ifndef MOCK_CHANNEL_H
+#define MOCK_CHANNEL_H
+
+void mock_channel_reset(void);
+const char *mock_channel_written(void);
+
+#endif // MOCK_CHANNEL_H
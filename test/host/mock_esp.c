@@ -3,7 +3,40 @@
  */
 
 #include "mock_esp.h"
+#include "esp_heap_caps.h"
 #include <stdio.h>
+#include <stdlib.h>
 
-// Empty file - mocks are mostly header-only
-// Add function mocks here as needed
+// Mostly header-only; functions that need state live here.
+
+static size_t s_psram_total = 0;
+static size_t s_psram_free = 0;
+
+void mock_esp_set_psram_size(size_t bytes)
+{
+    s_psram_total = bytes;
+    s_psram_free = bytes;
+}
+
+// PSRAM allocations are plain heap blocks charged against the budget (frees
+// do not give it back).
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    if (caps & MALLOC_CAP_SPIRAM) {
+        if (n * size > s_psram_free) {
+            return NULL;
+        }
+        s_psram_free -= n * size;
+    }
+    return calloc(n, size);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? s_psram_free : 0;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? s_psram_total : 0;
+}
@@ -1,4 +1,5 @@
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "mock_freertos.h"
 #include <stdlib.h>
@@ -13,6 +14,7 @@ typedef struct mock_queue {
     UBaseType_t head;
     UBaseType_t tail;
     unsigned char *storage;
+    void *caller_blocks[2];     // xQueueCreateStatic() buffers, released on delete
 } mock_queue_t;
 
 static TickType_t s_delays[MOCK_MAX_DELAYS];
@@ -63,6 +65,19 @@ QueueHandle_t xQueueCreate(UBaseType_t queue_length, UBaseType_t item_size)
     return (QueueHandle_t)queue;
 }
 
+// The mock keeps its own storage; the caller's heap buffers are freed along
+// with the queue so tests stay leak-free.
+QueueHandle_t xQueueCreateStatic(UBaseType_t queue_length, UBaseType_t item_size,
+                                 uint8_t *storage, StaticQueue_t *static_queue)
+{
+    mock_queue_t *queue = (mock_queue_t *)xQueueCreate(queue_length, item_size);
+    if (queue) {
+        queue->caller_blocks[0] = storage;
+        queue->caller_blocks[1] = static_queue;
+    }
+    return (QueueHandle_t)queue;
+}
+
 BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t timeout_ticks)
 {
     mock_queue_t *queue = (mock_queue_t *)handle;
@@ -122,6 +137,8 @@ void vQueueDelete(QueueHandle_t handle)
     }
 
     free(queue->storage);
+    free(queue->caller_blocks[0]);
+    free(queue->caller_blocks[1]);
     free(queue);
 }
 
@@ -154,3 +171,25 @@ void vTaskDelete(TaskHandle_t task_to_delete)
 {
     (void)task_to_delete;
 }
+
+struct mock_semaphore {
+    int unused;
+};
+
+static struct mock_semaphore s_mutex;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return &s_mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout_ticks)
+{
+    (void)timeout_ticks;
+    return semaphore ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return semaphore ? pdTRUE : pdFALSE;
+}
@@ -1,5 +1,6 @@
 #include "mock_llm.h"
 #include "config.h"
+#include "json_util.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -10,15 +11,19 @@ typedef struct {
     esp_err_t err;
     char response[MOCK_RESPONSE_MAX_LEN];
     bool has_response;
+    char streamed[MOCK_RESPONSE_MAX_LEN];
+    size_t chunk_len;
 } llm_result_t;
 
 static llm_backend_t s_backend = LLM_BACKEND_OPENAI;
 static char s_model[64] = "mock-model";
+static char s_summary_model[64] = "";
 static llm_result_t s_results[MOCK_MAX_RESULTS];
 static int s_result_count = 0;
 static int s_result_index = 0;
 static int s_request_count = 0;
 static char s_last_request[LLM_REQUEST_BUF_SIZE];
+static bool s_prompt_cache = false;
 
 void mock_llm_reset(void)
 {
@@ -27,6 +32,18 @@ void mock_llm_reset(void)
     s_result_index = 0;
     s_request_count = 0;
     s_last_request[0] = '\0';
+    s_prompt_cache = false;
+    s_summary_model[0] = '\0';
+}
+
+void mock_llm_set_summary_model(const char *model)
+{
+    snprintf(s_summary_model, sizeof(s_summary_model), "%s", model ? model : "");
+}
+
+void mock_llm_set_prompt_cache(bool enabled)
+{
+    s_prompt_cache = enabled;
 }
 
 void mock_llm_set_backend(llm_backend_t backend, const char *model)
@@ -56,6 +73,24 @@ bool mock_llm_push_result(esp_err_t err, const char *response_json)
     return true;
 }
 
+bool mock_llm_push_streamed_result(esp_err_t err, const char *response_json,
+                                   const char *streamed_text, size_t chunk_len)
+{
+    llm_result_t *entry;
+
+    if (!mock_llm_push_result(err, response_json)) {
+        return false;
+    }
+
+    entry = &s_results[s_result_count - 1];
+    if (streamed_text) {
+        strncpy(entry->streamed, streamed_text, sizeof(entry->streamed) - 1);
+        entry->streamed[sizeof(entry->streamed) - 1] = '\0';
+    }
+    entry->chunk_len = chunk_len > 0 ? chunk_len : 1;
+    return true;
+}
+
 int mock_llm_request_count(void)
 {
     return s_request_count;
@@ -71,9 +106,18 @@ esp_err_t llm_init(void)
     return ESP_OK;
 }
 
-esp_err_t llm_request(const char *request_json, char *response_buf, size_t response_buf_size)
+esp_err_t llm_request(const char *request_json, char *response_buf, size_t response_buf_size,
+                      char *text_out, size_t text_out_len)
 {
-    llm_result_t result = {0};
+    return llm_request_stream(request_json, response_buf, response_buf_size,
+                              text_out, text_out_len, NULL, NULL);
+}
+
+esp_err_t llm_request_stream(const char *request_json, char *response_buf, size_t response_buf_size,
+                             char *text_out, size_t text_out_len,
+                             llm_stream_text_cb_t on_text, void *user_ctx)
+{
+    static llm_result_t result;
     const char *default_response =
         "{\"content\":[{\"type\":\"text\",\"text\":\"mock ok\"}],\"stop_reason\":\"end_turn\"}";
 
@@ -87,20 +131,57 @@ esp_err_t llm_request(const char *request_json, char *response_buf, size_t respo
     if (s_result_index < s_result_count) {
         result = s_results[s_result_index++];
     } else {
+        memset(&result, 0, sizeof(result));
         result.err = ESP_OK;
         result.has_response = true;
         strncpy(result.response, default_response, sizeof(result.response) - 1);
         result.response[sizeof(result.response) - 1] = '\0';
     }
 
+    if (on_text && result.streamed[0] != '\0') {
+        const char *cursor = result.streamed;
+        while (*cursor != '\0') {
+            char chunk[64];
+            size_t n = strlen(cursor);
+            if (n > result.chunk_len) {
+                n = result.chunk_len;
+            }
+            if (n >= sizeof(chunk)) {
+                n = sizeof(chunk) - 1;
+            }
+            memcpy(chunk, cursor, n);
+            chunk[n] = '\0';
+            on_text(chunk, user_ctx);
+            cursor += n;
+        }
+    }
+
     if (result.err == ESP_OK && response_buf && response_buf_size > 0) {
         const char *to_copy = result.has_response ? result.response : default_response;
+        char tool_name[32];
+        char tool_id[64];
+        cJSON *tool_input = NULL;
+
         snprintf(response_buf, response_buf_size, "%s", to_copy);
+        if (!json_parse_response(response_buf, text_out, text_out_len, tool_name,
+                                 sizeof(tool_name), tool_id, sizeof(tool_id), &tool_input)) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
     }
 
     return result.err;
 }
 
+bool llm_stream_enabled(void)
+{
+    return false;
+}
+
+bool llm_prompt_cache_enabled(void)
+{
+    return s_prompt_cache && s_backend == LLM_BACKEND_ANTHROPIC;
+}
+
 bool llm_is_stub_mode(void)
 {
     return true;
@@ -126,7 +207,20 @@ const char *llm_get_model(void)
     return s_model;
 }
 
+const char *llm_get_summary_model(void)
+{
+    return s_summary_model[0] != '\0' ? s_summary_model : s_model;
+}
+
 bool llm_is_openai_format(void)
 {
     return s_backend == LLM_BACKEND_OPENAI || s_backend == LLM_BACKEND_OPENROUTER;
 }
+
+void llm_get_conn_stats(llm_conn_stats_t *out)
+{
+    if (out) {
+        memset(out, 0, sizeof(*out));
+        out->requests = (uint32_t)s_request_count;
+    }
+}
@@ -7,7 +7,14 @@
 
 void mock_llm_set_backend(llm_backend_t backend, const char *model);
 void mock_llm_reset(void);
+void mock_llm_set_prompt_cache(bool enabled);
+// Empty model (the default after reset) falls back to the current model.
+void mock_llm_set_summary_model(const char *model);
 bool mock_llm_push_result(esp_err_t err, const char *response_json);
+// Like mock_llm_push_result, but also feeds streamed_text to the stream
+// callback in chunk_len-sized fragments before returning.
+bool mock_llm_push_streamed_result(esp_err_t err, const char *response_json,
+                                   const char *streamed_text, size_t chunk_len);
 int mock_llm_request_count(void);
 const char *mock_llm_last_request_json(void);
 
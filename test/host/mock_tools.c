@@ -4,10 +4,48 @@
 #include <string.h>
 
 static int s_execute_calls = 0;
+static const char *s_result = NULL;
+static bool s_success = true;
+static const tool_def_t *s_defs = NULL;
+static int s_def_count = 0;
+static char s_last_name[32];
+static char s_last_input[256];
 
 void mock_tools_reset(void)
 {
     s_execute_calls = 0;
+    s_result = NULL;
+    s_success = true;
+    s_defs = NULL;
+    s_def_count = 0;
+    s_last_name[0] = '\0';
+    s_last_input[0] = '\0';
+}
+
+const char *mock_tools_last_name(void)
+{
+    return s_last_name;
+}
+
+const char *mock_tools_last_input(void)
+{
+    return s_last_input;
+}
+
+void mock_tools_set_result(const char *result)
+{
+    s_result = result;
+}
+
+void mock_tools_set_defs(const tool_def_t *defs, int count)
+{
+    s_defs = defs;
+    s_def_count = count;
+}
+
+void mock_tools_set_success(bool success)
+{
+    s_success = success;
 }
 
 int mock_tools_execute_calls(void)
@@ -22,18 +60,21 @@ void tools_init(void)
 const tool_def_t *tools_get_all(int *count)
 {
     if (count) {
-        *count = 0;
+        *count = s_def_count;
     }
-    return NULL;
+    return s_defs;
 }
 
 bool tools_execute(const char *name, const cJSON *input, char *result, size_t result_len)
 {
-    (void)name;
-    (void)input;
+    char *input_json = input ? cJSON_PrintUnformatted(input) : NULL;
+
+    snprintf(s_last_name, sizeof(s_last_name), "%s", name ? name : "");
+    snprintf(s_last_input, sizeof(s_last_input), "%s", input_json ? input_json : "");
+    cJSON_free(input_json);
     s_execute_calls++;
     if (result && result_len > 0) {
-        snprintf(result, result_len, "mock tool executed");
+        snprintf(result, result_len, "%s", s_result ? s_result : "mock tool executed");
     }
-    return true;
+    return s_success;
 }
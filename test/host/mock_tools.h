@@ -1,7 +1,19 @@
 #ifndef MOCK_TOOLS_H
 #define MOCK_TOOLS_H
 
+#include "tools.h"
+#include <stdbool.h>
+
 void mock_tools_reset(void);
 int mock_tools_execute_calls(void);
+// Result text of later tool executions (NULL restores the default).
+void mock_tools_set_result(const char *result);
+// Built-in tool list returned by tools_get_all (none after reset).
+void mock_tools_set_defs(const tool_def_t *defs, int count);
+// Whether later tool executions report success (reset restores true).
+void mock_tools_set_success(bool success);
+// Name and unformatted input JSON of the last tool execution ("" if none).
+const char *mock_tools_last_name(void);
+const char *mock_tools_last_input(void);
 
 #endif // MOCK_TOOLS_H
@@ -1,5 +1,5 @@
 /*
- * Mock user_tools for host tests
+ * Mock user_tools for host tests (in memory, no NVS)
  */
 
 #include "user_tools.h"
@@ -7,10 +7,22 @@
 #include <stdio.h>
 
 static user_tool_t s_mock_tools[MAX_DYNAMIC_TOOLS];
+static user_tool_recording_t s_mock_recordings[MAX_DYNAMIC_TOOLS];
 static int s_mock_count = 0;
+static uint32_t s_mock_generation = 0;
+
+static int find_index(const char *name) {
+    for (int i = 0; name && i < s_mock_count; i++) {
+        if (strcmp(s_mock_tools[i].name, name) == 0) return i;
+    }
+    return -1;
+}
 
 void user_tools_init(void) {
     s_mock_count = 0;
+    memset(s_mock_tools, 0, sizeof(s_mock_tools));
+    memset(s_mock_recordings, 0, sizeof(s_mock_recordings));
+    s_mock_generation++;
 }
 
 bool user_tools_create(const char *name, const char *description, const char *action) {
@@ -18,7 +30,9 @@ bool user_tools_create(const char *name, const char *description, const char *ac
     strncpy(s_mock_tools[s_mock_count].name, name, TOOL_NAME_MAX_LEN - 1);
     strncpy(s_mock_tools[s_mock_count].description, description, TOOL_DESC_MAX_LEN - 1);
     strncpy(s_mock_tools[s_mock_count].action, action, CRON_MAX_ACTION_LEN - 1);
+    memset(&s_mock_recordings[s_mock_count], 0, sizeof(user_tool_recording_t));
     s_mock_count++;
+    s_mock_generation++;
     return true;
 }
 
@@ -36,14 +50,51 @@ int user_tools_get_all(user_tool_t *tools, int max_count) {
 }
 
 const user_tool_t *user_tools_find(const char *name) {
-    (void)name;
-    return NULL;
+    int index = find_index(name);
+    return index >= 0 ? &s_mock_tools[index] : NULL;
+}
+
+const user_tool_recording_t *user_tools_get_recording(const char *name) {
+    int index = find_index(name);
+    return index >= 0 ? &s_mock_recordings[index] : NULL;
+}
+
+bool user_tools_record(const char *name, const tool_step_t *steps, int step_count) {
+    int index = find_index(name);
+    if (index < 0 || step_count <= 0 || step_count > TOOL_SCRIPT_MAX_STEPS ||
+        s_mock_recordings[index].replay_disabled) {
+        return false;
+    }
+    memcpy(s_mock_recordings[index].steps, steps, (size_t)step_count * sizeof(tool_step_t));
+    s_mock_recordings[index].step_count = (uint8_t)step_count;
+    return true;
+}
+
+bool user_tools_forget(const char *name) {
+    int index = find_index(name);
+    if (index < 0) return false;
+    bool replay_disabled = s_mock_recordings[index].replay_disabled;
+    memset(&s_mock_recordings[index], 0, sizeof(user_tool_recording_t));
+    s_mock_recordings[index].replay_disabled = replay_disabled;
+    return true;
+}
+
+bool user_tools_set_replay(const char *name, bool enabled) {
+    int index = find_index(name);
+    if (index < 0) return false;
+    memset(&s_mock_recordings[index], 0, sizeof(user_tool_recording_t));
+    s_mock_recordings[index].replay_disabled = !enabled;
+    return true;
 }
 
 int user_tools_count(void) {
     return s_mock_count;
 }
 
+uint32_t user_tools_generation(void) {
+    return s_mock_generation;
+}
+
 void user_tools_list(char *buf, size_t buf_len) {
     if (buf && buf_len > 0) {
         snprintf(buf, buf_len, "Mock: %d user tools", s_mock_count);
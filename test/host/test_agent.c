@@ -7,12 +7,18 @@
 
 #include "agent.h"
 #include "config.h"
+#include "json_writer.h"
 #include "messages.h"
+#include "msg_pool.h"
+#include "mock_channel.h"
 #include "mock_freertos.h"
 #include "mock_llm.h"
 #include "mock_ratelimit.h"
 #include "mock_tools.h"
+#include "token_estimate.h"
+#include "user_tools.h"
 #include "freertos/queue.h"
+#include "esp_timer.h"
 
 #define TEST(name) static int test_##name(void)
 #define ASSERT(cond) do { \
@@ -34,7 +40,8 @@ static int recv_channel_text(QueueHandle_t queue, char *out, size_t out_len)
     if (xQueueReceive(queue, &msg, 0) != pdTRUE) {
         return 0;
     }
-    snprintf(out, out_len, "%s", msg.text);
+    snprintf(out, out_len, "%s", msg.text->text);
+    msg_pool_release(msg.text);
     return 1;
 }
 
@@ -44,7 +51,8 @@ static int recv_telegram_text(QueueHandle_t queue, char *out, size_t out_len)
     if (xQueueReceive(queue, &msg, 0) != pdTRUE) {
         return 0;
     }
-    snprintf(out, out_len, "%s", msg.text);
+    snprintf(out, out_len, "%s", msg.text->text);
+    msg_pool_release(msg.text);
     return 1;
 }
 
@@ -54,7 +62,9 @@ static void reset_state(void)
     mock_llm_reset();
     mock_ratelimit_reset();
     mock_tools_reset();
+    mock_channel_reset();
     mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "mock-anthropic");
+    user_tools_init();
     agent_test_reset();
 }
 
@@ -96,6 +106,46 @@ TEST(retries_with_backoff_and_fanout)
     return 0;
 }
 
+TEST(long_reply_fans_out_in_one_buffer)
+{
+    QueueHandle_t channel_q;
+    QueueHandle_t telegram_q;
+    channel_msg_t channel_msg;
+    telegram_msg_t telegram_msg;
+    char reply[900];
+    char response[1024];
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    telegram_q = xQueueCreate(4, sizeof(telegram_msg_t));
+    ASSERT(channel_q != NULL);
+    ASSERT(telegram_q != NULL);
+    agent_test_set_queues(channel_q, telegram_q);
+
+    // Longer than the old 512-byte serial payload.
+    memset(reply, 'r', sizeof(reply) - 1);
+    reply[sizeof(reply) - 1] = '\0';
+    snprintf(response, sizeof(response),
+             "{\"content\":[{\"type\":\"text\",\"text\":\"%s\"}],\"stop_reason\":\"end_turn\"}",
+             reply);
+    ASSERT(mock_llm_push_result(ESP_OK, response));
+
+    agent_test_process_message("hello");
+
+    ASSERT(xQueueReceive(channel_q, &channel_msg, 0) == pdTRUE);
+    ASSERT(xQueueReceive(telegram_q, &telegram_msg, 0) == pdTRUE);
+    ASSERT(channel_msg.text == telegram_msg.text);
+    ASSERT(channel_msg.text->len == strlen(reply));
+    ASSERT_STR_EQ(channel_msg.text->text, reply);
+    msg_pool_release(channel_msg.text);
+    msg_pool_release(telegram_msg.text);
+
+    vQueueDelete(channel_q);
+    vQueueDelete(telegram_q);
+    return 0;
+}
+
 TEST(rate_limit_short_circuit)
 {
     QueueHandle_t channel_q;
@@ -188,35 +238,1374 @@ TEST(failed_turn_does_not_pollute_followup_prompt)
     return 0;
 }
 
-int test_agent_all(void)
+TEST(streamed_text_is_not_sent_twice)
 {
-    int failures = 0;
+    QueueHandle_t channel_q;
+    QueueHandle_t telegram_q;
+    char text[TELEGRAM_MAX_MSG_LEN];
+    const char *response =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"streamed hello\"}],\"stop_reason\":\"end_turn\"}";
 
-    printf("\nAgent Tests:\n");
+    reset_state();
 
-    printf("  retries_with_backoff_and_fanout... ");
-    if (test_retries_with_backoff_and_fanout() == 0) {
-        printf("OK\n");
-    } else {
-        failures++;
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    telegram_q = xQueueCreate(4, sizeof(telegram_msg_t));
+    ASSERT(channel_q != NULL);
+    ASSERT(telegram_q != NULL);
+    agent_test_set_queues(channel_q, telegram_q);
+
+    ASSERT(mock_llm_push_streamed_result(ESP_OK, response, "streamed hello", 4));
+
+    agent_test_process_message("hello");
+
+    ASSERT_STR_EQ(mock_channel_written(), "streamed hello\n\n");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 0);
+    ASSERT(recv_telegram_text(telegram_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "streamed hello");
+    ASSERT(recv_telegram_text(telegram_q, text, sizeof(text)) == 0);
+
+    vQueueDelete(channel_q);
+    vQueueDelete(telegram_q);
+    return 0;
+}
+
+TEST(streamed_text_is_batched_for_telegram)
+{
+    QueueHandle_t telegram_q;
+    char text[TELEGRAM_MAX_MSG_LEN];
+    char streamed[LLM_STREAM_TELEGRAM_BATCH * 3];
+    char joined[LLM_STREAM_TELEGRAM_BATCH * 3];
+    char response[LLM_STREAM_TELEGRAM_BATCH * 4];
+    int messages = 0;
+
+    reset_state();
+
+    streamed[0] = '\0';
+    while (strlen(streamed) < LLM_STREAM_TELEGRAM_BATCH * 2) {
+        strcat(streamed, "This sentence streams. ");
     }
+    snprintf(response, sizeof(response),
+             "{\"content\":[{\"type\":\"text\",\"text\":\"%s\"}],\"stop_reason\":\"end_turn\"}",
+             streamed);
 
-    printf("  rate_limit_short_circuit... ");
-    if (test_rate_limit_short_circuit() == 0) {
-        printf("OK\n");
-    } else {
-        failures++;
+    telegram_q = xQueueCreate(8, sizeof(telegram_msg_t));
+    ASSERT(telegram_q != NULL);
+    agent_test_set_queues(NULL, telegram_q);
+
+    ASSERT(mock_llm_push_streamed_result(ESP_OK, response, streamed, 22));
+
+    agent_test_process_message("tell me a story");
+
+    joined[0] = '\0';
+    while (recv_telegram_text(telegram_q, text, sizeof(text)) == 1) {
+        ASSERT(strlen(text) < TELEGRAM_MAX_MSG_LEN);
+        strcat(joined, text);
+        messages++;
     }
+    ASSERT(messages >= 2);
+    ASSERT_STR_EQ(joined, streamed);
 
-    printf("  fails_after_max_retries_without_extra_sleep... ");
-    if (test_fails_after_max_retries_without_extra_sleep() == 0) {
-        printf("OK\n");
-    } else {
-        failures++;
+    vQueueDelete(telegram_q);
+    return 0;
+}
+
+TEST(tool_round_appends_to_cached_request)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    uint32_t full_builds = 0;
+    uint32_t appends = 0;
+    const char *tool_use =
+        "{\"content\":[{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"gpio_read\","
+        "\"input\":{\"pin\":4}}],\"stop_reason\":\"tool_use\"}";
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"pin 4 is low\"}],\"stop_reason\":\"end_turn\"}";
+    const char *last_request;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    ASSERT(mock_llm_push_result(ESP_OK, tool_use));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+
+    agent_test_process_message("read pin 4");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "pin 4 is low");
+
+    ASSERT(mock_llm_request_count() == 2);
+    agent_test_request_cache_stats(&full_builds, &appends);
+    ASSERT(full_builds == 1);
+    ASSERT(appends == 1);
+
+    last_request = mock_llm_last_request_json();
+    ASSERT(last_request != NULL);
+    ASSERT(json_writer_is_valid(last_request));
+    ASSERT(strstr(last_request, "\"content\":\"read pin 4\"") != NULL);
+    ASSERT(strstr(last_request, "\"tool_use_id\":\"toolu_1\"") != NULL);
+    ASSERT(strstr(last_request, "mock tool executed") != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(parallel_tool_calls_run_in_one_round)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    const char *tool_use =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"Checking all three.\"},"
+        "{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"gpio_read\",\"input\":{\"pin\":2}},"
+        "{\"type\":\"tool_use\",\"id\":\"toolu_2\",\"name\":\"gpio_read\",\"input\":{\"pin\":3}},"
+        "{\"type\":\"tool_use\",\"id\":\"toolu_3\",\"name\":\"gpio_read\",\"input\":{\"pin\":4}}],"
+        "\"stop_reason\":\"tool_use\"}";
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"all low\"}],\"stop_reason\":\"end_turn\"}";
+    const char *last_request;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    ASSERT(mock_llm_push_result(ESP_OK, tool_use));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+
+    agent_test_process_message("read pins 2 to 4");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "all low");
+
+    // One LLM round trip for all three calls.
+    ASSERT(mock_llm_request_count() == 2);
+    ASSERT(mock_tools_execute_calls() == 3);
+
+    // The calls go back as one assistant message, the results as one user message.
+    last_request = mock_llm_last_request_json();
+    ASSERT(last_request != NULL);
+    ASSERT(json_writer_is_valid(last_request));
+    ASSERT(strstr(last_request,
+                  "{\"role\":\"assistant\",\"content\":[{\"type\":\"tool_use\",\"id\":\"toolu_1\"") != NULL);
+    ASSERT(strstr(last_request, "{\"pin\":3}},{\"type\":\"tool_use\",\"id\":\"toolu_3\"") != NULL);
+    ASSERT(strstr(last_request,
+                  "{\"role\":\"user\",\"content\":[{\"type\":\"tool_result\",\"tool_use_id\":\"toolu_1\"") != NULL);
+    ASSERT(strstr(last_request, "},{\"type\":\"tool_result\",\"tool_use_id\":\"toolu_3\"") != NULL);
+    ASSERT(strstr(last_request, "\"tool_use_id\":\"toolu_2\"") != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(tool_calls_past_round_limit_get_error_results)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    char tool_use[2048];
+    char expected[160];
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"done\"}],\"stop_reason\":\"end_turn\"}";
+    const char *last_request;
+    int len;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    len = snprintf(tool_use, sizeof(tool_use), "{\"content\":[");
+    for (int i = 0; i <= MAX_TOOL_CALLS_PER_ROUND; i++) {
+        len += snprintf(tool_use + len, sizeof(tool_use) - len,
+                        "%s{\"type\":\"tool_use\",\"id\":\"toolu_%d\",\"name\":\"gpio_read\","
+                        "\"input\":{\"pin\":%d}}", i ? "," : "", i, i);
     }
+    snprintf(tool_use + len, sizeof(tool_use) - len, "],\"stop_reason\":\"tool_use\"}");
+    ASSERT(mock_llm_push_result(ESP_OK, tool_use));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
 
-    printf("  failed_turn_does_not_pollute_followup_prompt... ");
-    if (test_failed_turn_does_not_pollute_followup_prompt() == 0) {
+    agent_test_process_message("read every pin");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "done");
+    ASSERT(mock_tools_execute_calls() == MAX_TOOL_CALLS_PER_ROUND);
+
+    // The call over the limit is answered, not left without a result.
+    last_request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(last_request));
+    snprintf(expected, sizeof(expected),
+             "{\"type\":\"tool_result\",\"tool_use_id\":\"toolu_%d\",\"content\":\"Error: "
+             "not executed: more than %d tool calls per response\",\"is_error\":true}",
+             MAX_TOOL_CALLS_PER_ROUND, MAX_TOOL_CALLS_PER_ROUND);
+    ASSERT(strstr(last_request, expected) != NULL);
+    ASSERT(strstr(last_request, "\"tool_use_id\":\"toolu_0\",\"content\":\"Error") == NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(history_eviction_rebuilds_cached_request)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    char message[900];
+    char response[128];
+    uint32_t full_builds = 0;
+    uint32_t appends = 0;
+    const char *last_request;
+    int turns = 0;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    // Long turns fill the history's byte budget; the first eviction drops msg-00.
+    memset(message, 'x', sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+    while (full_builds < 2) {
+        ASSERT(turns < 16);
+        memcpy(message, "msg-", 4);
+        message[4] = (char)('0' + turns / 10);
+        message[5] = (char)('0' + turns % 10);
+        snprintf(response, sizeof(response),
+                 "{\"content\":[{\"type\":\"text\",\"text\":\"reply-%02d\"}],"
+                 "\"stop_reason\":\"end_turn\"}", turns);
+        ASSERT(mock_llm_push_result(ESP_OK, response));
+        agent_test_process_message(message);
+        ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+        turns++;
+        agent_test_request_cache_stats(&full_builds, &appends);
+    }
+
+    ASSERT(turns > 2);
+    ASSERT(appends == (uint32_t)turns - 2);
+
+    last_request = mock_llm_last_request_json();
+    ASSERT(last_request != NULL);
+    ASSERT(json_writer_is_valid(last_request));
+    ASSERT(strstr(last_request, "msg-00") == NULL);
+    ASSERT(strstr(last_request, "reply-00") != NULL);
+    ASSERT(strstr(last_request, "msg-01") != NULL);
+    snprintf(text, sizeof(text), "msg-%02d", turns - 1);
+    ASSERT(strstr(last_request, text) != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(sessions_keep_cron_out_of_interactive_context)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    const char *last_request;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"serial-reply\"}],\"stop_reason\":\"end_turn\"}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"cron-reply\"}],\"stop_reason\":\"end_turn\"}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"telegram-reply\"}],\"stop_reason\":\"end_turn\"}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"done\"}],\"stop_reason\":\"end_turn\"}"));
+
+    agent_test_process_message("serial-question");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    agent_test_process_source_message(MSG_SOURCE_CRON, 3, "[CRON 3] check the soil sensor");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    last_request = mock_llm_last_request_json();
+    ASSERT(strstr(last_request, "serial-question") == NULL);
+
+    agent_test_process_source_message(MSG_SOURCE_TELEGRAM, 42, "telegram-question");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    last_request = mock_llm_last_request_json();
+    ASSERT(strstr(last_request, "serial-question") == NULL);
+    ASSERT(strstr(last_request, "[CRON 3]") == NULL);
+
+    // Back on serial: its own context continues, without the other origins.
+    agent_test_process_message("serial-followup");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "done");
+    last_request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(last_request));
+    ASSERT(strstr(last_request, "serial-question") != NULL);
+    ASSERT(strstr(last_request, "serial-reply") != NULL);
+    ASSERT(strstr(last_request, "serial-followup") != NULL);
+    ASSERT(strstr(last_request, "[CRON 3]") == NULL);
+    ASSERT(strstr(last_request, "cron-reply") == NULL);
+    ASSERT(strstr(last_request, "telegram-question") == NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(scheduler_runs_interactive_before_queued_cron)
+{
+    QueueHandle_t input_q;
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    agent_msg_t msg;
+
+    reset_state();
+
+    input_q = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(agent_msg_t));
+    channel_q = xQueueCreate(8, sizeof(channel_msg_t));
+    ASSERT(input_q != NULL && channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    agent_test_set_input_queue(input_q);
+
+    // Two cron firings are queued ahead of a Telegram message.
+    for (int id = 1; id <= 2; id++) {
+        msg = (agent_msg_t){
+            .source = MSG_SOURCE_CRON,
+            .msg_class = MSG_CLASS_BACKGROUND,
+            .source_id = id,
+            .enqueued_us = esp_timer_get_time(),
+        };
+        snprintf(text, sizeof(text), "[CRON %d] read the sensor", id);
+        msg.text = msg_pool_copy(text, strlen(text));
+        ASSERT(xQueueSend(input_q, &msg, 0) == pdTRUE);
+    }
+    msg = (agent_msg_t){
+        .source = MSG_SOURCE_TELEGRAM,
+        .msg_class = MSG_CLASS_INTERACTIVE,
+        .source_id = 42,
+        .enqueued_us = esp_timer_get_time(),
+        .text = msg_pool_copy("user-question", strlen("user-question")),
+    };
+    ASSERT(xQueueSend(input_q, &msg, 0) == pdTRUE);
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT(mock_llm_push_result(ESP_OK,
+            "{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"stop_reason\":\"end_turn\"}"));
+    }
+
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(strstr(mock_llm_last_request_json(), "user-question") != NULL);
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(strstr(mock_llm_last_request_json(), "[CRON 1]") != NULL);
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(strstr(mock_llm_last_request_json(), "[CRON 2]") != NULL);
+    ASSERT(!agent_test_dispatch_next());
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    }
+
+    vQueueDelete(input_q);
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+static void queue_chat_message(QueueHandle_t input_q, int64_t chat_id, const char *text)
+{
+    agent_msg_t msg = {
+        .source = MSG_SOURCE_TELEGRAM,
+        .msg_class = MSG_CLASS_INTERACTIVE,
+        .source_id = chat_id,
+        .enqueued_us = esp_timer_get_time(),
+        .text = msg_pool_copy(text, strlen(text)),
+    };
+    xQueueSend(input_q, &msg, 0);
+}
+
+TEST(queued_chat_messages_coalesce_into_one_turn)
+{
+    QueueHandle_t input_q;
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    const char *last_request;
+
+    reset_state();
+
+    input_q = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(agent_msg_t));
+    channel_q = xQueueCreate(8, sizeof(channel_msg_t));
+    ASSERT(input_q != NULL && channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    agent_test_set_input_queue(input_q);
+    agent_test_set_coalesce_window(0);
+
+    // A burst from chat 42, with another chat's message in between.
+    queue_chat_message(input_q, 42, "turn on");
+    queue_chat_message(input_q, 42, "the porch light");
+    queue_chat_message(input_q, 7, "other-chat");
+    queue_chat_message(input_q, 42, "please");
+
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"stop_reason\":\"end_turn\"}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"stop_reason\":\"end_turn\"}"));
+
+    ASSERT(agent_test_dispatch_next());
+    last_request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(last_request));
+    ASSERT(strstr(last_request, "\"turn on\\nthe porch light\\nplease\"") != NULL);
+    ASSERT(strstr(last_request, "other-chat") == NULL);
+    ASSERT(mock_llm_request_count() == 1);
+
+    ASSERT(agent_test_dispatch_next());
+    last_request = mock_llm_last_request_json();
+    ASSERT(strstr(last_request, "other-chat") != NULL);
+    ASSERT(strstr(last_request, "porch") == NULL);
+    ASSERT(!agent_test_dispatch_next());
+    ASSERT(mock_llm_request_count() == 2);
+
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 0);
+
+    vQueueDelete(input_q);
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(coalesced_turn_stops_at_message_limit)
+{
+    QueueHandle_t input_q;
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    char part[CHANNEL_RX_BUF_SIZE];
+
+    reset_state();
+
+    input_q = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(agent_msg_t));
+    channel_q = xQueueCreate(8, sizeof(channel_msg_t));
+    ASSERT(input_q != NULL && channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    agent_test_set_input_queue(input_q);
+    agent_test_set_coalesce_window(0);
+
+    // Three near-full messages do not fit in one MAX_MESSAGE_LEN turn.
+    for (int i = 0; i < 3; i++) {
+        memset(part, 'a' + i, sizeof(part) - 1);
+        part[sizeof(part) - 1] = '\0';
+        queue_chat_message(input_q, 42, part);
+    }
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"stop_reason\":\"end_turn\"}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"stop_reason\":\"end_turn\"}"));
+
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(strstr(mock_llm_last_request_json(), "aaaa") != NULL);
+    ASSERT(strstr(mock_llm_last_request_json(), "cccc") == NULL);
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(strstr(mock_llm_last_request_json(), "cccc") != NULL);
+    ASSERT(!agent_test_dispatch_next());
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+
+    vQueueDelete(input_q);
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(routed_commands_are_not_coalesced)
+{
+    QueueHandle_t input_q;
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    int64_t start_us;
+
+    reset_state();
+
+    input_q = xQueueCreate(INPUT_QUEUE_LENGTH, sizeof(agent_msg_t));
+    channel_q = xQueueCreate(8, sizeof(channel_msg_t));
+    ASSERT(input_q != NULL && channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    agent_test_set_input_queue(input_q);
+    agent_test_set_command_router(true);
+    // The agent is idle, so this window is never waited out.
+    agent_test_set_coalesce_window(10000);
+
+    queue_chat_message(input_q, 42, "/health");
+    queue_chat_message(input_q, 42, "/time");
+    queue_chat_message(input_q, 42, "turn on");
+    queue_chat_message(input_q, 42, "the light");
+    queue_chat_message(input_q, 42, "/time");
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"ok\"}],\"stop_reason\":\"end_turn\"}"));
+
+    start_us = esp_timer_get_time();
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(mock_llm_request_count() == 0);
+
+    // Plain messages still merge, up to the next command.
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(mock_llm_request_count() == 1);
+    ASSERT(strstr(mock_llm_last_request_json(), "\"turn on\\nthe light\"") != NULL);
+    ASSERT(strstr(mock_llm_last_request_json(), "/time") == NULL);
+
+    ASSERT(agent_test_dispatch_next());
+    ASSERT(!agent_test_dispatch_next());
+    ASSERT(mock_llm_request_count() == 1);
+    ASSERT(esp_timer_get_time() - start_us < 1000000);
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    }
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 0);
+
+    agent_test_set_command_router(false);
+    vQueueDelete(input_q);
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(command_router_answers_without_llm)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    agent_test_set_command_router(true);
+    mock_tools_set_result("Pin 5 set HIGH");
+
+    agent_test_process_message("gpio 5 on");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "Pin 5 set HIGH");
+    ASSERT_STR_EQ(mock_tools_last_name(), "gpio_write");
+    ASSERT_STR_EQ(mock_tools_last_input(), "{\"pin\":5,\"state\":1}");
+    ASSERT(mock_llm_request_count() == 0);
+    ASSERT(mock_ratelimit_record_count() == 0);
+
+    // /ask bypasses the router; the command never entered the history.
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"asked\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message("/ask gpio 6 on");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "asked");
+    ASSERT(mock_llm_request_count() == 1);
+    ASSERT(mock_tools_execute_calls() == 1);
+    ASSERT(strstr(mock_llm_last_request_json(), "\"gpio 6 on\"") != NULL);
+    ASSERT(strstr(mock_llm_last_request_json(), "/ask") == NULL);
+    ASSERT(strstr(mock_llm_last_request_json(), "gpio 5 on") == NULL);
+
+    // Disabled: everything goes to the LLM.
+    agent_test_set_command_router(false);
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"via llm\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message("/health");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "via llm");
+    ASSERT(mock_llm_request_count() == 2);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+static bool push_tool_use(const char *id, const char *name, const char *input_json)
+{
+    char response[512];
+    snprintf(response, sizeof(response),
+             "{\"content\":[{\"type\":\"tool_use\",\"id\":\"%s\",\"name\":\"%s\","
+             "\"input\":%s}],\"stop_reason\":\"tool_use\"}", id, name, input_json);
+    return mock_llm_push_result(ESP_OK, response);
+}
+
+TEST(user_tool_run_is_recorded_and_replayed)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"watered\"}],\"stop_reason\":\"end_turn\"}";
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    ASSERT(user_tools_create("water_plants", "Water the plants", "GPIO 5 on, then read pin 5"));
+
+    // First run: the model carries out the action and its calls are recorded.
+    ASSERT(push_tool_use("toolu_1", "water_plants", "{}"));
+    ASSERT(push_tool_use("toolu_2", "gpio_write", "{\"pin\":5,\"state\":1}"));
+    ASSERT(push_tool_use("toolu_3", "gpio_read", "{\"pin\":5}"));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("water the plants");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(mock_llm_request_count() == 4);
+    ASSERT(mock_tools_execute_calls() == 2);
+
+    // The read-back is a lookup beside a side effect: not part of the recording.
+    const user_tool_recording_t *recording = user_tools_get_recording("water_plants");
+    ASSERT(recording != NULL);
+    ASSERT(recording->step_count == 1);
+    ASSERT_STR_EQ(recording->steps[0].tool, "gpio_write");
+    ASSERT_STR_EQ(recording->steps[0].input, "{\"pin\":5,\"state\":1}");
+
+    // Later runs replay the steps inside the tool call: one round fewer per step.
+    ASSERT(push_tool_use("toolu_4", "water_plants", "{}"));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("water the plants again");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(mock_llm_request_count() == 6);
+    ASSERT(mock_tools_execute_calls() == 3);
+    ASSERT_STR_EQ(mock_tools_last_name(), "gpio_write");
+    ASSERT(strstr(mock_llm_last_request_json(), "Done, replayed 1 recorded steps") != NULL);
+
+    // As a slash command it needs no LLM at all.
+    agent_test_set_command_router(true);
+    agent_test_process_message("/water_plants");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(strncmp(text, "Done, replayed 1 recorded steps", 31) == 0);
+    ASSERT(mock_llm_request_count() == 6);
+    ASSERT(mock_tools_execute_calls() == 4);
+
+    // A failing step drops the recording; the next call goes to the model.
+    mock_tools_set_success(false);
+    agent_test_process_message("/water_plants");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(strstr(text, "failed at step 1 of 1") != NULL);
+    ASSERT(user_tools_get_recording("water_plants")->step_count == 0);
+    mock_tools_set_success(true);
+
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("/water_plants");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(mock_llm_request_count() == 7);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(user_tool_recording_stops_where_the_action_ends)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"done\"}],\"stop_reason\":\"end_turn\"}";
+    const user_tool_recording_t *recording;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    ASSERT(user_tools_create("blink", "Blink the LED", "GPIO 2 on, then off"));
+    ASSERT(user_tools_create("report", "Report pin 4", "Read pin 4"));
+
+    // Side effects over consecutive rounds are one action; the lookup after
+    // them is the model's own.
+    ASSERT(push_tool_use("toolu_1", "blink", "{}"));
+    ASSERT(push_tool_use("toolu_2", "gpio_write", "{\"pin\":2,\"state\":1}"));
+    ASSERT(push_tool_use("toolu_3", "gpio_write", "{\"pin\":2,\"state\":0}"));
+    ASSERT(push_tool_use("toolu_4", "get_time", "{}"));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("blink");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    recording = user_tools_get_recording("blink");
+    ASSERT(recording->step_count == 2);
+    ASSERT_STR_EQ(recording->steps[1].input, "{\"pin\":2,\"state\":0}");
+
+    // A query keeps its lookup, and ends with the round that made it.
+    ASSERT(push_tool_use("toolu_5", "report", "{}"));
+    ASSERT(push_tool_use("toolu_6", "gpio_read", "{\"pin\":4}"));
+    ASSERT(push_tool_use("toolu_7", "memory_set", "{\"key\":\"u_pin4\",\"value\":\"1\"}"));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("report");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    recording = user_tools_get_recording("report");
+    ASSERT(recording->step_count == 1);
+    ASSERT_STR_EQ(recording->steps[0].tool, "gpio_read");
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(user_tool_replay_opt_out_is_never_recorded)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    ASSERT(user_tools_create("report", "Report the weather", "Read pin 4 and describe it"));
+    ASSERT(user_tools_set_replay("report", false));
+
+    ASSERT(push_tool_use("toolu_1", "report", "{}"));
+    ASSERT(push_tool_use("toolu_2", "gpio_read", "{\"pin\":4}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"sunny\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message("weather?");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(user_tools_get_recording("report")->step_count == 0);
+    ASSERT(user_tools_get_recording("report")->replay_disabled);
+    ASSERT(strstr(mock_llm_last_request_json(), "Execute this action now") != NULL);
+
+    // Without a successful turn nothing is recorded either.
+    ASSERT(user_tools_set_replay("report", true));
+    ASSERT(push_tool_use("toolu_3", "report", "{}"));
+    ASSERT(push_tool_use("toolu_4", "gpio_read", "{\"pin\":4}"));
+    ASSERT(mock_llm_push_result(ESP_FAIL, NULL));
+    ASSERT(mock_llm_push_result(ESP_FAIL, NULL));
+    ASSERT(mock_llm_push_result(ESP_FAIL, NULL));
+    agent_test_process_message("weather now?");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(user_tools_get_recording("report")->step_count == 0);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(plan_mode_runs_a_whole_plan_in_one_round)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    static const tool_def_t defs[] = {
+        { .name = "gpio_write" },
+        { .name = "gpio_read" },
+        { .name = "delay" },
+        { .name = "memory_set" },
+    };
+    const char *plan =
+        "{\"steps\":[{\"tool\":\"gpio_write\",\"input\":{\"pin\":5,\"state\":1}},"
+        "{\"tool\":\"delay\",\"input\":{\"milliseconds\":200}},"
+        "{\"tool\":\"gpio_write\",\"input\":{\"pin\":5,\"state\":0}},"
+        "{\"tool\":\"gpio_read\",\"input\":{\"pin\":6}}]}";
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"blinked\"}],\"stop_reason\":\"end_turn\"}";
+    const char *memory_input =
+        "{\"key\":\"u_morning_routine\",\"value\":\"Open the blinds at 7:00, "
+        "start the coffee machine on pin 4 and read me the weather for Lisbon\"}";
+    char memory_plan[400];
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+    mock_tools_set_defs(defs, 4);
+
+    // Step mode does not offer the plan tool.
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("hello");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(strstr(mock_llm_last_request_json(), "\"run_plan\"") == NULL);
+
+    agent_test_set_plan_mode(true);
+    ASSERT(push_tool_use("toolu_1", "run_plan", plan));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("blink pin 5 once, then read pin 6");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT_STR_EQ(text, "blinked");
+    ASSERT(mock_llm_request_count() == 3);
+    ASSERT(mock_tools_execute_calls() == 4);
+    ASSERT_STR_EQ(mock_tools_last_name(), "gpio_read");
+    ASSERT(strstr(mock_llm_last_request_json(), "\"run_plan\"") != NULL);
+    ASSERT(strstr(mock_llm_last_request_json(), "Plan done, 4 steps:") != NULL);
+
+    // A failed step ends the plan; the model sees where.
+    mock_tools_set_success(false);
+    ASSERT(push_tool_use("toolu_2", "run_plan", plan));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("blink again");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(mock_tools_execute_calls() == 5);
+    ASSERT(strstr(mock_llm_last_request_json(), "Plan stopped: step 1 of 4 failed") != NULL);
+
+    // Unknown tools are rejected before anything runs.
+    mock_tools_set_success(true);
+    ASSERT(push_tool_use("toolu_3", "run_plan", "{\"steps\":[{\"tool\":\"run_plan\"}]}"));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("plan a plan");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(mock_tools_execute_calls() == 5);
+    ASSERT(strstr(mock_llm_last_request_json(), "step 1 must name a built-in tool") != NULL);
+
+    // Inputs are not held to the size of stored script steps.
+    ASSERT(strlen(memory_input) >= TOOL_STEP_INPUT_LEN);
+    snprintf(memory_plan, sizeof(memory_plan),
+             "{\"steps\":[{\"tool\":\"memory_set\",\"input\":%s},"
+             "{\"tool\":\"gpio_write\",\"input\":{\"pin\":4,\"state\":1}}]}", memory_input);
+    ASSERT(push_tool_use("toolu_4", "run_plan", memory_plan));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("remember my morning routine and start the coffee");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    ASSERT(mock_tools_execute_calls() == 7);
+    ASSERT(strstr(mock_llm_last_request_json(), "Plan done, 2 steps:") != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+// Runs turns msg-<first>..msg-<last>. With a summary result, the last reply
+// reports a prompt at the compaction threshold and the summary request that
+// follows it gets summary_err/summary_json.
+static int run_short_turns(QueueHandle_t channel_q, int first, int last,
+                           esp_err_t summary_err, const char *summary_json)
+{
+    bool large_prompt = summary_err != ESP_OK || summary_json != NULL;
+
+    char text[CHANNEL_RX_BUF_SIZE];
+    char message[32];
+    char response[192];
+
+    for (int i = first; i <= last; i++) {
+        snprintf(message, sizeof(message), "msg-%02d", i);
+        snprintf(response, sizeof(response),
+                 "{\"content\":[{\"type\":\"text\",\"text\":\"reply-%02d\"}],"
+                 "\"stop_reason\":\"end_turn\",\"usage\":{\"input_tokens\":%d,\"output_tokens\":5}}",
+                 i, (large_prompt && i == last) ? HISTORY_COMPACT_TOKENS : 100);
+        ASSERT(mock_llm_push_result(ESP_OK, response));
+        if (large_prompt && i == last) {
+            ASSERT(mock_llm_push_result(summary_err, summary_json));
+        }
+        agent_test_process_message(message);
+        ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    }
+    return 0;
+}
+
+static int recv_telegram_msg(QueueHandle_t queue, telegram_msg_kind_t *kind,
+                             char *out, size_t out_len)
+{
+    telegram_msg_t msg;
+    if (xQueueReceive(queue, &msg, 0) != pdTRUE) {
+        return 0;
+    }
+    *kind = msg.kind;
+    snprintf(out, out_len, "%s", msg.text->text);
+    msg_pool_release(msg.text);
+    return 1;
+}
+
+TEST(telegram_reply_shows_tool_progress)
+{
+    QueueHandle_t telegram_q;
+    telegram_msg_kind_t kind;
+    char text[TELEGRAM_MAX_MSG_LEN];
+
+    reset_state();
+    telegram_q = xQueueCreate(8, sizeof(telegram_msg_t));
+    ASSERT(telegram_q != NULL);
+    agent_test_set_queues(NULL, telegram_q);
+    agent_test_set_progressive_replies(true);
+
+    ASSERT(push_tool_use("toolu_1", "gpio_write", "{\"pin\":5,\"state\":1}"));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"Pin 5 is on.\"}],\"stop_reason\":\"end_turn\"}"));
+
+    agent_test_process_source_message(MSG_SOURCE_TELEGRAM, 42, "switch on pin 5");
+
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_REPLY_START);
+    ASSERT_STR_EQ(text, TELEGRAM_REPLY_PLACEHOLDER);
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_REPLY_PROGRESS);
+    ASSERT_STR_EQ(text, "Running gpio_write...");
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_TEXT);
+    ASSERT_STR_EQ(text, "Pin 5 is on.");
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 0);
+
+    // Serial requests still get one plain message.
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"hi\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message("hello");
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_TEXT);
+    ASSERT_STR_EQ(text, "hi");
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 0);
+
+    vQueueDelete(telegram_q);
+    return 0;
+}
+
+TEST(telegram_reply_collects_streamed_text)
+{
+    QueueHandle_t telegram_q;
+    telegram_msg_kind_t kind;
+    char text[TELEGRAM_MAX_MSG_LEN];
+    const char *streamed = "Checking the sensor. It reads 21 degrees.";
+    char response[256];
+
+    reset_state();
+    telegram_q = xQueueCreate(8, sizeof(telegram_msg_t));
+    ASSERT(telegram_q != NULL);
+    agent_test_set_queues(NULL, telegram_q);
+    agent_test_set_progressive_replies(true);
+
+    snprintf(response, sizeof(response),
+             "{\"content\":[{\"type\":\"text\",\"text\":\"%s\"}],\"stop_reason\":\"end_turn\"}",
+             streamed);
+    ASSERT(mock_llm_push_streamed_result(ESP_OK, response, streamed, 5));
+
+    agent_test_process_source_message(MSG_SOURCE_TELEGRAM, 42, "how warm is it");
+
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_REPLY_START);
+    // Edits are throttled, so at most a snapshot or two precede the final text.
+    do {
+        ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    } while (kind == TELEGRAM_MSG_REPLY_PROGRESS);
+    ASSERT(kind == TELEGRAM_MSG_TEXT);
+    ASSERT_STR_EQ(text, streamed);
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 0);
+
+    vQueueDelete(telegram_q);
+    return 0;
+}
+
+TEST(telegram_reply_splits_past_message_limit)
+{
+    QueueHandle_t telegram_q;
+    telegram_msg_kind_t kind;
+    static char text[TELEGRAM_MAX_MSG_LEN];
+    static char streamed[3501];
+    static char final_text[901];
+    static char response[LLM_RESPONSE_BUF_SIZE];
+
+    reset_state();
+    telegram_q = xQueueCreate(16, sizeof(telegram_msg_t));
+    ASSERT(telegram_q != NULL);
+    agent_test_set_queues(NULL, telegram_q);
+    agent_test_set_progressive_replies(true);
+
+    // Streamed text and the final answer together exceed one message.
+    memset(streamed, 's', sizeof(streamed) - 1);
+    memset(final_text, 'f', sizeof(final_text) - 1);
+    snprintf(response, sizeof(response),
+             "{\"content\":[{\"type\":\"text\",\"text\":\"%s\"},"
+             "{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"gpio_read\","
+             "\"input\":{\"pin\":5}}],\"stop_reason\":\"tool_use\"}", streamed);
+    ASSERT(mock_llm_push_streamed_result(ESP_OK, response, streamed, 500));
+    snprintf(response, sizeof(response),
+             "{\"content\":[{\"type\":\"text\",\"text\":\"%s\"}],\"stop_reason\":\"end_turn\"}",
+             final_text);
+    ASSERT(mock_llm_push_result(ESP_OK, response));
+
+    agent_test_process_source_message(MSG_SOURCE_TELEGRAM, 42, "read pin 5");
+
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_REPLY_START);
+    do {
+        ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    } while (kind == TELEGRAM_MSG_REPLY_PROGRESS);
+    ASSERT(kind == TELEGRAM_MSG_TEXT);
+    ASSERT_STR_EQ(text, streamed);
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 1);
+    ASSERT(kind == TELEGRAM_MSG_TEXT);
+    ASSERT_STR_EQ(text, final_text);
+    ASSERT(recv_telegram_msg(telegram_q, &kind, text, sizeof(text)) == 0);
+
+    vQueueDelete(telegram_q);
+    return 0;
+}
+
+TEST(history_compaction_replaces_old_turns)
+{
+    QueueHandle_t channel_q;
+    const char *request;
+
+    reset_state();
+    agent_test_set_history_compaction(true);
+    mock_llm_set_summary_model("cheap-model");
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    // Small prompts: nothing to compact yet.
+    ASSERT(run_short_turns(channel_q, 0, 2, ESP_OK, NULL) == 0);
+    ASSERT(mock_llm_request_count() == 3);
+
+    // A prompt at the token threshold triggers one summary request covering
+    // everything but the last HISTORY_COMPACT_KEEP_TURNS turns.
+    ASSERT(run_short_turns(channel_q, 3, 3, ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"User is Ted. Pin 5 drives the lamp.\"}],"
+        "\"stop_reason\":\"end_turn\"}") == 0);
+    ASSERT(mock_llm_request_count() == 5);
+    request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(request));
+    ASSERT(strstr(request, "\"model\":\"cheap-model\"") != NULL);
+    ASSERT(strstr(request, "user: msg-00\\nassistant: reply-00\\n") != NULL);
+    ASSERT(strstr(request, "assistant: reply-01\\n\"}") != NULL);
+    ASSERT(strstr(request, "msg-02") == NULL);
+    ASSERT(strstr(request, "\"tools\"") == NULL);
+
+    // Later requests carry the summary in place of the old turns.
+    ASSERT(run_short_turns(channel_q, 4, 4, ESP_OK, NULL) == 0);
+    request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(request));
+    ASSERT(strstr(request, "\"model\":\"mock-anthropic\"") != NULL);
+    ASSERT(strstr(request, "\"messages\":[{\"role\":\"user\",\"content\":\""
+                           HISTORY_SUMMARY_PREFIX "User is Ted. Pin 5 drives the lamp.\"},"
+                           "{\"role\":\"user\",\"content\":\"msg-02\"}") != NULL);
+    ASSERT(strstr(request, "msg-00") == NULL);
+    ASSERT(strstr(request, "reply-01") == NULL);
+    ASSERT(strstr(request, "msg-04") != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(history_compaction_failure_keeps_history)
+{
+    QueueHandle_t channel_q;
+    const char *request;
+
+    reset_state();
+    agent_test_set_history_compaction(true);
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    ASSERT(run_short_turns(channel_q, 0, 2, ESP_OK, NULL) == 0);
+    ASSERT(run_short_turns(channel_q, 3, 3, ESP_FAIL, NULL) == 0);
+    ASSERT(mock_llm_request_count() == 5);
+
+    // No retry, no summary: the next turn still sends the full history.
+    ASSERT(run_short_turns(channel_q, 4, 4, ESP_OK, NULL) == 0);
+    ASSERT(mock_llm_request_count() == 6);
+    request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(request));
+    ASSERT(strstr(request, HISTORY_SUMMARY_PREFIX) == NULL);
+    ASSERT(strstr(request, "msg-00") != NULL);
+    ASSERT(strstr(request, "msg-04") != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+static int run_tool_turn(QueueHandle_t channel_q, const char *message, const char *tool_id)
+{
+    char text[CHANNEL_RX_BUF_SIZE];
+    char tool_use[256];
+
+    snprintf(tool_use, sizeof(tool_use),
+             "{\"content\":[{\"type\":\"tool_use\",\"id\":\"%s\",\"name\":\"gpio_read\","
+             "\"input\":{\"pin\":4}}],\"stop_reason\":\"tool_use\"}", tool_id);
+    ASSERT(mock_llm_push_result(ESP_OK, tool_use));
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"done\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message(message);
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    return 0;
+}
+
+static int count_matches(const char *haystack, const char *needle)
+{
+    int count = 0;
+    for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+TEST(token_budget_elides_oldest_tool_results_first)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    char result[400];
+    const char *request;
+    size_t result_tokens;
+    size_t full_tokens;
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    result[0] = '\0';
+    while (strlen(result) + 16 < sizeof(result)) {
+        strcat(result, "pin 4 reads low ");
+    }
+    mock_tools_set_result(result);
+    result_tokens = token_estimate(result, strlen(result));
+
+    ASSERT(run_tool_turn(channel_q, "read pin 4", "toolu_1") == 0);
+    ASSERT(run_tool_turn(channel_q, "read it again", "toolu_2") == 0);
+    request = mock_llm_last_request_json();
+    ASSERT(count_matches(request, result) == 2);
+    full_tokens = token_estimate(request, strlen(request));
+
+    // Room for all but about one result: only the oldest one is elided, and
+    // its tool_use/tool_result pair stays in place.
+    agent_test_set_token_budget(full_tokens + 40 - result_tokens / 2);
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"hi\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message("hello");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(request));
+    ASSERT(count_matches(request, result) == 1);
+    ASSERT(count_matches(request, HISTORY_ELIDED_RESULT) == 1);
+    ASSERT(strstr(request, "\"tool_use_id\":\"toolu_1\",\"content\":\"" HISTORY_ELIDED_RESULT "\"") != NULL);
+    ASSERT(strstr(request, "\"id\":\"toolu_1\"") != NULL);
+    ASSERT(strstr(request, "read pin 4") != NULL);
+    ASSERT(token_estimate(request, strlen(request)) <= full_tokens + 40 - result_tokens / 2);
+
+    // Once no results are left to elide, the oldest turns go, never the newest.
+    agent_test_set_token_budget(50);
+    ASSERT(mock_llm_push_result(ESP_OK,
+        "{\"content\":[{\"type\":\"text\",\"text\":\"bye\"}],\"stop_reason\":\"end_turn\"}"));
+    agent_test_process_message("one last thing");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    request = mock_llm_last_request_json();
+    ASSERT(json_writer_is_valid(request));
+    ASSERT(strstr(request, "\"messages\":[{\"role\":\"user\",\"content\":\"one last thing\"}]") != NULL);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+TEST(token_usage_totals_accumulate)
+{
+    QueueHandle_t channel_q;
+    char text[CHANNEL_RX_BUF_SIZE];
+    agent_usage_totals_t totals;
+    const char *tool_use =
+        "{\"content\":[{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"gpio_read\","
+        "\"input\":{\"pin\":4}}],\"stop_reason\":\"tool_use\","
+        "\"usage\":{\"input_tokens\":100,\"cache_read_input_tokens\":900,"
+        "\"cache_creation_input_tokens\":0,\"output_tokens\":20}}";
+    const char *done =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"pin 4 is low\"}],\"stop_reason\":\"end_turn\","
+        "\"usage\":{\"input_tokens\":50,\"cache_read_input_tokens\":1000,"
+        "\"cache_creation_input_tokens\":30,\"output_tokens\":8}}";
+    const char *no_usage =
+        "{\"content\":[{\"type\":\"text\",\"text\":\"hi\"}],\"stop_reason\":\"end_turn\"}";
+
+    reset_state();
+
+    channel_q = xQueueCreate(4, sizeof(channel_msg_t));
+    ASSERT(channel_q != NULL);
+    agent_test_set_queues(channel_q, NULL);
+
+    ASSERT(mock_llm_push_result(ESP_OK, tool_use));
+    ASSERT(mock_llm_push_result(ESP_OK, done));
+    agent_test_process_message("read pin 4");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+
+    // Both rounds count toward the request.
+    agent_get_usage_totals(&totals);
+    ASSERT(totals.requests == 1);
+    ASSERT(totals.input_tokens == 100 + 900 + 50 + 1000 + 30);
+    ASSERT(totals.cache_read_tokens == 1900);
+    ASSERT(totals.output_tokens == 28);
+    ASSERT(totals.last_input_tokens == 2080);
+    ASSERT(totals.last_output_tokens == 28);
+
+    // A response without usage still counts as a request.
+    ASSERT(mock_llm_push_result(ESP_OK, no_usage));
+    agent_test_process_message("hello");
+    ASSERT(recv_channel_text(channel_q, text, sizeof(text)) == 1);
+    agent_get_usage_totals(&totals);
+    ASSERT(totals.requests == 2);
+    ASSERT(totals.input_tokens == 2080);
+    ASSERT(totals.last_input_tokens == 0);
+
+    vQueueDelete(channel_q);
+    return 0;
+}
+
+int test_agent_all(void)
+{
+    int failures = 0;
+
+    printf("\nAgent Tests:\n");
+
+    printf("  retries_with_backoff_and_fanout... ");
+    if (test_retries_with_backoff_and_fanout() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  long_reply_fans_out_in_one_buffer... ");
+    if (test_long_reply_fans_out_in_one_buffer() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  rate_limit_short_circuit... ");
+    if (test_rate_limit_short_circuit() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  fails_after_max_retries_without_extra_sleep... ");
+    if (test_fails_after_max_retries_without_extra_sleep() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  failed_turn_does_not_pollute_followup_prompt... ");
+    if (test_failed_turn_does_not_pollute_followup_prompt() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  streamed_text_is_not_sent_twice... ");
+    if (test_streamed_text_is_not_sent_twice() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  streamed_text_is_batched_for_telegram... ");
+    if (test_streamed_text_is_batched_for_telegram() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  tool_round_appends_to_cached_request... ");
+    if (test_tool_round_appends_to_cached_request() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  parallel_tool_calls_run_in_one_round... ");
+    if (test_parallel_tool_calls_run_in_one_round() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  tool_calls_past_round_limit_get_error_results... ");
+    if (test_tool_calls_past_round_limit_get_error_results() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  history_eviction_rebuilds_cached_request... ");
+    if (test_history_eviction_rebuilds_cached_request() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  token_budget_elides_oldest_tool_results_first... ");
+    if (test_token_budget_elides_oldest_tool_results_first() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  token_usage_totals_accumulate... ");
+    if (test_token_usage_totals_accumulate() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  history_compaction_replaces_old_turns... ");
+    if (test_history_compaction_replaces_old_turns() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  history_compaction_failure_keeps_history... ");
+    if (test_history_compaction_failure_keeps_history() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  sessions_keep_cron_out_of_interactive_context... ");
+    if (test_sessions_keep_cron_out_of_interactive_context() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  scheduler_runs_interactive_before_queued_cron... ");
+    if (test_scheduler_runs_interactive_before_queued_cron() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  queued_chat_messages_coalesce_into_one_turn... ");
+    if (test_queued_chat_messages_coalesce_into_one_turn() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  coalesced_turn_stops_at_message_limit... ");
+    if (test_coalesced_turn_stops_at_message_limit() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  routed_commands_are_not_coalesced... ");
+    if (test_routed_commands_are_not_coalesced() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  command_router_answers_without_llm... ");
+    if (test_command_router_answers_without_llm() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  user_tool_run_is_recorded_and_replayed... ");
+    if (test_user_tool_run_is_recorded_and_replayed() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  user_tool_recording_stops_where_the_action_ends... ");
+    if (test_user_tool_recording_stops_where_the_action_ends() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  user_tool_replay_opt_out_is_never_recorded... ");
+    if (test_user_tool_replay_opt_out_is_never_recorded() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+    printf("  plan_mode_runs_a_whole_plan_in_one_round... ");
+    if (test_plan_mode_runs_a_whole_plan_in_one_round() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  telegram_reply_shows_tool_progress... ");
+    if (test_telegram_reply_shows_tool_progress() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  telegram_reply_collects_streamed_text... ");
+    if (test_telegram_reply_collects_streamed_text() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  telegram_reply_splits_past_message_limit... ");
+    if (test_telegram_reply_splits_past_message_limit() == 0) {
         printf("OK\n");
     } else {
         failures++;
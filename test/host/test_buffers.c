@@ -0,0 +1,131 @@
+/*
+ * Host tests for PSRAM-aware buffer placement.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffers.h"
+#include "esp_heap_caps.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static bool all_zero(const char *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(bulk_prefers_psram_internal_stays_internal)
+{
+    buffer_test_reset();
+    mock_esp_set_psram_size(8192);
+
+    char *bulk = buffer_alloc("bulk", 4096, BUFFER_BULK);
+    char *internal = buffer_alloc("internal", 1024, BUFFER_INTERNAL);
+    ASSERT(bulk != NULL && internal != NULL);
+    ASSERT(all_zero(bulk, 4096));
+    ASSERT(buffer_in_psram("bulk"));
+    ASSERT(!buffer_in_psram("internal"));
+    ASSERT(heap_caps_get_free_size(MALLOC_CAP_SPIRAM) == 4096);
+    buffer_report();
+
+    free(bulk);
+    free(internal);
+    mock_esp_set_psram_size(0);
+    buffer_test_reset();
+    return 0;
+}
+
+TEST(bulk_falls_back_to_internal_ram)
+{
+    buffer_test_reset();
+
+    // No PSRAM at all
+    mock_esp_set_psram_size(0);
+    char *first = buffer_alloc("first", 2048, BUFFER_BULK);
+    ASSERT(first != NULL);
+    ASSERT(!buffer_in_psram("first"));
+
+    // PSRAM present but too small for this buffer
+    mock_esp_set_psram_size(1024);
+    char *second = buffer_alloc("second", 2048, BUFFER_BULK);
+    ASSERT(second != NULL);
+    ASSERT(!buffer_in_psram("second"));
+    ASSERT(heap_caps_get_free_size(MALLOC_CAP_SPIRAM) == 1024);
+
+    // Transient buffers are placed the same way but not listed.
+    char *transient = buffer_alloc(NULL, 512, BUFFER_BULK);
+    ASSERT(transient != NULL);
+    ASSERT(heap_caps_get_free_size(MALLOC_CAP_SPIRAM) == 512);
+
+    free(first);
+    free(second);
+    free(transient);
+    mock_esp_set_psram_size(0);
+    buffer_test_reset();
+    return 0;
+}
+
+TEST(queue_storage_is_bulk)
+{
+    char item[32] = "queued";
+    char out[32] = {0};
+
+    buffer_test_reset();
+    mock_esp_set_psram_size(4096);
+
+    QueueHandle_t queue = buffer_queue_create("queue", 4, sizeof(item));
+    ASSERT(queue != NULL);
+    ASSERT(buffer_in_psram("queue"));
+    ASSERT(heap_caps_get_free_size(MALLOC_CAP_SPIRAM) == 4096 - 4 * sizeof(item));
+    ASSERT(xQueueSend(queue, item, 0) == pdTRUE);
+    ASSERT(xQueueReceive(queue, out, 0) == pdTRUE);
+    ASSERT(strcmp(out, "queued") == 0);
+
+    vQueueDelete(queue);
+    mock_esp_set_psram_size(0);
+    buffer_test_reset();
+    return 0;
+}
+
+int test_buffers_all(void)
+{
+    int failures = 0;
+
+    printf("\nBuffer Placement Tests:\n");
+
+    printf("  bulk_prefers_psram_internal_stays_internal... ");
+    if (test_bulk_prefers_psram_internal_stays_internal() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  bulk_falls_back_to_internal_ram... ");
+    if (test_bulk_falls_back_to_internal_ram() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  queue_storage_is_bulk... ");
+    if (test_queue_storage_is_bulk() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
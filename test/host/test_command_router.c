@@ -0,0 +1,146 @@
+/*
+ * Host tests for the fast-path command grammar.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "command_router.h"
+#include "config.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static int expect_tool(const char *text, const char *tool, const char *input_json)
+{
+    command_route_t route;
+    if (command_route(text, &route) != COMMAND_TOOL || strcmp(route.tool, tool) != 0 ||
+        strcmp(route.input_json, input_json) != 0) {
+        printf("  FAIL: '%s' -> %s %s (line %d)\n", text, route.tool ? route.tool : "(none)",
+               route.input_json, __LINE__);
+        return 1;
+    }
+    return 0;
+}
+
+TEST(slash_commands_map_to_tools)
+{
+    command_route_t route;
+
+    ASSERT(expect_tool("/health", "get_health", "{}") == 0);
+    ASSERT(expect_tool("  /TIME  ", "get_time", "{}") == 0);
+    ASSERT(expect_tool("/version", "get_version", "{}") == 0);
+    ASSERT(expect_tool("/health@zclaw_bot", "get_health", "{}") == 0);
+    ASSERT(expect_tool("/cron", "cron_list", "{}") == 0);
+    ASSERT(expect_tool("/cron list", "cron_list", "{}") == 0);
+    ASSERT(expect_tool("/cron delete 3", "cron_delete", "{\"id\":3}") == 0);
+    ASSERT(expect_tool("/gpio 5 on", "gpio_write", "{\"pin\":5,\"state\":1}") == 0);
+    ASSERT(expect_tool("/gpio 5 LOW", "gpio_write", "{\"pin\":5,\"state\":0}") == 0);
+    ASSERT(expect_tool("/gpio 12", "gpio_read", "{\"pin\":12}") == 0);
+    ASSERT(expect_tool("/memory", "memory_list", "{}") == 0);
+    ASSERT(expect_tool("/memory get u_plant", "memory_get", "{\"key\":\"u_plant\"}") == 0);
+    ASSERT(expect_tool("/tools", "list_user_tools", "{}") == 0);
+
+    ASSERT(command_route("/help", &route) == COMMAND_HELP);
+    ASSERT(strstr(command_router_help(), "/gpio") != NULL);
+    return 0;
+}
+
+TEST(strict_phrases_map_to_tools)
+{
+    ASSERT(expect_tool("gpio 5 on", "gpio_write", "{\"pin\":5,\"state\":1}") == 0);
+    ASSERT(expect_tool("Pin 4 off.", "gpio_write", "{\"pin\":4,\"state\":0}") == 0);
+    ASSERT(expect_tool("turn on pin 5", "gpio_write", "{\"pin\":5,\"state\":1}") == 0);
+    ASSERT(expect_tool("Turn GPIO 7 off!", "gpio_write", "{\"pin\":7,\"state\":0}") == 0);
+    ASSERT(expect_tool("read pin 3", "gpio_read", "{\"pin\":3}") == 0);
+    ASSERT(expect_tool("What time is it?", "get_time", "{}") == 0);
+    return 0;
+}
+
+TEST(everything_else_goes_to_the_llm)
+{
+    command_route_t route;
+    const char *misses[] = {
+        "",
+        "hello",
+        "turn on the porch light",
+        "gpio 5 on and then gpio 6 off",
+        "gpio five on",
+        "gpio 500 on",
+        "/start",
+        "/gpio 5 maybe",
+        "/cron delete soon",
+        "/memory get \"quoted\"",
+        "what time is it in Tokyo",
+        "[CRON 3] gpio 5 on",
+    };
+
+    for (size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); i++) {
+        if (command_route(misses[i], &route) != COMMAND_NONE) {
+            printf("  FAIL: '%s' routed to %s\n", misses[i], route.tool ? route.tool : "?");
+            return 1;
+        }
+    }
+
+    ASSERT(command_route("/ask gpio 5 on", &route) == COMMAND_ASK);
+    ASSERT(strcmp(route.llm_text, "gpio 5 on") == 0);
+    ASSERT(command_route("/ask", &route) == COMMAND_NONE);
+    return 0;
+}
+
+TEST(user_tool_slash_names)
+{
+    char name[TOOL_NAME_MAX_LEN];
+
+    ASSERT(command_user_tool_name("/water_plants", name, sizeof(name)));
+    ASSERT(strcmp(name, "water_plants") == 0);
+    ASSERT(command_user_tool_name("  /Feed_Cat@zclaw_bot ", name, sizeof(name)));
+    ASSERT(strcmp(name, "Feed_Cat") == 0);
+    ASSERT(!command_user_tool_name("water_plants", name, sizeof(name)));
+    ASSERT(!command_user_tool_name("/water plants", name, sizeof(name)));
+    ASSERT(!command_user_tool_name("/", name, sizeof(name)));
+    ASSERT(!command_user_tool_name("/a_name_that_is_far_too_long", name, sizeof(name)));
+    return 0;
+}
+
+int test_command_router_all(void)
+{
+    int failures = 0;
+
+    printf("\nCommand Router Tests:\n");
+
+    printf("  slash_commands_map_to_tools... ");
+    if (test_slash_commands_map_to_tools() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  strict_phrases_map_to_tools... ");
+    if (test_strict_phrases_map_to_tools() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  everything_else_goes_to_the_llm... ");
+    if (test_everything_else_goes_to_the_llm() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  user_tool_slash_names... ");
+    if (test_user_tool_slash_names() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
@@ -0,0 +1,397 @@
+/*
+ * Host tests for the conversation history ring.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "history.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static history_t s_history;
+
+static int push_text(const char *role, const char *content)
+{
+    conversation_msg_t msg = {.role = role, .content = content, .tool_id = "", .tool_name = ""};
+    return history_push(&s_history, &msg);
+}
+
+// Push "m<seq>" padded with 'x' to len bytes.
+static int push_seq(int seq, size_t len)
+{
+    char content[MAX_MESSAGE_LEN];
+    int n = snprintf(content, sizeof(content), "m%d:", seq);
+    if (len >= sizeof(content)) {
+        len = sizeof(content) - 1;
+    }
+    while ((size_t)n < len) {
+        content[n++] = 'x';
+    }
+    content[n] = '\0';
+    return push_text((seq % 2) ? "assistant" : "user", content);
+}
+
+static int seq_of(const conversation_msg_t *msg)
+{
+    int seq = -1;
+    sscanf(msg->content, "m%d:", &seq);
+    return seq;
+}
+
+TEST(push_keeps_order_and_copies)
+{
+    char content[16] = "hello";
+    conversation_msg_t msg = {
+        .role = "assistant",
+        .content = content,
+        .tool_id = "toolu_1",
+        .tool_name = "gpio_write",
+        .is_tool_use = true,
+    };
+
+    history_init(&s_history);
+    ASSERT(push_text("user", "turn on pin 5") == 0);
+    ASSERT(history_push(&s_history, &msg) == 0);
+    strcpy(content, "changed");
+
+    const conversation_msg_t *msgs = history_messages(&s_history);
+    ASSERT(history_count(&s_history) == 2);
+    ASSERT(strcmp(msgs[0].role, "user") == 0);
+    ASSERT(strcmp(msgs[0].content, "turn on pin 5") == 0);
+    ASSERT(msgs[0].tool_id[0] == '\0');
+    ASSERT(msgs[0].tool_name[0] == '\0');
+    ASSERT(strcmp(msgs[1].role, "assistant") == 0);
+    ASSERT(strcmp(msgs[1].content, "hello") == 0);
+    ASSERT(strcmp(msgs[1].tool_id, "toolu_1") == 0);
+    ASSERT(strcmp(msgs[1].tool_name, "gpio_write") == 0);
+    ASSERT(msgs[1].is_tool_use);
+    ASSERT(history_bytes_used(&s_history) == 14 + 6 + 8 + 11);
+    return 0;
+}
+
+TEST(long_content_is_truncated)
+{
+    char content[MAX_MESSAGE_LEN + 100];
+    memset(content, 'a', sizeof(content) - 1);
+    content[sizeof(content) - 1] = '\0';
+
+    history_init(&s_history);
+    ASSERT(push_text("user", content) == 0);
+    ASSERT(strlen(history_messages(&s_history)[0].content) == MAX_MESSAGE_LEN - 1);
+    return 0;
+}
+
+TEST(evicts_oldest_by_byte_budget)
+{
+    int evicted = 0;
+
+    history_init(&s_history);
+    // Messages of ~1 KB: the budget, not the message cap, decides what stays.
+    for (int i = 0; i < 40; i++) {
+        evicted += push_seq(i, 1000);
+        ASSERT(history_bytes_used(&s_history) <= HISTORY_ARENA_BYTES);
+    }
+
+    int count = history_count(&s_history);
+    const conversation_msg_t *msgs = history_messages(&s_history);
+    ASSERT(count < HISTORY_MAX_MESSAGES);
+    ASSERT(count == HISTORY_ARENA_BYTES / 1001 || count == HISTORY_ARENA_BYTES / 1001 - 1);
+    ASSERT(evicted == 40 - count);
+    ASSERT(seq_of(&msgs[0]) == 40 - count);
+    ASSERT(seq_of(&msgs[count - 1]) == 39);
+    return 0;
+}
+
+TEST(evicts_oldest_by_message_cap)
+{
+    history_init(&s_history);
+    for (int i = 0; i < HISTORY_MAX_MESSAGES; i++) {
+        ASSERT(push_seq(i, 8) == 0);
+    }
+    ASSERT(push_seq(HISTORY_MAX_MESSAGES, 8) == 1);
+    ASSERT(history_count(&s_history) == HISTORY_MAX_MESSAGES);
+    ASSERT(seq_of(&history_messages(&s_history)[0]) == 1);
+    return 0;
+}
+
+TEST(wraparound_keeps_view_contiguous)
+{
+    int next_expected_oldest = 0;
+
+    history_init(&s_history);
+    for (int i = 0; i < 2000; i++) {
+        next_expected_oldest += push_seq(i, 10 + (size_t)(i * 37) % 900);
+
+        int count = history_count(&s_history);
+        const conversation_msg_t *msgs = history_messages(&s_history);
+        ASSERT(history_bytes_used(&s_history) <= HISTORY_ARENA_BYTES);
+        ASSERT(seq_of(&msgs[0]) == next_expected_oldest);
+        for (int j = 0; j < count; j++) {
+            ASSERT(seq_of(&msgs[j]) == next_expected_oldest + j);
+            ASSERT(msgs[j].content >= s_history.arena);
+            ASSERT(msgs[j].content + strlen(msgs[j].content) < s_history.arena + HISTORY_ARENA_BYTES);
+        }
+    }
+    return 0;
+}
+
+TEST(rollback_drops_newest_and_reuses_space)
+{
+    history_init(&s_history);
+    push_seq(0, 100);
+    push_seq(1, 100);
+    size_t used = history_bytes_used(&s_history);
+    uint32_t mark = history_mark(&s_history);
+
+    push_seq(2, 500);
+    push_seq(3, 500);
+    ASSERT(history_rollback(&s_history, mark) == 2);
+    ASSERT(history_count(&s_history) == 2);
+    ASSERT(history_bytes_used(&s_history) == used);
+    ASSERT(history_rollback(&s_history, mark) == 0);
+
+    // Rolled-back space is reused, so the oldest messages survive.
+    for (int i = 0; i < 20; i++) {
+        mark = history_mark(&s_history);
+        push_seq(100 + i, 1000);
+        ASSERT(history_rollback(&s_history, mark) == 1);
+    }
+    ASSERT(history_count(&s_history) == 2);
+    ASSERT(seq_of(&history_messages(&s_history)[0]) == 0);
+    ASSERT(seq_of(&history_messages(&s_history)[1]) == 1);
+    return 0;
+}
+
+TEST(rollback_after_eviction)
+{
+    // Two messages short of a full arena.
+    int kept = HISTORY_ARENA_BYTES / 1001 - 2;
+
+    history_init(&s_history);
+    for (int i = 0; i < kept; i++) {
+        push_seq(i, 1000);
+    }
+    uint32_t mark = history_mark(&s_history);
+
+    // A turn longer than the remaining budget evicts older messages.
+    int evicted = 0;
+    for (int i = kept; i < kept + 4; i++) {
+        evicted += push_seq(i, 1000);
+    }
+    ASSERT(evicted > 0);
+    ASSERT(history_rollback(&s_history, mark) == 4);
+
+    int count = history_count(&s_history);
+    const conversation_msg_t *msgs = history_messages(&s_history);
+    ASSERT(count == kept - evicted);
+    ASSERT(seq_of(&msgs[count - 1]) == kept - 1);
+
+    ASSERT(push_seq(kept, 1000) == 0);
+    ASSERT(seq_of(&history_messages(&s_history)[count]) == kept);
+    return 0;
+}
+
+TEST(join_previous_marks_newest)
+{
+    history_init(&s_history);
+    push_text("user", "read pins");
+    history_join_previous(&s_history);
+    ASSERT(!history_messages(&s_history)[0].joins_previous);
+
+    push_text("assistant", "{\"pin\":2}");
+    push_text("assistant", "{\"pin\":3}");
+    history_join_previous(&s_history);
+    ASSERT(!history_messages(&s_history)[1].joins_previous);
+    ASSERT(history_messages(&s_history)[2].joins_previous);
+
+    // Still joined once the ring has wrapped past its mirror.
+    for (int i = 0; i < HISTORY_MAX_MESSAGES + 4; i++) {
+        push_seq(i, 8);
+        if (i % 2) {
+            history_join_previous(&s_history);
+        }
+    }
+    const conversation_msg_t *msgs = history_messages(&s_history);
+    int count = history_count(&s_history);
+    ASSERT(msgs[count - 1].joins_previous == true);
+    ASSERT(msgs[count - 2].joins_previous == false);
+    return 0;
+}
+
+TEST(compact_replaces_oldest_with_summary)
+{
+    conversation_msg_t summary = {.role = "user", .content = "summary of m0..m3", .tool_id = "",
+                                  .tool_name = ""};
+
+    history_init(&s_history);
+    for (int i = 0; i < 6; i++) {
+        push_seq(i, 200);
+    }
+    history_join_previous(&s_history);
+    uint32_t mark = history_mark(&s_history);
+
+    ASSERT(history_compact(&s_history, 4, &summary) == 0);
+    const conversation_msg_t *msgs = history_messages(&s_history);
+    ASSERT(history_count(&s_history) == 3);
+    ASSERT(strcmp(msgs[0].content, "summary of m0..m3") == 0);
+    ASSERT(strcmp(msgs[0].role, "user") == 0);
+    ASSERT(!msgs[0].joins_previous);
+    ASSERT(seq_of(&msgs[1]) == 4);
+    ASSERT(seq_of(&msgs[2]) == 5);
+    ASSERT(msgs[2].joins_previous);
+    ASSERT(history_bytes_used(&s_history) == 18 + 2 * 201);
+
+    // Not a push: rollback marks still refer to the newest messages.
+    ASSERT(history_mark(&s_history) == mark);
+    push_seq(6, 10);
+    ASSERT(history_rollback(&s_history, mark) == 1);
+    ASSERT(history_count(&s_history) == 3);
+    return 0;
+}
+
+TEST(compact_in_wrapped_arena)
+{
+    char text[MAX_MESSAGE_LEN];
+    int next = 0;
+
+    // Interleave pushes of varying size with compactions so the summary lands
+    // before head in every arena layout; order and budget must always hold.
+    history_init(&s_history);
+    for (int round = 0; round < 300; round++) {
+        for (int i = 0; i < 3 + round % 5; i++) {
+            push_seq(next, 20 + (size_t)(next * 53) % 700);
+            next++;
+        }
+        int count = history_count(&s_history);
+        if (count < 3) {
+            continue;
+        }
+        int oldest_kept = seq_of(&history_messages(&s_history)[count - 2]);
+        memset(text, 's', sizeof(text));
+        text[100 + (round * 131) % 800] = '\0';
+        conversation_msg_t summary = {.role = "user", .content = text, .tool_id = "",
+                                      .tool_name = ""};
+
+        int evicted = history_compact(&s_history, count - 2, &summary);
+        const conversation_msg_t *msgs = history_messages(&s_history);
+        count = history_count(&s_history);
+        ASSERT(history_bytes_used(&s_history) <= HISTORY_ARENA_BYTES);
+        ASSERT(count == 3 - evicted);
+        ASSERT(msgs[0].content[0] == 's');
+        ASSERT(strlen(msgs[0].content) == strlen(text));
+        ASSERT(msgs[0].content >= s_history.arena);
+        ASSERT(msgs[0].content + strlen(text) < s_history.arena + HISTORY_ARENA_BYTES);
+        for (int j = 1; j < count; j++) {
+            ASSERT(seq_of(&msgs[j]) == oldest_kept + evicted + j - 1);
+        }
+    }
+    return 0;
+}
+
+TEST(holds_more_turns_in_less_ram)
+{
+    // The fixed-slot history held 24 messages in 24 * sizeof(full message).
+    const size_t fixed_slot_bytes = 24 * (16 + MAX_MESSAGE_LEN + 64 + 32 + 3);
+
+    ASSERT(sizeof(history_t) < fixed_slot_bytes * 3 / 4);
+
+    history_init(&s_history);
+    for (int i = 0; i < HISTORY_MAX_MESSAGES; i++) {
+        ASSERT(push_seq(i, 120) == 0);
+    }
+    ASSERT(history_count(&s_history) == HISTORY_MAX_MESSAGES);
+    return 0;
+}
+
+int test_history_all(void)
+{
+    int failures = 0;
+
+    printf("\nHistory Ring Tests:\n");
+
+    printf("  push_keeps_order_and_copies... ");
+    if (test_push_keeps_order_and_copies() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  long_content_is_truncated... ");
+    if (test_long_content_is_truncated() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  evicts_oldest_by_byte_budget... ");
+    if (test_evicts_oldest_by_byte_budget() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  evicts_oldest_by_message_cap... ");
+    if (test_evicts_oldest_by_message_cap() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  wraparound_keeps_view_contiguous... ");
+    if (test_wraparound_keeps_view_contiguous() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  rollback_drops_newest_and_reuses_space... ");
+    if (test_rollback_drops_newest_and_reuses_space() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  rollback_after_eviction... ");
+    if (test_rollback_after_eviction() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  join_previous_marks_newest... ");
+    if (test_join_previous_marks_newest() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  compact_replaces_oldest_with_summary... ");
+    if (test_compact_replaces_oldest_with_summary() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  compact_in_wrapped_arena... ");
+    if (test_compact_in_wrapped_arena() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  holds_more_turns_in_less_ram... ");
+    if (test_holds_more_turns_in_less_ram() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
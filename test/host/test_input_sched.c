@@ -0,0 +1,180 @@
+/*
+ * Host tests for agent input scheduling.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "input_sched.h"
+#include "msg_pool.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+#define MS(ms) ((int64_t)(ms) * 1000)
+
+static bool push(msg_class_t msg_class, int64_t enqueued_us, const char *text)
+{
+    agent_msg_t msg = {.msg_class = msg_class, .enqueued_us = enqueued_us,
+                       .text = msg_pool_copy(text, strlen(text))};
+    return input_sched_push(&msg);
+}
+
+static void reset_state(void)
+{
+    input_sched_test_reset();
+    msg_pool_test_reset();
+}
+
+TEST(interactive_runs_before_queued_cron)
+{
+    agent_msg_t msg;
+    uint32_t wait_ms = 0;
+
+    reset_state();
+    ASSERT(push(MSG_CLASS_BACKGROUND, MS(0), "periodic-1"));
+    ASSERT(push(MSG_CLASS_AUTOMATION, MS(10), "daily-1"));
+    ASSERT(push(MSG_CLASS_BACKGROUND, MS(20), "periodic-2"));
+    ASSERT(push(MSG_CLASS_INTERACTIVE, MS(30), "user-1"));
+    ASSERT(push(MSG_CLASS_INTERACTIVE, MS(40), "user-2"));
+    ASSERT(input_sched_pending() == 5);
+
+    const char *expected[] = {"user-1", "user-2", "daily-1", "periodic-1", "periodic-2"};
+    for (int i = 0; i < 5; i++) {
+        ASSERT(input_sched_pop(MS(100), &msg, &wait_ms));
+        ASSERT(strcmp(msg.text->text, expected[i]) == 0);
+    }
+    ASSERT(!input_sched_pop(MS(100), &msg, &wait_ms));
+    ASSERT(input_sched_pending() == 0);
+    return 0;
+}
+
+TEST(aging_keeps_background_from_starving)
+{
+    agent_msg_t msg;
+    uint32_t wait_ms = 0;
+
+    reset_state();
+    ASSERT(push(MSG_CLASS_BACKGROUND, MS(0), "periodic"));
+
+    // Interactive work keeps arriving; once the periodic job has waited two
+    // aging steps it ranks with interactive input and its longer wait wins.
+    int64_t now = MS(1000);
+    ASSERT(push(MSG_CLASS_INTERACTIVE, now, "user-0"));
+    ASSERT(input_sched_pop(now, &msg, &wait_ms));
+    ASSERT(strcmp(msg.text->text, "user-0") == 0);
+
+    now = MS(2 * INPUT_SCHED_AGING_MS);
+    ASSERT(push(MSG_CLASS_INTERACTIVE, now - MS(5), "user-1"));
+    ASSERT(input_sched_pop(now, &msg, &wait_ms));
+    ASSERT(strcmp(msg.text->text, "periodic") == 0);
+    ASSERT(wait_ms == 2 * INPUT_SCHED_AGING_MS);
+    ASSERT(input_sched_pop(now, &msg, &wait_ms));
+    ASSERT(strcmp(msg.text->text, "user-1") == 0);
+    ASSERT(wait_ms == 5);
+    return 0;
+}
+
+TEST(full_class_drops_and_stats_track_waits)
+{
+    agent_msg_t msg;
+    uint32_t wait_ms = 0;
+    input_class_stats_t stats;
+
+    reset_state();
+    for (int i = 0; i < INPUT_SCHED_CLASS_DEPTH; i++) {
+        ASSERT(push(MSG_CLASS_BACKGROUND, MS(0), "periodic"));
+    }
+    ASSERT(!push(MSG_CLASS_BACKGROUND, MS(0), "overflow"));
+    // Other classes still have room.
+    ASSERT(push(MSG_CLASS_INTERACTIVE, MS(0), "user"));
+
+    ASSERT(input_sched_pop(MS(250), &msg, &wait_ms));
+    ASSERT(input_sched_pop(MS(400), &msg, &wait_ms));
+    ASSERT(input_sched_pop(MS(900), &msg, &wait_ms));
+
+    input_sched_get_stats(MSG_CLASS_INTERACTIVE, &stats);
+    ASSERT(stats.dispatched == 1 && stats.dropped == 0);
+    ASSERT(stats.wait_ms_total == 250 && stats.wait_ms_max == 250);
+    input_sched_get_stats(MSG_CLASS_BACKGROUND, &stats);
+    ASSERT(stats.dispatched == 2 && stats.dropped == 1);
+    ASSERT(stats.wait_ms_total == 1300 && stats.wait_ms_max == 900);
+    ASSERT(strcmp(input_sched_class_name(MSG_CLASS_BACKGROUND), "background") == 0);
+    return 0;
+}
+
+TEST(take_related_keeps_other_origins_in_order)
+{
+    agent_msg_t first = {.source = MSG_SOURCE_TELEGRAM, .msg_class = MSG_CLASS_INTERACTIVE,
+                         .source_id = 42};
+    agent_msg_t msg;
+    uint32_t wait_ms = 0;
+
+    reset_state();
+    const char *texts[] = {"a-1", "b-1", "a-2", "b-2", "a-3"};
+    for (int i = 0; i < 5; i++) {
+        msg = (agent_msg_t){.source = MSG_SOURCE_TELEGRAM, .msg_class = MSG_CLASS_INTERACTIVE,
+                            .source_id = texts[i][0] == 'a' ? 42 : 7, .enqueued_us = MS(i)};
+        msg.text = msg_pool_copy(texts[i], strlen(texts[i]));
+        ASSERT(input_sched_push(&msg));
+    }
+
+    ASSERT(input_sched_take_related(&first, 16, MS(10), &msg));
+    ASSERT(strcmp(msg.text->text, "a-1") == 0);
+    ASSERT(input_sched_take_related(&first, 16, MS(10), &msg));
+    ASSERT(strcmp(msg.text->text, "a-2") == 0);
+    // Too long for the room left: stays queued.
+    ASSERT(!input_sched_take_related(&first, 2, MS(10), &msg));
+    ASSERT(input_sched_pending() == 3);
+
+    ASSERT(input_sched_pop(MS(10), &msg, &wait_ms));
+    ASSERT(strcmp(msg.text->text, "b-1") == 0);
+    ASSERT(input_sched_pop(MS(10), &msg, &wait_ms));
+    ASSERT(strcmp(msg.text->text, "b-2") == 0);
+    ASSERT(input_sched_pop(MS(10), &msg, &wait_ms));
+    ASSERT(strcmp(msg.text->text, "a-3") == 0);
+    ASSERT(input_sched_pending() == 0);
+    return 0;
+}
+
+int test_input_sched_all(void)
+{
+    int failures = 0;
+
+    printf("\nInput Scheduler Tests:\n");
+
+    printf("  interactive_runs_before_queued_cron... ");
+    if (test_interactive_runs_before_queued_cron() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  aging_keeps_background_from_starving... ");
+    if (test_aging_keeps_background_from_starving() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  full_class_drops_and_stats_track_waits... ");
+    if (test_full_class_drops_and_stats_track_waits() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  take_related_keeps_other_origins_in_order... ");
+    if (test_take_related_keeps_other_origins_in_order() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
@@ -0,0 +1,325 @@
+/*
+ * Host tests for the allocation-free pull parser and response parsing built on it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_pull.h"
+#include "json_util.h"
+#include "llm_response_fixtures.h"
+#include "mock_llm.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+#define ASSERT_STR_EQ(a, b) do { \
+    if (strcmp((a), (b)) != 0) { \
+        printf("  FAIL: '%s' != '%s' (line %d)\n", (a), (b), __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static bool pull_accepts(const char *json)
+{
+    json_pull_t pull;
+    json_pull_init(&pull, json, strlen(json));
+    return json_pull_skip(&pull, NULL) && json_pull_at_end(&pull);
+}
+
+TEST(walk_object_and_skip_values)
+{
+    const char *json = " { \"a\" : [1, {\"x\": null}], \"b\": \"two\", \"c\": {\"d\": true} } ";
+    json_pull_t pull;
+    json_span_t key;
+    json_span_t a = {0};
+    json_span_t c = {0};
+    char b[8] = "";
+    int keys = 0;
+
+    json_pull_init(&pull, json, strlen(json));
+    ASSERT(json_pull_object_begin(&pull));
+    while (json_pull_next_key(&pull, &key)) {
+        keys++;
+        if (json_span_eq(&key, "b")) {
+            ASSERT(json_pull_string(&pull, b, sizeof(b)));
+        } else {
+            ASSERT(json_pull_skip(&pull, json_span_eq(&key, "a") ? &a : &c));
+        }
+    }
+    ASSERT(!pull.error);
+    ASSERT(json_pull_at_end(&pull));
+    ASSERT(keys == 3);
+    ASSERT_STR_EQ(b, "two");
+    ASSERT(a.len == strlen("[1, {\"x\": null}]"));
+    ASSERT(strncmp(a.ptr, "[1, {\"x\": null}]", a.len) == 0);
+    ASSERT(strncmp(c.ptr, "{\"d\": true}", c.len) == 0);
+
+    // Arrays walk the same way.
+    json_pull_init(&pull, a.ptr, a.len);
+    ASSERT(json_pull_array_begin(&pull));
+    ASSERT(json_pull_next_item(&pull));
+    ASSERT(json_pull_peek(&pull) == '1');
+    ASSERT(json_pull_skip(&pull, NULL));
+    ASSERT(json_pull_next_item(&pull));
+    ASSERT(json_pull_peek(&pull) == '{');
+    ASSERT(json_pull_skip(&pull, NULL));
+    ASSERT(!json_pull_next_item(&pull));
+    ASSERT(!pull.error);
+    return 0;
+}
+
+TEST(string_decoding)
+{
+    json_span_t span;
+    char out[32];
+
+    span.ptr = "\"a\\\"b\\\\c\\/d\\n\\t\"";
+    span.len = strlen(span.ptr);
+    ASSERT(json_span_decode_string(&span, out, sizeof(out)) == 9);
+    ASSERT_STR_EQ(out, "a\"b\\c/d\n\t");
+
+    span.ptr = "\"\\u00e9\\u20ac\\ud83d\\ude00\"";
+    span.len = strlen(span.ptr);
+    json_span_decode_string(&span, out, sizeof(out));
+    ASSERT_STR_EQ(out, "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+
+    // Truncation keeps the buffer terminated.
+    span.ptr = "\"abcdefgh\"";
+    span.len = strlen(span.ptr);
+    ASSERT(json_span_decode_string(&span, out, 4) == 3);
+    ASSERT_STR_EQ(out, "abc");
+    return 0;
+}
+
+TEST(rejects_malformed_input)
+{
+    ASSERT(pull_accepts("{\"a\":[1,2.5e-3,-0,true,false,null,\"\\u0041\"]}"));
+    ASSERT(!pull_accepts("{\"a\":[1,]}"));
+    ASSERT(!pull_accepts("{,\"a\":1}"));
+    ASSERT(!pull_accepts("{\"a\" 1}"));
+    ASSERT(!pull_accepts("{\"a\":1,}"));
+    ASSERT(!pull_accepts("{\"a\":\"unterminated}"));
+    ASSERT(!pull_accepts("\"bad \\q escape\""));
+    ASSERT(!pull_accepts("{\"a\":01}"));
+    ASSERT(!pull_accepts("{} {}"));
+    ASSERT(!pull_accepts("{\"a\":{\"b\":"));
+
+    // Members must be separated by commas while walking, too.
+    json_pull_t pull;
+    json_span_t key;
+    const char *json = "{\"a\":1 \"b\":2}";
+    json_pull_init(&pull, json, strlen(json));
+    ASSERT(json_pull_object_begin(&pull));
+    ASSERT(json_pull_next_key(&pull, &key));
+    ASSERT(json_pull_skip(&pull, NULL));
+    ASSERT(!json_pull_next_key(&pull, &key));
+    ASSERT(pull.error);
+    return 0;
+}
+
+static int parse_fixture(llm_backend_t backend, const char *fixture,
+                         char *text, size_t text_len, char *name, char *id,
+                         cJSON **input)
+{
+    mock_llm_set_backend(backend, "fixture-model");
+    if (!json_parse_response(fixture, text, text_len, name, 32, id, 64, input)) {
+        return 1;
+    }
+    return 0;
+}
+
+TEST(parse_anthropic_fixture)
+{
+    char text[256];
+    char name[32];
+    char id[64];
+    cJSON *input = NULL;
+    llm_usage_t usage;
+
+    ASSERT(parse_fixture(LLM_BACKEND_ANTHROPIC, FIXTURE_ANTHROPIC_TOOL_USE,
+                         text, sizeof(text), name, id, &input) == 0);
+    ASSERT(json_get_last_usage(&usage));
+    ASSERT(usage.input_tokens == 2095);
+    ASSERT(usage.output_tokens == 503);
+    ASSERT(usage.cache_read_tokens == 1824);
+    ASSERT(usage.cache_write_tokens == 0);
+    ASSERT_STR_EQ(text, "I'll switch the porch light on (pin 5) \xe2\x80\x94 one moment.");
+    ASSERT_STR_EQ(name, "gpio_write");
+    ASSERT_STR_EQ(id, "toolu_01A09q90qw90lq917835lq9");
+    ASSERT(input != NULL);
+    ASSERT(cJSON_GetObjectItem(input, "pin")->valueint == 5);
+    ASSERT(cJSON_GetObjectItem(input, "state")->valueint == 1);
+    ASSERT_STR_EQ(cJSON_GetObjectItem(input, "note")->valuestring, "porch \"main\" light");
+    json_free_parsed_response();
+
+    ASSERT(parse_fixture(LLM_BACKEND_ANTHROPIC, FIXTURE_ANTHROPIC_TEXT,
+                         text, sizeof(text), name, id, &input) == 0);
+    ASSERT(strstr(text, "21.5\xc2\xb0" "C outside.\nAnything else? \xf0\x9f\x98\x80") != NULL);
+    ASSERT(name[0] == '\0');
+    ASSERT(input == NULL);
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(parse_openai_fixture)
+{
+    char text[256];
+    char name[32];
+    char id[64];
+    cJSON *input = NULL;
+    llm_usage_t usage;
+
+    ASSERT(parse_fixture(LLM_BACKEND_OPENAI, FIXTURE_OPENAI_TOOL_CALL,
+                         text, sizeof(text), name, id, &input) == 0);
+    // prompt_tokens includes the cached ones; they are reported apart.
+    ASSERT(json_get_last_usage(&usage));
+    ASSERT(usage.input_tokens == 2082 - 1792);
+    ASSERT(usage.cache_read_tokens == 1792);
+    ASSERT(usage.output_tokens == 217);
+    ASSERT(text[0] == '\0');
+    ASSERT_STR_EQ(name, "gpio_write");
+    ASSERT_STR_EQ(id, "call_12345xyz");
+    ASSERT(input != NULL);
+    ASSERT(cJSON_GetObjectItem(input, "pin")->valueint == 5);
+    ASSERT_STR_EQ(cJSON_GetObjectItem(input, "note")->valuestring, "porch \"main\" light");
+    json_free_parsed_response();
+
+    ASSERT(parse_fixture(LLM_BACKEND_OPENROUTER, FIXTURE_OPENAI_TEXT,
+                         text, sizeof(text), name, id, &input) == 0);
+    ASSERT_STR_EQ(text, "Done. The porch light is on and it is 21.5\xc2\xb0" "C outside.");
+    ASSERT(name[0] == '\0');
+    ASSERT(input == NULL);
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(parse_rejects_malformed_response)
+{
+    char text[64];
+    char name[32];
+    char id[64];
+    cJSON *input = NULL;
+
+    ASSERT(parse_fixture(LLM_BACKEND_ANTHROPIC, "{\"content\":[]} trailing",
+                         text, sizeof(text), name, id, &input) == 1);
+    ASSERT(parse_fixture(LLM_BACKEND_ANTHROPIC, "{\"content\":[{\"type\":\"text\",",
+                         text, sizeof(text), name, id, &input) == 1);
+    ASSERT(parse_fixture(LLM_BACKEND_ANTHROPIC, "{\"stop_reason\":\"end_turn\"}",
+                         text, sizeof(text), name, id, &input) == 1);
+    ASSERT(parse_fixture(LLM_BACKEND_OPENAI, "{\"choices\":[]}",
+                         text, sizeof(text), name, id, &input) == 1);
+    ASSERT(parse_fixture(LLM_BACKEND_OPENAI, "{\"choices\":[{\"index\":0}]}",
+                         text, sizeof(text), name, id, &input) == 1);
+    return 0;
+}
+
+TEST(parse_parallel_tool_calls)
+{
+    char text[64];
+    char name[32];
+    char id[64];
+    cJSON *input = NULL;
+    const json_tool_call_t *calls = NULL;
+    char body[4096];
+    int len;
+
+    // One more tool_use block than a response keeps; the extra one is dropped.
+    len = snprintf(body, sizeof(body), "{\"content\":[");
+    for (int i = 0; i <= MAX_TOOL_CALLS_PER_RESPONSE; i++) {
+        len += snprintf(body + len, sizeof(body) - len,
+                        "%s{\"type\":\"tool_use\",\"id\":\"toolu_%d\",\"name\":\"gpio_read\","
+                        "\"input\":{\"pin\":%d}}", i ? "," : "", i, i);
+    }
+    snprintf(body + len, sizeof(body) - len, "],\"stop_reason\":\"tool_use\"}");
+
+    ASSERT(parse_fixture(LLM_BACKEND_ANTHROPIC, body, text, sizeof(text), name, id, &input) == 0);
+    ASSERT(json_get_tool_calls(&calls) == MAX_TOOL_CALLS_PER_RESPONSE);
+    ASSERT(input == calls[0].input);
+    for (int i = 0; i < MAX_TOOL_CALLS_PER_RESPONSE; i++) {
+        char expected[16];
+        snprintf(expected, sizeof(expected), "toolu_%d", i);
+        ASSERT_STR_EQ(calls[i].id, expected);
+        ASSERT(cJSON_GetObjectItem(calls[i].input, "pin")->valueint == i);
+    }
+    json_free_parsed_response();
+    ASSERT(json_get_tool_calls(&calls) == 0);
+
+    ASSERT(parse_fixture(LLM_BACKEND_OPENAI,
+                         "{\"choices\":[{\"message\":{\"content\":null,\"tool_calls\":["
+                         "{\"id\":\"call_a\",\"type\":\"function\",\"function\":"
+                         "{\"name\":\"gpio_read\",\"arguments\":\"{\\\"pin\\\":2}\"}},"
+                         "{\"id\":\"call_b\",\"type\":\"function\",\"function\":"
+                         "{\"name\":\"memory_get\",\"arguments\":\"{}\"}}]}}]}",
+                         text, sizeof(text), name, id, &input) == 0);
+    ASSERT(json_get_tool_calls(&calls) == 2);
+    ASSERT_STR_EQ(name, "gpio_read");
+    ASSERT_STR_EQ(calls[1].id, "call_b");
+    ASSERT_STR_EQ(calls[1].name, "memory_get");
+    ASSERT(cJSON_IsObject(calls[1].input));
+    json_free_parsed_response();
+    return 0;
+}
+
+int test_json_pull_all(void)
+{
+    int failures = 0;
+
+    printf("\nJSON Pull Parser Tests:\n");
+
+    printf("  walk_object_and_skip_values... ");
+    if (test_walk_object_and_skip_values() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  string_decoding... ");
+    if (test_string_decoding() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  rejects_malformed_input... ");
+    if (test_rejects_malformed_input() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  parse_anthropic_fixture... ");
+    if (test_parse_anthropic_fixture() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  parse_openai_fixture... ");
+    if (test_parse_openai_fixture() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  parse_rejects_malformed_response... ");
+    if (test_parse_rejects_malformed_response() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  parse_parallel_tool_calls... ");
+    if (test_parse_parallel_tool_calls() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
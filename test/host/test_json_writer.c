@@ -0,0 +1,507 @@
+/*
+ * Host tests for the in-place JSON writer and the request builder that uses it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_writer.h"
+#include "json_util.h"
+#include "json_request_cjson.h"
+#include "tools.h"
+#include "user_tools.h"
+#include "mock_llm.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+#define ASSERT_STR_EQ(a, b) do { \
+    if (strcmp((a), (b)) != 0) { \
+        printf("  FAIL: '%s' != '%s' (line %d)\n", (a), (b), __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static bool dummy_tool_execute(const cJSON *input, char *result, size_t result_len)
+{
+    (void)input;
+    snprintf(result, result_len, "ok");
+    return true;
+}
+
+static const tool_def_t s_test_tools[] = {
+    {
+        .name = "gpio_write",
+        .description = "Set a GPIO pin HIGH or LOW.",
+        .input_schema_json = "{\"type\":\"object\",\"properties\":{\"pin\":{\"type\":\"integer\"},"
+                             "\"state\":{\"type\":\"integer\",\"description\":\"0=LOW, 1=HIGH\"}},"
+                             "\"required\":[\"pin\",\"state\"]}",
+        .execute = dummy_tool_execute
+    },
+    {
+        .name = "broken_schema",
+        .description = "Schema that does not parse \"falls back\" to {}.",
+        .input_schema_json = "{\"type\":",
+        .execute = dummy_tool_execute
+    },
+};
+
+static void set_msg(conversation_msg_t *msg, const char *role, const char *content,
+                    bool is_tool_use, bool is_tool_result, const char *tool_id,
+                    const char *tool_name)
+{
+    memset(msg, 0, sizeof(*msg));
+    msg->role = role;
+    msg->content = content;
+    msg->is_tool_use = is_tool_use;
+    msg->is_tool_result = is_tool_result;
+    msg->tool_id = tool_id ? tool_id : "";
+    msg->tool_name = tool_name ? tool_name : "";
+}
+
+static int fill_history(conversation_msg_t *history)
+{
+    set_msg(&history[0], "user", "tool done", false, true, "toolu_orphan", NULL);
+    set_msg(&history[1], "user", "Turn on pin 5 \"now\"\n\tplease \\ thanks", false, false, NULL, NULL);
+    set_msg(&history[2], "assistant", "{\"pin\":5,\"state\":1}", true, false, "toolu_1", "gpio_write");
+    set_msg(&history[3], "user", "Pin 5 set HIGH", false, true, "toolu_1", NULL);
+    set_msg(&history[4], "assistant", "Done \xe2\x9c\x85 \x01", false, false, NULL, NULL);
+    set_msg(&history[5], "assistant", "not json", true, false, "toolu_2", "gpio_write");
+    set_msg(&history[6], "user", "ok", false, true, "toolu_2", NULL);
+    return 7;
+}
+
+TEST(writer_nesting_and_escaping)
+{
+    char buf[256];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "s", "a\"b\\c\n\x02");
+    json_writer_kv_int(&w, "n", -42);
+    json_writer_key(&w, "list");
+    json_writer_array_begin(&w);
+    json_writer_bool(&w, true);
+    json_writer_null(&w);
+    json_writer_array_begin(&w);
+    json_writer_array_end(&w);
+    ASSERT(json_writer_raw(&w, " { \"k\" : [1, 2.5e3, \"x y\"] } "));
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+
+    ASSERT(json_writer_finish(&w));
+    ASSERT_STR_EQ(buf, "{\"s\":\"a\\\"b\\\\c\\n\\u0002\",\"n\":-42,"
+                       "\"list\":[true,null,[],{\"k\":[1,2.5e3,\"x y\"]}]}");
+    return 0;
+}
+
+TEST(writer_overflow_latches)
+{
+    char buf[16];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_kv_string(&w, "key", "this value is far too long");
+    json_writer_object_end(&w);
+
+    ASSERT(!json_writer_finish(&w));
+    ASSERT(w.overflow);
+    ASSERT(strlen(buf) < sizeof(buf));
+    return 0;
+}
+
+TEST(writer_rejects_bad_nesting_and_raw)
+{
+    char buf[64];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_object_begin(&w);
+    json_writer_key(&w, "a");
+    json_writer_object_end(&w);
+    ASSERT(!json_writer_finish(&w));
+
+    ASSERT(!json_writer_is_valid("{\"a\":}"));
+    ASSERT(!json_writer_is_valid("[1,]"));
+    ASSERT(!json_writer_is_valid("{} {}"));
+    ASSERT(!json_writer_is_valid("\"bad \\q escape\""));
+    ASSERT(!json_writer_is_valid("01"));
+    ASSERT(json_writer_is_valid("{\"a\":[true,false,null,-0.5E+2,\"\\u00e9\"]}"));
+    return 0;
+}
+
+static int check_matches_cjson(llm_backend_t backend)
+{
+    conversation_msg_t history[8];
+    char buf[LLM_REQUEST_BUF_SIZE];
+    int history_len = fill_history(history);
+
+    mock_llm_set_backend(backend, "model-under-test");
+    user_tools_init();
+    ASSERT(user_tools_create("water_plants", "Water the plants", "gpio_write pin 3 high"));
+
+    char *expected = json_build_request_cjson("sys \"prompt\"", history, history_len,
+                                              "and now?", s_test_tools, 2);
+    size_t len = json_build_request_into(buf, sizeof(buf), "sys \"prompt\"", history,
+                                         history_len, "and now?", s_test_tools, 2);
+    user_tools_init();
+
+    ASSERT(expected != NULL);
+    ASSERT(len == strlen(buf));
+    if (strcmp(expected, buf) != 0) {
+        printf("  FAIL: writer output differs from cJSON\n    cjson:  %s\n    writer: %s\n",
+               expected, buf);
+        free(expected);
+        return 1;
+    }
+    free(expected);
+    return 0;
+}
+
+TEST(request_matches_cjson_anthropic)
+{
+    return check_matches_cjson(LLM_BACKEND_ANTHROPIC);
+}
+
+TEST(request_matches_cjson_openai)
+{
+    return check_matches_cjson(LLM_BACKEND_OPENAI);
+}
+
+TEST(request_matches_cjson_openrouter)
+{
+    return check_matches_cjson(LLM_BACKEND_OPENROUTER);
+}
+
+TEST(request_too_large_fails_cleanly)
+{
+    char buf[128];
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "model-under-test");
+    ASSERT(json_build_request_into(buf, sizeof(buf), "sys prompt", NULL, 0, "hello",
+                                   s_test_tools, 1) == 0);
+    ASSERT(strlen(buf) < sizeof(buf));
+    return 0;
+}
+
+TEST(tools_catalog_cached_until_user_tools_change)
+{
+    static char first[LLM_REQUEST_BUF_SIZE];
+    static char second[LLM_REQUEST_BUF_SIZE];
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "model-under-test");
+    user_tools_init();
+    json_test_reset_tools_catalog();
+
+    ASSERT(json_build_request_into(first, sizeof(first), "sys", NULL, 0, "hi",
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_build_request_into(second, sizeof(second), "sys", NULL, 0, "hello",
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_test_tools_catalog_builds() == 1);
+    ASSERT(strcmp(strstr(first, "\"tools\":"), strstr(second, "\"tools\":")) == 0);
+
+    // Creating a user tool bumps the generation and forces a rebuild.
+    ASSERT(user_tools_create("water_plants", "Water the plants", "gpio_write pin 3 high"));
+    ASSERT(json_build_request_into(second, sizeof(second), "sys", NULL, 0, "hi",
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_test_tools_catalog_builds() == 2);
+    ASSERT(strstr(second, "\"name\":\"water_plants\"") != NULL);
+
+    // Switching backend changes the tool schema shape.
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "model-under-test");
+    ASSERT(json_build_request_into(second, sizeof(second), "sys", NULL, 0, "hi",
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_test_tools_catalog_builds() == 3);
+    ASSERT(strstr(second, "\"type\":\"function\"") != NULL);
+
+    user_tools_init();
+    return 0;
+}
+
+static int count_occurrences(const char *haystack, const char *needle)
+{
+    int count = 0;
+    for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+TEST(prompt_cache_breakpoints_follow_history)
+{
+    static char cached[LLM_REQUEST_BUF_SIZE];
+    static char full[LLM_REQUEST_BUF_SIZE];
+    conversation_msg_t history[8];
+    json_request_cache_t cache = {0};
+    int history_len = fill_history(history);
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "model-under-test");
+    mock_llm_set_prompt_cache(true);
+    user_tools_init();
+
+    // Grow the history one message at a time, as tool rounds do.
+    for (int len = 2; len <= history_len; len++) {
+        size_t cached_len = json_build_request_cached(&cache, cached, sizeof(cached), "sys",
+                                                      history, len, s_test_tools, 2);
+        size_t full_len = json_build_request_into(full, sizeof(full), "sys", history, len,
+                                                  NULL, s_test_tools, 2);
+        ASSERT(cached_len > 0);
+        ASSERT(cached_len == full_len);
+        ASSERT_STR_EQ(cached, full);
+        ASSERT(json_writer_is_valid(cached));
+        // System prompt plus the newest message only.
+        ASSERT(count_occurrences(cached, "\"cache_control\":{\"type\":\"ephemeral\"}") == 2);
+    }
+    ASSERT(cache.full_builds == 1);
+    ASSERT(strstr(cached, "\"system\":[{\"type\":\"text\",\"text\":\"sys\","
+                          "\"cache_control\":{\"type\":\"ephemeral\"}}]") != NULL);
+    ASSERT(strstr(cached, "\"tool_use_id\":\"toolu_2\",\"content\":\"ok\","
+                          "\"cache_control\"") != NULL);
+
+    // A plain text message takes the block form to carry the marker.
+    ASSERT(json_build_request_into(full, sizeof(full), "sys", history, 5, NULL,
+                                   s_test_tools, 2) > 0);
+    ASSERT(strstr(full, "\"content\":[{\"type\":\"text\",\"text\":\"Done") != NULL);
+
+    // OpenAI-format backends never get markers.
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "model-under-test");
+    ASSERT(json_build_request_into(full, sizeof(full), "sys", history, history_len, NULL,
+                                   s_test_tools, 2) > 0);
+    ASSERT(strstr(full, "cache_control") == NULL);
+
+    mock_llm_set_prompt_cache(false);
+    return 0;
+}
+
+static int fill_parallel_history(conversation_msg_t *history)
+{
+    set_msg(&history[0], "user", "read pins 2 and 3", false, false, NULL, NULL);
+    set_msg(&history[1], "assistant", "{\"pin\":2}", true, false, "toolu_a", "gpio_read");
+    set_msg(&history[2], "assistant", "{\"pin\":3}", true, false, "toolu_b", "gpio_read");
+    history[2].joins_previous = true;
+    set_msg(&history[3], "user", "Pin 2 is LOW", false, true, "toolu_a", NULL);
+    set_msg(&history[4], "user", "Pin 3 is HIGH", false, true, "toolu_b", NULL);
+    history[4].joins_previous = true;
+    return 5;
+}
+
+TEST(parallel_tool_calls_group_into_one_message)
+{
+    static char cached[LLM_REQUEST_BUF_SIZE];
+    static char full[LLM_REQUEST_BUF_SIZE];
+    conversation_msg_t history[5];
+    json_request_cache_t cache = {0};
+    int history_len = fill_parallel_history(history);
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "model-under-test");
+    user_tools_init();
+    ASSERT(json_build_request_into(full, sizeof(full), "sys", history, history_len, NULL,
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_writer_is_valid(full));
+    ASSERT(strstr(full, "{\"role\":\"assistant\",\"content\":["
+                        "{\"type\":\"tool_use\",\"id\":\"toolu_a\",\"name\":\"gpio_read\",\"input\":{\"pin\":2}},"
+                        "{\"type\":\"tool_use\",\"id\":\"toolu_b\",\"name\":\"gpio_read\",\"input\":{\"pin\":3}}]}") != NULL);
+    ASSERT(strstr(full, "{\"role\":\"user\",\"content\":["
+                        "{\"type\":\"tool_result\",\"tool_use_id\":\"toolu_a\",\"content\":\"Pin 2 is LOW\"},"
+                        "{\"type\":\"tool_result\",\"tool_use_id\":\"toolu_b\",\"content\":\"Pin 3 is HIGH\"}]}") != NULL);
+
+    // A joiner whose head was evicted opens the message itself.
+    ASSERT(json_build_request_into(full, sizeof(full), "sys", &history[2], 3, NULL,
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_writer_is_valid(full));
+    ASSERT(strstr(full, "\"messages\":[{\"role\":\"assistant\",\"content\":["
+                        "{\"type\":\"tool_use\",\"id\":\"toolu_b\"") != NULL);
+    ASSERT(strstr(full, "toolu_a") == NULL);
+
+    // With prompt caching the breakpoint goes on the last block of the group,
+    // and the cached prefix stops before the group.
+    mock_llm_set_prompt_cache(true);
+    const int group_ends[] = {1, 3, 5};
+    for (int i = 0; i < 3; i++) {
+        size_t cached_len = json_build_request_cached(&cache, cached, sizeof(cached), "sys",
+                                                      history, group_ends[i], s_test_tools, 2);
+        ASSERT(cached_len > 0);
+        ASSERT(json_build_request_into(full, sizeof(full), "sys", history, group_ends[i],
+                                       NULL, s_test_tools, 2) == cached_len);
+        ASSERT_STR_EQ(cached, full);
+        ASSERT(count_occurrences(cached, "\"cache_control\":{\"type\":\"ephemeral\"}") == 2);
+    }
+    ASSERT(cache.full_builds == 1);
+    ASSERT(strstr(cached, "\"content\":\"Pin 3 is HIGH\",\"cache_control\"") != NULL);
+    mock_llm_set_prompt_cache(false);
+
+    // OpenAI: one assistant message with both tool_calls, one tool message per result.
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "model-under-test");
+    ASSERT(json_build_request_into(full, sizeof(full), "sys", history, history_len, NULL,
+                                   s_test_tools, 2) > 0);
+    ASSERT(json_writer_is_valid(full));
+    ASSERT(strstr(full, "{\"role\":\"assistant\",\"content\":null,\"tool_calls\":["
+                        "{\"id\":\"toolu_a\",\"type\":\"function\",\"function\":"
+                        "{\"name\":\"gpio_read\",\"arguments\":\"{\\\"pin\\\":2}\"}},"
+                        "{\"id\":\"toolu_b\",") != NULL);
+    ASSERT(count_occurrences(full, "\"tool_calls\"") == 1);
+    ASSERT(strstr(full, "{\"role\":\"tool\",\"tool_call_id\":\"toolu_a\",\"content\":\"Pin 2 is LOW\"},"
+                        "{\"role\":\"tool\",\"tool_call_id\":\"toolu_b\"") != NULL);
+    return 0;
+}
+
+TEST(writer_string_in_pieces)
+{
+    char buf[64];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_array_begin(&w);
+    json_writer_int(&w, 1);
+    json_writer_string_begin(&w);
+    json_writer_string_append(&w, "user: \"hi\"");
+    json_writer_string_append(&w, "\n");
+    json_writer_string_append(&w, NULL);
+    json_writer_string_end(&w);
+    json_writer_array_end(&w);
+    ASSERT(json_writer_finish(&w));
+    ASSERT_STR_EQ(buf, "[1,\"user: \\\"hi\\\"\\n\"]");
+
+    // An unterminated or unopened piecewise string is misuse.
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_string_begin(&w);
+    json_writer_string_append(&w, "x");
+    ASSERT(!json_writer_finish(&w));
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_string_append(&w, "x");
+    ASSERT(!json_writer_finish(&w) && w.error);
+    return 0;
+}
+
+TEST(summary_request_is_one_transcript)
+{
+    static char buf[LLM_REQUEST_BUF_SIZE];
+    conversation_msg_t history[5];
+    int history_len = fill_parallel_history(history);
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "model-under-test");
+    mock_llm_set_summary_model("cheap-model");
+    ASSERT(json_build_summary_request_into(buf, sizeof(buf), "Summarize.", history, history_len) > 0);
+    ASSERT(json_writer_is_valid(buf));
+    ASSERT(strstr(buf, "{\"model\":\"cheap-model\",\"max_tokens\":") == buf);
+    ASSERT(strstr(buf, "\"system\":\"Summarize.\",\"messages\":[{\"role\":\"user\",\"content\":"
+                       "\"user: read pins 2 and 3\\n"
+                       "assistant called gpio_read {\\\"pin\\\":2}\\n"
+                       "assistant called gpio_read {\\\"pin\\\":3}\\n"
+                       "tool result: Pin 2 is LOW\\n"
+                       "tool result: Pin 3 is HIGH\\n\"}]}") != NULL);
+    ASSERT(strstr(buf, "\"tools\"") == NULL);
+    ASSERT(strstr(buf, "\"stream\"") == NULL);
+
+    // OpenAI: instructions as the system message; no summary model means the main one.
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "model-under-test");
+    mock_llm_set_summary_model(NULL);
+    ASSERT(json_build_summary_request_into(buf, sizeof(buf), "Summarize.", history, 1) > 0);
+    ASSERT(json_writer_is_valid(buf));
+    ASSERT(strstr(buf, "{\"model\":\"model-under-test\",\"max_completion_tokens\":") == buf);
+    ASSERT(strstr(buf, "\"messages\":[{\"role\":\"system\",\"content\":\"Summarize.\"},"
+                       "{\"role\":\"user\",\"content\":\"user: read pins 2 and 3\\n\"}]}") != NULL);
+
+    ASSERT(json_build_summary_request_into(buf, 64, "Summarize.", history, history_len) == 0);
+    return 0;
+}
+
+int test_json_writer_all(void)
+{
+    int failures = 0;
+
+    printf("\nJSON Writer Tests:\n");
+
+    printf("  writer_nesting_and_escaping... ");
+    if (test_writer_nesting_and_escaping() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  writer_overflow_latches... ");
+    if (test_writer_overflow_latches() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  writer_rejects_bad_nesting_and_raw... ");
+    if (test_writer_rejects_bad_nesting_and_raw() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  request_matches_cjson_anthropic... ");
+    if (test_request_matches_cjson_anthropic() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  request_matches_cjson_openai... ");
+    if (test_request_matches_cjson_openai() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  request_matches_cjson_openrouter... ");
+    if (test_request_matches_cjson_openrouter() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  request_too_large_fails_cleanly... ");
+    if (test_request_too_large_fails_cleanly() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  tools_catalog_cached_until_user_tools_change... ");
+    if (test_tools_catalog_cached_until_user_tools_change() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  prompt_cache_breakpoints_follow_history... ");
+    if (test_prompt_cache_breakpoints_follow_history() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  parallel_tool_calls_group_into_one_message... ");
+    if (test_parallel_tool_calls_group_into_one_message() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  writer_string_in_pieces... ");
+    if (test_writer_string_in_pieces() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  summary_request_is_one_transcript... ");
+    if (test_summary_request_is_one_transcript() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
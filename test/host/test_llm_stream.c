@@ -0,0 +1,422 @@
+/*
+ * Host tests for the streaming (SSE) response decoder.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "llm_stream.h"
+#include "json_util.h"
+#include "mock_llm.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+#define ASSERT_STR_EQ(a, b) do { \
+    if (strcmp((a), (b)) != 0) { \
+        printf("  FAIL: '%s' != '%s' (line %d)\n", (a), (b), __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static llm_stream_t s_stream;
+static char s_text[256];
+static char s_deltas[512];
+static int s_delta_count;
+
+static void collect_text(const char *text, void *user_ctx)
+{
+    (void)user_ctx;
+    strncat(s_deltas, text, sizeof(s_deltas) - strlen(s_deltas) - 1);
+    s_delta_count++;
+}
+
+// Feed in small, uneven slices to exercise line reassembly across chunks.
+static void feed_sliced(const char *body, size_t slice)
+{
+    size_t len = strlen(body);
+    for (size_t off = 0; off < len; off += slice) {
+        size_t n = (len - off < slice) ? len - off : slice;
+        llm_stream_feed(&s_stream, body + off, n);
+    }
+}
+
+static void reset_stream(bool openai_format)
+{
+    s_deltas[0] = '\0';
+    s_delta_count = 0;
+    llm_stream_init(&s_stream, openai_format, s_text, sizeof(s_text), collect_text, NULL);
+}
+
+TEST(anthropic_text_stream)
+{
+    const json_tool_call_t *calls = NULL;
+    llm_usage_t usage;
+    const char *body =
+        "event: message_start\n"
+        "data: {\"type\":\"message_start\",\"message\":{\"id\":\"msg_1\",\"content\":[],"
+            "\"usage\":{\"input_tokens\":12,\"cache_creation_input_tokens\":0,"
+            "\"cache_read_input_tokens\":1800,\"output_tokens\":1}}}\n\n"
+        "event: content_block_start\n"
+        "data: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\n\n"
+        ": keep-alive\n\n"
+        "event: content_block_delta\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"Hello\"}}\n\n"
+        "event: content_block_delta\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\" there\"}}\n\n"
+        "event: content_block_stop\n"
+        "data: {\"type\":\"content_block_stop\",\"index\":0}\n\n"
+        "event: message_delta\n"
+        "data: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"end_turn\"},"
+            "\"usage\":{\"output_tokens\":15}}\n\n"
+        "event: message_stop\n"
+        "data: {\"type\":\"message_stop\"}\n\n";
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "mock-anthropic");
+    reset_stream(false);
+    feed_sliced(body, 7);
+
+    ASSERT(s_stream.done);
+    ASSERT(s_delta_count == 2);
+    ASSERT_STR_EQ(s_deltas, "Hello there");
+    ASSERT(llm_stream_finish(&s_stream));
+
+    ASSERT_STR_EQ(s_text, "Hello there");
+    ASSERT(json_get_tool_calls(&calls) == 0);
+    ASSERT(json_get_last_usage(&usage));
+    ASSERT(usage.input_tokens == 12);
+    ASSERT(usage.cache_read_tokens == 1800);
+    ASSERT(usage.cache_write_tokens == 0);
+    ASSERT(usage.output_tokens == 15);
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(anthropic_tool_use_assembled)
+{
+    const json_tool_call_t *calls = NULL;
+    cJSON *pin;
+    const char *body =
+        "data: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\r\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"On it.\"}}\r\n"
+        "data: {\"type\":\"content_block_stop\",\"index\":0}\r\n"
+        "data: {\"type\":\"content_block_start\",\"index\":1,\"content_block\":"
+            "{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"gpio_write\",\"input\":{}}}\r\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":1,\"delta\":{\"type\":\"input_json_delta\",\"partial_json\":\"\"}}\r\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":1,\"delta\":{\"type\":\"input_json_delta\",\"partial_json\":\"{\\\"pin\\\": \"}}\r\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":1,\"delta\":{\"type\":\"input_json_delta\",\"partial_json\":\"5, \\\"state\\\": 1}\"}}\r\n"
+        "data: {\"type\":\"content_block_stop\",\"index\":1}\r\n"
+        "data: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"tool_use\"}}\r\n"
+        "data: {\"type\":\"message_stop\"}";
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "mock-anthropic");
+    reset_stream(false);
+    feed_sliced(body, 13);
+
+    ASSERT_STR_EQ(s_deltas, "On it.");
+    ASSERT(llm_stream_finish(&s_stream));
+    ASSERT(s_stream.done);
+
+    ASSERT_STR_EQ(s_text, "On it.");
+    ASSERT(json_get_tool_calls(&calls) == 1);
+    ASSERT_STR_EQ(calls[0].name, "gpio_write");
+    ASSERT_STR_EQ(calls[0].id, "toolu_1");
+    ASSERT(calls[0].input != NULL);
+    pin = cJSON_GetObjectItem(calls[0].input, "pin");
+    ASSERT(pin && cJSON_IsNumber(pin) && pin->valueint == 5);
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(stream_cut_inside_tool_call_fails)
+{
+    const json_tool_call_t *calls = NULL;
+    const char *start =
+        "data: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":"
+            "{\"type\":\"tool_use\",\"id\":\"toolu_1\",\"name\":\"cron_set\",\"input\":{}}}\n"
+        "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"input_json_delta\",\"partial_json\":\"{\\\"type\\\": \\\"daily\\\"\"}}\n";
+
+    // The connection drops mid-input: nothing is left to run.
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "mock-anthropic");
+    reset_stream(false);
+    feed_sliced(start, 11);
+    ASSERT(!llm_stream_finish(&s_stream));
+    ASSERT(json_get_tool_calls(&calls) == 0);
+
+    // The block was closed, but its input never completed.
+    reset_stream(false);
+    feed_sliced(start, 11);
+    feed_sliced("data: {\"type\":\"content_block_stop\",\"index\":0}\n"
+                "data: {\"type\":\"message_stop\"}\n", 11);
+    ASSERT(s_stream.done);
+    ASSERT(!llm_stream_finish(&s_stream));
+    ASSERT(json_get_tool_calls(&calls) == 0);
+
+    // OpenAI calls stay open until [DONE].
+    reset_stream(true);
+    feed_sliced("data: {\"choices\":[{\"delta\":{\"tool_calls\":[{\"index\":0,\"id\":\"call_1\","
+                "\"function\":{\"name\":\"gpio_write\",\"arguments\":\"{\\\"pin\\\": 5}\"}}]}}]}\n", 9);
+    ASSERT(!llm_stream_finish(&s_stream));
+    ASSERT(json_get_tool_calls(&calls) == 0);
+    return 0;
+}
+
+TEST(anthropic_error_event)
+{
+    const char *body =
+        "event: error\n"
+        "data: {\"type\":\"error\",\"error\":{\"type\":\"overloaded_error\",\"message\":\"Overloaded\"}}\n\n";
+
+    mock_llm_set_backend(LLM_BACKEND_ANTHROPIC, "mock-anthropic");
+    reset_stream(false);
+    feed_sliced(body, 64);
+
+    ASSERT(llm_stream_finish(&s_stream));
+    ASSERT_STR_EQ(s_text, "API Error: Overloaded");
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(openai_text_and_tool_call)
+{
+    const json_tool_call_t *calls = NULL;
+    cJSON *key;
+    llm_usage_t usage;
+    const char *body =
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"role\":\"assistant\",\"content\":\"\"}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"content\":\"Saving\"}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":0,\"id\":\"call_9\","
+            "\"type\":\"function\",\"function\":{\"name\":\"memory_set\",\"arguments\":\"\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":0,"
+            "\"function\":{\"arguments\":\"{\\\"key\\\":\\\"u_\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":0,"
+            "\"function\":{\"arguments\":\"color\\\",\\\"value\\\":\\\"blue\\\"}\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"tool_calls\"}]}\n\n"
+        "data: {\"choices\":[],\"usage\":{\"prompt_tokens\":1200,\"completion_tokens\":31,"
+            "\"prompt_tokens_details\":{\"cached_tokens\":1024}}}\n\n"
+        "data: [DONE]\n\n";
+
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "gpt-test");
+    reset_stream(true);
+    feed_sliced(body, 5);
+
+    ASSERT(s_stream.done);
+    ASSERT_STR_EQ(s_deltas, "Saving");
+    ASSERT(llm_stream_finish(&s_stream));
+
+    ASSERT_STR_EQ(s_text, "Saving");
+    ASSERT(json_get_tool_calls(&calls) == 1);
+    ASSERT_STR_EQ(calls[0].name, "memory_set");
+    ASSERT_STR_EQ(calls[0].id, "call_9");
+    ASSERT(calls[0].input != NULL);
+    key = cJSON_GetObjectItem(calls[0].input, "key");
+    ASSERT(key && cJSON_IsString(key));
+    ASSERT_STR_EQ(key->valuestring, "u_color");
+    ASSERT(json_get_last_usage(&usage));
+    ASSERT(usage.input_tokens == 176);
+    ASSERT(usage.cache_read_tokens == 1024);
+    ASSERT(usage.output_tokens == 31);
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(openai_parallel_tool_calls)
+{
+    const json_tool_call_t *calls = NULL;
+    const char *body =
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":0,\"id\":\"call_a\","
+            "\"type\":\"function\",\"function\":{\"name\":\"gpio_read\",\"arguments\":\"{\\\"pin\\\":\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":1,\"id\":\"call_b\","
+            "\"type\":\"function\",\"function\":{\"name\":\"memory_get\",\"arguments\":\"{\\\"key\\\":\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":0,"
+            "\"function\":{\"arguments\":\"2}\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"tool_calls\":[{\"index\":1,"
+            "\"function\":{\"arguments\":\"\\\"u_mode\\\"}\"}}]}}]}\n\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"tool_calls\"}]}\n\n"
+        "data: [DONE]\n\n";
+
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "gpt-test");
+    reset_stream(true);
+    feed_sliced(body, 7);
+
+    ASSERT(s_stream.done);
+    ASSERT(s_stream.tool_count == 2);
+    ASSERT(llm_stream_finish(&s_stream));
+
+    ASSERT(s_stream.tool_count == 0 && s_stream.tool_input_len == 0);
+    ASSERT(json_get_tool_calls(&calls) == 2);
+    ASSERT_STR_EQ(calls[0].id, "call_a");
+    ASSERT_STR_EQ(calls[0].name, "gpio_read");
+    ASSERT(cJSON_GetObjectItem(calls[0].input, "pin")->valueint == 2);
+    ASSERT_STR_EQ(calls[1].id, "call_b");
+    ASSERT_STR_EQ(calls[1].name, "memory_get");
+    ASSERT_STR_EQ(cJSON_GetObjectItem(calls[1].input, "key")->valuestring, "u_mode");
+    json_free_parsed_response();
+    ASSERT(json_get_tool_calls(&calls) == 0);
+    return 0;
+}
+
+TEST(openai_calls_opened_before_their_input)
+{
+    const json_tool_call_t *calls = NULL;
+    const char *body =
+        "data: {\"choices\":[{\"delta\":{\"tool_calls\":[{\"index\":0,\"id\":\"call_a\","
+            "\"function\":{\"name\":\"gpio_read\",\"arguments\":\"\"}},"
+            "{\"index\":1,\"id\":\"call_b\",\"function\":{\"name\":\"get_time\",\"arguments\":\"\"}}]}}]}\n"
+        "data: {\"choices\":[{\"delta\":{\"tool_calls\":[{\"index\":1,"
+            "\"function\":{\"arguments\":\"{}\"}}]}}]}\n"
+        "data: {\"choices\":[{\"delta\":{\"tool_calls\":[{\"index\":0,"
+            "\"function\":{\"arguments\":\"{\\\"pin\\\":4}\"}}]}}]}\n"
+        "data: [DONE]\n";
+
+    mock_llm_set_backend(LLM_BACKEND_OPENAI, "gpt-test");
+    reset_stream(true);
+    feed_sliced(body, 11);
+
+    ASSERT(s_stream.tool_count == 2);
+    ASSERT(llm_stream_finish(&s_stream));
+    ASSERT(json_get_tool_calls(&calls) == 2);
+    ASSERT_STR_EQ(calls[0].id, "call_a");
+    ASSERT(cJSON_GetObjectItem(calls[0].input, "pin")->valueint == 4);
+    ASSERT_STR_EQ(calls[1].name, "get_time");
+    ASSERT(cJSON_IsObject(calls[1].input) && calls[1].input->child == NULL);
+    json_free_parsed_response();
+    return 0;
+}
+
+TEST(empty_stream_fails)
+{
+    reset_stream(true);
+    feed_sliced(": ping\n\n", 3);
+    ASSERT(!llm_stream_finish(&s_stream));
+    return 0;
+}
+
+TEST(oversized_line_marks_truncated)
+{
+    char body[LLM_STREAM_LINE_BUF_SIZE + 64];
+
+    reset_stream(true);
+    memset(body, 'x', sizeof(body) - 2);
+    memcpy(body, "data: ", 6);
+    body[sizeof(body) - 2] = '\n';
+    body[sizeof(body) - 1] = '\0';
+    feed_sliced(body, 100);
+    feed_sliced("data: {\"choices\":[{\"delta\":{\"content\":\"ok\"}}]}\n", 100);
+
+    ASSERT(s_stream.truncated);
+    ASSERT_STR_EQ(s_deltas, "ok");
+    return 0;
+}
+
+TEST(text_past_the_buffer_is_cut_not_failed)
+{
+    static char text[MAX_MESSAGE_LEN];
+    char event[256];
+    char part[101];
+
+    s_deltas[0] = '\0';
+    s_delta_count = 0;
+    llm_stream_init(&s_stream, false, text, sizeof(text), collect_text, NULL);
+
+    // Twelve 100-byte deltas: a 1200-byte answer.
+    memset(part, 'a', sizeof(part) - 1);
+    part[sizeof(part) - 1] = '\0';
+    for (int i = 0; i < 12; i++) {
+        snprintf(event, sizeof(event),
+                 "data: {\"type\":\"content_block_delta\",\"index\":0,"
+                 "\"delta\":{\"type\":\"text_delta\",\"text\":\"%s\"}}\n\n", part);
+        feed_sliced(event, 64);
+    }
+    feed_sliced("data: {\"type\":\"message_stop\"}\n\n", 64);
+
+    ASSERT(llm_stream_finish(&s_stream));
+    ASSERT(s_stream.text_truncated);
+    ASSERT(!s_stream.truncated);
+    ASSERT(strlen(text) == sizeof(text) - 1);
+    json_free_parsed_response();
+    return 0;
+}
+
+int test_llm_stream_all(void)
+{
+    int failures = 0;
+
+    printf("\nLLM Stream Tests:\n");
+
+    printf("  anthropic_text_stream... ");
+    if (test_anthropic_text_stream() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  anthropic_tool_use_assembled... ");
+    if (test_anthropic_tool_use_assembled() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  stream_cut_inside_tool_call_fails... ");
+    if (test_stream_cut_inside_tool_call_fails() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  anthropic_error_event... ");
+    if (test_anthropic_error_event() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  openai_text_and_tool_call... ");
+    if (test_openai_text_and_tool_call() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  openai_parallel_tool_calls... ");
+    if (test_openai_parallel_tool_calls() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  openai_calls_opened_before_their_input... ");
+    if (test_openai_calls_opened_before_their_input() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  empty_stream_fails... ");
+    if (test_empty_stream_fails() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  text_past_the_buffer_is_cut_not_failed... ");
+    if (test_text_past_the_buffer_is_cut_not_failed() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  oversized_line_marks_truncated... ");
+    if (test_oversized_line_marks_truncated() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
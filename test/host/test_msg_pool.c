@@ -0,0 +1,174 @@
+/*
+ * Host tests for the refcounted message pool.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "msg_pool.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+TEST(fan_out_shares_one_buffer)
+{
+    msg_pool_stats_t stats;
+
+    msg_pool_test_reset();
+    msg_buf_t *buf = msg_pool_copy("hello", 5);
+    ASSERT(buf != NULL);
+    ASSERT(buf->len == 5 && strcmp(buf->text, "hello") == 0);
+
+    // One reference per queue, then the producer drops its own.
+    ASSERT(msg_pool_retain(buf) == buf);
+    ASSERT(msg_pool_retain(buf) == buf);
+    msg_pool_release(buf);
+    msg_pool_get_stats(&stats);
+    ASSERT(stats.allocs == 1 && stats.bytes_in_use > 0);
+
+    msg_pool_release(buf);
+    msg_pool_get_stats(&stats);
+    ASSERT(stats.bytes_in_use > 0);
+    msg_pool_release(buf);
+    msg_pool_get_stats(&stats);
+    ASSERT(stats.bytes_in_use == 0);
+    ASSERT(stats.bytes_in_use_peak > 0);
+    msg_pool_release(NULL);
+    return 0;
+}
+
+TEST(released_buffers_are_reused)
+{
+    msg_pool_stats_t stats;
+
+    msg_pool_test_reset();
+    msg_buf_t *first = msg_pool_alloc(40);
+    ASSERT(first != NULL);
+    msg_pool_release(first);
+    msg_pool_get_stats(&stats);
+    size_t reserved = stats.bytes_reserved;
+
+    msg_buf_t *second = msg_pool_copy("again", 5);
+    ASSERT(second == first);
+    ASSERT(strcmp(second->text, "again") == 0);
+    msg_pool_get_stats(&stats);
+    ASSERT(stats.bytes_reserved == reserved);
+    ASSERT(stats.allocs == 2);
+    msg_pool_release(second);
+    return 0;
+}
+
+TEST(size_classes_and_truncation)
+{
+    char *big = malloc(TELEGRAM_MAX_MSG_LEN + 100);
+    ASSERT(big != NULL);
+    memset(big, 'x', TELEGRAM_MAX_MSG_LEN + 100);
+
+    msg_pool_test_reset();
+    msg_buf_t *small = msg_pool_alloc(100);
+    msg_buf_t *line = msg_pool_alloc(INPUT_MAX_LEN);
+    msg_buf_t *huge = msg_pool_copy(big, TELEGRAM_MAX_MSG_LEN + 100);
+    free(big);
+    ASSERT(small != NULL && line != NULL && huge != NULL);
+
+    ASSERT(small->size >= 101 && small->size < 512);
+    ASSERT(line->size == INPUT_MAX_LEN + 1);
+    ASSERT(huge->size == TELEGRAM_MAX_MSG_LEN);
+    ASSERT(huge->len == TELEGRAM_MAX_MSG_LEN - 1);
+    ASSERT(huge->text[huge->len] == '\0');
+
+    ASSERT(msg_pool_append(small, "abc", 3));
+    ASSERT(msg_pool_append(small, "def", 3));
+    ASSERT(small->len == 6 && strcmp(small->text, "abcdef") == 0);
+    ASSERT(!msg_pool_append(huge, "y", 1));
+
+    msg_pool_release(small);
+    msg_pool_release(line);
+    msg_pool_release(huge);
+    return 0;
+}
+
+TEST(budget_is_shared_across_size_classes)
+{
+    msg_buf_t *held[MSG_POOL_BYTES / TELEGRAM_MAX_MSG_LEN + 1];
+    msg_pool_stats_t stats;
+    int count = 0;
+
+    msg_pool_test_reset();
+    while (count < (int)(sizeof(held) / sizeof(held[0]))) {
+        held[count] = msg_pool_alloc(TELEGRAM_MAX_MSG_LEN);
+        if (!held[count]) {
+            break;
+        }
+        count++;
+    }
+    ASSERT(count > 0 && count < (int)(sizeof(held) / sizeof(held[0])));
+    msg_pool_get_stats(&stats);
+    ASSERT(stats.failures == 1);
+    ASSERT(stats.bytes_reserved <= MSG_POOL_BYTES);
+
+    // Nothing is given back while the buffers are in use.
+    ASSERT(msg_pool_alloc(TELEGRAM_MAX_MSG_LEN) == NULL);
+
+    // Once released, the cached large blocks give way to another class.
+    for (int i = 0; i < count; i++) {
+        msg_pool_release(held[i]);
+    }
+    msg_buf_t *lines[MSG_POOL_BYTES / (INPUT_MAX_LEN + 1 + 64)];
+    int line_count = (int)(sizeof(lines) / sizeof(lines[0]));
+    for (int i = 0; i < line_count; i++) {
+        lines[i] = msg_pool_alloc(INPUT_MAX_LEN);
+        ASSERT(lines[i] != NULL);
+    }
+    msg_pool_get_stats(&stats);
+    ASSERT(stats.failures == 2);
+    ASSERT(stats.bytes_reserved <= MSG_POOL_BYTES);
+    for (int i = 0; i < line_count; i++) {
+        msg_pool_release(lines[i]);
+    }
+    return 0;
+}
+
+int test_msg_pool_all(void)
+{
+    int failures = 0;
+
+    printf("\nMessage Pool Tests:\n");
+
+    printf("  fan_out_shares_one_buffer... ");
+    if (test_fan_out_shares_one_buffer() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  released_buffers_are_reused... ");
+    if (test_released_buffers_are_reused() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  size_classes_and_truncation... ");
+    if (test_size_classes_and_truncation() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  budget_is_shared_across_size_classes... ");
+    if (test_budget_is_shared_across_size_classes() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
@@ -15,6 +15,17 @@ extern int test_memory_keys_all(void);
 extern int test_telegram_update_all(void);
 extern int test_agent_all(void);
 extern int test_tools_gpio_policy_all(void);
+extern int test_llm_stream_all(void);
+extern int test_json_writer_all(void);
+extern int test_json_pull_all(void);
+extern int test_history_all(void);
+extern int test_token_estimate_all(void);
+extern int test_session_all(void);
+extern int test_buffers_all(void);
+extern int test_input_sched_all(void);
+extern int test_msg_pool_all(void);
+extern int test_command_router_all(void);
+extern int test_tool_script_all(void);
 
 int main(int argc, char *argv[])
 {
@@ -33,6 +44,17 @@ int main(int argc, char *argv[])
     failures += test_telegram_update_all();
     failures += test_agent_all();
     failures += test_tools_gpio_policy_all();
+    failures += test_llm_stream_all();
+    failures += test_json_writer_all();
+    failures += test_json_pull_all();
+    failures += test_history_all();
+    failures += test_token_estimate_all();
+    failures += test_session_all();
+    failures += test_buffers_all();
+    failures += test_input_sched_all();
+    failures += test_msg_pool_all();
+    failures += test_command_router_all();
+    failures += test_tool_script_all();
 
     printf("\n===================\n");
     if (failures == 0) {
@@ -0,0 +1,152 @@
+/*
+ * Host tests for per-origin conversation sessions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "session.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static int push_user(history_t *history, const char *text)
+{
+    conversation_msg_t msg = {.role = "user", .content = text, .tool_id = "", .tool_name = ""};
+    return history_push(history, &msg);
+}
+
+TEST(sessions_are_keyed_by_origin)
+{
+    bool created = false;
+
+    session_test_reset();
+    history_t *serial = session_get(MSG_SOURCE_SERIAL, 0, &created);
+    ASSERT(serial != NULL && created);
+    push_user(serial, "hello from serial");
+
+    history_t *telegram = session_get(MSG_SOURCE_TELEGRAM, 12345, &created);
+    ASSERT(telegram != NULL && created && telegram != serial);
+    ASSERT(history_count(telegram) == 0);
+
+    // Cron is a separate origin, shared by all cron entries.
+    history_t *cron_1 = session_get(MSG_SOURCE_CRON, 1, &created);
+    ASSERT(cron_1 != NULL && created && cron_1 != serial && cron_1 != telegram);
+    ASSERT(session_get(MSG_SOURCE_CRON, 1, &created) == cron_1 && !created);
+    ASSERT(session_get(MSG_SOURCE_CRON, 2, &created) == cron_1 && !created);
+
+    ASSERT(session_get(MSG_SOURCE_SERIAL, 0, &created) == serial && !created);
+    ASSERT(history_count(serial) == 1);
+    ASSERT(strcmp(history_messages(serial)[0].content, "hello from serial") == 0);
+    ASSERT(session_count() == 3);
+    session_test_reset();
+    ASSERT(session_count() == 0);
+    return 0;
+}
+
+TEST(memory_cap_evicts_least_recently_used)
+{
+    bool created = false;
+    int capacity = session_capacity();
+
+    ASSERT(capacity >= 1 && capacity <= SESSION_MAX_COUNT);
+    ASSERT((size_t)capacity * sizeof(history_t) <= SESSION_MEMORY_CAP || capacity == 1);
+
+    session_test_reset();
+    history_t *serial = session_get(MSG_SOURCE_SERIAL, 0, &created);
+    push_user(serial, "keep me");
+    for (int id = 1; id < capacity; id++) {
+        ASSERT(session_get(MSG_SOURCE_TELEGRAM, id, &created) != NULL && created);
+    }
+    ASSERT(session_count() == capacity);
+
+    // Touch serial: the oldest chat is the LRU session now.
+    ASSERT(session_get(MSG_SOURCE_SERIAL, 0, &created) == serial);
+    ASSERT(session_get(MSG_SOURCE_TELEGRAM, 100, &created) != NULL && created);
+    ASSERT(session_count() == capacity);
+    ASSERT(session_get(MSG_SOURCE_SERIAL, 0, &created) == serial && !created);
+    ASSERT(strcmp(history_messages(serial)[0].content, "keep me") == 0);
+
+    if (capacity > 1) {
+        // The evicted chat starts over empty.
+        history_t *chat = session_get(MSG_SOURCE_TELEGRAM, 1, &created);
+        ASSERT(chat != NULL && created && history_count(chat) == 0);
+    }
+    session_test_reset();
+    return 0;
+}
+
+TEST(cron_never_evicts_interactive_sessions)
+{
+    bool created = false;
+    int capacity = session_capacity();
+
+    session_test_reset();
+    history_t *serial = session_get(MSG_SOURCE_SERIAL, 0, &created);
+    push_user(serial, "keep me");
+    for (int id = 1; id < capacity; id++) {
+        ASSERT(session_get(MSG_SOURCE_TELEGRAM, id, &created) != NULL && created);
+    }
+
+    // Every slot holds a conversation: cron gets none rather than erase one.
+    ASSERT(session_get(MSG_SOURCE_CRON, 1, &created) == NULL && !created);
+    ASSERT(session_count() == capacity);
+    ASSERT(session_get(MSG_SOURCE_SERIAL, 0, &created) == serial && !created);
+    ASSERT(strcmp(history_messages(serial)[0].content, "keep me") == 0);
+
+    // With a slot free, cron takes it, and an interactive origin may still
+    // displace cron.
+    if (capacity < 2) {
+        session_test_reset();
+        return 0;
+    }
+    session_test_reset();
+    serial = session_get(MSG_SOURCE_SERIAL, 0, &created);
+    for (int id = 1; id < capacity - 1; id++) {
+        ASSERT(session_get(MSG_SOURCE_TELEGRAM, id, &created) != NULL);
+    }
+    history_t *cron = session_get(MSG_SOURCE_CRON, 3, &created);
+    ASSERT(cron != NULL && created);
+    ASSERT(session_get(MSG_SOURCE_CRON, 4, &created) == cron && !created);
+    ASSERT(session_get(MSG_SOURCE_SERIAL, 0, &created) == serial);
+    ASSERT(session_get(MSG_SOURCE_TELEGRAM, 100, &created) != NULL && created);
+    ASSERT(session_count() == capacity);
+    ASSERT(session_get(MSG_SOURCE_SERIAL, 0, &created) == serial && !created);
+    session_test_reset();
+    return 0;
+}
+
+int test_session_all(void)
+{
+    int failures = 0;
+
+    printf("\nSession Tests:\n");
+
+    printf("  sessions_are_keyed_by_origin... ");
+    if (test_sessions_are_keyed_by_origin() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  memory_cap_evicts_least_recently_used... ");
+    if (test_memory_cap_evicts_least_recently_used() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  cron_never_evicts_interactive_sessions... ");
+    if (test_cron_never_evicts_interactive_sessions() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
@@ -1,9 +1,11 @@
 /*
- * Host tests for Telegram update_id parsing helpers.
+ * Host tests for Telegram update_id parsing helpers and the getUpdates extractor.
  */
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include "telegram_update.h"
 
@@ -60,6 +62,199 @@ TEST(parse_invalid_input)
     return 0;
 }
 
+typedef struct {
+    int count;
+    int stop_after;
+    int64_t ids[8];
+    int64_t chats[8];
+    char texts[8][64];
+    bool has_text[8];
+    bool truncated[8];
+    size_t text_len[8];
+} collected_t;
+
+static bool collect_update(const telegram_update_t *update, const char *text, void *user_ctx)
+{
+    collected_t *c = (collected_t *)user_ctx;
+
+    if (c->count < 8) {
+        c->ids[c->count] = update->has_id ? update->update_id : -1;
+        c->chats[c->count] = update->has_chat ? update->chat_id : 0;
+        snprintf(c->texts[c->count], sizeof(c->texts[c->count]), "%s", text);
+        c->has_text[c->count] = update->has_text;
+        c->truncated[c->count] = update->text_truncated;
+        c->text_len[c->count] = strlen(text);
+    }
+    c->count++;
+    return c->stop_after == 0 || c->count < c->stop_after;
+}
+
+static int feed_all(const char *body, size_t len, collected_t *c, bool *done)
+{
+    telegram_update_stream_t *stream = malloc(sizeof(*stream));
+
+    if (!stream) {
+        return 1;
+    }
+    telegram_update_stream_init(stream, collect_update, c);
+    telegram_update_stream_feed(stream, body, len);
+    *done = stream->result_done;
+    free(stream);
+    return 0;
+}
+
+TEST(stream_message_fields)
+{
+    collected_t c = {0};
+    bool done = false;
+    const char *body =
+        "{\"ok\":true,\"result\":[{\"update_id\":5000000001,\"message\":{\"message_id\":7,"
+        "\"from\":{\"id\":1,\"first_name\":\"A\"},"
+        "\"reply_to_message\":{\"chat\":{\"id\":9},\"text\":\"old\"},"
+        "\"chat\":{\"id\":-1001234567890123,\"type\":\"group\"},"
+        "\"text\":\"gpio \\\"5\\\" on\\n\\u00e9\\ud83d\\ude00\"}},"
+        "{\"update_id\":3,\"message\":{\"chat\":{\"id\":1},\"photo\":[{\"text\":\"x\"}]}},"
+        "{\"message\":{}}]}";
+
+    ASSERT(feed_all(body, strlen(body), &c, &done) == 0);
+    ASSERT(done);
+    ASSERT(c.count == 3);
+    ASSERT(c.ids[0] == 5000000001LL);
+    ASSERT(c.chats[0] == -1001234567890123LL);
+    ASSERT(c.has_text[0] && !c.truncated[0]);
+    ASSERT(strcmp(c.texts[0], "gpio \"5\" on\n\xc3\xa9\xf0\x9f\x98\x80") == 0);
+    ASSERT(c.ids[1] == 3 && c.chats[1] == 1);
+    ASSERT(!c.has_text[1]);
+    ASSERT(c.ids[2] == -1 && c.chats[2] == 0);
+    return 0;
+}
+
+TEST(stream_splits_batch_across_chunks)
+{
+    const char *body =
+        "{\"ok\":true,\"result\":[\n"
+        "{\"update_id\":10,\"message\":{\"chat\":{\"id\":1},\"text\":\"a } ] {\"}},"
+        "{\"update_id\":11,\"message\":{\"chat\":{\"id\":1},\"text\":\"quote \\\" ]\"}},"
+        "{\"update_id\":12,\"message\":{\"chat\":{\"id\":1},\"text\":\"c\"}}"
+        "]}";
+    size_t len = strlen(body);
+
+    // Every chunk size, including one byte at a time.
+    for (size_t chunk = 1; chunk <= len; chunk++) {
+        telegram_update_stream_t *stream = malloc(sizeof(*stream));
+        collected_t c = {0};
+        ASSERT(stream);
+        telegram_update_stream_init(stream, collect_update, &c);
+        for (size_t off = 0; off < len; off += chunk) {
+            size_t n = (len - off < chunk) ? len - off : chunk;
+            telegram_update_stream_feed(stream, body + off, n);
+        }
+        bool done = stream->result_done;
+        free(stream);
+
+        ASSERT(done);
+        ASSERT(c.count == 3);
+        ASSERT(c.ids[0] == 10 && c.ids[1] == 11 && c.ids[2] == 12);
+        ASSERT(strcmp(c.texts[0], "a } ] {") == 0);
+        ASSERT(strcmp(c.texts[1], "quote \" ]") == 0);
+        ASSERT(c.chats[2] == 1 && !c.truncated[2]);
+    }
+    return 0;
+}
+
+TEST(stream_text_after_large_reply)
+{
+    static char body[8192];
+    collected_t c = {0};
+    bool done = false;
+    int len;
+
+    // The quoted message is longer than any buffer; the text after it still counts.
+    len = snprintf(body, sizeof(body),
+                   "{\"ok\":true,\"result\":[{\"update_id\":20,\"message\":{"
+                   "\"reply_to_message\":{\"chat\":{\"id\":2},\"text\":\"");
+    memset(body + len, 'x', 6000);
+    len += 6000;
+    len += snprintf(body + len, sizeof(body) - (size_t)len,
+                    "\"},\"chat\":{\"id\":1},\"text\":\"hi\"}},"
+                    "{\"update_id\":21,\"message\":{\"chat\":{\"id\":1},\"text\":\"next\"}}]}");
+
+    ASSERT(feed_all(body, (size_t)len, &c, &done) == 0);
+    ASSERT(done);
+    ASSERT(c.count == 2);
+    ASSERT(c.ids[0] == 20 && c.chats[0] == 1);
+    ASSERT(c.has_text[0] && !c.truncated[0]);
+    ASSERT(strcmp(c.texts[0], "hi") == 0);
+    ASSERT(c.ids[1] == 21);
+    ASSERT(strcmp(c.texts[1], "next") == 0);
+    return 0;
+}
+
+TEST(stream_long_text_is_flagged)
+{
+    static char body[8192];
+    collected_t c = {0};
+    bool done = false;
+    int len;
+
+    // Each é decodes to two bytes, so 600 of them overflow INPUT_MAX_LEN.
+    len = snprintf(body, sizeof(body),
+                   "{\"ok\":true,\"result\":[{\"update_id\":30,\"message\":{"
+                   "\"chat\":{\"id\":1},\"text\":\"");
+    for (int i = 0; i < 600; i++) {
+        len += snprintf(body + len, sizeof(body) - (size_t)len, "\\u00e9");
+    }
+    len += snprintf(body + len, sizeof(body) - (size_t)len,
+                    "\"}},{\"update_id\":31,\"message\":{\"chat\":{\"id\":1},\"text\":\"ok\"}}]}");
+
+    ASSERT(feed_all(body, (size_t)len, &c, &done) == 0);
+    ASSERT(done);
+    ASSERT(c.count == 2);
+    ASSERT(c.ids[0] == 30 && c.has_text[0] && c.truncated[0]);
+    ASSERT(c.text_len[0] <= INPUT_MAX_LEN && c.text_len[0] % 2 == 0);
+    ASSERT(c.ids[1] == 31 && !c.truncated[1]);
+    ASSERT(strcmp(c.texts[1], "ok") == 0);
+    return 0;
+}
+
+TEST(stream_stops_when_asked)
+{
+    const char *body =
+        "{\"ok\":true,\"result\":[{\"update_id\":1},{\"update_id\":2},{\"update_id\":3}]}";
+    telegram_update_stream_t *stream = malloc(sizeof(*stream));
+    collected_t c = {.stop_after = 2};
+
+    ASSERT(stream);
+    telegram_update_stream_init(stream, collect_update, &c);
+    telegram_update_stream_feed(stream, body, strlen(body));
+    bool stopped = stream->stopped;
+    bool done = stream->result_done;
+    free(stream);
+
+    ASSERT(stopped && !done);
+    ASSERT(c.count == 2);
+    ASSERT(c.ids[1] == 2);
+    return 0;
+}
+
+TEST(stream_ignores_other_arrays)
+{
+    const char *body = "{\"ok\":false,\"error_code\":409,\"description\":\"[{}]\","
+                       "\"parameters\":[{\"update_id\":4}]}";
+    telegram_update_stream_t *stream = malloc(sizeof(*stream));
+    collected_t c = {0};
+
+    ASSERT(stream);
+    telegram_update_stream_init(stream, collect_update, &c);
+    telegram_update_stream_feed(stream, body, strlen(body));
+    bool done = stream->result_done;
+    free(stream);
+
+    ASSERT(!done);
+    ASSERT(c.count == 0);
+    return 0;
+}
+
 int test_telegram_update_all(void)
 {
     int failures = 0;
@@ -101,5 +296,47 @@ int test_telegram_update_all(void)
         failures++;
     }
 
+    printf("  stream_message_fields... ");
+    if (test_stream_message_fields() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  stream_splits_batch_across_chunks... ");
+    if (test_stream_splits_batch_across_chunks() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  stream_text_after_large_reply... ");
+    if (test_stream_text_after_large_reply() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  stream_long_text_is_flagged... ");
+    if (test_stream_long_text_is_flagged() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  stream_stops_when_asked... ");
+    if (test_stream_stops_when_asked() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  stream_ignores_other_arrays... ");
+    if (test_stream_ignores_other_arrays() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
     return failures;
 }
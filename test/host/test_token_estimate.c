@@ -0,0 +1,93 @@
+/*
+ * Host tests for the on-device token estimator.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "token_estimate.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static size_t estimate(const char *text)
+{
+    return token_estimate(text, strlen(text));
+}
+
+TEST(words_numbers_and_punctuation)
+{
+    ASSERT(token_estimate(NULL, 10) == 0);
+    ASSERT(estimate("") == 0);
+    ASSERT(estimate("Turn on the porch light") == 5);
+    ASSERT(estimate("a    b") == 3);
+    ASSERT(estimate("123") == 1);
+    ASSERT(estimate("2024") == 2);
+    ASSERT(estimate("{\"pin\":5}") == 5);
+    ASSERT(estimate("\"},{\"") == 2);
+    // Long identifiers split into several tokens.
+    ASSERT(estimate("toolu_abcdefghijklmnop") == 5);
+    return 0;
+}
+
+TEST(escapes_and_utf8)
+{
+    ASSERT(estimate("\\n\\\"") == 2);
+    ASSERT(estimate("\\u00e9x") == 2);
+    ASSERT(estimate("Done \xe2\x9c\x85 caf\xc3\xa9") == 4);
+    // Only len bytes are read.
+    ASSERT(token_estimate("hello world", 5) == 1);
+    return 0;
+}
+
+TEST(prose_and_json_ratios)
+{
+    const char *prose =
+        "Please turn on the porch light and tell me the temperature outside. "
+        "It should be on until midnight, then switch off again.";
+    const char *json =
+        "{\"role\":\"assistant\",\"content\":[{\"type\":\"tool_use\",\"id\":\"toolu_01\","
+        "\"name\":\"gpio_write\",\"input\":{\"pin\":5,\"state\":1}}]}";
+
+    // About 4-5 bytes per token for English, fewer for JSON.
+    size_t prose_tokens = estimate(prose);
+    size_t json_tokens = estimate(json);
+    ASSERT(prose_tokens * 3 <= strlen(prose) && prose_tokens * 6 >= strlen(prose));
+    ASSERT(json_tokens * 2 <= strlen(json) && json_tokens * 4 >= strlen(json));
+    return 0;
+}
+
+int test_token_estimate_all(void)
+{
+    int failures = 0;
+
+    printf("\nToken Estimate Tests:\n");
+
+    printf("  words_numbers_and_punctuation... ");
+    if (test_words_numbers_and_punctuation() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  escapes_and_utf8... ");
+    if (test_escapes_and_utf8() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  prose_and_json_ratios... ");
+    if (test_prose_and_json_ratios() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}
@@ -0,0 +1,200 @@
+/*
+ * Host tests for tool scripts (user tool recordings, scripted cron entries).
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tool_script.h"
+#include "mock_tools.h"
+
+#define TEST(name) static int test_##name(void)
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d)\n", #cond, __LINE__); \
+        return 1; \
+    } \
+} while(0)
+
+static const tool_def_t s_defs[] = {
+    { .name = "gpio_write" },
+    { .name = "gpio_read" },
+    { .name = "delay" },
+    { .name = "cron_delete" },
+    { .name = "create_tool" },
+};
+
+static int parse_in(tool_script_scope_t scope, const char *json, tool_step_t *steps,
+                    char *error, size_t error_len)
+{
+    cJSON *script = cJSON_Parse(json);
+    int count = tool_script_parse(script, scope, steps, TOOL_SCRIPT_MAX_STEPS, error, error_len);
+    cJSON_Delete(script);
+    return count;
+}
+
+static int parse(const char *json, tool_step_t *steps, char *error, size_t error_len)
+{
+    return parse_in(TOOL_SCRIPT_AGENT, json, steps, error, error_len);
+}
+
+TEST(parse_validates_and_round_trips)
+{
+    tool_step_t steps[TOOL_SCRIPT_MAX_STEPS];
+    char error[96];
+    char json[CRON_MAX_SCRIPT_LEN];
+
+    mock_tools_reset();
+    mock_tools_set_defs(s_defs, 2);
+
+    ASSERT(parse("[{\"tool\":\"gpio_write\",\"input\":{\"pin\":4,\"state\":1}},"
+                 "{\"tool\":\"gpio_read\"}]", steps, error, sizeof(error)) == 2);
+    ASSERT(strcmp(steps[0].tool, "gpio_write") == 0);
+    ASSERT(strcmp(steps[0].input, "{\"pin\":4,\"state\":1}") == 0);
+    ASSERT(strcmp(steps[1].input, "{}") == 0);
+
+    ASSERT(tool_script_to_json(steps, 2, json, sizeof(json)));
+    ASSERT(strcmp(json, "[{\"tool\":\"gpio_write\",\"input\":{\"pin\":4,\"state\":1}},"
+                        "{\"tool\":\"gpio_read\",\"input\":{}}]") == 0);
+    ASSERT(!tool_script_to_json(steps, 2, json, 40));
+
+    ASSERT(parse("{\"tool\":\"gpio_read\"}", steps, error, sizeof(error)) == -1);
+    ASSERT(parse("[]", steps, error, sizeof(error)) == -1);
+    ASSERT(parse("[{\"tool\":\"self_destruct\"}]", steps, error, sizeof(error)) == -1);
+    ASSERT(strstr(error, "step 1") != NULL);
+    ASSERT(parse("[{\"tool\":\"gpio_read\"},{\"tool\":\"gpio_read\",\"input\":5}]",
+                 steps, error, sizeof(error)) == -1);
+    ASSERT(strstr(error, "step 2") != NULL);
+    ASSERT(parse("[{\"tool\":\"gpio_read\"},{\"tool\":\"gpio_read\"},{\"tool\":\"gpio_read\"},"
+                 "{\"tool\":\"gpio_read\"},{\"tool\":\"gpio_read\"}]", steps, error, sizeof(error)) == -1);
+    ASSERT(parse("[{\"tool\":\"gpio_write\",\"input\":{\"note\":\"................................."
+                 "..............................................................\"}}]",
+                 steps, error, sizeof(error)) == -1);
+    ASSERT(strstr(error, "too long") != NULL);
+    return 0;
+}
+
+TEST(cron_scripts_only_take_side_effect_safe_tools)
+{
+    tool_step_t steps[TOOL_SCRIPT_MAX_STEPS];
+    char error[128];
+
+    mock_tools_reset();
+    mock_tools_set_defs(s_defs, 5);
+
+    ASSERT(parse_in(TOOL_SCRIPT_CRON, "[{\"tool\":\"gpio_write\",\"input\":{\"pin\":4}}]",
+                    steps, error, sizeof(error)) == 1);
+    ASSERT(parse_in(TOOL_SCRIPT_CRON, "[{\"tool\":\"gpio_read\"},{\"tool\":\"delay\"}]",
+                    steps, error, sizeof(error)) == -1);
+    ASSERT(strstr(error, "step 2: delay") != NULL);
+    ASSERT(parse_in(TOOL_SCRIPT_CRON, "[{\"tool\":\"cron_delete\"}]",
+                    steps, error, sizeof(error)) == -1);
+    ASSERT(parse_in(TOOL_SCRIPT_CRON, "[{\"tool\":\"create_tool\"}]",
+                    steps, error, sizeof(error)) == -1);
+
+    // The agent task may still plan with them.
+    ASSERT(parse("[{\"tool\":\"gpio_write\"},{\"tool\":\"delay\"},{\"tool\":\"cron_delete\"}]",
+                 steps, error, sizeof(error)) == 3);
+    return 0;
+}
+
+TEST(run_stops_at_first_failure)
+{
+    tool_step_t steps[TOOL_SCRIPT_MAX_STEPS];
+    char error[96];
+    char result[64];
+
+    mock_tools_reset();
+    mock_tools_set_defs(s_defs, 2);
+    ASSERT(parse("[{\"tool\":\"gpio_write\",\"input\":{\"pin\":4,\"state\":1}},"
+                 "{\"tool\":\"gpio_read\",\"input\":{\"pin\":4}}]", steps, error, sizeof(error)) == 2);
+
+    mock_tools_set_result("ok");
+    snprintf(result, sizeof(result), "Results:");
+    ASSERT(tool_script_run(steps, 2, result, sizeof(result)) == 2);
+    ASSERT(strcmp(result, "Results:\ngpio_write: ok\ngpio_read: ok") == 0);
+    ASSERT(mock_tools_execute_calls() == 2);
+    ASSERT(strcmp(mock_tools_last_input(), "{\"pin\":4}") == 0);
+
+    mock_tools_set_success(false);
+    result[0] = '\0';
+    ASSERT(tool_script_run(steps, 2, result, sizeof(result)) == 0);
+    ASSERT(mock_tools_execute_calls() == 3);
+
+    // A full result buffer truncates the text, not the run.
+    mock_tools_set_success(true);
+    mock_tools_set_result("a result long enough to fill the whole buffer by itself....");
+    result[0] = '\0';
+    ASSERT(tool_script_run(steps, 2, result, 24) == 2);
+    ASSERT(strlen(result) == 23);
+    ASSERT(mock_tools_execute_calls() == 5);
+    mock_tools_reset();
+    return 0;
+}
+
+TEST(json_scripts_run_without_copying_inputs)
+{
+    char error[128];
+    char result[96];
+    cJSON *script = cJSON_Parse(
+        "[{\"tool\":\"gpio_write\",\"input\":{\"pin\":4,\"note\":\"................................."
+        "..............................................................\"}},"
+        "{\"tool\":\"gpio_read\"}]");
+
+    mock_tools_reset();
+    mock_tools_set_defs(s_defs, 5);
+    ASSERT(script);
+    ASSERT(tool_script_check(script, TOOL_SCRIPT_AGENT, 2, error, sizeof(error)) == 2);
+    ASSERT(tool_script_check(script, TOOL_SCRIPT_AGENT, 1, error, sizeof(error)) == -1);
+
+    mock_tools_set_result("ok");
+    snprintf(result, sizeof(result), "Results:");
+    ASSERT(tool_script_run_json(script, result, sizeof(result)) == 2);
+    ASSERT(strcmp(result, "Results:\ngpio_write: ok\ngpio_read: ok") == 0);
+    ASSERT(strcmp(mock_tools_last_input(), "{}") == 0);
+    cJSON_Delete(script);
+
+    script = cJSON_Parse("[{\"tool\":\"gpio_read\"},{\"tool\":\"delay\"}]");
+    ASSERT(tool_script_check(script, TOOL_SCRIPT_CRON, 4, error, sizeof(error)) == -1);
+    ASSERT(strstr(error, "step 2: delay") != NULL);
+    cJSON_Delete(script);
+    mock_tools_reset();
+    return 0;
+}
+
+int test_tool_script_all(void)
+{
+    int failures = 0;
+
+    printf("\nTool Script Tests:\n");
+
+    printf("  parse_validates_and_round_trips... ");
+    if (test_parse_validates_and_round_trips() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  cron_scripts_only_take_side_effect_safe_tools... ");
+    if (test_cron_scripts_only_take_side_effect_safe_tools() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  run_stops_at_first_failure... ");
+    if (test_run_stops_at_first_failure() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    printf("  json_scripts_run_without_copying_inputs... ");
+    if (test_json_scripts_run_without_copying_inputs() == 0) {
+        printf("OK\n");
+    } else {
+        failures++;
+    }
+
+    return failures;
+}